@@ -1,7 +1,9 @@
 #version 330 core
+in vec2 frag_uv;
 out vec4 out_color;
 uniform vec3 vcolor;
+uniform sampler2D diffuse;
 void main()
 {
-	out_color = vec4(vcolor, 1.0f);
+	out_color = texture(diffuse, frag_uv) * vec4(vcolor, 1.0f);
 }
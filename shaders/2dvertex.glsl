@@ -1,7 +1,10 @@
 #version 330 core
 layout (location = 0) in vec3 position;
+layout (location = 2) in vec2 uv;
+out vec2 frag_uv;
 uniform vec3 offset;
 void main()
 {
 	gl_Position = vec4(position + offset, 1.0);
+	frag_uv = uv;
 }
@@ -0,0 +1,9 @@
+#version 330 core
+in vec2 frag_uv;
+out vec4 out_color;
+uniform vec4 color;
+uniform sampler2D diffuse;
+void main()
+{
+	out_color = texture(diffuse, frag_uv) * color;
+}
@@ -0,0 +1,13 @@
+#version 330 core
+layout (location = 0) in vec2 position;
+layout (location = 1) in vec2 uv;
+// Per instance; reads as zero when the scene doesn't instance
+layout (location = 2) in vec2 instance_offset;
+out vec2 frag_uv;
+uniform vec2 offset;
+uniform float scale;
+void main()
+{
+	gl_Position = vec4(position * scale + offset + instance_offset, 0.0, 1.0);
+	frag_uv = uv;
+}
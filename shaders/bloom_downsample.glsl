@@ -0,0 +1,74 @@
+#version 450 core
+// The whole bloom chain in one dispatch. Each group takes a 64x64 tile of
+// the scene down to 32x32 texels of the chain's first level, keeping only
+// what's brighter than the threshold, then halves that in shared memory for
+// each level after. No group needs another's texels, so no level waits on
+// a dispatch of its own.
+layout (local_size_x = 16, local_size_y = 16) in;
+
+// BLOOM_LEVELS in PostChain.h, which the 32x32 tile can halve five times
+const int LEVELS = 6;
+const int TILE = 32;
+
+uniform sampler2D scene;
+uniform float threshold;
+uniform float knee; // width of the soft edge around the threshold
+layout (rgba16f, binding = 0) writeonly uniform image2D chain[LEVELS];
+
+// Levels ping-pong between these, the even ones in tile
+shared vec3 tile[TILE * TILE];
+shared vec3 half_tile[TILE * TILE / 4];
+
+vec3 bright_part(vec3 color)
+{
+	// Quadratic across the knee, so nothing pops in at the threshold
+	float brightness = max(color.r, max(color.g, color.b));
+	float soft = clamp(brightness - threshold + knee, 0.0, 2.0 * knee);
+	soft = soft * soft / (4.0 * knee + 1e-4);
+	return color * (max(soft, brightness - threshold) / max(brightness, 1e-4));
+}
+
+void main()
+{
+	ivec2 local = ivec2(gl_LocalInvocationID.xy);
+	ivec2 group = ivec2(gl_WorkGroupID.xy);
+
+	// Two by two texels of the first level each. The bilinear fetch from
+	// the corner the four scene texels share averages them.
+	vec2 scene_texel = 1.0 / vec2(textureSize(scene, 0));
+	for (int i = 0; i < 4; i++)
+	{
+		ivec2 texel = local * 2 + ivec2(i & 1, i >> 1);
+		ivec2 level_texel = group * TILE + texel;
+		vec3 color = bright_part(textureLod(scene, vec2(level_texel * 2 + 1) * scene_texel, 0.0).rgb);
+		tile[texel.y * TILE + texel.x] = color;
+		imageStore(chain[0], level_texel, vec4(color, 1.0));
+	}
+
+	int index = int(gl_LocalInvocationIndex);
+	for (int level = 1, size = TILE / 2; level < LEVELS; level++, size /= 2)
+	{
+		// Every texel of the level before is written, and every read of
+		// the one before that is done, so it can be written over
+		barrier();
+		if (index < size * size)
+		{
+			ivec2 texel = ivec2(index % size, index / size);
+			int first = texel.y * 2 * size * 2 + texel.x * 2;
+			int below = first + size * 2;
+			vec3 color;
+			if ((level & 1) == 1)
+			{
+				color = (tile[first] + tile[first + 1] + tile[below] + tile[below + 1]) * 0.25;
+				half_tile[index] = color;
+			}
+			else
+			{
+				color = (half_tile[first] + half_tile[first + 1] + half_tile[below]
+					+ half_tile[below + 1]) * 0.25;
+				tile[index] = color;
+			}
+			imageStore(chain[level], group * size + texel, vec4(color, 1.0));
+		}
+	}
+}
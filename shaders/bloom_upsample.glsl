@@ -0,0 +1,33 @@
+#version 450 core
+// Adds a level of the bloom chain, tent filtered, to the level above it.
+// Run from the smallest level up, the first level ends up with the glow of
+// every level, each spread wider than the last.
+layout (local_size_x = 8, local_size_y = 8) in;
+
+uniform sampler2D chain;
+uniform int source_level;
+layout (rgba16f, binding = 0) uniform image2D destination;
+
+void main()
+{
+	ivec2 texel = ivec2(gl_GlobalInvocationID.xy);
+	ivec2 size = imageSize(destination);
+	if (any(greaterThanEqual(texel, size)))
+	{
+		return;
+	}
+
+	// Nine bilinear taps a source texel apart, weighted 1 2 1
+	vec2 uv = (vec2(texel) + 0.5) / vec2(size);
+	vec2 step = 1.0 / vec2(textureSize(chain, source_level));
+	float lod = float(source_level);
+	vec3 sum = textureLod(chain, uv, lod).rgb * 4.0;
+	sum += (textureLod(chain, uv + vec2(-step.x, 0.0), lod).rgb
+		+ textureLod(chain, uv + vec2(step.x, 0.0), lod).rgb
+		+ textureLod(chain, uv + vec2(0.0, -step.y), lod).rgb
+		+ textureLod(chain, uv + vec2(0.0, step.y), lod).rgb) * 2.0;
+	sum += textureLod(chain, uv - step, lod).rgb + textureLod(chain, uv + step, lod).rgb
+		+ textureLod(chain, uv + vec2(-step.x, step.y), lod).rgb
+		+ textureLod(chain, uv + vec2(step.x, -step.y), lod).rgb;
+	imageStore(destination, texel, imageLoad(destination, texel) + vec4(sum / 16.0, 0.0));
+}
@@ -0,0 +1,202 @@
+#version 450 core
+// Tests every scene instance against the frustum and against last frame's
+// Hi-Z pyramid, and appends the survivors to the draws of their mesh
+layout (local_size_x = 64) in;
+
+// Laid out as glMultiDrawElementsIndirect reads it
+struct DrawCommand
+{
+	uint count;
+	uint instance_count;
+	uint first_index;
+	int base_vertex;
+	uint base_instance;
+};
+
+struct Mesh
+{
+	uint first_command;
+	uint command_count; // zero while the mesh isn't resident
+	uint first_instance; // of its slice of the visible instances
+	uint padding;
+};
+
+// What the model shader reads per instance at locations 4 and 5
+struct InstanceData
+{
+	vec4 position_scale;
+	vec4 rotation;
+};
+
+layout (std140, binding = 0) uniform CullParams
+{
+	vec4 frustum_planes[6];
+	mat4 previous_view_projection; // of the frame the pyramid is from
+	vec4 camera_position;
+	vec2 hiz_size; // of level 0, in pixels
+	uint instance_count;
+	uint hiz_levels; // zero without a pyramid
+	// Word offsets of the instance arrays: mesh, position xyz, rotation
+	// xyzw, scale, center xyz and radius
+	uvec4 components[4];
+};
+
+// The scene file's instance arrays, as they are on disk
+layout (std430, binding = 0) readonly buffer Instances { uint words[]; };
+layout (std430, binding = 1) readonly buffer Meshes { Mesh meshes[]; };
+layout (std430, binding = 2) buffer Commands { DrawCommand commands[]; };
+layout (std430, binding = 3) writeonly buffer Visible { InstanceData visible[]; };
+layout (std430, binding = 4) buffer Counters
+{
+	uint visible_count;
+	uint frustum_culled;
+	uint occlusion_culled;
+	uint drawn; // visible and resident
+	uvec2 mesh_stats[]; // visible, nearest distance as float bits
+};
+
+layout (binding = 15) uniform sampler2D hiz;
+
+shared uint group_visible;
+shared uint group_frustum_culled;
+shared uint group_occlusion_culled;
+shared uint group_drawn;
+
+float component(uint index, uint instance)
+{
+	return uintBitsToFloat(words[index + instance]);
+}
+
+bool in_frustum(vec3 center, float radius)
+{
+	for (int i = 0; i < 6; i++)
+	{
+		if (dot(frustum_planes[i].xyz, center) + frustum_planes[i].w < -radius)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+// Whether the sphere's bounding box was behind everything drawn last frame,
+// as last frame's camera saw it
+bool occluded(vec3 center, float radius)
+{
+	if (hiz_levels == 0u)
+	{
+		return false;
+	}
+
+	vec2 ndc_min = vec2(1.0);
+	vec2 ndc_max = vec2(-1.0);
+	float nearest = 1.0;
+	for (int i = 0; i < 8; i++)
+	{
+		vec3 corner = center + radius * vec3((i & 1) != 0 ? 1.0 : -1.0,
+			(i & 2) != 0 ? 1.0 : -1.0, (i & 4) != 0 ? 1.0 : -1.0);
+		vec4 clip = previous_view_projection * vec4(corner, 1.0);
+		// Reaching behind the camera, so the rectangle is unbounded
+		if (clip.w <= 0.0)
+		{
+			return false;
+		}
+		vec3 ndc = clip.xyz / clip.w;
+		ndc_min = min(ndc_min, ndc.xy);
+		ndc_max = max(ndc_max, ndc.xy);
+		nearest = min(nearest, ndc.z);
+	}
+	if (nearest <= -1.0)
+	{
+		return false;
+	}
+
+	// The level where the rectangle spans at most two texels each way, so
+	// four of them cover it
+	ivec2 last_pixel = ivec2(hiz_size) - 1;
+	ivec2 pixel_min = min(ivec2(clamp(ndc_min * 0.5 + 0.5, 0.0, 1.0) * hiz_size), last_pixel);
+	ivec2 pixel_max = min(ivec2(clamp(ndc_max * 0.5 + 0.5, 0.0, 1.0) * hiz_size), last_pixel);
+	ivec2 span = pixel_max - pixel_min + 1;
+	int level = min(int(ceil(log2(float(max(span.x, span.y))))), int(hiz_levels) - 1);
+
+	// Odd sized levels fold their last row and column into the texel
+	// before, so clamping to the last texel stays conservative
+	ivec2 last = max(ivec2(hiz_size) >> level, 1) - 1;
+	ivec2 texel_min = min(pixel_min >> level, last);
+	ivec2 texel_max = min(pixel_max >> level, last);
+	float farthest = max(
+		max(texelFetch(hiz, texel_min, level).r, texelFetch(hiz, ivec2(texel_max.x, texel_min.y), level).r),
+		max(texelFetch(hiz, ivec2(texel_min.x, texel_max.y), level).r, texelFetch(hiz, texel_max, level).r));
+	return nearest * 0.5 + 0.5 > farthest;
+}
+
+void main()
+{
+	if (gl_LocalInvocationIndex == 0u)
+	{
+		group_visible = 0u;
+		group_frustum_culled = 0u;
+		group_occlusion_culled = 0u;
+		group_drawn = 0u;
+	}
+	barrier();
+
+	// Dispatched in rows when there are more groups than fit in x
+	uint instance = (gl_WorkGroupID.y * gl_NumWorkGroups.x + gl_WorkGroupID.x) * gl_WorkGroupSize.x
+		+ gl_LocalInvocationIndex;
+	if (instance < instance_count)
+	{
+		vec3 center = vec3(component(components[2].y, instance),
+			component(components[2].z, instance), component(components[2].w, instance));
+		float radius = component(components[3].x, instance);
+
+		if (!in_frustum(center, radius))
+		{
+			atomicAdd(group_frustum_culled, 1u);
+		}
+		else if (occluded(center, radius))
+		{
+			atomicAdd(group_occlusion_culled, 1u);
+		}
+		else
+		{
+			atomicAdd(group_visible, 1u);
+
+			// For streaming and LOD selection, which happen on the CPU
+			uint mesh_index = words[components[0].x + instance];
+			float scale = component(components[2].x, instance);
+			float distance = length(camera_position.xyz - center) / scale;
+			atomicAdd(mesh_stats[mesh_index].x, 1u);
+			atomicMin(mesh_stats[mesh_index].y, floatBitsToUint(distance));
+
+			Mesh mesh = meshes[mesh_index];
+			if (mesh.command_count > 0u)
+			{
+				// Every submesh draws every instance, so their counts move
+				// together and the first hands out the slots
+				uint slot = atomicAdd(commands[mesh.first_command].instance_count, 1u);
+				for (uint i = 1u; i < mesh.command_count; i++)
+				{
+					atomicAdd(commands[mesh.first_command + i].instance_count, 1u);
+				}
+
+				visible[mesh.first_instance + slot] = InstanceData(
+					vec4(component(components[0].y, instance), component(components[0].z, instance),
+						component(components[0].w, instance), scale),
+					vec4(component(components[1].x, instance), component(components[1].y, instance),
+						component(components[1].z, instance), component(components[1].w, instance)));
+				atomicAdd(group_drawn, 1u);
+			}
+		}
+	}
+
+	// One global atomic per group rather than per instance
+	barrier();
+	if (gl_LocalInvocationIndex == 0u)
+	{
+		atomicAdd(visible_count, group_visible);
+		atomicAdd(frustum_culled, group_frustum_culled);
+		atomicAdd(occlusion_culled, group_occlusion_culled);
+		atomicAdd(drawn, group_drawn);
+	}
+}
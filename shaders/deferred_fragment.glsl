@@ -0,0 +1,40 @@
+#version 330 core
+// Lights the G-buffer: the sun, then the clustered lights of each pixel's
+// cluster, as model_fragment.glsl does for forward shading
+out vec4 out_color;
+uniform usampler2D gbuffer; // see gbuffer_fragment.glsl
+uniform sampler2D gbuffer_depth;
+uniform mat4 inverse_view_projection;
+uniform vec2 viewport_size;
+uniform vec3 light_direction;
+
+#include "include/view_depth.glsl"
+#include "include/clustered_lights.glsl"
+#include "include/sun_shadow.glsl"
+#include "include/octahedral.glsl"
+
+void main()
+{
+	ivec2 pixel = ivec2(gl_FragCoord.xy);
+	float depth = texelFetch(gbuffer_depth, pixel, 0).r;
+	// Nothing was drawn here, and the frame is already cleared
+	if (depth == 1.0)
+	{
+		discard;
+	}
+
+	uvec4 surface = texelFetch(gbuffer, pixel, 0);
+	vec4 albedo = vec4(uvec4(surface.x & 0xFFu, surface.x >> 8, surface.y & 0xFFu,
+		surface.y >> 8)) / 255.0;
+	vec3 normal = octahedral_decode(vec2(surface.zw) / 65535.0 * 2.0 - 1.0);
+
+	vec3 ndc = vec3(gl_FragCoord.xy / viewport_size, depth) * 2.0 - 1.0;
+	vec4 world = inverse_view_projection * vec4(ndc, 1.0);
+	vec3 position = world.xyz / world.w;
+
+	float depth_in_view = view_depth(ndc.z);
+	float n_dot_l = max(dot(normal, -light_direction), 0.0);
+	float shadow = sun_shadow(position, normal, depth_in_view);
+	out_color = vec4(albedo.rgb * (0.2 + 0.8 * n_dot_l * shadow
+		+ clustered_lights(position, normal, depth_in_view)), albedo.a);
+}
@@ -0,0 +1,6 @@
+#version 330 core
+// Depth only, for the pre-pass: the depth test does all the work
+
+void main()
+{
+}
@@ -0,0 +1,46 @@
+#version 330 core
+// FXAA in the spirit of Timothy Lottes' console version: the luma of the
+// four diagonal neighbours gives the direction of the local edge, and the
+// pixel is blurred along it with two taps, or four where the edge is long
+out vec4 out_color;
+uniform sampler2D source;
+
+float luma(vec3 color)
+{
+	return dot(clamp(color, 0.0, 1.0), vec3(0.299, 0.587, 0.114));
+}
+
+void main()
+{
+	vec2 texel = 1.0 / vec2(textureSize(source, 0));
+	vec2 uv = gl_FragCoord.xy * texel;
+	vec3 middle = textureLod(source, uv, 0.0).rgb;
+	float nw = luma(textureLod(source, uv + vec2(-0.5, 0.5) * texel, 0.0).rgb);
+	float ne = luma(textureLod(source, uv + vec2(0.5, 0.5) * texel, 0.0).rgb);
+	float sw = luma(textureLod(source, uv + vec2(-0.5, -0.5) * texel, 0.0).rgb);
+	float se = luma(textureLod(source, uv + vec2(0.5, -0.5) * texel, 0.0).rgb);
+	float m = luma(middle);
+	float luma_min = min(m, min(min(nw, ne), min(sw, se)));
+	float luma_max = max(m, max(max(nw, ne), max(sw, se)));
+
+	// Flat areas are left alone
+	if (luma_max - luma_min < max(0.0625, luma_max * 0.125))
+	{
+		out_color = vec4(middle, 1.0);
+		return;
+	}
+
+	// Across the luma gradient, stretched so the shorter axis is one texel
+	vec2 direction = vec2((sw + se) - (nw + ne), (ne + se) - (nw + sw));
+	float reduce = max((nw + ne + sw + se) * (0.25 / 8.0), 1.0 / 128.0);
+	float scale = 1.0 / (min(abs(direction.x), abs(direction.y)) + reduce);
+	direction = clamp(direction * scale, vec2(-8.0), vec2(8.0)) * texel;
+
+	vec3 near = 0.5 * (textureLod(source, uv - direction / 6.0, 0.0).rgb
+		+ textureLod(source, uv + direction / 6.0, 0.0).rgb);
+	vec3 far = near * 0.5 + 0.25 * (textureLod(source, uv - direction * 0.5, 0.0).rgb
+		+ textureLod(source, uv + direction * 0.5, 0.0).rgb);
+	// The far taps crossed into something else if they left the local range
+	float far_luma = luma(far);
+	out_color = vec4(far_luma < luma_min || far_luma > luma_max ? near : far, 1.0);
+}
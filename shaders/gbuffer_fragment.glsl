@@ -0,0 +1,31 @@
+#version 330 core
+// model_fragment.glsl without the lighting: the surface goes into the
+// G-buffer for deferred_fragment.glsl to light
+in vec3 frag_color;
+in vec2 frag_uv;
+in vec3 frag_normal;
+flat in int frag_material;
+out uvec4 out_surface; // albedo rg, albedo b and alpha, octahedral normal
+uniform samplerBuffer materials;
+uniform sampler2DArray diffuse_maps;
+
+#include "include/octahedral.glsl"
+
+void main()
+{
+	// Four texels per material, see GpuMaterial
+	vec4 diffuse = texelFetch(materials, frag_material * 4 + 0);
+	vec4 uv_transform = texelFetch(materials, frag_material * 4 + 2);
+	vec4 diffuse_map = texelFetch(materials, frag_material * 4 + 3);
+
+	vec3 albedo = diffuse.rgb * frag_color;
+	if (diffuse_map.y > 0.5)
+	{
+		vec2 uv = fract(frag_uv) * uv_transform.xy + uv_transform.zw;
+		albedo *= texture(diffuse_maps, vec3(uv, diffuse_map.x)).rgb;
+	}
+
+	uvec4 color = uvec4(round(clamp(vec4(albedo, diffuse.a), 0.0, 1.0) * 255.0));
+	uvec2 normal = uvec2(round((octahedral_encode(normalize(frag_normal)) * 0.5 + 0.5) * 65535.0));
+	out_surface = uvec4(color.r | (color.g << 8), color.b | (color.a << 8), normal);
+}
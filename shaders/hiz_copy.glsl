@@ -0,0 +1,15 @@
+#version 450 core
+// Copies the depth buffer into level 0 of the Hi-Z pyramid
+layout (local_size_x = 8, local_size_y = 8) in;
+
+layout (binding = 15) uniform sampler2D depth;
+layout (r32f, binding = 0) writeonly uniform image2D destination;
+
+void main()
+{
+	ivec2 texel = ivec2(gl_GlobalInvocationID.xy);
+	if (all(lessThan(texel, imageSize(destination))))
+	{
+		imageStore(destination, texel, vec4(texelFetch(depth, texel, 0).r));
+	}
+}
@@ -0,0 +1,32 @@
+#version 450 core
+// Builds a level of the Hi-Z pyramid from the one below it, keeping the
+// farthest depth of the texels each one covers
+layout (local_size_x = 8, local_size_y = 8) in;
+
+layout (r32f, binding = 0) readonly uniform image2D source;
+layout (r32f, binding = 1) writeonly uniform image2D destination;
+
+void main()
+{
+	ivec2 texel = ivec2(gl_GlobalInvocationID.xy);
+	ivec2 size = imageSize(destination);
+	if (any(greaterThanEqual(texel, size)))
+	{
+		return;
+	}
+
+	// The last row and column also take the leftover texels of odd sized
+	// sources, so nothing is ever dropped
+	ivec2 source_size = imageSize(source);
+	ivec2 first = texel * 2;
+	ivec2 last = min(first + 1 + ivec2(equal(texel, size - 1)) * (source_size & 1), source_size - 1);
+	float farthest = 0.0;
+	for (int y = first.y; y <= last.y; y++)
+	{
+		for (int x = first.x; x <= last.x; x++)
+		{
+			farthest = max(farthest, imageLoad(source, ivec2(x, y)).r);
+		}
+	}
+	imageStore(destination, texel, vec4(farthest));
+}
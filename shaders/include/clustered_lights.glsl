@@ -0,0 +1,44 @@
+// Clustered lights, see LightClusters. Without CLUSTERED_LIGHTS there are
+// none to add.
+#ifdef CLUSTERED_LIGHTS
+uniform samplerBuffer lights; // three texels per light, see GpuLight
+uniform usamplerBuffer light_clusters; // offset and count of each cluster's indices
+uniform usamplerBuffer light_indices;
+uniform ivec3 cluster_grid;
+uniform vec2 cluster_tile_scale; // clusters per pixel, across and up
+uniform vec2 cluster_depth; // slice = log(view depth) * x + y
+
+vec3 clustered_lights(vec3 position, vec3 normal, float depth)
+{
+	ivec3 cell = clamp(ivec3(ivec2(gl_FragCoord.xy * cluster_tile_scale),
+		int(log(depth) * cluster_depth.x + cluster_depth.y)), ivec3(0), cluster_grid - 1);
+	uvec2 range = texelFetch(light_clusters,
+		(cell.z * cluster_grid.y + cell.y) * cluster_grid.x + cell.x).rg;
+
+	vec3 lit = vec3(0.0);
+	for (uint i = 0u; i < range.y; i++)
+	{
+		int light = int(texelFetch(light_indices, int(range.x + i)).r) * 3;
+		vec4 position_range = texelFetch(lights, light);
+		vec4 color_cos_inner = texelFetch(lights, light + 1);
+		vec4 direction_cos_outer = texelFetch(lights, light + 2);
+
+		vec3 to_light = position_range.xyz - position;
+		float distance_squared = dot(to_light, to_light);
+		vec3 direction = to_light * inversesqrt(max(distance_squared, 1e-8));
+		// Inverse square, windowed down to nothing at the range
+		float falloff = distance_squared / (position_range.w * position_range.w);
+		float window = clamp(1.0 - falloff * falloff, 0.0, 1.0);
+		float attenuation = window * window / (distance_squared + 1.0);
+		float spot = smoothstep(direction_cos_outer.w, color_cos_inner.w,
+			dot(-direction, direction_cos_outer.xyz));
+		lit += color_cos_inner.rgb * (max(dot(normal, direction), 0.0) * attenuation * spot);
+	}
+	return lit;
+}
+#else
+vec3 clustered_lights(vec3 position, vec3 normal, float depth)
+{
+	return vec3(0.0);
+}
+#endif
@@ -0,0 +1,37 @@
+// Sun shadows, see ShadowMaps. Without SHADOWS everything is lit.
+#ifdef SHADOWS
+uniform sampler2DArrayShadow shadow_maps;
+uniform mat4 shadow_matrices[4];
+uniform vec4 shadow_splits; // view depth where each cascade ends
+uniform vec4 shadow_texel_sizes; // in world units
+
+float sun_shadow(vec3 position, vec3 normal, float view_depth)
+{
+	// The first cascade that reaches this far, lit past the last
+	int cascade = int(dot(vec4(greaterThanEqual(vec4(view_depth), shadow_splits)), vec4(1.0)));
+	if (cascade > 3)
+	{
+		return 1.0;
+	}
+
+	// Pushed out along the normal by a little more than a texel, which
+	// keeps surfaces at a slope to the light from shadowing themselves
+	vec4 page = shadow_matrices[cascade]
+		* vec4(position + normal * (shadow_texel_sizes[cascade] * 1.5), 1.0);
+	vec3 coords = page.xyz * 0.5 + 0.5;
+
+	// Four taps half a texel apart, each filtered by the compare
+	float offset = 0.5 / float(textureSize(shadow_maps, 0).x);
+	float lit = 0.0;
+	lit += texture(shadow_maps, vec4(coords.xy + vec2(-offset, -offset), float(cascade), coords.z));
+	lit += texture(shadow_maps, vec4(coords.xy + vec2(offset, -offset), float(cascade), coords.z));
+	lit += texture(shadow_maps, vec4(coords.xy + vec2(-offset, offset), float(cascade), coords.z));
+	lit += texture(shadow_maps, vec4(coords.xy + vec2(offset, offset), float(cascade), coords.z));
+	return lit * 0.25;
+}
+#else
+float sun_shadow(vec3 position, vec3 normal, float view_depth)
+{
+	return 1.0;
+}
+#endif
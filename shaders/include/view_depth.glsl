@@ -0,0 +1,8 @@
+uniform vec2 depth_range; // near and far planes
+
+// Back to view depth from a depth buffer value in NDC
+float view_depth(float ndc_depth)
+{
+	return 2.0 * depth_range.x * depth_range.y
+		/ (depth_range.y + depth_range.x - ndc_depth * (depth_range.y - depth_range.x));
+}
@@ -0,0 +1,36 @@
+#version 330 core
+in vec3 frag_color;
+in vec2 frag_uv;
+in vec3 frag_normal;
+in vec3 frag_position; // world space
+flat in int frag_material;
+out vec4 out_color;
+uniform samplerBuffer materials;
+uniform sampler2DArray diffuse_maps;
+uniform vec3 light_direction;
+
+#include "include/view_depth.glsl"
+#include "include/clustered_lights.glsl"
+#include "include/sun_shadow.glsl"
+
+void main()
+{
+	// Four texels per material, see GpuMaterial
+	vec4 diffuse = texelFetch(materials, frag_material * 4 + 0);
+	vec4 uv_transform = texelFetch(materials, frag_material * 4 + 2);
+	vec4 diffuse_map = texelFetch(materials, frag_material * 4 + 3);
+
+	vec3 albedo = diffuse.rgb * frag_color;
+	if (diffuse_map.y > 0.5)
+	{
+		vec2 uv = fract(frag_uv) * uv_transform.xy + uv_transform.zw;
+		albedo *= texture(diffuse_maps, vec3(uv, diffuse_map.x)).rgb;
+	}
+
+	vec3 normal = normalize(frag_normal);
+	float depth = view_depth(gl_FragCoord.z * 2.0 - 1.0);
+	float n_dot_l = max(dot(normal, -light_direction), 0.0);
+	float shadow = sun_shadow(frag_position, normal, depth);
+	out_color = vec4(albedo * (0.2 + 0.8 * n_dot_l * shadow
+		+ clustered_lights(frag_position, normal, depth)), diffuse.a);
+}
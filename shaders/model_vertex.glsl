@@ -0,0 +1,52 @@
+#version 330 core
+#ifdef GPU_CULLED
+#extension GL_ARB_shader_draw_parameters : require
+#endif
+layout (location = 0) in vec3 position;
+layout (location = 1) in vec3 color;
+layout (location = 2) in vec2 uv;
+layout (location = 3) in vec3 normal;
+// Scene instances only; other draws leave these at no translation, a scale
+// of one and the identity rotation
+layout (location = 4) in vec4 instance_position; // xyz, uniform scale in w
+layout (location = 5) in vec4 instance_rotation; // quaternion
+out vec3 frag_color;
+out vec2 frag_uv;
+out vec3 frag_normal;
+out vec3 frag_position; // world space
+flat out int frag_material;
+// The depth prepass and the G-buffer pass share this stage, and the second
+// tests for equal depth, so both must compute exactly the same positions
+invariant gl_Position;
+uniform mat4 view_projection;
+
+#ifdef GPU_CULLED
+// The GPU culled scene: the instance attributes start at each draw's base
+// instance, and the material comes from the draw
+const mat4 model = mat4(1.0);
+// Of the first draw of the current glMultiDrawElementsIndirect call
+uniform int first_draw;
+layout (std430, binding = 5) readonly buffer DrawMaterials { int draw_materials[]; };
+#define MATERIAL draw_materials[first_draw + gl_DrawIDARB]
+#else
+uniform mat4 model;
+uniform int material_index;
+#define MATERIAL material_index
+#endif
+
+vec3 rotate(vec4 q, vec3 v)
+{
+	return v + 2.0 * cross(q.xyz, cross(q.xyz, v) + q.w * v);
+}
+
+void main()
+{
+	vec3 placed = rotate(instance_rotation, position) * instance_position.w + instance_position.xyz;
+	vec4 world = model * vec4(placed, 1.0);
+	gl_Position = view_projection * world;
+	frag_position = world.xyz;
+	frag_color = color;
+	frag_uv = uv;
+	frag_normal = mat3(model) * rotate(instance_rotation, normal);
+	frag_material = MATERIAL;
+}
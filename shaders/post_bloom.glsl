@@ -0,0 +1,9 @@
+// Bloom, see bloom_downsample.glsl. The chain's first level has the glow of
+// every level by now.
+uniform sampler2D bloom_chain;
+uniform float bloom_intensity;
+
+vec3 bloom(vec3 color, vec2 uv)
+{
+	return color + textureLod(bloom_chain, uv, 0.0).rgb * bloom_intensity;
+}
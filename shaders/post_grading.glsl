@@ -0,0 +1,16 @@
+// Lift, gamma and gain per channel, then contrast around middle grey and
+// saturation around the luma
+uniform vec3 grading_lift;
+uniform vec3 grading_gamma;
+uniform vec3 grading_gain;
+uniform float grading_contrast;
+uniform float grading_saturation;
+
+vec3 grading(vec3 color, vec2 uv)
+{
+	vec3 graded = pow(max(color * grading_gain + grading_lift * (1.0 - color), 0.0),
+		1.0 / grading_gamma);
+	graded = (graded - 0.5) * grading_contrast + 0.5;
+	float luma = dot(graded, vec3(0.2126, 0.7152, 0.0722));
+	return max(mix(vec3(luma), graded, grading_saturation), 0.0);
+}
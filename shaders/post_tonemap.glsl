@@ -0,0 +1,8 @@
+// Exposure, then Krzysztof Narkowicz's fit of the ACES filmic curve
+uniform float exposure;
+
+vec3 tonemap(vec3 color, vec2 uv)
+{
+	vec3 x = color * exposure;
+	return clamp(x * (2.51 * x + 0.03) / (x * (2.43 * x + 0.59) + 0.14), 0.0, 1.0);
+}
@@ -1,20 +1,180 @@
 #include "Application.h"
 
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
 #include <iostream>
+#include <random>
 #include <string>
 #include <vector>
 
 #include <GL/glew.h>
 #include <GL/gl.h>
+#include <glm/ext/matrix_transform.hpp>
 
 Application::Application()
 {
-	renderer = std::make_shared<Renderer>();
+	jobs = std::make_shared<JobSystem>();
+	renderer = std::make_shared<Renderer>(jobs);
+}
+
+void Application::parse_arguments(int argc, char* argv[])
+{
+	for (int i = 1; i < argc; i++)
+	{
+		if (std::strcmp(argv[i], "--host-budget") == 0 && i + 1 < argc)
+		{
+			residency_budget.host_bytes = std::strtoull(argv[++i], nullptr, 10) * 1024 * 1024;
+		}
+		else if (std::strcmp(argv[i], "--vram-budget") == 0 && i + 1 < argc)
+		{
+			residency_budget.vram_bytes = std::strtoull(argv[++i], nullptr, 10) * 1024 * 1024;
+		}
+		else if (std::strcmp(argv[i], "--headless") == 0)
+		{
+			renderer_options.headless = true;
+		}
+		else if (std::strcmp(argv[i], "--frames") == 0 && i + 1 < argc)
+		{
+			benchmark_frames = (uint32_t)std::strtoul(argv[++i], nullptr, 10);
+		}
+		else if (std::strcmp(argv[i], "--warmup") == 0 && i + 1 < argc)
+		{
+			warmup_frames = (uint32_t)std::strtoul(argv[++i], nullptr, 10);
+		}
+		else if (std::strcmp(argv[i], "--width") == 0 && i + 1 < argc)
+		{
+			renderer_options.width = std::max(std::atoi(argv[++i]), 1);
+		}
+		else if (std::strcmp(argv[i], "--height") == 0 && i + 1 < argc)
+		{
+			renderer_options.height = std::max(std::atoi(argv[++i]), 1);
+		}
+		else if (std::strcmp(argv[i], "--report") == 0 && i + 1 < argc)
+		{
+			report_path = argv[++i];
+		}
+		else if (std::strcmp(argv[i], "--capture") == 0 && i + 1 < argc)
+		{
+			renderer_options.capture_path = argv[++i];
+		}
+		else if (std::strcmp(argv[i], "--capture-frames") == 0 && i + 1 < argc)
+		{
+			renderer_options.capture_frames = (uint32_t)std::strtoul(argv[++i], nullptr, 10);
+		}
+		else if (std::strcmp(argv[i], "--gpu-culling") == 0)
+		{
+			renderer_options.gpu_culling = true;
+		}
+		else if (std::strcmp(argv[i], "--deferred") == 0)
+		{
+			renderer_options.shading_path = ShadingPath::Deferred;
+		}
+		else if (std::strcmp(argv[i], "--lights") == 0 && i + 1 < argc)
+		{
+			light_count = std::min((uint32_t)std::strtoul(argv[++i], nullptr, 10), MAX_LIGHTS);
+		}
+		else if (std::strcmp(argv[i], "--target-ms") == 0 && i + 1 < argc)
+		{
+			renderer_options.dynamic_resolution = true;
+			renderer_options.resolution.target_ms = std::max(std::strtof(argv[++i], nullptr), 0.1f);
+		}
+		else if (std::strcmp(argv[i], "--min-scale") == 0 && i + 1 < argc)
+		{
+			renderer_options.resolution.min_scale = std::strtof(argv[++i], nullptr);
+		}
+		else if (std::strcmp(argv[i], "--max-scale") == 0 && i + 1 < argc)
+		{
+			renderer_options.resolution.max_scale = std::strtof(argv[++i], nullptr);
+		}
+		else if (std::strcmp(argv[i], "--post") == 0 && i + 1 < argc)
+		{
+			if (!parse_post_effects(argv[++i], renderer_options.post.effects))
+			{
+				std::cerr << "Expected bloom, tonemap, grading, fxaa or all.\n";
+			}
+		}
+		else if (std::string(argv[i]).ends_with(".glscene"))
+		{
+			scene_path = argv[i];
+		}
+		else
+		{
+			model_paths.emplace_back(argv[i]);
+		}
+	}
 }
 
 void Application::setup()
 {
 	renderer->create_shaders();
+	renderer->set_residency_budget(residency_budget);
+
+	// The camera path runs along the scene's longest side, and nothing
+	// needs to arrive before it starts
+	if (!scene_path.empty() && renderer->load_scene(scene_path))
+	{
+		const SceneFileHeader& header = renderer->scene_file().header();
+		const glm::vec3 extent = header.bounds_max - header.bounds_min;
+		scene_center = (header.bounds_min + header.bounds_max) * 0.5f;
+		scene_radius = extent.x * 0.5f;
+		scene_extent = std::max(scene_extent, extent.x);
+		for (const SceneMesh& mesh : header.meshes)
+		{
+			model_radius = std::max(model_radius, mesh.radius);
+		}
+	}
+
+	// Models fill in as they finish loading, the first frame doesn't wait
+	for (const std::string& path : model_paths)
+	{
+		spawn(load_scene_model(path));
+	}
+}
+
+Task<void> Application::load_scene_model(std::string path)
+{
+	scene_loads_pending++;
+	LoadOptions options;
+	options.priority = JobPriority::High;
+	const std::shared_ptr<Model> model = co_await renderer->assets.load_model(path,
+		MAX_MODEL_LODS, options);
+	scene_loads_pending--;
+
+	if (model)
+	{
+		// Lay the models out side by side along x, in the order they arrive
+		const glm::vec3 center = (model->bounds_min + model->bounds_max) * 0.5f;
+		const glm::vec3 position(scene_extent + model->radius, 0.0f, 0.0f);
+		scene_extent += model->radius * 2.0f;
+		renderer->add_model(path, MAX_MODEL_LODS, model,
+			glm::translate(glm::mat4(1.0f), position - center));
+
+		scene_center = glm::vec3(scene_extent * 0.5f, 0.0f, 0.0f);
+		scene_radius = scene_extent * 0.5f;
+		model_radius = std::max(model_radius, model->radius);
+	}
+
+	if (scene_loads_pending == 0)
+	{
+		std::cout << "Scene loaded " << milliseconds_since_launch() << " ms after launch\n";
+	}
+}
+
+double Application::milliseconds_since_launch() const
+{
+	return (double)(SDL_GetPerformanceCounter() - launch_counter) * 1000.0
+		/ (double)SDL_GetPerformanceFrequency();
+}
+
+float Application::scene_seconds() const
+{
+	if (renderer_options.headless)
+	{
+		return (float)frame_index / 60.0f;
+	}
+	return (float)SDL_GetTicks() / 1000.0f;
 }
 
 void Application::input()
@@ -61,6 +221,13 @@ void Application::input()
 					Renderer::set_render_mode(GL_FILL);
 					break;
 				}
+				// Switch between forward and deferred shading
+				if (event.key.keysym.sym == SDLK_3)
+				{
+					renderer->shading_path = renderer->shading_path == ShadingPath::Forward
+						? ShadingPath::Deferred : ShadingPath::Forward;
+					break;
+				}
 				break;
 			}
 		}
@@ -69,6 +236,63 @@ void Application::input()
 
 void Application::update()
 {
+	// Nothing to look at until the first model arrives
+	if (scene_extent <= 0.0f)
+	{
+		return;
+	}
+
+	// A scripted path: dolly back and forth along the row while moving in
+	// and out, so models leave and re-enter view and change size on screen.
+	// Culling, LODs and residency all get some exercise.
+	const float t = scene_seconds();
+	const float x = scene_center.x - std::cos(t * 0.2f) * scene_radius;
+	const float distance = model_radius * (4.0f + 3.0f * std::sin(t * 0.5f));
+	renderer->camera.target = glm::vec3(x, scene_center.y, scene_center.z);
+	renderer->camera.position = glm::vec3(x, scene_center.y + model_radius * 0.5f,
+		scene_center.z + distance);
+	renderer->camera.far_plane = distance + scene_radius * 2.0f;
+	// Fixed rather than following the far plane, so the shadow pages of
+	// the static scene stay cached while the camera moves
+	renderer->shadow_distance = model_radius * 16.0f;
+
+	update_lights(t);
+}
+
+void Application::update_lights(float t)
+{
+	std::vector<Light>& lights = renderer->lights;
+	lights.resize(light_count);
+	if (light_count == 0)
+	{
+		return;
+	}
+
+	// Reseeded every frame, so only the time moves them. Each light reaches
+	// a little past its neighbours, so most of the scene is lit by a few.
+	std::mt19937 random(1234);
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+	const float spacing = 2.0f * scene_radius / std::sqrt((float)light_count);
+	for (Light& light : lights)
+	{
+		const float x = (unit(random) * 2.0f - 1.0f) * scene_radius;
+		const float z = (unit(random) * 2.0f - 1.0f) * scene_radius;
+		const float phase = unit(random) * 6.2831853f;
+		const float height = model_radius * (0.5f + 0.5f * std::sin(t + phase));
+		light.position = scene_center + glm::vec3(x, height, z);
+		light.color = glm::vec3(unit(random), unit(random), unit(random)) * 2.0f;
+		light.range = spacing * 1.5f;
+
+		// One in four shines down from higher up
+		light.type = unit(random) < 0.25f ? LightType::Spot : LightType::Point;
+		if (light.type == LightType::Spot)
+		{
+			light.position.y += light.range * 0.5f;
+			light.direction = glm::vec3(std::cos(t + phase) * 0.3f, -1.0f, std::sin(t + phase) * 0.3f);
+			light.inner_angle = 0.4f;
+			light.outer_angle = 0.6f;
+		}
+	}
 }
 
 void Application::render()
@@ -78,14 +302,23 @@ void Application::render()
 
 void Application::initialize()
 {
+	launch_counter = SDL_GetPerformanceCounter();
+	jobs->initialize();
+
 	// All libraries are successfully initialized and the application is running
-	running = renderer->initialize();
+	running = renderer->initialize(renderer_options);
 }
 
 void Application::run()
 {
 	setup();
 
+	if (renderer_options.headless)
+	{
+		run_headless();
+		return;
+	}
+
 	SDL_DisplayMode display_mode;
 	SDL_GetCurrentDisplayMode(0, &display_mode);
 
@@ -104,6 +337,12 @@ void Application::run()
 		render();
 		end = SDL_GetPerformanceCounter();
 
+		if (!first_frame_reported)
+		{
+			std::cout << "First frame " << milliseconds_since_launch() << " ms after launch\n";
+			first_frame_reported = true;
+		}
+
 		time_elapsed = (float)(end - start) / (float)SDL_GetPerformanceFrequency();
 
 		// If we still have time after updating the frame, wait to advance to
@@ -116,7 +355,40 @@ void Application::run()
 	}
 }
 
+void Application::run_headless()
+{
+	// The scene has to be in place before timing means anything
+	while (running && scene_loads_pending > 0)
+	{
+		render();
+	}
+
+	// Let residency and the driver settle before the measured frames
+	for (uint32_t i = 0; running && i < warmup_frames; i++)
+	{
+		update();
+		render();
+		frame_index++;
+	}
+
+	renderer->reset_stats();
+	for (uint32_t i = 0; running && i < benchmark_frames; i++)
+	{
+		update();
+		render();
+		frame_index++;
+	}
+
+	std::cout << "Rendered " << benchmark_frames << " headless frames\n";
+	running = false;
+}
+
 void Application::destroy()
 {
+	if (!report_path.empty())
+	{
+		renderer->write_timing_report(report_path);
+	}
 	renderer->destroy();
+	jobs->destroy();
 }
@@ -1,6 +1,10 @@
 #pragma once
 
 #include <memory>
+#include <string>
+#include <vector>
+#include <glm/vec3.hpp>
+#include "./Jobs/JobSystem.h"
 #include "./Renderer/Renderer.h"
 
 class Application
@@ -8,6 +12,20 @@ class Application
 public:
 	Application();
 
+	// Every argument is the path of an OBJ model to show, or of a .glscene
+	// file to show instead of the row of models, apart from
+	// --host-budget <MB> and --vram-budget <MB> which bound residency, and
+	// --headless, --frames <N>, --warmup <N>, --width <px>, --height <px>
+	// and --report <path> which set up an offscreen timing run, and
+	// --capture <path> and --capture-frames <N> which record GL calls,
+	// --gpu-culling which culls scene instances with compute shaders,
+	// --deferred which starts on the deferred path instead of forward,
+	// --lights <N> which scatters that many moving lights over the scene,
+	// --target-ms <ms> which scales the resolution to keep GPU time under
+	// it, between --min-scale <s> and --max-scale <s> of the window, and
+	// --post <effects> which runs a comma separated list of bloom, tonemap,
+	// grading and fxaa, or all of them, on every frame
+	void parse_arguments(int argc, char* argv[]);
 	void initialize();
 	void run();
 	void setup();
@@ -17,8 +35,41 @@ public:
 	void destroy();
 
 private:
+	// Loads a model in the background and places it once it arrives
+	Task<void> load_scene_model(std::string path);
+	double milliseconds_since_launch() const;
+	// Headless runs step time by a fixed amount per frame so every run
+	// follows the same camera path
+	float scene_seconds() const;
+	void run_headless();
+	// The same lights every run, bobbing up and down over the scene
+	void update_lights(float t);
+
+	std::shared_ptr<JobSystem> jobs;
 	std::shared_ptr<Renderer> renderer;
 
+	std::vector<std::string> model_paths;
+	std::string scene_path;
+	ResidencyBudget residency_budget;
+	RendererOptions renderer_options;
+
+	uint32_t benchmark_frames = 300;
+	uint32_t warmup_frames = 10;
+	uint64_t frame_index = 0;
+	std::string report_path;
+
+	// The models sit in a row along x which the camera path follows, or the
+	// scene is centered on scene_center
+	glm::vec3 scene_center = glm::vec3(0.0f);
+	float scene_extent = 0.0f;
+	float scene_radius = 1.0f;
+	float model_radius = 0.0f; // of the largest model
+	uint32_t scene_loads_pending = 0;
+	uint32_t light_count = 0;
+
+	uint64_t launch_counter = 0;
+	bool first_frame_reported = false;
+
 	float target_seconds_per_frame = 0.0f;
 	bool running = false;
 };
@@ -0,0 +1,167 @@
+#include "AssetLoader.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+#include "../Model/Model.h"
+#include "../Texture/TextureLoader.h"
+
+AssetLoader::PendingLoad::PendingLoad(std::atomic<uint32_t>& counter)
+	: count(counter)
+{
+	count++;
+}
+
+AssetLoader::PendingLoad::~PendingLoad()
+{
+	count--;
+}
+
+void AssetLoader::WorkerAwaiter::await_suspend(std::coroutine_handle<> handle) const
+{
+	// The coroutine may be running on a worker before submit returns, so
+	// nothing of the awaiter is touched afterwards
+	loader->jobs->submit([handle] { handle.resume(); }, priority);
+}
+
+void AssetLoader::RenderThreadAwaiter::await_suspend(std::coroutine_handle<> handle) const
+{
+	const std::lock_guard<std::mutex> lock(loader->mutex);
+	loader->render_queue.push_back({handle, priority});
+}
+
+void AssetLoader::initialize(std::shared_ptr<JobSystem> job_system,
+	TextureLoader& texture_loader)
+{
+	jobs = std::move(job_system);
+	textures = &texture_loader;
+	stopping = false;
+}
+
+void AssetLoader::destroy()
+{
+	// Every load sees itself cancelled at its next hop, so this settles
+	// within a couple of rounds
+	stopping = true;
+	while (pending() > 0)
+	{
+		jobs->wait_idle();
+		update(INFINITY);
+	}
+	render_queue.clear();
+}
+
+AssetLoader::WorkerAwaiter AssetLoader::on_worker(JobPriority priority)
+{
+	return WorkerAwaiter{this, priority};
+}
+
+AssetLoader::RenderThreadAwaiter AssetLoader::on_render_thread(JobPriority priority)
+{
+	return RenderThreadAwaiter{this, priority};
+}
+
+bool AssetLoader::cancelled(const LoadOptions& options) const
+{
+	return stopping || options.cancel.cancelled();
+}
+
+Task<std::shared_ptr<Model>> AssetLoader::load_model(std::string path, int lod_count,
+	LoadOptions options)
+{
+	const PendingLoad pending_load(loads_pending);
+
+	co_await on_worker(options.priority);
+	if (cancelled(options))
+	{
+		co_return nullptr;
+	}
+
+	std::shared_ptr<Model> model = load_model_from_obj(path.c_str(), lod_count);
+
+	co_await on_render_thread(options.priority);
+	if (cancelled(options))
+	{
+		co_return nullptr;
+	}
+
+	co_return model;
+}
+
+Task<std::shared_ptr<Texture>> AssetLoader::load_texture(std::string path,
+	LoadOptions options)
+{
+	const PendingLoad pending_load(loads_pending);
+
+	auto texture = std::make_shared<Texture>();
+	texture->path = path;
+	texture->id = textures->placeholder;
+
+	co_await on_worker(options.priority);
+	if (cancelled(options))
+	{
+		co_return nullptr;
+	}
+
+	// Queues the pixels for the texture loader's next update
+	textures->load_now(texture);
+
+	// The upload takes a frame or two to go through the pixel buffers
+	do
+	{
+		co_await on_render_thread(options.priority);
+		if (cancelled(options))
+		{
+			co_return nullptr;
+		}
+	} while (!texture->resident && !texture->failed);
+
+	co_return texture->failed ? nullptr : texture;
+}
+
+void AssetLoader::update(double budget_seconds)
+{
+	const auto start = std::chrono::steady_clock::now();
+
+	// Only what was queued before now runs, so coroutines that wait again
+	// get resumed next frame
+	std::vector<Continuation> ready;
+	{
+		const std::lock_guard<std::mutex> lock(mutex);
+		ready.swap(render_queue);
+	}
+	std::stable_sort(ready.begin(), ready.end(), [](const Continuation& a, const Continuation& b) {
+		return a.priority < b.priority;
+	});
+
+	size_t next = 0;
+	while (next < ready.size())
+	{
+		ready[next++].handle.resume();
+
+		const double elapsed = std::chrono::duration<double>(
+			std::chrono::steady_clock::now() - start).count();
+		if (elapsed >= budget_seconds)
+		{
+			break;
+		}
+	}
+
+	// The rest go ahead of anything queued while we were resuming
+	if (next < ready.size())
+	{
+		const std::lock_guard<std::mutex> lock(mutex);
+		render_queue.insert(render_queue.begin(), ready.begin() + (ptrdiff_t)next, ready.end());
+	}
+}
+
+uint32_t AssetLoader::pending() const
+{
+	return loads_pending;
+}
+
+bool AssetLoader::stopped() const
+{
+	return stopping;
+}
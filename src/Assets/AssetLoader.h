@@ -0,0 +1,127 @@
+#pragma once
+
+#include <atomic>
+#include <coroutine>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "../Jobs/JobSystem.h"
+#include "../Jobs/Task.h"
+
+class Model;
+class TextureLoader;
+struct Texture;
+
+// Render thread time spent resuming coroutines per frame, in seconds
+constexpr double ASSET_RESUME_BUDGET = 0.002;
+
+// Cancels a load from any thread. Copies share the same flag.
+class CancelToken
+{
+public:
+	CancelToken() : flag(std::make_shared<std::atomic<bool>>(false)) {}
+
+	void cancel() const { *flag = true; }
+	bool cancelled() const { return *flag; }
+
+private:
+	std::shared_ptr<std::atomic<bool>> flag;
+};
+
+struct LoadOptions
+{
+	JobPriority priority = JobPriority::Normal;
+	CancelToken cancel;
+};
+
+// Awaitable asset loading. Coroutines hop to a worker for file I/O and
+// decoding and back to the render thread for anything touching GL:
+//
+//     std::shared_ptr<Model> model = co_await assets.load_model(path, 4, {});
+//
+// Both hops are ordered by priority, and a cancelled load returns null at
+// the next hop instead of finishing.
+class AssetLoader
+{
+public:
+	struct WorkerAwaiter
+	{
+		AssetLoader* loader = nullptr;
+		JobPriority priority = JobPriority::Normal;
+
+		bool await_ready() const noexcept { return false; }
+		void await_suspend(std::coroutine_handle<> handle) const;
+		void await_resume() const noexcept {}
+	};
+
+	struct RenderThreadAwaiter
+	{
+		AssetLoader* loader = nullptr;
+		JobPriority priority = JobPriority::Normal;
+
+		bool await_ready() const noexcept { return false; }
+		void await_suspend(std::coroutine_handle<> handle) const;
+		void await_resume() const noexcept {}
+	};
+
+	void initialize(std::shared_ptr<JobSystem> job_system, TextureLoader& texture_loader);
+	// Cancels every load and runs the coroutines until they've all returned
+	void destroy();
+
+	// Resumes the awaiting coroutine on a worker
+	WorkerAwaiter on_worker(JobPriority priority);
+	// Resumes the awaiting coroutine on the render thread, during a later
+	// update(). Awaiting it from update() itself waits for the next frame.
+	RenderThreadAwaiter on_render_thread(JobPriority priority);
+
+	// Parses and simplifies the model on a worker and returns on the render
+	// thread. Null if it failed or was cancelled.
+	Task<std::shared_ptr<Model>> load_model(std::string path, int lod_count,
+		LoadOptions options);
+
+	// Decodes the texture (or maps it, when cooked) on a worker, uploads it
+	// through the texture loader's pixel buffers and returns on the render
+	// thread once it's resident. Null if it failed or was cancelled.
+	Task<std::shared_ptr<Texture>> load_texture(std::string path, LoadOptions options);
+
+	// Call once per frame on the render thread: resumes waiting coroutines,
+	// highest priority first, until the budget runs out
+	void update(double budget_seconds = ASSET_RESUME_BUDGET);
+
+	// Loads started and not yet returned
+	uint32_t pending() const;
+	// Whether destroy() is cancelling everything
+	bool stopped() const;
+
+private:
+	struct Continuation
+	{
+		std::coroutine_handle<> handle;
+		JobPriority priority = JobPriority::Normal;
+	};
+
+	// Counts a load for as long as its coroutine body runs
+	struct PendingLoad
+	{
+		explicit PendingLoad(std::atomic<uint32_t>& counter);
+		~PendingLoad();
+		PendingLoad(const PendingLoad&) = delete;
+		PendingLoad& operator=(const PendingLoad&) = delete;
+
+		std::atomic<uint32_t>& count;
+	};
+
+	bool cancelled(const LoadOptions& options) const;
+
+	std::shared_ptr<JobSystem> jobs;
+	TextureLoader* textures = nullptr;
+
+	std::mutex mutex;
+	std::vector<Continuation> render_queue;
+
+	std::atomic<uint32_t> loads_pending = 0;
+	std::atomic<bool> stopping = false;
+};
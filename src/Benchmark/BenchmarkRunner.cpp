@@ -0,0 +1,393 @@
+#include "BenchmarkRunner.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+
+#include <GL/glew.h>
+#include <GL/gl.h>
+
+#include "../Renderer/TimingReport.h"
+
+namespace
+{
+	void write_summary(std::ostream& out, const char* name, const TimingSummary& summary)
+	{
+		out << "\"" << name << "\": {\"mean\": " << summary.mean
+			<< ", \"median\": " << summary.median << ", \"p99\": " << summary.p99
+			<< ", \"min\": " << summary.min << ", \"max\": " << summary.max << "}";
+	}
+
+	// Finds "key": in line from position start and returns where its value
+	// begins
+	size_t find_value(const std::string& line, const std::string& key, size_t start = 0)
+	{
+		const std::string pattern = "\"" + key + "\":";
+		const size_t position = line.find(pattern, start);
+		if (position == std::string::npos)
+		{
+			return std::string::npos;
+		}
+		return line.find_first_not_of(' ', position + pattern.size());
+	}
+
+	bool read_string(const std::string& line, const std::string& key, std::string& value)
+	{
+		const size_t start = find_value(line, key);
+		if (start == std::string::npos || line[start] != '"')
+		{
+			return false;
+		}
+		const size_t end = line.find('"', start + 1);
+		if (end == std::string::npos)
+		{
+			return false;
+		}
+		value = line.substr(start + 1, end - start - 1);
+		return true;
+	}
+
+	bool read_number(const std::string& line, const std::string& key, double& value,
+		size_t start = 0)
+	{
+		const size_t position = find_value(line, key, start);
+		if (position == std::string::npos)
+		{
+			return false;
+		}
+		char* end = nullptr;
+		value = std::strtod(line.c_str() + position, &end);
+		return end != line.c_str() + position;
+	}
+
+	bool read_summary(const std::string& line, const std::string& key, TimingSummary& summary)
+	{
+		const size_t start = line.find("\"" + key + "\":");
+		return start != std::string::npos
+			&& read_number(line, "mean", summary.mean, start)
+			&& read_number(line, "median", summary.median, start)
+			&& read_number(line, "p99", summary.p99, start)
+			&& read_number(line, "min", summary.min, start)
+			&& read_number(line, "max", summary.max, start);
+	}
+
+	double percent_change(double baseline, double current)
+	{
+		return baseline > 0.0 ? (current - baseline) / baseline * 100.0 : 0.0;
+	}
+}
+
+bool read_benchmark_results(const std::string& path, std::vector<BenchmarkResult>& results)
+{
+	std::ifstream file(path);
+	if (!file)
+	{
+		std::cerr << "Unable to open benchmark results: " << path << "\n";
+		return false;
+	}
+
+	std::string line;
+	while (std::getline(file, line))
+	{
+		if (line.find("\"scenario\":") == std::string::npos)
+		{
+			continue;
+		}
+
+		BenchmarkResult result;
+		double value = 0.0;
+		double frames = 0.0;
+		if (!read_string(line, "scenario", result.scenario)
+			|| !read_string(line, "parameter", result.parameter)
+			|| !read_number(line, "value", value)
+			|| !read_number(line, "frames", frames)
+			|| !read_summary(line, "cpu_ms", result.cpu)
+			|| !read_summary(line, "gpu_ms", result.gpu))
+		{
+			std::cerr << "Malformed benchmark result in " << path << ": " << line << "\n";
+			return false;
+		}
+		result.value = (uint32_t)value;
+		result.frames = (uint32_t)frames;
+		results.push_back(std::move(result));
+	}
+
+	return true;
+}
+
+void BenchmarkRunner::parse_arguments(int argc, char* argv[])
+{
+	for (int i = 1; i < argc; i++)
+	{
+		if (std::strcmp(argv[i], "--scenario") == 0 && i + 1 < argc)
+		{
+			scenario_names.emplace_back(argv[++i]);
+		}
+		else if (std::strcmp(argv[i], "--frames") == 0 && i + 1 < argc)
+		{
+			frames = std::max((uint32_t)std::strtoul(argv[++i], nullptr, 10), 1u);
+		}
+		else if (std::strcmp(argv[i], "--warmup") == 0 && i + 1 < argc)
+		{
+			warmup_frames = (uint32_t)std::strtoul(argv[++i], nullptr, 10);
+		}
+		else if (std::strcmp(argv[i], "--width") == 0 && i + 1 < argc)
+		{
+			width = std::max(std::atoi(argv[++i]), 1);
+		}
+		else if (std::strcmp(argv[i], "--height") == 0 && i + 1 < argc)
+		{
+			height = std::max(std::atoi(argv[++i]), 1);
+		}
+		else if (std::strcmp(argv[i], "--out") == 0 && i + 1 < argc)
+		{
+			output_path = argv[++i];
+		}
+		else if (std::strcmp(argv[i], "--compare") == 0 && i + 2 < argc)
+		{
+			compare_mode = true;
+			baseline_path = argv[++i];
+			current_path = argv[++i];
+		}
+		else if (std::strcmp(argv[i], "--threshold") == 0 && i + 1 < argc)
+		{
+			threshold_percent = std::strtod(argv[++i], nullptr);
+		}
+	}
+}
+
+int BenchmarkRunner::run()
+{
+	if (compare_mode)
+	{
+		return compare() > 0 ? 1 : 0;
+	}
+
+	// Check the names before spending any time rendering
+	std::vector<const BenchmarkScenario*> scenarios;
+	for (const BenchmarkScenario& scenario : BENCHMARK_SCENARIOS)
+	{
+		if (scenario_names.empty() || std::find(scenario_names.begin(),
+			scenario_names.end(), scenario.name) != scenario_names.end())
+		{
+			scenarios.push_back(&scenario);
+		}
+	}
+	for (const std::string& name : scenario_names)
+	{
+		if (std::none_of(scenarios.begin(), scenarios.end(),
+			[&name](const BenchmarkScenario* scenario) { return name == scenario->name; }))
+		{
+			std::cerr << "Unknown benchmark scenario: " << name << "\n";
+			return 1;
+		}
+	}
+
+	if (!initialize())
+	{
+		destroy();
+		return 1;
+	}
+
+	std::vector<BenchmarkResult> results;
+	for (const BenchmarkScenario* scenario : scenarios)
+	{
+		for (const uint32_t value : scenario->values)
+		{
+			results.push_back(run_scenario(*scenario, value));
+
+			const BenchmarkResult& result = results.back();
+			std::cout << std::left << std::setw(10) << result.scenario
+					  << std::setw(16) << result.parameter << std::right
+					  << std::setw(9) << result.value
+					  << "  cpu " << result.cpu.median << " ms (p99 " << result.cpu.p99 << ")"
+					  << "  gpu " << result.gpu.median << " ms (p99 " << result.gpu.p99 << ")\n";
+		}
+	}
+
+	const bool written = write_results(results);
+	destroy();
+	return written ? 0 : 1;
+}
+
+bool BenchmarkRunner::initialize()
+{
+	if (!context.create(3, 3))
+	{
+		return false;
+	}
+
+	glewExperimental = GL_TRUE;
+	if (glewContextInit() != GLEW_OK)
+	{
+		std::cerr << "Failed to initialize GLEW.\n";
+		return false;
+	}
+
+	// Only colour, none of the scenes depth test
+	glGenRenderbuffers(1, &color_buffer);
+	glBindRenderbuffer(GL_RENDERBUFFER, color_buffer);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+	glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+	glGenFramebuffers(1, &framebuffer);
+	glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, color_buffer);
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+	{
+		std::cerr << "Benchmark framebuffer is incomplete.\n";
+		return false;
+	}
+	glViewport(0, 0, width, height);
+
+	shader = Shader("./shaders/benchmark_vertex.glsl", "./shaders/benchmark_fragment.glsl");
+	if (shader.program == 0)
+	{
+		return false;
+	}
+
+	frame_timer.initialize();
+
+	std::cout << "Benchmarking on " << gl_string(GL_RENDERER) << " at "
+			  << width << "x" << height << ", " << frames << " frames per run\n";
+	return true;
+}
+
+void BenchmarkRunner::destroy()
+{
+	frame_timer.destroy();
+	shader.destroy();
+	glDeleteFramebuffers(1, &framebuffer);
+	glDeleteRenderbuffers(1, &color_buffer);
+	framebuffer = 0;
+	color_buffer = 0;
+	context.destroy();
+}
+
+BenchmarkResult BenchmarkRunner::run_scenario(const BenchmarkScenario& scenario,
+	uint32_t value)
+{
+	BenchmarkScene scene;
+	scene.create(scenario.kind, value, shader.program);
+
+	// Nothing from building the scene may leak into the first frames
+	glFinish();
+
+	for (uint32_t frame = 0; frame < warmup_frames + frames; frame++)
+	{
+		if (frame == warmup_frames)
+		{
+			frame_timer.clear();
+		}
+
+		frame_timer.begin_frame();
+		glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+		glClear(GL_COLOR_BUFFER_BIT);
+		scene.draw();
+		frame_timer.end_frame();
+		glFlush();
+	}
+	frame_timer.finish();
+
+	BenchmarkResult result;
+	result.scenario = scenario.name;
+	result.parameter = scenario.parameter;
+	result.value = value;
+	result.frames = (uint32_t)frame_timer.cpu_times().size();
+	result.cpu = summarize_timings(frame_timer.cpu_times());
+	result.gpu = summarize_timings(frame_timer.gpu_times());
+
+	scene.destroy();
+	frame_timer.clear();
+	return result;
+}
+
+bool BenchmarkRunner::write_results(const std::vector<BenchmarkResult>& results) const
+{
+	std::ofstream file(output_path);
+	if (!file)
+	{
+		std::cerr << "Unable to create benchmark results: " << output_path << "\n";
+		return false;
+	}
+
+	// One result per line, which is all read_benchmark_results relies on
+	file << "{\n"
+		 << "  \"gl_renderer\": \"" << json_escape(gl_string(GL_RENDERER)) << "\",\n"
+		 << "  \"gl_version\": \"" << json_escape(gl_string(GL_VERSION)) << "\",\n"
+		 << "  \"width\": " << width << ",\n"
+		 << "  \"height\": " << height << ",\n"
+		 << "  \"results\": [\n";
+	for (size_t i = 0; i < results.size(); i++)
+	{
+		const BenchmarkResult& result = results[i];
+		file << "    {\"scenario\": \"" << result.scenario << "\", \"parameter\": \""
+			 << result.parameter << "\", \"value\": " << result.value
+			 << ", \"frames\": " << result.frames << ", ";
+		write_summary(file, "cpu_ms", result.cpu);
+		file << ", ";
+		write_summary(file, "gpu_ms", result.gpu);
+		file << "}" << (i + 1 < results.size() ? "," : "") << "\n";
+	}
+	file << "  ]\n"
+		 << "}\n";
+
+	std::cout << "Wrote " << results.size() << " benchmark results to " << output_path << "\n";
+	return (bool)file;
+}
+
+int BenchmarkRunner::compare() const
+{
+	std::vector<BenchmarkResult> baseline;
+	std::vector<BenchmarkResult> current;
+	if (!read_benchmark_results(baseline_path, baseline)
+		|| !read_benchmark_results(current_path, current))
+	{
+		return 1;
+	}
+
+	const auto regressed = [this](double before, double after) {
+		return after - before > BENCHMARK_NOISE_FLOOR_MS
+			&& percent_change(before, after) > threshold_percent;
+	};
+
+	int regressions = 0;
+	std::cout << std::fixed << std::setprecision(3);
+	for (const BenchmarkResult& result : current)
+	{
+		const auto match = std::find_if(baseline.begin(), baseline.end(),
+			[&result](const BenchmarkResult& other) {
+				return other.scenario == result.scenario && other.value == result.value;
+			});
+
+		std::cout << std::left << std::setw(10) << result.scenario << std::right
+				  << std::setw(9) << result.value;
+		if (match == baseline.end())
+		{
+			std::cout << "  not in baseline\n";
+			continue;
+		}
+
+		// Medians, the mean and p99 move too much from run to run
+		const bool cpu_regressed = regressed(match->cpu.median, result.cpu.median);
+		const bool gpu_regressed = regressed(match->gpu.median, result.gpu.median);
+		std::cout << "  cpu " << match->cpu.median << " -> " << result.cpu.median << " ms ("
+				  << std::showpos << percent_change(match->cpu.median, result.cpu.median)
+				  << std::noshowpos << "%)" << (cpu_regressed ? " REGRESSED" : "")
+				  << "  gpu " << match->gpu.median << " -> " << result.gpu.median << " ms ("
+				  << std::showpos << percent_change(match->gpu.median, result.gpu.median)
+				  << std::noshowpos << "%)" << (gpu_regressed ? " REGRESSED" : "") << "\n";
+
+		if (cpu_regressed || gpu_regressed)
+		{
+			regressions++;
+		}
+	}
+
+	std::cout << regressions << " regressions beyond " << threshold_percent << "%\n";
+	return regressions;
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "BenchmarkScene.h"
+#include "../Renderer/FrameTimer.h"
+#include "../Renderer/HeadlessContext.h"
+#include "../Shader/Shader.h"
+
+constexpr size_t BENCHMARK_SWEEP_STEPS = 3;
+// Median changes smaller than this are noise, whatever the percentage
+constexpr double BENCHMARK_NOISE_FLOOR_MS = 0.01;
+
+// A named scene swept over a parameter, e.g. "draws" over draw_count
+struct BenchmarkScenario
+{
+	const char* name;
+	const char* parameter;
+	BenchmarkSceneKind kind;
+	std::array<uint32_t, BENCHMARK_SWEEP_STEPS> values;
+};
+
+constexpr std::array<BenchmarkScenario, 5> BENCHMARK_SCENARIOS = {{
+	{"triangles", "triangle_count", BenchmarkSceneKind::Triangles, {10000, 100000, 1000000}},
+	{"draws", "draw_count", BenchmarkSceneKind::Draws, {100, 1000, 10000}},
+	{"instances", "instance_count", BenchmarkSceneKind::Instances, {1000, 10000, 100000}},
+	{"materials", "material_count", BenchmarkSceneKind::Materials, {16, 128, 1024}},
+	{"fill", "layer_count", BenchmarkSceneKind::Fill, {1, 4, 16}},
+}};
+
+struct BenchmarkResult
+{
+	std::string scenario;
+	std::string parameter;
+	uint32_t value = 0;
+	uint32_t frames = 0;
+	TimingSummary cpu;
+	TimingSummary gpu;
+};
+
+// Renders the synthetic scenarios offscreen and writes their frame times
+// as JSON, or compares two such files. Started with --benchmark:
+//   --benchmark [--scenario <name>]... [--frames <N>] [--warmup <N>]
+//               [--width <px>] [--height <px>] [--out <path>]
+//   --benchmark --compare <baseline> <current> [--threshold <percent>]
+class BenchmarkRunner
+{
+public:
+	void parse_arguments(int argc, char* argv[]);
+	// Returns the process exit code, non-zero on failure or regression
+	int run();
+
+private:
+	bool initialize();
+	void destroy();
+	BenchmarkResult run_scenario(const BenchmarkScenario& scenario, uint32_t value);
+	bool write_results(const std::vector<BenchmarkResult>& results) const;
+	// Prints how every result in the current file moved against the
+	// baseline and counts those that slowed down beyond the threshold
+	int compare() const;
+
+	std::vector<std::string> scenario_names; // all of them when empty
+	uint32_t frames = 100;
+	uint32_t warmup_frames = 10;
+	int width = 1280;
+	int height = 720;
+	std::string output_path = "benchmark.json";
+
+	bool compare_mode = false;
+	std::string baseline_path;
+	std::string current_path;
+	double threshold_percent = 10.0;
+
+	HeadlessContext context;
+	FrameTimer frame_timer;
+	uint32_t framebuffer = 0;
+	uint32_t color_buffer = 0;
+	Shader shader;
+};
+
+// Reads back what BenchmarkRunner wrote, one result per line
+bool read_benchmark_results(const std::string& path, std::vector<BenchmarkResult>& results);
@@ -0,0 +1,265 @@
+#include "BenchmarkScene.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+
+#include <GL/glew.h>
+#include <GL/gl.h>
+
+namespace
+{
+	uint32_t grid_columns(uint32_t count)
+	{
+		return std::max((uint32_t)std::ceil(std::sqrt((double)count)), 1u);
+	}
+
+	uint32_t create_texture(uint32_t size, const uint8_t* pixels)
+	{
+		uint32_t id = 0;
+		glGenTextures(1, &id);
+		glBindTexture(GL_TEXTURE_2D, id);
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, (GLsizei)size, (GLsizei)size, 0,
+			GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glBindTexture(GL_TEXTURE_2D, 0);
+		return id;
+	}
+}
+
+void BenchmarkScene::create(BenchmarkSceneKind scene_kind, uint32_t scene_count,
+	uint32_t shader_program)
+{
+	kind = scene_kind;
+	count = scene_count;
+	program = shader_program;
+
+	offset_location = glGetUniformLocation(program, "offset");
+	scale_location = glGetUniformLocation(program, "scale");
+	color_location = glGetUniformLocation(program, "color");
+	glUseProgram(program);
+	glUniform1i(glGetUniformLocation(program, "diffuse"), 0);
+
+	const uint8_t white[] = {255, 255, 255, 255};
+	white_texture = create_texture(1, white);
+
+	std::vector<BenchmarkVertex> vertices;
+	std::vector<uint32_t> indices;
+
+	switch (kind)
+	{
+		case BenchmarkSceneKind::Triangles:
+		{
+			// One small triangle per grid cell, all in a single buffer
+			const uint32_t columns = grid_columns(count);
+			const float cell = 2.0f / (float)columns;
+			vertices.reserve((size_t)count * 3);
+			for (uint32_t i = 0; i < count; i++)
+			{
+				const glm::vec2 center(-1.0f + cell * ((float)(i % columns) + 0.5f),
+					-1.0f + cell * ((float)(i / columns) + 0.5f));
+				const float size = cell * 0.4f;
+				vertices.push_back({center + glm::vec2(-size, -size), glm::vec2(0.0f, 0.0f)});
+				vertices.push_back({center + glm::vec2(size, -size), glm::vec2(1.0f, 0.0f)});
+				vertices.push_back({center + glm::vec2(0.0f, size), glm::vec2(0.5f, 1.0f)});
+			}
+			indices.resize(vertices.size());
+			for (uint32_t i = 0; i < (uint32_t)indices.size(); i++)
+			{
+				indices[i] = i;
+			}
+			offsets.assign(1, glm::vec2(0.0f));
+			break;
+		}
+		case BenchmarkSceneKind::Draws:
+		case BenchmarkSceneKind::Instances:
+		{
+			// A disc, small enough that the draw overhead dominates
+			vertices.push_back({glm::vec2(0.0f), glm::vec2(0.5f)});
+			for (uint32_t i = 0; i < BENCHMARK_MESH_TRIANGLES; i++)
+			{
+				const float angle = 6.2831853f * (float)i / (float)BENCHMARK_MESH_TRIANGLES;
+				const glm::vec2 direction(std::cos(angle), std::sin(angle));
+				vertices.push_back({direction, direction * 0.5f + 0.5f});
+				indices.push_back(0);
+				indices.push_back(i + 1);
+				indices.push_back((i + 1) % BENCHMARK_MESH_TRIANGLES + 1);
+			}
+			place_in_grid();
+			break;
+		}
+		case BenchmarkSceneKind::Materials:
+		case BenchmarkSceneKind::Fill:
+		{
+			vertices = {
+				{glm::vec2(-1.0f, -1.0f), glm::vec2(0.0f, 0.0f)},
+				{glm::vec2(1.0f, -1.0f), glm::vec2(1.0f, 0.0f)},
+				{glm::vec2(1.0f, 1.0f), glm::vec2(1.0f, 1.0f)},
+				{glm::vec2(-1.0f, 1.0f), glm::vec2(0.0f, 1.0f)},
+			};
+			indices = {0, 1, 2, 2, 3, 0};
+			if (kind == BenchmarkSceneKind::Fill)
+			{
+				// Every layer covers the whole screen
+				offsets.assign(count, glm::vec2(0.0f));
+			}
+			else
+			{
+				place_in_grid();
+			}
+			break;
+		}
+	}
+
+	upload(vertices, indices);
+
+	if (kind == BenchmarkSceneKind::Instances)
+	{
+		// The grid moves into an instance attribute and the uniform stays put
+		glGenBuffers(1, &instance_buffer);
+		glBindBuffer(GL_ARRAY_BUFFER, instance_buffer);
+		glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr)(offsets.size() * sizeof(glm::vec2)),
+			offsets.data(), GL_STATIC_DRAW);
+		glEnableVertexAttribArray(2);
+		glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(glm::vec2), nullptr);
+		glVertexAttribDivisor(2, 1);
+		glBindVertexArray(0);
+		offsets.assign(1, glm::vec2(0.0f));
+	}
+
+	if (kind == BenchmarkSceneKind::Materials)
+	{
+		// A checker in a colour of its own for every material
+		std::vector<uint8_t> pixels((size_t)BENCHMARK_TEXTURE_SIZE * BENCHMARK_TEXTURE_SIZE * 4);
+		textures.resize(count);
+		for (uint32_t i = 0; i < count; i++)
+		{
+			const uint32_t hash = (i + 1) * 2654435761u;
+			for (uint32_t y = 0; y < BENCHMARK_TEXTURE_SIZE; y++)
+			{
+				for (uint32_t x = 0; x < BENCHMARK_TEXTURE_SIZE; x++)
+				{
+					const uint32_t shade = ((x / 8 + y / 8) % 2) ? 255 : 160;
+					uint8_t* texel = &pixels[((size_t)y * BENCHMARK_TEXTURE_SIZE + x) * 4];
+					texel[0] = (uint8_t)(((hash >> 0) & 0xff) * shade / 255);
+					texel[1] = (uint8_t)(((hash >> 8) & 0xff) * shade / 255);
+					texel[2] = (uint8_t)(((hash >> 16) & 0xff) * shade / 255);
+					texel[3] = 255;
+				}
+			}
+			textures[i] = create_texture(BENCHMARK_TEXTURE_SIZE, pixels.data());
+		}
+	}
+}
+
+void BenchmarkScene::upload(const std::vector<BenchmarkVertex>& vertices,
+	const std::vector<uint32_t>& indices)
+{
+	glGenVertexArrays(1, &vao);
+	glBindVertexArray(vao);
+
+	glGenBuffers(1, &vbo);
+	glBindBuffer(GL_ARRAY_BUFFER, vbo);
+	glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr)(vertices.size() * sizeof(BenchmarkVertex)),
+		vertices.data(), GL_STATIC_DRAW);
+
+	glGenBuffers(1, &ebo);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, (GLsizeiptr)(indices.size() * sizeof(uint32_t)),
+		indices.data(), GL_STATIC_DRAW);
+	index_count = (uint32_t)indices.size();
+
+	glEnableVertexAttribArray(0);
+	glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(BenchmarkVertex),
+		(void*)offsetof(BenchmarkVertex, position));
+	glEnableVertexAttribArray(1);
+	glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(BenchmarkVertex),
+		(void*)offsetof(BenchmarkVertex, uv));
+}
+
+void BenchmarkScene::place_in_grid()
+{
+	const uint32_t columns = grid_columns(count);
+	const float cell = 2.0f / (float)columns;
+	scale = cell * 0.45f;
+
+	offsets.resize(count);
+	for (uint32_t i = 0; i < count; i++)
+	{
+		offsets[i] = glm::vec2(-1.0f + cell * ((float)(i % columns) + 0.5f),
+			-1.0f + cell * ((float)(i / columns) + 0.5f));
+	}
+}
+
+void BenchmarkScene::draw() const
+{
+	glUseProgram(program);
+	glBindVertexArray(vao);
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_2D, white_texture);
+	glUniform1f(scale_location, scale);
+	glUniform4f(color_location, 1.0f, 1.0f, 1.0f, 1.0f);
+
+	switch (kind)
+	{
+		case BenchmarkSceneKind::Triangles:
+		case BenchmarkSceneKind::Draws:
+		{
+			for (const glm::vec2& offset : offsets)
+			{
+				glUniform2f(offset_location, offset.x, offset.y);
+				glDrawElements(GL_TRIANGLES, (GLsizei)index_count, GL_UNSIGNED_INT, nullptr);
+			}
+			break;
+		}
+		case BenchmarkSceneKind::Instances:
+		{
+			glUniform2f(offset_location, 0.0f, 0.0f);
+			glDrawElementsInstanced(GL_TRIANGLES, (GLsizei)index_count, GL_UNSIGNED_INT,
+				nullptr, (GLsizei)count);
+			break;
+		}
+		case BenchmarkSceneKind::Materials:
+		{
+			for (uint32_t i = 0; i < count; i++)
+			{
+				glBindTexture(GL_TEXTURE_2D, textures[i]);
+				glUniform2f(offset_location, offsets[i].x, offsets[i].y);
+				glDrawElements(GL_TRIANGLES, (GLsizei)index_count, GL_UNSIGNED_INT, nullptr);
+			}
+			break;
+		}
+		case BenchmarkSceneKind::Fill:
+		{
+			// Blending keeps every layer from being rejected early, so each
+			// one shades the full screen
+			glEnable(GL_BLEND);
+			glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+			glUniform4f(color_location, 1.0f, 1.0f, 1.0f, 1.0f / (float)count);
+			glUniform2f(offset_location, 0.0f, 0.0f);
+			for (uint32_t i = 0; i < count; i++)
+			{
+				glDrawElements(GL_TRIANGLES, (GLsizei)index_count, GL_UNSIGNED_INT, nullptr);
+			}
+			glDisable(GL_BLEND);
+			break;
+		}
+	}
+
+	glBindVertexArray(0);
+}
+
+void BenchmarkScene::destroy()
+{
+	glDeleteTextures((GLsizei)textures.size(), textures.data());
+	glDeleteTextures(1, &white_texture);
+	glDeleteBuffers(1, &instance_buffer);
+	glDeleteBuffers(1, &ebo);
+	glDeleteBuffers(1, &vbo);
+	glDeleteVertexArrays(1, &vao);
+
+	*this = BenchmarkScene();
+}
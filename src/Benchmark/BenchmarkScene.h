@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <glm/vec2.hpp>
+
+// What a scene stresses, one per benchmark scenario
+enum class BenchmarkSceneKind
+{
+	Triangles, // count triangles in a single draw
+	Draws, // count draws of a small mesh
+	Instances, // count instances of a small mesh in one draw
+	Materials, // count quads, each with its own texture
+	Fill, // count blended full-screen quads
+};
+
+// Triangles in the small mesh the draw and instance scenes repeat
+constexpr uint32_t BENCHMARK_MESH_TRIANGLES = 32;
+constexpr uint32_t BENCHMARK_TEXTURE_SIZE = 64;
+
+// A synthetic scene built for one value of a scenario's parameter. Every
+// scene draws with the benchmark shader, whose program is passed in.
+class BenchmarkScene
+{
+public:
+	void create(BenchmarkSceneKind scene_kind, uint32_t scene_count, uint32_t program);
+	void draw() const;
+	void destroy();
+
+private:
+	struct BenchmarkVertex
+	{
+		glm::vec2 position;
+		glm::vec2 uv;
+	};
+
+	void upload(const std::vector<BenchmarkVertex>& vertices,
+		const std::vector<uint32_t>& indices);
+	// Lays count cells out in a square grid over the screen
+	void place_in_grid();
+
+	BenchmarkSceneKind kind = BenchmarkSceneKind::Triangles;
+	uint32_t count = 0;
+	uint32_t program = 0;
+
+	uint32_t vao = 0;
+	uint32_t vbo = 0;
+	uint32_t ebo = 0;
+	uint32_t instance_buffer = 0;
+	uint32_t index_count = 0;
+
+	uint32_t white_texture = 0;
+	std::vector<uint32_t> textures; // one per material
+
+	std::vector<glm::vec2> offsets; // per draw
+	float scale = 1.0f;
+
+	// Looked up once, so the draw loop only measures the driver
+	int offset_location = -1;
+	int scale_location = -1;
+	int color_location = -1;
+};
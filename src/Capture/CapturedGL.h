@@ -0,0 +1,292 @@
+#pragma once
+
+// Routes the GL calls of the file that includes this through the command
+// capture, which records them while a capture is running. Include it after
+// everything else that pulls in GL. Calls not listed here reach the driver
+// directly and are never recorded, which is fine for queries but not for
+// anything that changes state.
+
+#include <GL/glew.h>
+#include <GL/gl.h>
+
+void capture_glActiveTexture(GLenum texture);
+void capture_glAttachShader(GLuint program, GLuint shader);
+void capture_glBindBuffer(GLenum target, GLuint buffer);
+void capture_glBindBufferBase(GLenum target, GLuint index, GLuint buffer);
+void capture_glBindFramebuffer(GLenum target, GLuint framebuffer);
+void capture_glBindImageTexture(GLuint unit, GLuint texture, GLint level, GLboolean layered,
+	GLint layer, GLenum access, GLenum format);
+void capture_glBindRenderbuffer(GLenum target, GLuint renderbuffer);
+void capture_glBindTexture(GLenum target, GLuint texture);
+void capture_glBindVertexArray(GLuint array);
+void capture_glBlitFramebuffer(GLint src_x0, GLint src_y0, GLint src_x1, GLint src_y1,
+	GLint dst_x0, GLint dst_y0, GLint dst_x1, GLint dst_y1, GLbitfield mask, GLenum filter);
+void capture_glBufferData(GLenum target, GLsizeiptr size, const void* data, GLenum usage);
+void capture_glBufferSubData(GLenum target, GLintptr offset, GLsizeiptr size, const void* data);
+void capture_glClear(GLbitfield mask);
+void capture_glClearColor(GLfloat red, GLfloat green, GLfloat blue, GLfloat alpha);
+void capture_glColorMask(GLboolean red, GLboolean green, GLboolean blue, GLboolean alpha);
+void capture_glCompileShader(GLuint shader);
+void capture_glCompressedTexImage2D(GLenum target, GLint level, GLenum internal_format,
+	GLsizei width, GLsizei height, GLint border, GLsizei image_size, const void* data);
+void capture_glCopyBufferSubData(GLenum read_target, GLenum write_target,
+	GLintptr read_offset, GLintptr write_offset, GLsizeiptr size);
+GLuint capture_glCreateProgram();
+GLuint capture_glCreateShader(GLenum type);
+void capture_glDeleteBuffers(GLsizei n, const GLuint* buffers);
+void capture_glDeleteFramebuffers(GLsizei n, const GLuint* framebuffers);
+void capture_glDeleteProgram(GLuint program);
+void capture_glDeleteRenderbuffers(GLsizei n, const GLuint* renderbuffers);
+void capture_glDeleteShader(GLuint shader);
+void capture_glDeleteTextures(GLsizei n, const GLuint* textures);
+void capture_glDeleteVertexArrays(GLsizei n, const GLuint* arrays);
+void capture_glDepthFunc(GLenum func);
+void capture_glDepthMask(GLboolean flag);
+void capture_glDetachShader(GLuint program, GLuint shader);
+void capture_glDisable(GLenum capability);
+void capture_glDisableVertexAttribArray(GLuint index);
+void capture_glDispatchCompute(GLuint groups_x, GLuint groups_y, GLuint groups_z);
+void capture_glDrawArrays(GLenum mode, GLint first, GLsizei count);
+void capture_glDrawBuffer(GLenum buffer);
+void capture_glDrawElements(GLenum mode, GLsizei count, GLenum type, const void* indices);
+void capture_glDrawElementsInstancedBaseVertex(GLenum mode, GLsizei count, GLenum type,
+	const void* indices, GLsizei instance_count, GLint base_vertex);
+void capture_glEnable(GLenum capability);
+void capture_glEnableVertexAttribArray(GLuint index);
+void capture_glFlush();
+void capture_glFramebufferRenderbuffer(GLenum target, GLenum attachment,
+	GLenum renderbuffer_target, GLuint renderbuffer);
+void capture_glFramebufferTexture2D(GLenum target, GLenum attachment, GLenum texture_target,
+	GLuint texture, GLint level);
+void capture_glFramebufferTextureLayer(GLenum target, GLenum attachment, GLuint texture,
+	GLint level, GLint layer);
+void capture_glGenBuffers(GLsizei n, GLuint* buffers);
+void capture_glGenFramebuffers(GLsizei n, GLuint* framebuffers);
+void capture_glGenRenderbuffers(GLsizei n, GLuint* renderbuffers);
+void capture_glGenTextures(GLsizei n, GLuint* textures);
+void capture_glGenVertexArrays(GLsizei n, GLuint* arrays);
+void capture_glGenerateMipmap(GLenum target);
+GLint capture_glGetUniformLocation(GLuint program, const GLchar* name);
+void capture_glInvalidateFramebuffer(GLenum target, GLsizei count, const GLenum* attachments);
+void capture_glLinkProgram(GLuint program);
+void* capture_glMapBufferRange(GLenum target, GLintptr offset, GLsizeiptr length,
+	GLbitfield access);
+void capture_glMemoryBarrier(GLbitfield barriers);
+void capture_glMultiDrawElements(GLenum mode, const GLsizei* count, GLenum type,
+	const void* const* indices, GLsizei draw_count);
+void capture_glMultiDrawElementsBaseVertex(GLenum mode, const GLsizei* count, GLenum type,
+	const void* const* indices, GLsizei draw_count, const GLint* base_vertex);
+void capture_glMultiDrawElementsIndirect(GLenum mode, GLenum type, const void* indirect,
+	GLsizei draw_count, GLsizei stride);
+void capture_glPixelStorei(GLenum name, GLint param);
+void capture_glPolygonMode(GLenum face, GLenum mode);
+void capture_glPolygonOffset(GLfloat factor, GLfloat units);
+void capture_glReadBuffer(GLenum buffer);
+void capture_glRenderbufferStorage(GLenum target, GLenum internal_format, GLsizei width,
+	GLsizei height);
+void capture_glShaderSource(GLuint shader, GLsizei count, const GLchar* const* strings,
+	const GLint* lengths);
+void capture_glTexBuffer(GLenum target, GLenum internal_format, GLuint buffer);
+void capture_glTexImage2D(GLenum target, GLint level, GLint internal_format, GLsizei width,
+	GLsizei height, GLint border, GLenum format, GLenum type, const void* pixels);
+void capture_glTexImage3D(GLenum target, GLint level, GLint internal_format, GLsizei width,
+	GLsizei height, GLsizei depth, GLint border, GLenum format, GLenum type,
+	const void* pixels);
+void capture_glTexParameteri(GLenum target, GLenum name, GLint param);
+void capture_glTexStorage2D(GLenum target, GLsizei levels, GLenum internal_format,
+	GLsizei width, GLsizei height);
+void capture_glTexSubImage2D(GLenum target, GLint level, GLint x, GLint y, GLsizei width,
+	GLsizei height, GLenum format, GLenum type, const void* pixels);
+void capture_glTexSubImage3D(GLenum target, GLint level, GLint x, GLint y, GLint z,
+	GLsizei width, GLsizei height, GLsizei depth, GLenum format, GLenum type,
+	const void* pixels);
+void capture_glTextureView(GLuint texture, GLenum target, GLuint original_texture,
+	GLenum internal_format, GLuint min_level, GLuint num_levels, GLuint min_layer,
+	GLuint num_layers);
+void capture_glUniform1f(GLint location, GLfloat value);
+void capture_glUniform1i(GLint location, GLint value);
+void capture_glUniform2fv(GLint location, GLsizei count, const GLfloat* value);
+void capture_glUniform3fv(GLint location, GLsizei count, const GLfloat* value);
+void capture_glUniform3iv(GLint location, GLsizei count, const GLint* value);
+void capture_glUniform4fv(GLint location, GLsizei count, const GLfloat* value);
+void capture_glUniformMatrix4fv(GLint location, GLsizei count, GLboolean transpose,
+	const GLfloat* value);
+GLboolean capture_glUnmapBuffer(GLenum target);
+void capture_glUseProgram(GLuint program);
+void capture_glVertexAttrib4f(GLuint index, GLfloat x, GLfloat y, GLfloat z, GLfloat w);
+void capture_glVertexAttribDivisor(GLuint index, GLuint divisor);
+void capture_glVertexAttribPointer(GLuint index, GLint size, GLenum type,
+	GLboolean normalized, GLsizei stride, const void* pointer);
+void capture_glViewport(GLint x, GLint y, GLsizei width, GLsizei height);
+
+// GLCapture.cpp calls the real functions
+#ifndef GL_CAPTURE_IMPLEMENTATION
+#undef glActiveTexture
+#define glActiveTexture capture_glActiveTexture
+#undef glAttachShader
+#define glAttachShader capture_glAttachShader
+#undef glBindBuffer
+#define glBindBuffer capture_glBindBuffer
+#undef glBindBufferBase
+#define glBindBufferBase capture_glBindBufferBase
+#undef glBindFramebuffer
+#define glBindFramebuffer capture_glBindFramebuffer
+#undef glBindImageTexture
+#define glBindImageTexture capture_glBindImageTexture
+#undef glBindRenderbuffer
+#define glBindRenderbuffer capture_glBindRenderbuffer
+#undef glBindTexture
+#define glBindTexture capture_glBindTexture
+#undef glBindVertexArray
+#define glBindVertexArray capture_glBindVertexArray
+#undef glBlitFramebuffer
+#define glBlitFramebuffer capture_glBlitFramebuffer
+#undef glBufferData
+#define glBufferData capture_glBufferData
+#undef glBufferSubData
+#define glBufferSubData capture_glBufferSubData
+#undef glClear
+#define glClear capture_glClear
+#undef glClearColor
+#define glClearColor capture_glClearColor
+#undef glColorMask
+#define glColorMask capture_glColorMask
+#undef glCompileShader
+#define glCompileShader capture_glCompileShader
+#undef glCompressedTexImage2D
+#define glCompressedTexImage2D capture_glCompressedTexImage2D
+#undef glCopyBufferSubData
+#define glCopyBufferSubData capture_glCopyBufferSubData
+#undef glCreateProgram
+#define glCreateProgram capture_glCreateProgram
+#undef glCreateShader
+#define glCreateShader capture_glCreateShader
+#undef glDeleteBuffers
+#define glDeleteBuffers capture_glDeleteBuffers
+#undef glDeleteFramebuffers
+#define glDeleteFramebuffers capture_glDeleteFramebuffers
+#undef glDeleteProgram
+#define glDeleteProgram capture_glDeleteProgram
+#undef glDeleteRenderbuffers
+#define glDeleteRenderbuffers capture_glDeleteRenderbuffers
+#undef glDeleteShader
+#define glDeleteShader capture_glDeleteShader
+#undef glDeleteTextures
+#define glDeleteTextures capture_glDeleteTextures
+#undef glDeleteVertexArrays
+#define glDeleteVertexArrays capture_glDeleteVertexArrays
+#undef glDepthFunc
+#define glDepthFunc capture_glDepthFunc
+#undef glDepthMask
+#define glDepthMask capture_glDepthMask
+#undef glDetachShader
+#define glDetachShader capture_glDetachShader
+#undef glDisable
+#define glDisable capture_glDisable
+#undef glDisableVertexAttribArray
+#define glDisableVertexAttribArray capture_glDisableVertexAttribArray
+#undef glDispatchCompute
+#define glDispatchCompute capture_glDispatchCompute
+#undef glDrawArrays
+#define glDrawArrays capture_glDrawArrays
+#undef glDrawBuffer
+#define glDrawBuffer capture_glDrawBuffer
+#undef glDrawElements
+#define glDrawElements capture_glDrawElements
+#undef glDrawElementsInstancedBaseVertex
+#define glDrawElementsInstancedBaseVertex capture_glDrawElementsInstancedBaseVertex
+#undef glEnable
+#define glEnable capture_glEnable
+#undef glEnableVertexAttribArray
+#define glEnableVertexAttribArray capture_glEnableVertexAttribArray
+#undef glFlush
+#define glFlush capture_glFlush
+#undef glFramebufferRenderbuffer
+#define glFramebufferRenderbuffer capture_glFramebufferRenderbuffer
+#undef glFramebufferTexture2D
+#define glFramebufferTexture2D capture_glFramebufferTexture2D
+#undef glFramebufferTextureLayer
+#define glFramebufferTextureLayer capture_glFramebufferTextureLayer
+#undef glGenBuffers
+#define glGenBuffers capture_glGenBuffers
+#undef glGenFramebuffers
+#define glGenFramebuffers capture_glGenFramebuffers
+#undef glGenRenderbuffers
+#define glGenRenderbuffers capture_glGenRenderbuffers
+#undef glGenTextures
+#define glGenTextures capture_glGenTextures
+#undef glGenVertexArrays
+#define glGenVertexArrays capture_glGenVertexArrays
+#undef glGenerateMipmap
+#define glGenerateMipmap capture_glGenerateMipmap
+#undef glGetUniformLocation
+#define glGetUniformLocation capture_glGetUniformLocation
+#undef glInvalidateFramebuffer
+#define glInvalidateFramebuffer capture_glInvalidateFramebuffer
+#undef glLinkProgram
+#define glLinkProgram capture_glLinkProgram
+#undef glMapBufferRange
+#define glMapBufferRange capture_glMapBufferRange
+#undef glMemoryBarrier
+#define glMemoryBarrier capture_glMemoryBarrier
+#undef glMultiDrawElements
+#define glMultiDrawElements capture_glMultiDrawElements
+#undef glMultiDrawElementsBaseVertex
+#define glMultiDrawElementsBaseVertex capture_glMultiDrawElementsBaseVertex
+#undef glMultiDrawElementsIndirect
+#define glMultiDrawElementsIndirect capture_glMultiDrawElementsIndirect
+#undef glPixelStorei
+#define glPixelStorei capture_glPixelStorei
+#undef glPolygonMode
+#define glPolygonMode capture_glPolygonMode
+#undef glPolygonOffset
+#define glPolygonOffset capture_glPolygonOffset
+#undef glReadBuffer
+#define glReadBuffer capture_glReadBuffer
+#undef glRenderbufferStorage
+#define glRenderbufferStorage capture_glRenderbufferStorage
+#undef glShaderSource
+#define glShaderSource capture_glShaderSource
+#undef glTexBuffer
+#define glTexBuffer capture_glTexBuffer
+#undef glTexImage2D
+#define glTexImage2D capture_glTexImage2D
+#undef glTexImage3D
+#define glTexImage3D capture_glTexImage3D
+#undef glTexParameteri
+#define glTexParameteri capture_glTexParameteri
+#undef glTexStorage2D
+#define glTexStorage2D capture_glTexStorage2D
+#undef glTexSubImage2D
+#define glTexSubImage2D capture_glTexSubImage2D
+#undef glTexSubImage3D
+#define glTexSubImage3D capture_glTexSubImage3D
+#undef glTextureView
+#define glTextureView capture_glTextureView
+#undef glUniform1f
+#define glUniform1f capture_glUniform1f
+#undef glUniform1i
+#define glUniform1i capture_glUniform1i
+#undef glUniform2fv
+#define glUniform2fv capture_glUniform2fv
+#undef glUniform3fv
+#define glUniform3fv capture_glUniform3fv
+#undef glUniform3iv
+#define glUniform3iv capture_glUniform3iv
+#undef glUniform4fv
+#define glUniform4fv capture_glUniform4fv
+#undef glUniformMatrix4fv
+#define glUniformMatrix4fv capture_glUniformMatrix4fv
+#undef glUnmapBuffer
+#define glUnmapBuffer capture_glUnmapBuffer
+#undef glUseProgram
+#define glUseProgram capture_glUseProgram
+#undef glVertexAttrib4f
+#define glVertexAttrib4f capture_glVertexAttrib4f
+#undef glVertexAttribDivisor
+#define glVertexAttribDivisor capture_glVertexAttribDivisor
+#undef glVertexAttribPointer
+#define glVertexAttribPointer capture_glVertexAttribPointer
+#undef glViewport
+#define glViewport capture_glViewport
+#endif
@@ -0,0 +1,202 @@
+#include "CommandStream.h"
+
+#include <iostream>
+
+const char* gl_command_name(GLCommand command)
+{
+	static const char* const names[] = {
+		"glActiveTexture", "glAttachShader", "glBindBuffer", "glBindBufferBase",
+		"glBindFramebuffer", "glBindImageTexture", "glBindRenderbuffer", "glBindTexture",
+		"glBindVertexArray", "glBlitFramebuffer", "glBufferData",
+		"glBufferSubData", "glClear", "glClearColor", "glColorMask", "glCompileShader",
+		"glCompressedTexImage2D", "glCopyBufferSubData", "glCreateProgram", "glCreateShader",
+		"glDeleteBuffers", "glDeleteFramebuffers", "glDeleteProgram", "glDeleteRenderbuffers",
+		"glDeleteShader", "glDeleteTextures", "glDeleteVertexArrays", "glDepthFunc",
+		"glDepthMask", "glDetachShader", "glDisable", "glDisableVertexAttribArray",
+		"glDispatchCompute", "glDrawArrays", "glDrawBuffer", "glDrawElements",
+		"glDrawElementsInstancedBaseVertex", "glEnable", "glEnableVertexAttribArray", "glFlush",
+		"glFramebufferRenderbuffer", "glFramebufferTexture2D", "glFramebufferTextureLayer",
+		"glGenBuffers", "glGenFramebuffers", "glGenRenderbuffers",
+		"glGenTextures", "glGenVertexArrays", "glGenerateMipmap", "glGetUniformLocation",
+		"glInvalidateFramebuffer", "glLinkProgram", "glMemoryBarrier", "glMultiDrawElements", "glMultiDrawElementsBaseVertex",
+		"glMultiDrawElementsIndirect", "glPixelStorei",
+		"glPolygonMode", "glPolygonOffset", "glReadBuffer",
+		"glRenderbufferStorage", "glShaderSource", "glTexBuffer", "glTexImage2D",
+		"glTexImage3D", "glTexParameteri", "glTexStorage2D", "glTexSubImage2D", "glTexSubImage3D",
+		"glTextureView",
+		"glUniform1f", "glUniform1i", "glUniform2fv", "glUniform3fv", "glUniform3iv",
+		"glUniform4fv", "glUniformMatrix4fv",
+		"glUseProgram", "glVertexAttrib4f", "glVertexAttribDivisor", "glVertexAttribPointer",
+		"glViewport", "end of frame",
+	};
+	static_assert(sizeof(names) / sizeof(names[0]) == (size_t)GLCommand::Count);
+
+	return command < GLCommand::Count ? names[(size_t)command] : "unknown";
+}
+
+bool CommandWriter::open(const std::string& path, int width, int height)
+{
+	file.open(path, std::ios::binary);
+	if (!file)
+	{
+		std::cerr << "Unable to create command stream: " << path << "\n";
+		return false;
+	}
+
+	header = CommandStreamHeader();
+	header.width = width;
+	header.height = height;
+	written = 0;
+
+	// Rewritten with the final counts on close
+	file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	buffer.reserve(COMMAND_STREAM_FLUSH_SIZE);
+	return true;
+}
+
+void CommandWriter::close()
+{
+	if (!file.is_open())
+	{
+		return;
+	}
+
+	flush();
+	file.seekp(0);
+	file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	file.close();
+	buffer = std::vector<uint8_t>();
+}
+
+bool CommandWriter::is_open() const
+{
+	return file.is_open();
+}
+
+void CommandWriter::begin(GLCommand command)
+{
+	write((uint16_t)command);
+	header.command_count++;
+}
+
+void CommandWriter::end_frame()
+{
+	begin(GLCommand::EndFrame);
+	header.frame_count++;
+}
+
+void CommandWriter::write_blob(const void* data, size_t size)
+{
+	write((uint64_t)size);
+	write_bytes(data, size);
+}
+
+uint32_t CommandWriter::frames() const
+{
+	return header.frame_count;
+}
+
+uint64_t CommandWriter::bytes_written() const
+{
+	return written + buffer.size();
+}
+
+void CommandWriter::write_bytes(const void* data, size_t size)
+{
+	const uint8_t* bytes = static_cast<const uint8_t*>(data);
+	buffer.insert(buffer.end(), bytes, bytes + size);
+	if (buffer.size() >= COMMAND_STREAM_FLUSH_SIZE)
+	{
+		flush();
+	}
+}
+
+void CommandWriter::flush()
+{
+	file.write(reinterpret_cast<const char*>(buffer.data()), (std::streamsize)buffer.size());
+	written += buffer.size();
+	buffer.clear();
+}
+
+bool CommandReader::open(const std::string& path)
+{
+	std::ifstream file(path, std::ios::binary | std::ios::ate);
+	if (!file)
+	{
+		std::cerr << "Unable to open command stream: " << path << "\n";
+		return false;
+	}
+
+	data.resize((size_t)file.tellg());
+	file.seekg(0);
+	file.read(reinterpret_cast<char*>(data.data()), (std::streamsize)data.size());
+
+	if (!file || data.size() < sizeof(CommandStreamHeader))
+	{
+		std::cerr << "Command stream is too small: " << path << "\n";
+		return false;
+	}
+
+	std::memcpy(&stream_header, data.data(), sizeof(stream_header));
+	if (stream_header.magic != COMMAND_STREAM_MAGIC || stream_header.version != COMMAND_STREAM_VERSION)
+	{
+		std::cerr << "Invalid command stream: " << path << "\n";
+		return false;
+	}
+
+	position = sizeof(CommandStreamHeader);
+	overrun = false;
+	return true;
+}
+
+bool CommandReader::next(GLCommand& command)
+{
+	if (overrun || position + sizeof(uint16_t) > data.size())
+	{
+		return false;
+	}
+
+	command = (GLCommand)read<uint16_t>();
+	if (command >= GLCommand::Count)
+	{
+		std::cerr << "Unknown command " << (uint32_t)command << " in command stream\n";
+		return false;
+	}
+	return true;
+}
+
+const uint8_t* CommandReader::read_blob(size_t& size)
+{
+	size = (size_t)read<uint64_t>();
+	const uint8_t* bytes = read_bytes(size);
+	if (overrun)
+	{
+		size = 0;
+	}
+	return bytes;
+}
+
+const CommandStreamHeader& CommandReader::header() const
+{
+	return stream_header;
+}
+
+const uint8_t* CommandReader::read_bytes(size_t size)
+{
+	// A truncated stream reads as zeros and ends at the next command. Only
+	// plain values are read from it then, blobs come back empty.
+	if (overrun || size > data.size() - position)
+	{
+		if (!overrun)
+		{
+			std::cerr << "Command stream ends in the middle of a command\n";
+		}
+		overrun = true;
+		zeros.assign(sizeof(uint64_t) * 4, 0);
+		return zeros.data();
+	}
+
+	const uint8_t* bytes = data.data() + position;
+	position += size;
+	return bytes;
+}
@@ -0,0 +1,192 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+constexpr uint32_t COMMAND_STREAM_MAGIC = 0x53434c47; // "GLCS"
+constexpr uint32_t COMMAND_STREAM_VERSION = 8;
+// Commands are buffered and written out in chunks of this size
+constexpr size_t COMMAND_STREAM_FLUSH_SIZE = 4 * 1024 * 1024;
+
+struct CommandStreamHeader
+{
+	uint32_t magic = COMMAND_STREAM_MAGIC;
+	uint32_t version = COMMAND_STREAM_VERSION;
+	// Of the default framebuffer, which replays render into one this size
+	int32_t width = 0;
+	int32_t height = 0;
+	uint32_t frame_count = 0;
+	uint32_t reserved = 0;
+	uint64_t command_count = 0;
+};
+
+// Every recorded call. Arguments follow the opcode in the order the GL
+// function takes them; pointers to client memory become sized blobs, and
+// pointers into bound buffers become 64 bit offsets.
+enum class GLCommand : uint16_t
+{
+	ActiveTexture,
+	AttachShader,
+	BindBuffer,
+	BindBufferBase,
+	BindFramebuffer,
+	BindImageTexture,
+	BindRenderbuffer,
+	BindTexture,
+	BindVertexArray,
+	BlitFramebuffer,
+	BufferData,
+	BufferSubData,
+	Clear,
+	ClearColor,
+	ColorMask,
+	CompileShader,
+	CompressedTexImage2D,
+	CopyBufferSubData,
+	CreateProgram,
+	CreateShader,
+	DeleteBuffers,
+	DeleteFramebuffers,
+	DeleteProgram,
+	DeleteRenderbuffers,
+	DeleteShader,
+	DeleteTextures,
+	DeleteVertexArrays,
+	DepthFunc,
+	DepthMask,
+	DetachShader,
+	Disable,
+	DisableVertexAttribArray,
+	DispatchCompute,
+	DrawArrays,
+	DrawBuffer,
+	DrawElements,
+	DrawElementsInstancedBaseVertex,
+	Enable,
+	EnableVertexAttribArray,
+	Flush,
+	FramebufferRenderbuffer,
+	FramebufferTexture2D,
+	FramebufferTextureLayer,
+	GenBuffers,
+	GenFramebuffers,
+	GenRenderbuffers,
+	GenTextures,
+	GenVertexArrays,
+	GenerateMipmap,
+	GetUniformLocation,
+	InvalidateFramebuffer,
+	LinkProgram,
+	MemoryBarrier,
+	MultiDrawElements,
+	MultiDrawElementsBaseVertex,
+	MultiDrawElementsIndirect,
+	PixelStorei,
+	PolygonMode,
+	PolygonOffset,
+	ReadBuffer,
+	RenderbufferStorage,
+	ShaderSource,
+	TexBuffer,
+	TexImage2D,
+	TexImage3D,
+	TexParameteri,
+	TexStorage2D,
+	TexSubImage2D,
+	TexSubImage3D,
+	TextureView,
+	Uniform1f,
+	Uniform1i,
+	Uniform2fv,
+	Uniform3fv,
+	Uniform3iv,
+	Uniform4fv,
+	UniformMatrix4fv,
+	UseProgram,
+	VertexAttrib4f,
+	VertexAttribDivisor,
+	VertexAttribPointer,
+	Viewport,
+	EndFrame,
+	Count,
+};
+
+// Where the pixels of a texture upload come from
+enum class PixelSource : uint8_t
+{
+	None, // no pixels, storage only
+	Data, // a blob follows
+	UnpackBuffer, // an offset into the bound pixel unpack buffer follows
+};
+
+const char* gl_command_name(GLCommand command);
+
+// Appends commands to a stream file
+class CommandWriter
+{
+public:
+	bool open(const std::string& path, int width, int height);
+	// Writes out what's buffered and the final frame and command counts
+	void close();
+	bool is_open() const;
+
+	void begin(GLCommand command);
+	void end_frame();
+
+	template <typename T>
+	void write(const T& value)
+	{
+		static_assert(std::is_trivially_copyable_v<T>);
+		write_bytes(&value, sizeof(T));
+	}
+	// A 64 bit size followed by the bytes
+	void write_blob(const void* data, size_t size);
+
+	uint32_t frames() const;
+	uint64_t bytes_written() const;
+
+private:
+	void write_bytes(const void* data, size_t size);
+	void flush();
+
+	std::ofstream file;
+	std::vector<uint8_t> buffer;
+	CommandStreamHeader header;
+	uint64_t written = 0;
+};
+
+// Reads a whole stream file into memory and walks its commands
+class CommandReader
+{
+public:
+	bool open(const std::string& path);
+
+	// False at the end of the stream
+	bool next(GLCommand& command);
+
+	template <typename T>
+	T read()
+	{
+		static_assert(std::is_trivially_copyable_v<T>);
+		T value;
+		std::memcpy(&value, read_bytes(sizeof(T)), sizeof(T));
+		return value;
+	}
+	// Points into the stream, valid while the reader lives
+	const uint8_t* read_blob(size_t& size);
+
+	const CommandStreamHeader& header() const;
+
+private:
+	const uint8_t* read_bytes(size_t size);
+
+	std::vector<uint8_t> data;
+	std::vector<uint8_t> zeros; // read in place of a truncated stream
+	CommandStreamHeader stream_header;
+	size_t position = 0;
+	bool overrun = false;
+};
@@ -0,0 +1,1027 @@
+#define GL_CAPTURE_IMPLEMENTATION
+#include "CapturedGL.h"
+#include "GLCapture.h"
+
+#include <iostream>
+#include <string>
+#include <unordered_map>
+
+#include "CommandStream.h"
+
+namespace
+{
+	// A buffer range mapped for writing, recorded as an upload on unmap
+	struct Mapping
+	{
+		void* pointer = nullptr;
+		GLintptr offset = 0;
+		GLsizeiptr length = 0;
+	};
+
+	struct CaptureState
+	{
+		CommandWriter writer;
+		std::string path;
+		bool active = false;
+		uint32_t frames_left = 0;
+
+		// Tracked whether capturing or not, as uploads depend on them
+		GLuint unpack_buffer = 0;
+		GLint unpack_alignment = 4;
+		std::unordered_map<GLenum, Mapping> mappings; // by target
+	};
+
+	// Made on first use and never destroyed, so static initialization and
+	// teardown order never matter
+	CaptureState& capture()
+	{
+		static CaptureState* state = new CaptureState();
+		return *state;
+	}
+
+	template <typename... Args>
+	void record(GLCommand command, const Args&... args)
+	{
+		capture().writer.begin(command);
+		(capture().writer.write(args), ...);
+	}
+
+	void record_names(GLCommand command, GLsizei n, const GLuint* names)
+	{
+		capture().writer.begin(command);
+		capture().writer.write_blob(names, sizeof(GLuint) * (size_t)n);
+	}
+
+	uint64_t offset_of(const void* pointer)
+	{
+		return (uint64_t)reinterpret_cast<uintptr_t>(pointer);
+	}
+
+	size_t component_count(GLenum format)
+	{
+		switch (format)
+		{
+			case GL_RED:
+				return 1;
+			case GL_RG:
+				return 2;
+			case GL_RGB:
+			case GL_BGR:
+				return 3;
+			default:
+				return 4;
+		}
+	}
+
+	size_t component_size(GLenum type)
+	{
+		switch (type)
+		{
+			case GL_UNSIGNED_BYTE:
+			case GL_BYTE:
+				return 1;
+			case GL_UNSIGNED_SHORT:
+			case GL_SHORT:
+			case GL_HALF_FLOAT:
+				return 2;
+			default:
+				return 4;
+		}
+	}
+
+	// Bytes an upload of this size reads, with rows padded to the unpack
+	// alignment apart from the last
+	size_t image_size(GLsizei width, GLsizei height, GLsizei depth, GLenum format,
+		GLenum type)
+	{
+		const size_t alignment = (size_t)capture().unpack_alignment;
+		const size_t row = (size_t)width * component_count(format) * component_size(type);
+		const size_t pitch = (row + alignment - 1) / alignment * alignment;
+		const size_t rows = (size_t)height * (size_t)depth;
+		return rows > 0 ? pitch * (rows - 1) + row : 0;
+	}
+
+	void record_pixels(const void* pixels, size_t size)
+	{
+		if (capture().unpack_buffer)
+		{
+			capture().writer.write(PixelSource::UnpackBuffer);
+			capture().writer.write(offset_of(pixels));
+		}
+		else if (pixels)
+		{
+			capture().writer.write(PixelSource::Data);
+			capture().writer.write_blob(pixels, size);
+		}
+		else
+		{
+			capture().writer.write(PixelSource::None);
+		}
+	}
+}
+
+bool gl_capture_begin(const std::string& path, uint32_t frame_count, int width,
+	int height)
+{
+	gl_capture_end();
+	if (frame_count == 0 || !capture().writer.open(path, width, height))
+	{
+		return false;
+	}
+
+	capture().path = path;
+	capture().active = true;
+	capture().frames_left = frame_count;
+	std::cout << "Capturing " << frame_count << " frames of GL calls to " << path << "\n";
+	return true;
+}
+
+void gl_capture_end_frame()
+{
+	if (!capture().active)
+	{
+		return;
+	}
+
+	capture().writer.end_frame();
+	if (--capture().frames_left == 0)
+	{
+		gl_capture_end();
+	}
+}
+
+void gl_capture_end()
+{
+	if (!capture().writer.is_open())
+	{
+		return;
+	}
+
+	std::cout << "Captured " << capture().writer.frames() << " frames, "
+			  << (double)capture().writer.bytes_written() / (1024.0 * 1024.0) << " MB, to "
+			  << capture().path << "\n";
+	capture().writer.close();
+	capture().active = false;
+	capture().mappings.clear();
+}
+
+bool gl_capture_active()
+{
+	return capture().active;
+}
+
+void capture_glActiveTexture(GLenum texture)
+{
+	if (capture().active)
+	{
+		record(GLCommand::ActiveTexture, texture);
+	}
+	glActiveTexture(texture);
+}
+
+void capture_glAttachShader(GLuint program, GLuint shader)
+{
+	if (capture().active)
+	{
+		record(GLCommand::AttachShader, program, shader);
+	}
+	glAttachShader(program, shader);
+}
+
+void capture_glBindBuffer(GLenum target, GLuint buffer)
+{
+	if (capture().active)
+	{
+		record(GLCommand::BindBuffer, target, buffer);
+	}
+	if (target == GL_PIXEL_UNPACK_BUFFER)
+	{
+		capture().unpack_buffer = buffer;
+	}
+	glBindBuffer(target, buffer);
+}
+
+void capture_glBindBufferBase(GLenum target, GLuint index, GLuint buffer)
+{
+	if (capture().active)
+	{
+		record(GLCommand::BindBufferBase, target, index, buffer);
+	}
+	glBindBufferBase(target, index, buffer);
+}
+
+void capture_glBindFramebuffer(GLenum target, GLuint framebuffer)
+{
+	if (capture().active)
+	{
+		record(GLCommand::BindFramebuffer, target, framebuffer);
+	}
+	glBindFramebuffer(target, framebuffer);
+}
+
+void capture_glBindImageTexture(GLuint unit, GLuint texture, GLint level, GLboolean layered,
+	GLint layer, GLenum access, GLenum format)
+{
+	if (capture().active)
+	{
+		record(GLCommand::BindImageTexture, unit, texture, level, layered, layer, access, format);
+	}
+	glBindImageTexture(unit, texture, level, layered, layer, access, format);
+}
+
+void capture_glBindRenderbuffer(GLenum target, GLuint renderbuffer)
+{
+	if (capture().active)
+	{
+		record(GLCommand::BindRenderbuffer, target, renderbuffer);
+	}
+	glBindRenderbuffer(target, renderbuffer);
+}
+
+void capture_glBindTexture(GLenum target, GLuint texture)
+{
+	if (capture().active)
+	{
+		record(GLCommand::BindTexture, target, texture);
+	}
+	glBindTexture(target, texture);
+}
+
+void capture_glBindVertexArray(GLuint array)
+{
+	if (capture().active)
+	{
+		record(GLCommand::BindVertexArray, array);
+	}
+	glBindVertexArray(array);
+}
+
+void capture_glBlitFramebuffer(GLint src_x0, GLint src_y0, GLint src_x1, GLint src_y1,
+	GLint dst_x0, GLint dst_y0, GLint dst_x1, GLint dst_y1, GLbitfield mask, GLenum filter)
+{
+	if (capture().active)
+	{
+		record(GLCommand::BlitFramebuffer, src_x0, src_y0, src_x1, src_y1, dst_x0, dst_y0, dst_x1,
+			dst_y1, mask, filter);
+	}
+	glBlitFramebuffer(src_x0, src_y0, src_x1, src_y1, dst_x0, dst_y0, dst_x1, dst_y1, mask,
+		filter);
+}
+
+void capture_glBufferData(GLenum target, GLsizeiptr size, const void* data, GLenum usage)
+{
+	if (capture().active)
+	{
+		record(GLCommand::BufferData, target, usage, (uint64_t)size);
+		capture().writer.write((uint8_t)(data != nullptr));
+		if (data)
+		{
+			capture().writer.write_blob(data, (size_t)size);
+		}
+	}
+	glBufferData(target, size, data, usage);
+}
+
+void capture_glBufferSubData(GLenum target, GLintptr offset, GLsizeiptr size, const void* data)
+{
+	if (capture().active)
+	{
+		record(GLCommand::BufferSubData, target, (uint64_t)offset);
+		capture().writer.write_blob(data, (size_t)size);
+	}
+	glBufferSubData(target, offset, size, data);
+}
+
+void capture_glClear(GLbitfield mask)
+{
+	if (capture().active)
+	{
+		record(GLCommand::Clear, mask);
+	}
+	glClear(mask);
+}
+
+void capture_glClearColor(GLfloat red, GLfloat green, GLfloat blue, GLfloat alpha)
+{
+	if (capture().active)
+	{
+		record(GLCommand::ClearColor, red, green, blue, alpha);
+	}
+	glClearColor(red, green, blue, alpha);
+}
+
+void capture_glColorMask(GLboolean red, GLboolean green, GLboolean blue, GLboolean alpha)
+{
+	if (capture().active)
+	{
+		record(GLCommand::ColorMask, red, green, blue, alpha);
+	}
+	glColorMask(red, green, blue, alpha);
+}
+
+void capture_glCompileShader(GLuint shader)
+{
+	if (capture().active)
+	{
+		record(GLCommand::CompileShader, shader);
+	}
+	glCompileShader(shader);
+}
+
+void capture_glCompressedTexImage2D(GLenum target, GLint level, GLenum internal_format,
+	GLsizei width, GLsizei height, GLint border, GLsizei image_size, const void* data)
+{
+	if (capture().active)
+	{
+		record(GLCommand::CompressedTexImage2D, target, level, internal_format, width,
+			height, border, image_size);
+		record_pixels(data, (size_t)image_size);
+	}
+	glCompressedTexImage2D(target, level, internal_format, width, height, border,
+		image_size, data);
+}
+
+void capture_glCopyBufferSubData(GLenum read_target, GLenum write_target,
+	GLintptr read_offset, GLintptr write_offset, GLsizeiptr size)
+{
+	if (capture().active)
+	{
+		record(GLCommand::CopyBufferSubData, read_target, write_target, (uint64_t)read_offset,
+			(uint64_t)write_offset, (uint64_t)size);
+	}
+	glCopyBufferSubData(read_target, write_target, read_offset, write_offset, size);
+}
+
+GLuint capture_glCreateProgram()
+{
+	const GLuint program = glCreateProgram();
+	if (capture().active)
+	{
+		record(GLCommand::CreateProgram, program);
+	}
+	return program;
+}
+
+GLuint capture_glCreateShader(GLenum type)
+{
+	const GLuint shader = glCreateShader(type);
+	if (capture().active)
+	{
+		record(GLCommand::CreateShader, type, shader);
+	}
+	return shader;
+}
+
+void capture_glDeleteBuffers(GLsizei n, const GLuint* buffers)
+{
+	if (capture().active)
+	{
+		record_names(GLCommand::DeleteBuffers, n, buffers);
+	}
+	glDeleteBuffers(n, buffers);
+}
+
+void capture_glDeleteFramebuffers(GLsizei n, const GLuint* framebuffers)
+{
+	if (capture().active)
+	{
+		record_names(GLCommand::DeleteFramebuffers, n, framebuffers);
+	}
+	glDeleteFramebuffers(n, framebuffers);
+}
+
+void capture_glDeleteProgram(GLuint program)
+{
+	if (capture().active)
+	{
+		record(GLCommand::DeleteProgram, program);
+	}
+	glDeleteProgram(program);
+}
+
+void capture_glDeleteRenderbuffers(GLsizei n, const GLuint* renderbuffers)
+{
+	if (capture().active)
+	{
+		record_names(GLCommand::DeleteRenderbuffers, n, renderbuffers);
+	}
+	glDeleteRenderbuffers(n, renderbuffers);
+}
+
+void capture_glDeleteShader(GLuint shader)
+{
+	if (capture().active)
+	{
+		record(GLCommand::DeleteShader, shader);
+	}
+	glDeleteShader(shader);
+}
+
+void capture_glDeleteTextures(GLsizei n, const GLuint* textures)
+{
+	if (capture().active)
+	{
+		record_names(GLCommand::DeleteTextures, n, textures);
+	}
+	glDeleteTextures(n, textures);
+}
+
+void capture_glDeleteVertexArrays(GLsizei n, const GLuint* arrays)
+{
+	if (capture().active)
+	{
+		record_names(GLCommand::DeleteVertexArrays, n, arrays);
+	}
+	glDeleteVertexArrays(n, arrays);
+}
+
+void capture_glDepthFunc(GLenum func)
+{
+	if (capture().active)
+	{
+		record(GLCommand::DepthFunc, func);
+	}
+	glDepthFunc(func);
+}
+
+void capture_glDepthMask(GLboolean flag)
+{
+	if (capture().active)
+	{
+		record(GLCommand::DepthMask, flag);
+	}
+	glDepthMask(flag);
+}
+
+void capture_glDetachShader(GLuint program, GLuint shader)
+{
+	if (capture().active)
+	{
+		record(GLCommand::DetachShader, program, shader);
+	}
+	glDetachShader(program, shader);
+}
+
+void capture_glDisable(GLenum capability)
+{
+	if (capture().active)
+	{
+		record(GLCommand::Disable, capability);
+	}
+	glDisable(capability);
+}
+
+void capture_glDisableVertexAttribArray(GLuint index)
+{
+	if (capture().active)
+	{
+		record(GLCommand::DisableVertexAttribArray, index);
+	}
+	glDisableVertexAttribArray(index);
+}
+
+void capture_glDispatchCompute(GLuint groups_x, GLuint groups_y, GLuint groups_z)
+{
+	if (capture().active)
+	{
+		record(GLCommand::DispatchCompute, groups_x, groups_y, groups_z);
+	}
+	glDispatchCompute(groups_x, groups_y, groups_z);
+}
+
+void capture_glDrawArrays(GLenum mode, GLint first, GLsizei count)
+{
+	if (capture().active)
+	{
+		record(GLCommand::DrawArrays, mode, first, count);
+	}
+	glDrawArrays(mode, first, count);
+}
+
+void capture_glDrawBuffer(GLenum buffer)
+{
+	if (capture().active)
+	{
+		record(GLCommand::DrawBuffer, buffer);
+	}
+	glDrawBuffer(buffer);
+}
+
+void capture_glDrawElements(GLenum mode, GLsizei count, GLenum type, const void* indices)
+{
+	if (capture().active)
+	{
+		record(GLCommand::DrawElements, mode, count, type, offset_of(indices));
+	}
+	glDrawElements(mode, count, type, indices);
+}
+
+void capture_glDrawElementsInstancedBaseVertex(GLenum mode, GLsizei count, GLenum type,
+	const void* indices, GLsizei instance_count, GLint base_vertex)
+{
+	if (capture().active)
+	{
+		record(GLCommand::DrawElementsInstancedBaseVertex, mode, count, type, offset_of(indices),
+			instance_count, base_vertex);
+	}
+	glDrawElementsInstancedBaseVertex(mode, count, type, indices, instance_count, base_vertex);
+}
+
+void capture_glEnable(GLenum capability)
+{
+	if (capture().active)
+	{
+		record(GLCommand::Enable, capability);
+	}
+	glEnable(capability);
+}
+
+void capture_glEnableVertexAttribArray(GLuint index)
+{
+	if (capture().active)
+	{
+		record(GLCommand::EnableVertexAttribArray, index);
+	}
+	glEnableVertexAttribArray(index);
+}
+
+void capture_glFlush()
+{
+	if (capture().active)
+	{
+		record(GLCommand::Flush);
+	}
+	glFlush();
+}
+
+void capture_glFramebufferRenderbuffer(GLenum target, GLenum attachment,
+	GLenum renderbuffer_target, GLuint renderbuffer)
+{
+	if (capture().active)
+	{
+		record(GLCommand::FramebufferRenderbuffer, target, attachment, renderbuffer_target,
+			renderbuffer);
+	}
+	glFramebufferRenderbuffer(target, attachment, renderbuffer_target, renderbuffer);
+}
+
+void capture_glFramebufferTexture2D(GLenum target, GLenum attachment, GLenum texture_target,
+	GLuint texture, GLint level)
+{
+	if (capture().active)
+	{
+		record(GLCommand::FramebufferTexture2D, target, attachment, texture_target, texture,
+			level);
+	}
+	glFramebufferTexture2D(target, attachment, texture_target, texture, level);
+}
+
+void capture_glFramebufferTextureLayer(GLenum target, GLenum attachment, GLuint texture,
+	GLint level, GLint layer)
+{
+	if (capture().active)
+	{
+		record(GLCommand::FramebufferTextureLayer, target, attachment, texture, level, layer);
+	}
+	glFramebufferTextureLayer(target, attachment, texture, level, layer);
+}
+
+void capture_glGenBuffers(GLsizei n, GLuint* buffers)
+{
+	glGenBuffers(n, buffers);
+	if (capture().active)
+	{
+		record_names(GLCommand::GenBuffers, n, buffers);
+	}
+}
+
+void capture_glGenFramebuffers(GLsizei n, GLuint* framebuffers)
+{
+	glGenFramebuffers(n, framebuffers);
+	if (capture().active)
+	{
+		record_names(GLCommand::GenFramebuffers, n, framebuffers);
+	}
+}
+
+void capture_glGenRenderbuffers(GLsizei n, GLuint* renderbuffers)
+{
+	glGenRenderbuffers(n, renderbuffers);
+	if (capture().active)
+	{
+		record_names(GLCommand::GenRenderbuffers, n, renderbuffers);
+	}
+}
+
+void capture_glGenTextures(GLsizei n, GLuint* textures)
+{
+	glGenTextures(n, textures);
+	if (capture().active)
+	{
+		record_names(GLCommand::GenTextures, n, textures);
+	}
+}
+
+void capture_glGenVertexArrays(GLsizei n, GLuint* arrays)
+{
+	glGenVertexArrays(n, arrays);
+	if (capture().active)
+	{
+		record_names(GLCommand::GenVertexArrays, n, arrays);
+	}
+}
+
+void capture_glGenerateMipmap(GLenum target)
+{
+	if (capture().active)
+	{
+		record(GLCommand::GenerateMipmap, target);
+	}
+	glGenerateMipmap(target);
+}
+
+GLint capture_glGetUniformLocation(GLuint program, const GLchar* name)
+{
+	// Replays look the name up again, as locations can differ between drivers
+	const GLint location = glGetUniformLocation(program, name);
+	if (capture().active)
+	{
+		record(GLCommand::GetUniformLocation, program, location);
+		capture().writer.write_blob(name, std::char_traits<char>::length(name));
+	}
+	return location;
+}
+
+void capture_glInvalidateFramebuffer(GLenum target, GLsizei count, const GLenum* attachments)
+{
+	if (capture().active)
+	{
+		record(GLCommand::InvalidateFramebuffer, target);
+		capture().writer.write_blob(attachments, sizeof(GLenum) * (size_t)count);
+	}
+	glInvalidateFramebuffer(target, count, attachments);
+}
+
+void capture_glLinkProgram(GLuint program)
+{
+	if (capture().active)
+	{
+		record(GLCommand::LinkProgram, program);
+	}
+	glLinkProgram(program);
+}
+
+void* capture_glMapBufferRange(GLenum target, GLintptr offset, GLsizeiptr length,
+	GLbitfield access)
+{
+	void* pointer = glMapBufferRange(target, offset, length, access);
+	if (capture().active && pointer && (access & GL_MAP_WRITE_BIT))
+	{
+		capture().mappings[target] = {pointer, offset, length};
+	}
+	return pointer;
+}
+
+void capture_glMemoryBarrier(GLbitfield barriers)
+{
+	if (capture().active)
+	{
+		record(GLCommand::MemoryBarrier, barriers);
+	}
+	glMemoryBarrier(barriers);
+}
+
+void capture_glMultiDrawElements(GLenum mode, const GLsizei* count, GLenum type,
+	const void* const* indices, GLsizei draw_count)
+{
+	if (capture().active)
+	{
+		record(GLCommand::MultiDrawElements, mode, type);
+		capture().writer.write_blob(count, sizeof(GLsizei) * (size_t)draw_count);
+		capture().writer.write_blob(indices, sizeof(const void*) * (size_t)draw_count);
+	}
+	glMultiDrawElements(mode, count, type, indices, draw_count);
+}
+
+void capture_glMultiDrawElementsBaseVertex(GLenum mode, const GLsizei* count, GLenum type,
+	const void* const* indices, GLsizei draw_count, const GLint* base_vertex)
+{
+	if (capture().active)
+	{
+		record(GLCommand::MultiDrawElementsBaseVertex, mode, type);
+		capture().writer.write_blob(count, sizeof(GLsizei) * (size_t)draw_count);
+		capture().writer.write_blob(indices, sizeof(const void*) * (size_t)draw_count);
+		capture().writer.write_blob(base_vertex, sizeof(GLint) * (size_t)draw_count);
+	}
+	glMultiDrawElementsBaseVertex(mode, count, type, indices, draw_count, base_vertex);
+}
+
+void capture_glMultiDrawElementsIndirect(GLenum mode, GLenum type, const void* indirect,
+	GLsizei draw_count, GLsizei stride)
+{
+	// The commands stay in the bound draw indirect buffer, which the stream
+	// already has
+	if (capture().active)
+	{
+		record(GLCommand::MultiDrawElementsIndirect, mode, type, offset_of(indirect), draw_count,
+			stride);
+	}
+	glMultiDrawElementsIndirect(mode, type, indirect, draw_count, stride);
+}
+
+void capture_glPixelStorei(GLenum name, GLint param)
+{
+	if (capture().active)
+	{
+		record(GLCommand::PixelStorei, name, param);
+	}
+	if (name == GL_UNPACK_ALIGNMENT)
+	{
+		capture().unpack_alignment = param;
+	}
+	glPixelStorei(name, param);
+}
+
+void capture_glPolygonMode(GLenum face, GLenum mode)
+{
+	if (capture().active)
+	{
+		record(GLCommand::PolygonMode, face, mode);
+	}
+	glPolygonMode(face, mode);
+}
+
+void capture_glPolygonOffset(GLfloat factor, GLfloat units)
+{
+	if (capture().active)
+	{
+		record(GLCommand::PolygonOffset, factor, units);
+	}
+	glPolygonOffset(factor, units);
+}
+
+void capture_glReadBuffer(GLenum buffer)
+{
+	if (capture().active)
+	{
+		record(GLCommand::ReadBuffer, buffer);
+	}
+	glReadBuffer(buffer);
+}
+
+void capture_glRenderbufferStorage(GLenum target, GLenum internal_format, GLsizei width,
+	GLsizei height)
+{
+	if (capture().active)
+	{
+		record(GLCommand::RenderbufferStorage, target, internal_format, width, height);
+	}
+	glRenderbufferStorage(target, internal_format, width, height);
+}
+
+void capture_glShaderSource(GLuint shader, GLsizei count, const GLchar* const* strings,
+	const GLint* lengths)
+{
+	if (capture().active)
+	{
+		// The pieces go in joined up, as one string
+		std::string source;
+		for (GLsizei i = 0; i < count; i++)
+		{
+			if (lengths && lengths[i] >= 0)
+			{
+				source.append(strings[i], (size_t)lengths[i]);
+			}
+			else
+			{
+				source.append(strings[i]);
+			}
+		}
+		record(GLCommand::ShaderSource, shader);
+		capture().writer.write_blob(source.data(), source.size());
+	}
+	glShaderSource(shader, count, strings, lengths);
+}
+
+void capture_glTexBuffer(GLenum target, GLenum internal_format, GLuint buffer)
+{
+	if (capture().active)
+	{
+		record(GLCommand::TexBuffer, target, internal_format, buffer);
+	}
+	glTexBuffer(target, internal_format, buffer);
+}
+
+void capture_glTexImage2D(GLenum target, GLint level, GLint internal_format, GLsizei width,
+	GLsizei height, GLint border, GLenum format, GLenum type, const void* pixels)
+{
+	if (capture().active)
+	{
+		record(GLCommand::TexImage2D, target, level, internal_format, width, height, border,
+			format, type);
+		record_pixels(pixels, image_size(width, height, 1, format, type));
+	}
+	glTexImage2D(target, level, internal_format, width, height, border, format, type, pixels);
+}
+
+void capture_glTexImage3D(GLenum target, GLint level, GLint internal_format, GLsizei width,
+	GLsizei height, GLsizei depth, GLint border, GLenum format, GLenum type,
+	const void* pixels)
+{
+	if (capture().active)
+	{
+		record(GLCommand::TexImage3D, target, level, internal_format, width, height, depth,
+			border, format, type);
+		record_pixels(pixels, image_size(width, height, depth, format, type));
+	}
+	glTexImage3D(target, level, internal_format, width, height, depth, border, format, type,
+		pixels);
+}
+
+void capture_glTexParameteri(GLenum target, GLenum name, GLint param)
+{
+	if (capture().active)
+	{
+		record(GLCommand::TexParameteri, target, name, param);
+	}
+	glTexParameteri(target, name, param);
+}
+
+void capture_glTexStorage2D(GLenum target, GLsizei levels, GLenum internal_format,
+	GLsizei width, GLsizei height)
+{
+	if (capture().active)
+	{
+		record(GLCommand::TexStorage2D, target, levels, internal_format, width, height);
+	}
+	glTexStorage2D(target, levels, internal_format, width, height);
+}
+
+void capture_glTexSubImage2D(GLenum target, GLint level, GLint x, GLint y, GLsizei width,
+	GLsizei height, GLenum format, GLenum type, const void* pixels)
+{
+	if (capture().active)
+	{
+		record(GLCommand::TexSubImage2D, target, level, x, y, width, height, format, type);
+		record_pixels(pixels, image_size(width, height, 1, format, type));
+	}
+	glTexSubImage2D(target, level, x, y, width, height, format, type, pixels);
+}
+
+void capture_glTexSubImage3D(GLenum target, GLint level, GLint x, GLint y, GLint z,
+	GLsizei width, GLsizei height, GLsizei depth, GLenum format, GLenum type,
+	const void* pixels)
+{
+	if (capture().active)
+	{
+		record(GLCommand::TexSubImage3D, target, level, x, y, z, width, height, depth,
+			format, type);
+		record_pixels(pixels, image_size(width, height, depth, format, type));
+	}
+	glTexSubImage3D(target, level, x, y, z, width, height, depth, format, type, pixels);
+}
+
+void capture_glTextureView(GLuint texture, GLenum target, GLuint original_texture,
+	GLenum internal_format, GLuint min_level, GLuint num_levels, GLuint min_layer,
+	GLuint num_layers)
+{
+	if (capture().active)
+	{
+		record(GLCommand::TextureView, texture, target, original_texture, internal_format,
+			min_level, num_levels, min_layer, num_layers);
+	}
+	glTextureView(texture, target, original_texture, internal_format, min_level, num_levels,
+		min_layer, num_layers);
+}
+
+void capture_glUniform1f(GLint location, GLfloat value)
+{
+	if (capture().active)
+	{
+		record(GLCommand::Uniform1f, location, value);
+	}
+	glUniform1f(location, value);
+}
+
+void capture_glUniform1i(GLint location, GLint value)
+{
+	if (capture().active)
+	{
+		record(GLCommand::Uniform1i, location, value);
+	}
+	glUniform1i(location, value);
+}
+
+void capture_glUniform2fv(GLint location, GLsizei count, const GLfloat* value)
+{
+	if (capture().active)
+	{
+		record(GLCommand::Uniform2fv, location);
+		capture().writer.write_blob(value, sizeof(GLfloat) * 2 * (size_t)count);
+	}
+	glUniform2fv(location, count, value);
+}
+
+void capture_glUniform3fv(GLint location, GLsizei count, const GLfloat* value)
+{
+	if (capture().active)
+	{
+		record(GLCommand::Uniform3fv, location);
+		capture().writer.write_blob(value, sizeof(GLfloat) * 3 * (size_t)count);
+	}
+	glUniform3fv(location, count, value);
+}
+
+void capture_glUniform3iv(GLint location, GLsizei count, const GLint* value)
+{
+	if (capture().active)
+	{
+		record(GLCommand::Uniform3iv, location);
+		capture().writer.write_blob(value, sizeof(GLint) * 3 * (size_t)count);
+	}
+	glUniform3iv(location, count, value);
+}
+
+void capture_glUniform4fv(GLint location, GLsizei count, const GLfloat* value)
+{
+	if (capture().active)
+	{
+		record(GLCommand::Uniform4fv, location);
+		capture().writer.write_blob(value, sizeof(GLfloat) * 4 * (size_t)count);
+	}
+	glUniform4fv(location, count, value);
+}
+
+void capture_glUniformMatrix4fv(GLint location, GLsizei count, GLboolean transpose,
+	const GLfloat* value)
+{
+	if (capture().active)
+	{
+		record(GLCommand::UniformMatrix4fv, location, transpose);
+		capture().writer.write_blob(value, sizeof(GLfloat) * 16 * (size_t)count);
+	}
+	glUniformMatrix4fv(location, count, transpose, value);
+}
+
+GLboolean capture_glUnmapBuffer(GLenum target)
+{
+	// Whatever was written through the mapping goes in as a plain upload
+	const auto mapping = capture().mappings.find(target);
+	if (mapping != capture().mappings.end())
+	{
+		if (capture().active)
+		{
+			record(GLCommand::BufferSubData, target, (uint64_t)mapping->second.offset);
+			capture().writer.write_blob(mapping->second.pointer, (size_t)mapping->second.length);
+		}
+		capture().mappings.erase(mapping);
+	}
+	return glUnmapBuffer(target);
+}
+
+void capture_glUseProgram(GLuint program)
+{
+	if (capture().active)
+	{
+		record(GLCommand::UseProgram, program);
+	}
+	glUseProgram(program);
+}
+
+void capture_glVertexAttrib4f(GLuint index, GLfloat x, GLfloat y, GLfloat z, GLfloat w)
+{
+	if (capture().active)
+	{
+		record(GLCommand::VertexAttrib4f, index, x, y, z, w);
+	}
+	glVertexAttrib4f(index, x, y, z, w);
+}
+
+void capture_glVertexAttribDivisor(GLuint index, GLuint divisor)
+{
+	if (capture().active)
+	{
+		record(GLCommand::VertexAttribDivisor, index, divisor);
+	}
+	glVertexAttribDivisor(index, divisor);
+}
+
+void capture_glVertexAttribPointer(GLuint index, GLint size, GLenum type,
+	GLboolean normalized, GLsizei stride, const void* pointer)
+{
+	if (capture().active)
+	{
+		record(GLCommand::VertexAttribPointer, index, size, type, normalized, stride,
+			offset_of(pointer));
+	}
+	glVertexAttribPointer(index, size, type, normalized, stride, pointer);
+}
+
+void capture_glViewport(GLint x, GLint y, GLsizei width, GLsizei height)
+{
+	if (capture().active)
+	{
+		record(GLCommand::Viewport, x, y, width, height);
+	}
+	glViewport(x, y, width, height);
+}
@@ -0,0 +1,16 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+// Records the GL calls made through CapturedGL.h into a command stream,
+// along with the buffer and texture contents they upload, for frame_count
+// frames. Objects made before the capture began aren't in the stream, so
+// start it right after the context is created. glreplay plays the stream
+// back. Only one capture runs at a time.
+bool gl_capture_begin(const std::string& path, uint32_t frame_count, int width,
+	int height);
+// Marks the end of a frame, and ends the capture after its last one
+void gl_capture_end_frame();
+void gl_capture_end();
+bool gl_capture_active();
@@ -0,0 +1,174 @@
+#include "JobSystem.h"
+
+#include <algorithm>
+#include <atomic>
+
+void JobSystem::initialize(uint32_t thread_count)
+{
+	if (thread_count == 0)
+	{
+		thread_count = std::max(std::thread::hardware_concurrency(), 2u) - 1;
+	}
+
+	stopping = false;
+	for (uint32_t i = 0; i < thread_count; i++)
+	{
+		workers.emplace_back(&JobSystem::worker_loop, this);
+	}
+}
+
+void JobSystem::destroy()
+{
+	{
+		const std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	wake.notify_all();
+
+	for (std::thread& worker : workers)
+	{
+		worker.join();
+	}
+	workers.clear();
+	for (auto& queue : queues)
+	{
+		queue.clear();
+	}
+}
+
+void JobSystem::submit(std::function<void()> job, JobPriority priority)
+{
+	{
+		const std::lock_guard<std::mutex> lock(mutex);
+		queues[(size_t)priority].push_back(std::move(job));
+	}
+	wake.notify_one();
+}
+
+bool JobSystem::pop_job(std::function<void()>& job)
+{
+	return pop_job(job, JobPriority::Low);
+}
+
+bool JobSystem::pop_job(std::function<void()>& job, JobPriority lowest)
+{
+	for (size_t i = 0; i <= (size_t)lowest; i++)
+	{
+		auto& queue = queues[i];
+		if (!queue.empty())
+		{
+			job = std::move(queue.front());
+			queue.pop_front();
+			return true;
+		}
+	}
+	return false;
+}
+
+bool JobSystem::queues_empty() const
+{
+	return std::all_of(queues.begin(), queues.end(),
+		[](const auto& queue) { return queue.empty(); });
+}
+
+void JobSystem::parallel_for(uint32_t count,
+	const std::function<void(uint32_t begin, uint32_t end)>& job)
+{
+	if (count == 0)
+	{
+		return;
+	}
+
+	const uint32_t ranges = std::min(count, worker_count() + 1);
+	const uint32_t range_size = (count + ranges - 1) / ranges;
+	std::atomic<uint32_t> remaining(ranges - 1);
+
+	for (uint32_t i = 1; i < ranges; i++)
+	{
+		const uint32_t begin = i * range_size;
+		const uint32_t end = std::min(begin + range_size, count);
+		// Someone is waiting on these, so they go ahead of background work
+		submit([&job, &remaining, begin, end] {
+			if (begin < end)
+			{
+				job(begin, end);
+			}
+			remaining--;
+		}, JobPriority::High);
+	}
+
+	job(0, std::min(range_size, count));
+
+	// Help out instead of blocking, so nested calls from workers can't
+	// deadlock the pool. Only high priority work is taken, so a frame never
+	// ends up running an asset load while it waits.
+	while (remaining > 0)
+	{
+		if (!run_pending_job(JobPriority::High))
+		{
+			std::this_thread::yield();
+		}
+	}
+}
+
+bool JobSystem::run_pending_job(JobPriority lowest)
+{
+	std::function<void()> job;
+	{
+		const std::lock_guard<std::mutex> lock(mutex);
+		if (!pop_job(job, lowest))
+		{
+			return false;
+		}
+		busy++;
+	}
+
+	job();
+
+	const std::lock_guard<std::mutex> lock(mutex);
+	busy--;
+	if (queues_empty() && busy == 0)
+	{
+		idle.notify_all();
+	}
+	return true;
+}
+
+void JobSystem::wait_idle()
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	idle.wait(lock, [this] { return queues_empty() && busy == 0; });
+}
+
+uint32_t JobSystem::worker_count() const
+{
+	return (uint32_t)workers.size();
+}
+
+void JobSystem::worker_loop()
+{
+	std::unique_lock<std::mutex> lock(mutex);
+
+	while (true)
+	{
+		wake.wait(lock, [this] { return stopping || !queues_empty(); });
+		if (stopping)
+		{
+			return;
+		}
+
+		std::function<void()> job;
+		pop_job(job);
+		busy++;
+
+		lock.unlock();
+		job();
+		lock.lock();
+
+		busy--;
+		if (queues_empty() && busy == 0)
+		{
+			idle.notify_all();
+		}
+	}
+}
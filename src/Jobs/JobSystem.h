@@ -0,0 +1,62 @@
+#pragma once
+
+#include <array>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Workers always take the oldest job of the highest priority waiting
+enum class JobPriority : uint8_t
+{
+	High,
+	Normal,
+	Low,
+};
+
+constexpr size_t JOB_PRIORITY_COUNT = 3;
+
+// A fixed pool of worker threads pulling jobs off shared queues, one per
+// priority
+class JobSystem
+{
+public:
+	// Starts thread_count workers, or one per core minus the main thread
+	// when thread_count is 0
+	void initialize(uint32_t thread_count = 0);
+	void destroy();
+
+	void submit(std::function<void()> job, JobPriority priority = JobPriority::Normal);
+
+	// Splits [0, count) into one range per thread and runs them in parallel,
+	// including on the calling thread. Returns once every range is done.
+	void parallel_for(uint32_t count,
+		const std::function<void(uint32_t begin, uint32_t end)>& job);
+
+	// Blocks until the queue is empty and every worker is idle
+	void wait_idle();
+
+	uint32_t worker_count() const;
+
+private:
+	void worker_loop();
+	// Runs one queued job of at least the given priority on the calling
+	// thread, if there is one
+	bool run_pending_job(JobPriority lowest);
+	// Takes the next job off the queues. Call with the mutex held.
+	bool pop_job(std::function<void()>& job);
+	// As above, but skips queues below the given priority
+	bool pop_job(std::function<void()>& job, JobPriority lowest);
+	bool queues_empty() const;
+
+	std::vector<std::thread> workers;
+	std::array<std::deque<std::function<void()>>, JOB_PRIORITY_COUNT> queues;
+	std::mutex mutex;
+	std::condition_variable wake;
+	std::condition_variable idle;
+	uint32_t busy = 0;
+	bool stopping = false;
+};
@@ -0,0 +1,150 @@
+#pragma once
+
+#include <coroutine>
+#include <exception>
+#include <optional>
+#include <utility>
+
+// What every task's promise shares: tasks start suspended, and when one
+// finishes it hands control straight to whoever awaited it, on whatever
+// thread it finished on
+struct TaskPromiseBase
+{
+	struct FinalAwaiter
+	{
+		bool await_ready() const noexcept { return false; }
+
+		template <typename Promise>
+		std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> handle) const noexcept
+		{
+			return handle.promise().continuation;
+		}
+
+		void await_resume() const noexcept {}
+	};
+
+	std::suspend_always initial_suspend() const noexcept { return {}; }
+	FinalAwaiter final_suspend() const noexcept { return {}; }
+	void unhandled_exception() const noexcept { std::terminate(); }
+
+	std::coroutine_handle<> continuation = std::noop_coroutine();
+};
+
+// A coroutine producing a T. Nothing runs until the task is awaited.
+template <typename T = void>
+class Task
+{
+public:
+	struct promise_type : TaskPromiseBase
+	{
+		Task get_return_object()
+		{
+			return Task(std::coroutine_handle<promise_type>::from_promise(*this));
+		}
+
+		void return_value(T result) { value = std::move(result); }
+
+		std::optional<T> value;
+	};
+
+	struct Awaiter
+	{
+		std::coroutine_handle<promise_type> handle;
+
+		bool await_ready() const noexcept { return false; }
+
+		std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) const noexcept
+		{
+			handle.promise().continuation = awaiting;
+			return handle;
+		}
+
+		T await_resume() const { return std::move(*handle.promise().value); }
+	};
+
+	Task(Task&& other) noexcept : handle(std::exchange(other.handle, nullptr)) {}
+	Task(const Task&) = delete;
+	Task& operator=(const Task&) = delete;
+	~Task()
+	{
+		if (handle)
+		{
+			handle.destroy();
+		}
+	}
+
+	Awaiter operator co_await() && noexcept { return Awaiter{handle}; }
+
+private:
+	explicit Task(std::coroutine_handle<promise_type> coroutine) : handle(coroutine) {}
+
+	std::coroutine_handle<promise_type> handle;
+};
+
+template <>
+class Task<void>
+{
+public:
+	struct promise_type : TaskPromiseBase
+	{
+		Task get_return_object()
+		{
+			return Task(std::coroutine_handle<promise_type>::from_promise(*this));
+		}
+
+		void return_void() const noexcept {}
+	};
+
+	struct Awaiter
+	{
+		std::coroutine_handle<promise_type> handle;
+
+		bool await_ready() const noexcept { return false; }
+
+		std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) const noexcept
+		{
+			handle.promise().continuation = awaiting;
+			return handle;
+		}
+
+		void await_resume() const noexcept {}
+	};
+
+	Task(Task&& other) noexcept : handle(std::exchange(other.handle, nullptr)) {}
+	Task(const Task&) = delete;
+	Task& operator=(const Task&) = delete;
+	~Task()
+	{
+		if (handle)
+		{
+			handle.destroy();
+		}
+	}
+
+	Awaiter operator co_await() && noexcept { return Awaiter{handle}; }
+
+private:
+	explicit Task(std::coroutine_handle<promise_type> coroutine) : handle(coroutine) {}
+
+	std::coroutine_handle<promise_type> handle;
+};
+
+// Fire and forget: the coroutine starts right away and frees itself when
+// it finishes
+struct DetachedTask
+{
+	struct promise_type
+	{
+		DetachedTask get_return_object() const noexcept { return {}; }
+		std::suspend_never initial_suspend() const noexcept { return {}; }
+		std::suspend_never final_suspend() const noexcept { return {}; }
+		void return_void() const noexcept {}
+		void unhandled_exception() const noexcept { std::terminate(); }
+	};
+};
+
+// Runs a task nobody awaits
+inline DetachedTask spawn(Task<void> task)
+{
+	co_await std::move(task);
+}
@@ -0,0 +1,64 @@
+#include "HeapCounter.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+
+namespace
+{
+	std::atomic<uint64_t> allocation_count{0};
+
+	void* allocate(size_t size, size_t alignment)
+	{
+		allocation_count.fetch_add(1, std::memory_order_relaxed);
+
+		// aligned_alloc wants a multiple of the alignment, and malloc never
+		// gives back null for a zero sized request made through new
+		size = size == 0 ? 1 : size;
+		void* pointer = alignment <= alignof(std::max_align_t)
+			? std::malloc(size)
+			: std::aligned_alloc(alignment, (size + alignment - 1) & ~(alignment - 1));
+		if (!pointer)
+		{
+			throw std::bad_alloc();
+		}
+		return pointer;
+	}
+}
+
+uint64_t heap_allocation_count()
+{
+	return allocation_count.load(std::memory_order_relaxed);
+}
+
+// The array and nothrow forms end up in these by default
+void* operator new(size_t size)
+{
+	return allocate(size, alignof(std::max_align_t));
+}
+
+void* operator new(size_t size, std::align_val_t alignment)
+{
+	return allocate(size, (size_t)alignment);
+}
+
+void operator delete(void* pointer) noexcept
+{
+	std::free(pointer);
+}
+
+void operator delete(void* pointer, std::align_val_t) noexcept
+{
+	std::free(pointer);
+}
+
+void operator delete(void* pointer, size_t) noexcept
+{
+	std::free(pointer);
+}
+
+void operator delete(void* pointer, size_t, std::align_val_t) noexcept
+{
+	std::free(pointer);
+}
@@ -0,0 +1,8 @@
+#pragma once
+
+#include <cstdint>
+
+// Every operator new the program has made so far. The global allocation
+// functions are replaced to count them, which costs one relaxed atomic add
+// each, so it stays on in release builds.
+uint64_t heap_allocation_count();
@@ -0,0 +1,143 @@
+#include "LinearArena.h"
+
+#include <algorithm>
+
+LinearArena::LinearArena(size_t block_bytes)
+	: block_size(block_bytes)
+{
+}
+
+void* LinearArena::allocate(size_t size, size_t alignment)
+{
+	while (true)
+	{
+		if (current < blocks.size())
+		{
+			Block& block = blocks[current];
+			const uintptr_t base = reinterpret_cast<uintptr_t>(block.data.get());
+			const size_t start = ((base + offset + alignment - 1) & ~(uintptr_t)(alignment - 1)) - base;
+			if (start + size <= block.size)
+			{
+				offset = start + size;
+				peak = std::max(peak, used + offset);
+				return block.data.get() + start;
+			}
+		}
+		next_block(size + alignment);
+	}
+}
+
+void LinearArena::next_block(size_t size)
+{
+	if (current < blocks.size())
+	{
+		used += offset;
+		current++;
+	}
+	offset = 0;
+
+	// Blocks left over from earlier frames come first, unless too small
+	if (current < blocks.size() && blocks[current].size >= size)
+	{
+		return;
+	}
+
+	Block block;
+	block.size = std::max(block_size, size);
+	block.data = std::make_unique<std::byte[]>(block.size);
+	blocks.insert(blocks.begin() + (ptrdiff_t)current, std::move(block));
+	allocations++;
+}
+
+LinearArena::Marker LinearArena::mark() const
+{
+	return {current, offset, used};
+}
+
+void LinearArena::rewind(const Marker& marker)
+{
+	current = marker.block;
+	offset = marker.offset;
+	used = marker.used;
+}
+
+void LinearArena::reset()
+{
+	rewind(Marker());
+}
+
+size_t LinearArena::bytes_used() const
+{
+	return used + offset;
+}
+
+size_t LinearArena::peak_bytes() const
+{
+	return peak;
+}
+
+size_t LinearArena::capacity() const
+{
+	size_t bytes = 0;
+	for (const Block& block : blocks)
+	{
+		bytes += block.size;
+	}
+	return bytes;
+}
+
+uint32_t LinearArena::block_allocations() const
+{
+	return allocations;
+}
+
+LinearArena& scratch_arena()
+{
+	// Freed with its thread
+#if defined(__clang__)
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wexit-time-destructors"
+#endif
+	thread_local LinearArena arena(SCRATCH_BLOCK_SIZE);
+#if defined(__clang__)
+#pragma clang diagnostic pop
+#endif
+	return arena;
+}
+
+void FrameArena::begin_frame()
+{
+	last_frame_bytes = arenas[index].bytes_used();
+	index = (index + 1) % FRAME_ARENA_COUNT;
+	arenas[index].reset();
+}
+
+LinearArena& FrameArena::current()
+{
+	return arenas[index];
+}
+
+size_t FrameArena::frame_bytes() const
+{
+	return last_frame_bytes;
+}
+
+size_t FrameArena::peak_bytes() const
+{
+	size_t peak = 0;
+	for (const LinearArena& arena : arenas)
+	{
+		peak = std::max(peak, arena.peak_bytes());
+	}
+	return peak;
+}
+
+uint32_t FrameArena::block_allocations() const
+{
+	uint32_t count = 0;
+	for (const LinearArena& arena : arenas)
+	{
+		count += arena.block_allocations();
+	}
+	return count;
+}
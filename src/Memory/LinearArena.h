@@ -0,0 +1,159 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <vector>
+
+constexpr size_t ARENA_BLOCK_SIZE = 1024 * 1024;
+constexpr size_t SCRATCH_BLOCK_SIZE = 256 * 1024;
+// How many frames' worth of memory is alive at once. Two lets a render
+// thread read frame N while frame N + 1 is built.
+constexpr uint32_t FRAME_ARENA_COUNT = 2;
+
+// Hands out memory by bumping an offset through big blocks, and frees it
+// all at once. Blocks are kept when reset, so once the arena has grown to
+// what a frame needs it stops touching the heap. Not thread safe.
+class LinearArena
+{
+public:
+	// Where the arena was, to rewind to
+	struct Marker
+	{
+		size_t block = 0;
+		size_t offset = 0;
+		size_t used = 0;
+	};
+
+	explicit LinearArena(size_t block_bytes = ARENA_BLOCK_SIZE);
+	LinearArena(const LinearArena&) = delete;
+	LinearArena& operator=(const LinearArena&) = delete;
+
+	void* allocate(size_t size, size_t alignment);
+
+	template <typename T>
+	T* allocate(size_t count)
+	{
+		return static_cast<T*>(allocate(count * sizeof(T), alignof(T)));
+	}
+
+	// Frees everything allocated since the marker
+	Marker mark() const;
+	void rewind(const Marker& marker);
+	// Frees everything
+	void reset();
+
+	size_t bytes_used() const;
+	size_t peak_bytes() const;
+	size_t capacity() const;
+	// Blocks taken from the heap over the arena's life
+	uint32_t block_allocations() const;
+
+private:
+	struct Block
+	{
+		std::unique_ptr<std::byte[]> data;
+		size_t size = 0;
+	};
+
+	// Moves on to a block with room for size bytes at any alignment
+	void next_block(size_t size);
+
+	size_t block_size;
+	std::vector<Block> blocks;
+	size_t current = 0;
+	size_t offset = 0; // into the current block
+	size_t used = 0; // in the blocks before the current one
+	size_t peak = 0;
+	uint32_t allocations = 0;
+};
+
+// Lets standard containers allocate from an arena. Freeing is a no-op; the
+// memory comes back when the arena resets. Without an arena it falls back
+// to the heap, so containers can be made before they are bound to one.
+template <typename T>
+class ArenaAllocator
+{
+public:
+	using value_type = T;
+	// Assigning a container rebinds it to the other's arena
+	using propagate_on_container_copy_assignment = std::true_type;
+	using propagate_on_container_move_assignment = std::true_type;
+	using propagate_on_container_swap = std::true_type;
+
+	ArenaAllocator() = default;
+	explicit ArenaAllocator(LinearArena& target) : arena(&target) {}
+	template <typename U>
+	ArenaAllocator(const ArenaAllocator<U>& other) : arena(other.arena) {}
+
+	T* allocate(size_t count)
+	{
+		if (arena)
+		{
+			return arena->allocate<T>(count);
+		}
+		return static_cast<T*>(::operator new(count * sizeof(T), std::align_val_t(alignof(T))));
+	}
+
+	void deallocate(T* pointer, size_t count)
+	{
+		if (!arena)
+		{
+			::operator delete(pointer, count * sizeof(T), std::align_val_t(alignof(T)));
+		}
+	}
+
+	template <typename U>
+	bool operator==(const ArenaAllocator<U>& other) const
+	{
+		return arena == other.arena;
+	}
+
+	LinearArena* arena = nullptr;
+};
+
+template <typename T>
+using ArenaVector = std::vector<T, ArenaAllocator<T>>;
+
+// Rewinds the arena to where it was when the scope began
+class ArenaScope
+{
+public:
+	explicit ArenaScope(LinearArena& target) : arena(target), marker(target.mark()) {}
+	~ArenaScope() { arena.rewind(marker); }
+	ArenaScope(const ArenaScope&) = delete;
+	ArenaScope& operator=(const ArenaScope&) = delete;
+
+private:
+	LinearArena& arena;
+	LinearArena::Marker marker;
+};
+
+// This thread's arena for data that dies before the call or job that made
+// it returns. Put an ArenaScope around each use, so nested uses and the
+// next job find it where they left it.
+LinearArena& scratch_arena();
+
+// The memory of the frames in flight. Each frame allocates from the next
+// arena in turn, which is only reset once FRAME_ARENA_COUNT frames later,
+// when whatever read the data it holds has finished with it.
+class FrameArena
+{
+public:
+	// Moves on to the next arena and resets it
+	void begin_frame();
+	LinearArena& current();
+
+	// Of the frame that just ended
+	size_t frame_bytes() const;
+	size_t peak_bytes() const;
+	uint32_t block_allocations() const;
+
+private:
+	std::array<LinearArena, FRAME_ARENA_COUNT> arenas;
+	uint32_t index = 0;
+	size_t last_frame_bytes = 0;
+};
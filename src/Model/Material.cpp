@@ -0,0 +1,159 @@
+#include "Material.h"
+
+#include <bit>
+#include <iostream>
+
+#include <GL/glew.h>
+#include <GL/gl.h>
+
+#include "Model.h"
+#include "../Jobs/JobSystem.h"
+#include "../Resources/GpuMemory.h"
+#include "../Texture/Image.h"
+#include "../Texture/TexturePacker.h"
+#include "../Capture/CapturedGL.h"
+
+std::string MaterialLibrary::key(const Material& material)
+{
+	// Names differ between files for the same material, so only the
+	// parameters count. Floats go in bitwise so the key is exact.
+	const float values[] = {
+		material.diffuse.r, material.diffuse.g, material.diffuse.b,
+		material.specular.r, material.specular.g, material.specular.b,
+		material.shininess, material.opacity,
+	};
+
+	std::string result;
+	for (const float value : values)
+	{
+		const uint32_t bits = std::bit_cast<uint32_t>(value);
+		result.append(reinterpret_cast<const char*>(&bits), sizeof(bits));
+	}
+	result += material.diffuse_map;
+	return result;
+}
+
+void MaterialLibrary::add_model(Model& model)
+{
+	model.material_ids.clear();
+	for (const Material& material : model.materials)
+	{
+		const auto [it, inserted] = lookup.emplace(key(material), (uint32_t)materials.size());
+		if (inserted)
+		{
+			materials.push_back(material);
+		}
+		model.material_ids.push_back(it->second);
+	}
+
+	model_count++;
+	added_count += (uint32_t)model.materials.size();
+}
+
+void MaterialLibrary::upload(TexturePacker& packer, JobSystem& jobs)
+{
+	if (uploaded == materials.size())
+	{
+		return;
+	}
+
+	// Diffuse maps nobody has packed yet, each path once
+	std::vector<std::string> paths;
+	for (uint32_t i = uploaded; i < (uint32_t)materials.size(); i++)
+	{
+		const std::string& path = materials[i].diffuse_map;
+		if (!path.empty() && map_slots.emplace(path, UINT32_MAX).second)
+		{
+			paths.push_back(path);
+		}
+	}
+
+	std::vector<Image> images(paths.size());
+	std::vector<uint8_t> decoded(paths.size(), 0);
+	jobs.parallel_for((uint32_t)paths.size(), [&](uint32_t begin, uint32_t end) {
+		for (uint32_t i = begin; i < end; i++)
+		{
+			decoded[i] = decode_image_file(paths[i], images[i]) ? 1 : 0;
+		}
+	});
+
+	for (size_t i = 0; i < paths.size(); i++)
+	{
+		if (decoded[i])
+		{
+			map_slots[paths[i]] = packer.add(std::move(images[i]));
+		}
+	}
+	packer.build();
+
+	for (uint32_t i = uploaded; i < (uint32_t)materials.size(); i++)
+	{
+		const Material& material = materials[i];
+
+		GpuMaterial gpu;
+		gpu.diffuse = glm::vec4(material.diffuse, material.opacity);
+		gpu.specular = glm::vec4(material.specular, material.shininess);
+
+		uint32_t texture = 0;
+		const auto slot = map_slots.find(material.diffuse_map);
+		if (slot != map_slots.end() && slot->second != UINT32_MAX)
+		{
+			const TextureSlot& packed = packer.slot(slot->second);
+			gpu.uv_transform = packed.uv_transform;
+			gpu.diffuse_map = glm::vec4((float)packed.layer, 1.0f, 0.0f, 0.0f);
+			texture = packed.texture;
+		}
+
+		gpu_materials.push_back(gpu);
+		texture_arrays.push_back(texture);
+	}
+	uploaded = (uint32_t)materials.size();
+
+	// The whole buffer goes up again; it's a few bytes per material
+	if (!buffer)
+	{
+		glGenBuffers(1, &buffer);
+		glGenTextures(1, &buffer_texture);
+	}
+	glBindBuffer(GL_TEXTURE_BUFFER, buffer);
+	glBufferData(GL_TEXTURE_BUFFER, (GLsizeiptr)(gpu_materials.size() * sizeof(GpuMaterial)),
+		gpu_materials.data(), GL_STATIC_DRAW);
+	gpu_memory().allocate(GpuObject::Buffer, buffer, GpuMemoryCategory::Uniform, "MaterialLibrary",
+		gpu_materials.size() * sizeof(GpuMaterial));
+	glBindBuffer(GL_TEXTURE_BUFFER, 0);
+	glBindTexture(GL_TEXTURE_BUFFER, buffer_texture);
+	glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, buffer);
+	glBindTexture(GL_TEXTURE_BUFFER, 0);
+
+	std::cout << "Materials: " << materials.size() << " unique of " << added_count
+			  << " across " << model_count << " models, " << paths.size()
+			  << " new diffuse maps\n";
+}
+
+void MaterialLibrary::destroy()
+{
+	gpu_memory().release(GpuObject::Buffer, buffer);
+	glDeleteTextures(1, &buffer_texture);
+	glDeleteBuffers(1, &buffer);
+	buffer_texture = 0;
+	buffer = 0;
+	materials.clear();
+	gpu_materials.clear();
+	texture_arrays.clear();
+	lookup.clear();
+	map_slots.clear();
+	uploaded = 0;
+	model_count = 0;
+	added_count = 0;
+}
+
+uint32_t MaterialLibrary::texture_array(uint32_t id) const
+{
+	// Materials added since the last upload have no texture yet
+	return id < texture_arrays.size() ? texture_arrays[id] : 0;
+}
+
+uint32_t MaterialLibrary::size() const
+{
+	return (uint32_t)materials.size();
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <glm/vec3.hpp>
+#include <glm/vec4.hpp>
+
+class JobSystem;
+class Model;
+class TexturePacker;
+
+// Surface parameters of one .mtl material
+struct Material
+{
+	std::string name;
+	glm::vec3 diffuse = glm::vec3(0.8f);
+	glm::vec3 specular = glm::vec3(0.0f);
+	float shininess = 1.0f;
+	float opacity = 1.0f;
+	std::string diffuse_map; // resolved path, empty without one
+};
+
+// How a material sits in the material buffer: four RGBA32F texels, fetched
+// in the shader with the draw's material index
+struct GpuMaterial
+{
+	glm::vec4 diffuse = glm::vec4(0.8f, 0.8f, 0.8f, 1.0f); // rgb, opacity
+	glm::vec4 specular = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f); // rgb, shininess
+	glm::vec4 uv_transform = glm::vec4(1.0f, 1.0f, 0.0f, 0.0f); // of the diffuse map
+	glm::vec4 diffuse_map = glm::vec4(0.0f); // layer, has map, unused, unused
+};
+
+constexpr uint32_t GPU_MATERIAL_TEXELS = sizeof(GpuMaterial) / sizeof(glm::vec4);
+
+// Every material in the scene. Identical materials from different models
+// share one entry, so they share one slot of the material buffer and sort
+// together when drawing.
+class MaterialLibrary
+{
+public:
+	// Registers the model's materials and fills in model.material_ids
+	void add_model(Model& model);
+
+	// Decodes any new diffuse maps on the workers, packs them and uploads
+	// the material buffer
+	void upload(TexturePacker& packer, JobSystem& jobs);
+	void destroy();
+
+	// Texture array holding the diffuse map, or 0 without one or before the
+	// material is uploaded
+	uint32_t texture_array(uint32_t id) const;
+	uint32_t size() const;
+
+	// Texture buffer with GPU_MATERIAL_TEXELS texels per material
+	uint32_t buffer_texture = 0;
+
+private:
+	static std::string key(const Material& material);
+
+	std::vector<Material> materials;
+	std::vector<GpuMaterial> gpu_materials;
+	std::vector<uint32_t> texture_arrays;
+	std::unordered_map<std::string, uint32_t> lookup;
+
+	// Diffuse map path to packer slot, once packed
+	std::unordered_map<std::string, uint32_t> map_slots;
+
+	uint32_t buffer = 0;
+	uint32_t uploaded = 0; // materials in the buffer
+	uint32_t model_count = 0;
+	uint32_t added_count = 0; // before deduplication
+};
@@ -0,0 +1,499 @@
+#include "MeshCodec.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <iostream>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "../Jobs/JobSystem.h"
+#include "../Memory/LinearArena.h"
+
+namespace
+{
+	constexpr size_t LZ_MIN_MATCH = 4;
+	constexpr size_t LZ_MAX_OFFSET = 65535;
+	constexpr uint32_t LZ_HASH_BITS = 14;
+	// Literal and match lengths past this go on in extra bytes
+	constexpr size_t LZ_TOKEN_MAX = 15;
+	// Vertices decoded per stream before interleaving them
+	constexpr uint32_t DECODE_BLOCK = 256;
+
+	uint32_t load32(const uint8_t* source)
+	{
+		uint32_t value = 0;
+		std::memcpy(&value, source, sizeof(value));
+		return value;
+	}
+
+	void store32(uint8_t* destination, uint32_t value)
+	{
+		std::memcpy(destination, &value, sizeof(value));
+	}
+
+	uint32_t lz_hash(uint32_t sequence)
+	{
+		return (sequence * 2654435761u) >> (32 - LZ_HASH_BITS);
+	}
+
+	void write_length(std::vector<uint8_t>& output, size_t length)
+	{
+		while (length >= 255)
+		{
+			output.push_back(255);
+			length -= 255;
+		}
+		output.push_back((uint8_t)length);
+	}
+
+	bool read_length(const uint8_t*& in, const uint8_t* end, size_t& length)
+	{
+		uint8_t byte = 0;
+		do
+		{
+			if (in >= end)
+			{
+				return false;
+			}
+			byte = *in++;
+			length += byte;
+		} while (byte == 255);
+		return true;
+	}
+
+	void write_sequence(std::vector<uint8_t>& output, const uint8_t* literals,
+		size_t literal_count, size_t offset, size_t match_length)
+	{
+		const size_t literal_token = std::min(literal_count, LZ_TOKEN_MAX);
+		const size_t match_token = match_length > 0
+			? std::min(match_length - LZ_MIN_MATCH, LZ_TOKEN_MAX) : 0;
+		output.push_back((uint8_t)(literal_token << 4 | match_token));
+		if (literal_token == LZ_TOKEN_MAX)
+		{
+			write_length(output, literal_count - LZ_TOKEN_MAX);
+		}
+		output.insert(output.end(), literals, literals + literal_count);
+
+		// The last sequence is literals only, and ends the block
+		if (match_length == 0)
+		{
+			return;
+		}
+		output.push_back((uint8_t)(offset & 0xFF));
+		output.push_back((uint8_t)(offset >> 8));
+		if (match_token == LZ_TOKEN_MAX)
+		{
+			write_length(output, match_length - LZ_MIN_MATCH - LZ_TOKEN_MAX);
+		}
+	}
+
+	// Copies in 16 byte steps, which may write up to 15 bytes past the end
+	void wild_copy(uint8_t* destination, const uint8_t* source, size_t size)
+	{
+		for (size_t i = 0; i < size; i += 16)
+		{
+			std::memcpy(destination + i, source + i, 16);
+		}
+	}
+
+	uint32_t zigzag(uint32_t delta)
+	{
+		return (delta << 1) ^ (uint32_t)((int32_t)delta >> 31);
+	}
+
+	uint32_t unzigzag(uint32_t value)
+	{
+		return (value >> 1) ^ (0u - (value & 1));
+	}
+
+	// Delta codes the 32 bit words count elements apart by stride, and
+	// writes their bytes out as four planes of count bytes
+	void encode_stream(const uint8_t* source, uint32_t count, uint32_t stride, uint8_t* planes)
+	{
+		uint32_t previous = 0;
+		for (uint32_t i = 0; i < count; i++)
+		{
+			const uint32_t value = load32(source + (size_t)i * stride);
+			const uint32_t coded = zigzag(value - previous);
+			previous = value;
+			planes[i] = (uint8_t)coded;
+			planes[count + i] = (uint8_t)(coded >> 8);
+			planes[count * 2 + i] = (uint8_t)(coded >> 16);
+			planes[count * 3 + i] = (uint8_t)(coded >> 24);
+		}
+	}
+
+	// Undoes encode_stream for the count words from first on, carrying on
+	// from previous. Returns the last word.
+	uint32_t decode_stream(const uint8_t* planes, uint32_t plane_size, uint32_t first,
+		uint32_t count, uint32_t previous, uint32_t* output)
+	{
+		const uint8_t* plane0 = planes + first;
+		const uint8_t* plane1 = plane0 + plane_size;
+		const uint8_t* plane2 = plane1 + plane_size;
+		const uint8_t* plane3 = plane2 + plane_size;
+		uint32_t i = 0;
+
+#if defined(__SSE2__)
+		// Sixteen words at a time: interleave the planes back into words,
+		// undo the zigzag, then a prefix sum within each group of four
+		// carries the running value along
+		const __m128i one = _mm_set1_epi32(1);
+		__m128i running = _mm_set1_epi32((int32_t)previous);
+		const auto decode4 = [&](__m128i coded, uint32_t* destination) {
+			__m128i delta = _mm_xor_si128(_mm_srli_epi32(coded, 1),
+				_mm_sub_epi32(_mm_setzero_si128(), _mm_and_si128(coded, one)));
+			delta = _mm_add_epi32(delta, _mm_slli_si128(delta, 4));
+			delta = _mm_add_epi32(delta, _mm_slli_si128(delta, 8));
+			const __m128i values = _mm_add_epi32(delta, running);
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(destination), values);
+			running = _mm_shuffle_epi32(values, _MM_SHUFFLE(3, 3, 3, 3));
+		};
+		for (; i + 16 <= count; i += 16)
+		{
+			const __m128i bytes0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(plane0 + i));
+			const __m128i bytes1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(plane1 + i));
+			const __m128i bytes2 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(plane2 + i));
+			const __m128i bytes3 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(plane3 + i));
+			const __m128i low01 = _mm_unpacklo_epi8(bytes0, bytes1);
+			const __m128i high01 = _mm_unpackhi_epi8(bytes0, bytes1);
+			const __m128i low23 = _mm_unpacklo_epi8(bytes2, bytes3);
+			const __m128i high23 = _mm_unpackhi_epi8(bytes2, bytes3);
+			decode4(_mm_unpacklo_epi16(low01, low23), output + i);
+			decode4(_mm_unpackhi_epi16(low01, low23), output + i + 4);
+			decode4(_mm_unpacklo_epi16(high01, high23), output + i + 8);
+			decode4(_mm_unpackhi_epi16(high01, high23), output + i + 12);
+		}
+		previous = (uint32_t)_mm_cvtsi128_si32(running);
+#endif
+
+		for (; i < count; i++)
+		{
+			const uint32_t coded = (uint32_t)plane0[i] | (uint32_t)plane1[i] << 8
+				| (uint32_t)plane2[i] << 16 | (uint32_t)plane3[i] << 24;
+			previous += unzigzag(coded);
+			output[i] = previous;
+		}
+		return previous;
+	}
+
+	void encode_chunk(const uint8_t* source, uint32_t count, uint32_t stride,
+		std::vector<uint8_t>& output)
+	{
+		const uint32_t words = stride / 4;
+		std::vector<uint8_t> planes((size_t)count * stride);
+		for (uint32_t word = 0; word < words; word++)
+		{
+			encode_stream(source + word * 4, count, stride, planes.data() + (size_t)word * count * 4);
+		}
+		lz_compress(planes.data(), planes.size(), output);
+	}
+
+	bool decode_chunk(const uint8_t* source, size_t size, uint32_t count, uint32_t stride,
+		uint8_t* destination)
+	{
+		LinearArena& scratch = scratch_arena();
+		ArenaScope scope(scratch);
+		const size_t plane_bytes = (size_t)count * stride;
+		uint8_t* planes = scratch.allocate<uint8_t>(plane_bytes);
+		if (!lz_decompress(source, size, planes, plane_bytes))
+		{
+			return false;
+		}
+
+		// Indices decode straight into place. Vertices decode a block of
+		// each stream at a time, small enough to stay in cache while the
+		// block is interleaved out to the vertices.
+		const uint32_t words = stride / 4;
+		if (words == 1)
+		{
+			decode_stream(planes, count, 0, count, 0, reinterpret_cast<uint32_t*>(destination));
+			return true;
+		}
+		uint32_t* previous = scratch.allocate<uint32_t>(words);
+		uint32_t* block = scratch.allocate<uint32_t>((size_t)words * DECODE_BLOCK);
+		std::fill(previous, previous + words, 0u);
+		for (uint32_t first = 0; first < count; first += DECODE_BLOCK)
+		{
+			const uint32_t block_count = std::min(DECODE_BLOCK, count - first);
+			for (uint32_t word = 0; word < words; word++)
+			{
+				previous[word] = decode_stream(planes + (size_t)word * count * 4, count, first,
+					block_count, previous[word], block + (size_t)word * DECODE_BLOCK);
+			}
+			for (uint32_t i = 0; i < block_count; i++)
+			{
+				uint8_t* vertex = destination + (size_t)(first + i) * stride;
+				for (uint32_t word = 0; word < words; word++)
+				{
+					store32(vertex + word * 4, block[(size_t)word * DECODE_BLOCK + i]);
+				}
+			}
+		}
+		return true;
+	}
+
+	void encode_chunks(const uint8_t* source, uint32_t count, uint32_t stride,
+		uint32_t chunk_size, std::vector<MeshCodecChunk>& chunks, std::vector<uint8_t>& payload)
+	{
+		for (uint32_t first = 0; first < count; first += chunk_size)
+		{
+			MeshCodecChunk chunk;
+			chunk.first = first;
+			chunk.count = std::min(chunk_size, count - first);
+			chunk.offset = payload.size();
+			encode_chunk(source + (size_t)first * stride, chunk.count, stride, payload);
+			chunk.size = payload.size() - chunk.offset;
+			chunks.push_back(chunk);
+		}
+	}
+}
+
+void lz_compress(const uint8_t* input, size_t size, std::vector<uint8_t>& output)
+{
+	// Positions plus one, so zero means empty
+	std::vector<uint32_t> table((size_t)1 << LZ_HASH_BITS, 0);
+	size_t anchor = 0;
+	size_t position = 0;
+	uint32_t misses = 0;
+
+	while (position + LZ_MIN_MATCH <= size)
+	{
+		const uint32_t sequence = load32(input + position);
+		const uint32_t hash = lz_hash(sequence);
+		const size_t candidate = table[hash];
+		table[hash] = (uint32_t)position + 1;
+
+		if (candidate == 0 || position - (candidate - 1) > LZ_MAX_OFFSET
+			|| load32(input + candidate - 1) != sequence)
+		{
+			// Data that doesn't compress gets skipped through faster and faster
+			position += 1 + (misses++ >> 6);
+			continue;
+		}
+		misses = 0;
+
+		const size_t match = candidate - 1;
+		size_t length = LZ_MIN_MATCH;
+		while (position + length < size && input[match + length] == input[position + length])
+		{
+			length++;
+		}
+		write_sequence(output, input + anchor, position - anchor, position - match, length);
+		position += length;
+		anchor = position;
+	}
+
+	write_sequence(output, input + anchor, size - anchor, 0, 0);
+}
+
+bool lz_decompress(const uint8_t* input, size_t size, uint8_t* output, size_t output_size)
+{
+	const uint8_t* in = input;
+	const uint8_t* in_end = input + size;
+	uint8_t* out = output;
+	uint8_t* out_end = output + output_size;
+
+	while (in < in_end)
+	{
+		const uint8_t token = *in++;
+		size_t literals = token >> 4;
+		if (literals == LZ_TOKEN_MAX && !read_length(in, in_end, literals))
+		{
+			return false;
+		}
+		if (literals > (size_t)(in_end - in) || literals > (size_t)(out_end - out))
+		{
+			return false;
+		}
+		if ((size_t)(in_end - in) >= literals + 16 && (size_t)(out_end - out) >= literals + 16)
+		{
+			wild_copy(out, in, literals);
+		}
+		else
+		{
+			std::memcpy(out, in, literals);
+		}
+		in += literals;
+		out += literals;
+
+		if (in == in_end)
+		{
+			break;
+		}
+		if (in_end - in < 2)
+		{
+			return false;
+		}
+		const size_t offset = (size_t)in[0] | (size_t)in[1] << 8;
+		in += 2;
+		size_t length = token & LZ_TOKEN_MAX;
+		if (length == LZ_TOKEN_MAX && !read_length(in, in_end, length))
+		{
+			return false;
+		}
+		length += LZ_MIN_MATCH;
+		if (offset == 0 || offset > (size_t)(out - output) || length > (size_t)(out_end - out))
+		{
+			return false;
+		}
+
+		// Matches closer than a copy step overlap themselves. Runs of one
+		// byte, the zeros of the high planes mostly, are a fill; the rest go
+		// a byte at a time.
+		const uint8_t* match = out - offset;
+		if (offset >= 16 && (size_t)(out_end - out) >= length + 16)
+		{
+			wild_copy(out, match, length);
+		}
+		else if (offset == 1)
+		{
+			std::memset(out, *match, length);
+		}
+		else
+		{
+			for (size_t i = 0; i < length; i++)
+			{
+				out[i] = match[i];
+			}
+		}
+		out += length;
+	}
+
+	return out == out_end;
+}
+
+std::vector<uint8_t> encode_mesh(const void* vertices, uint32_t vertex_count,
+	uint32_t vertex_stride, const uint32_t* indices, uint32_t index_count)
+{
+	std::vector<uint8_t> data;
+	if (vertex_stride == 0 || vertex_stride % 4 != 0)
+	{
+		std::cerr << "Mesh codec needs a vertex stride that is a multiple of four, not "
+				  << vertex_stride << "\n";
+		return data;
+	}
+
+	std::vector<MeshCodecChunk> chunks;
+	std::vector<uint8_t> payload;
+	encode_chunks(static_cast<const uint8_t*>(vertices), vertex_count, vertex_stride,
+		MESH_CODEC_CHUNK_VERTICES, chunks, payload);
+	const size_t vertex_chunks = chunks.size();
+	encode_chunks(reinterpret_cast<const uint8_t*>(indices), index_count, sizeof(uint32_t),
+		MESH_CODEC_CHUNK_INDICES, chunks, payload);
+
+	MeshCodecHeader header;
+	header.vertex_count = vertex_count;
+	header.vertex_stride = vertex_stride;
+	header.index_count = index_count;
+	header.vertex_chunk_count = (uint32_t)vertex_chunks;
+	header.index_chunk_count = (uint32_t)(chunks.size() - vertex_chunks);
+
+	const size_t table_size = sizeof(MeshCodecChunk) * chunks.size();
+	data.resize(sizeof(header) + table_size + payload.size());
+	std::memcpy(data.data(), &header, sizeof(header));
+	std::memcpy(data.data() + sizeof(header), chunks.data(), table_size);
+	std::memcpy(data.data() + sizeof(header) + table_size, payload.data(), payload.size());
+	return data;
+}
+
+bool read_mesh_header(const uint8_t* data, size_t size, MeshCodecHeader& header)
+{
+	if (size < sizeof(header))
+	{
+		std::cerr << "Compressed mesh is truncated\n";
+		return false;
+	}
+	std::memcpy(&header, data, sizeof(header));
+	if (header.magic != MESH_CODEC_MAGIC || header.version != MESH_CODEC_VERSION)
+	{
+		std::cerr << "Not a compressed mesh, or an unsupported version\n";
+		return false;
+	}
+	if (header.vertex_stride == 0 || header.vertex_stride % 4 != 0)
+	{
+		std::cerr << "Compressed mesh has a bad vertex stride\n";
+		return false;
+	}
+
+	const size_t chunk_count = (size_t)header.vertex_chunk_count + header.index_chunk_count;
+	const size_t payload_start = sizeof(header) + sizeof(MeshCodecChunk) * chunk_count;
+	if (size < payload_start)
+	{
+		std::cerr << "Compressed mesh chunk table is truncated\n";
+		return false;
+	}
+
+	// Every element in exactly one chunk, every chunk inside the payloads
+	uint64_t vertices = 0;
+	uint64_t indices = 0;
+	for (size_t i = 0; i < chunk_count; i++)
+	{
+		MeshCodecChunk chunk;
+		std::memcpy(&chunk, data + sizeof(header) + sizeof(chunk) * i, sizeof(chunk));
+		uint64_t& covered = i < header.vertex_chunk_count ? vertices : indices;
+		if (chunk.first != covered || chunk.offset > size - payload_start
+			|| chunk.size > size - payload_start - chunk.offset)
+		{
+			std::cerr << "Compressed mesh chunk " << i << " is out of bounds\n";
+			return false;
+		}
+		covered += chunk.count;
+	}
+	if (vertices != header.vertex_count || indices != header.index_count)
+	{
+		std::cerr << "Compressed mesh chunks don't cover the mesh\n";
+		return false;
+	}
+	return true;
+}
+
+bool decode_mesh(const uint8_t* data, size_t size, void* vertices, uint32_t* indices,
+	JobSystem* jobs)
+{
+	MeshCodecHeader header;
+	if (!read_mesh_header(data, size, header))
+	{
+		return false;
+	}
+
+	const uint32_t chunk_count = header.vertex_chunk_count + header.index_chunk_count;
+	const uint8_t* table = data + sizeof(header);
+	const uint8_t* payload = table + sizeof(MeshCodecChunk) * chunk_count;
+	std::atomic<bool> decoded(true);
+
+	const auto decode_range = [&](uint32_t begin, uint32_t end) {
+		for (uint32_t i = begin; i < end; i++)
+		{
+			MeshCodecChunk chunk;
+			std::memcpy(&chunk, table + sizeof(chunk) * i, sizeof(chunk));
+			const bool vertex_chunk = i < header.vertex_chunk_count;
+			const uint32_t stride = vertex_chunk ? header.vertex_stride : (uint32_t)sizeof(uint32_t);
+			uint8_t* destination = vertex_chunk
+				? static_cast<uint8_t*>(vertices) + (size_t)chunk.first * stride
+				: reinterpret_cast<uint8_t*>(indices + chunk.first);
+			if (!decode_chunk(payload + chunk.offset, chunk.size, chunk.count, stride, destination))
+			{
+				decoded = false;
+			}
+		}
+	};
+
+	if (jobs)
+	{
+		jobs->parallel_for(chunk_count, decode_range);
+	}
+	else
+	{
+		decode_range(0, chunk_count);
+	}
+
+	if (!decoded)
+	{
+		std::cerr << "Compressed mesh is corrupt\n";
+	}
+	return decoded;
+}
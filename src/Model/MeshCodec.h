@@ -0,0 +1,61 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+class JobSystem;
+
+// Compressed mesh container: a fixed header, a table of independently
+// coded chunks, then the chunk payloads. Vertices are split into one
+// stream per 32 bit word of the vertex, delta coded against the previous
+// vertex, zigzagged and transposed into byte planes; indices are delta
+// coded against the previous index the same way. Meshes in vertex fetch
+// order, as welding leaves them, turn into planes that are mostly zeros,
+// which the LZ stage after them packs down to a fraction of the raw size.
+
+constexpr uint32_t MESH_CODEC_MAGIC = 0x5A4D4C47; // "GLMZ"
+constexpr uint32_t MESH_CODEC_VERSION = 1;
+// Small enough that a mesh splits across every thread, big enough that the
+// LZ window fills up
+constexpr uint32_t MESH_CODEC_CHUNK_VERTICES = 16 * 1024;
+constexpr uint32_t MESH_CODEC_CHUNK_INDICES = 48 * 1024;
+
+struct MeshCodecHeader
+{
+	uint32_t magic = MESH_CODEC_MAGIC;
+	uint32_t version = MESH_CODEC_VERSION;
+	uint32_t vertex_count = 0;
+	uint32_t vertex_stride = 0; // bytes, a multiple of four
+	uint32_t index_count = 0;
+	uint32_t vertex_chunk_count = 0;
+	uint32_t index_chunk_count = 0;
+	uint32_t reserved = 0;
+};
+
+// Vertex chunks come first in the table, then index chunks
+struct MeshCodecChunk
+{
+	uint32_t first = 0; // vertex or index
+	uint32_t count = 0;
+	uint64_t offset = 0; // from the start of the payloads
+	uint64_t size = 0; // compressed
+};
+
+// Lossless. vertex_stride has to be a multiple of four.
+std::vector<uint8_t> encode_mesh(const void* vertices, uint32_t vertex_count,
+	uint32_t vertex_stride, const uint32_t* indices, uint32_t index_count);
+
+// Checks the header and chunk table, so the caller can size the output
+bool read_mesh_header(const uint8_t* data, size_t size, MeshCodecHeader& header);
+
+// Decodes into vertex_count * vertex_stride bytes of vertices and
+// index_count indices. Chunks decode in parallel when given a job system.
+bool decode_mesh(const uint8_t* data, size_t size, void* vertices, uint32_t* indices,
+	JobSystem* jobs = nullptr);
+
+// The LZ stage on its own, in the LZ4 block layout: runs of literals and
+// back references into the last 64 KB. Appends to output.
+void lz_compress(const uint8_t* input, size_t size, std::vector<uint8_t>& output);
+// output_size has to be the exact decompressed size
+bool lz_decompress(const uint8_t* input, size_t size, uint8_t* output, size_t output_size);
@@ -0,0 +1,223 @@
+#include "Meshlet.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include <glm/common.hpp>
+#include <glm/geometric.hpp>
+
+namespace
+{
+	void compute_meshlet_bounds(Meshlet& meshlet,
+		const std::vector<Vertex>& vertices, const uint32_t* indices)
+	{
+		const uint32_t* tris = indices + meshlet.index_offset;
+
+		// Sphere around the center of the bounding box
+		glm::vec3 min = vertices[tris[0]].position;
+		glm::vec3 max = min;
+		for (uint32_t i = 0; i < meshlet.index_count; i++)
+		{
+			min = glm::min(min, vertices[tris[i]].position);
+			max = glm::max(max, vertices[tris[i]].position);
+		}
+		meshlet.center = (min + max) * 0.5f;
+		meshlet.radius = 0.0f;
+		for (uint32_t i = 0; i < meshlet.index_count; i++)
+		{
+			meshlet.radius = std::max(meshlet.radius,
+				glm::length(vertices[tris[i]].position - meshlet.center));
+		}
+
+		// Average the face normals for the cone axis
+		glm::vec3 axis(0.0f);
+		for (uint32_t i = 0; i < meshlet.index_count; i += 3)
+		{
+			const glm::vec3& p0 = vertices[tris[i + 0]].position;
+			const glm::vec3& p1 = vertices[tris[i + 1]].position;
+			const glm::vec3& p2 = vertices[tris[i + 2]].position;
+			axis += glm::cross(p1 - p0, p2 - p0);
+		}
+
+		const float axis_length = glm::length(axis);
+		meshlet.cone_axis = glm::vec3(0.0f);
+		meshlet.cone_apex = meshlet.center;
+		meshlet.cone_cutoff = 1.0f;
+		if (axis_length <= 0.0f)
+		{
+			return;
+		}
+		axis /= axis_length;
+
+		// The widest angle between the axis and any face normal
+		float min_dot = 1.0f;
+		for (uint32_t i = 0; i < meshlet.index_count; i += 3)
+		{
+			const glm::vec3& p0 = vertices[tris[i + 0]].position;
+			const glm::vec3& p1 = vertices[tris[i + 1]].position;
+			const glm::vec3& p2 = vertices[tris[i + 2]].position;
+			const glm::vec3 normal = glm::cross(p1 - p0, p2 - p0);
+			const float length = glm::length(normal);
+			if (length > 0.0f)
+			{
+				min_dot = std::min(min_dot, glm::dot(normal / length, axis));
+			}
+		}
+
+		// Cones wider than ~85 degrees can't cull anything useful
+		if (min_dot <= 0.1f)
+		{
+			return;
+		}
+
+		// Move the apex back along the axis until it's behind every triangle's
+		// plane, so the test holds from any point of view
+		float max_t = 0.0f;
+		for (uint32_t i = 0; i < meshlet.index_count; i += 3)
+		{
+			const glm::vec3& p0 = vertices[tris[i + 0]].position;
+			const glm::vec3& p1 = vertices[tris[i + 1]].position;
+			const glm::vec3& p2 = vertices[tris[i + 2]].position;
+			const glm::vec3 normal = glm::cross(p1 - p0, p2 - p0);
+			const float length = glm::length(normal);
+			if (length <= 0.0f)
+			{
+				continue;
+			}
+
+			const glm::vec3 n = normal / length;
+			const float dc = glm::dot(meshlet.center - p0, n);
+			const float dn = glm::dot(axis, n);
+			max_t = std::max(max_t, dc / dn);
+		}
+
+		meshlet.cone_axis = axis;
+		meshlet.cone_apex = meshlet.center - axis * max_t;
+		meshlet.cone_cutoff = std::sqrt(1.0f - min_dot * min_dot);
+	}
+}
+
+void build_meshlets(std::vector<Meshlet>& meshlets,
+	const std::vector<Vertex>& vertices, uint32_t* indices, size_t index_count,
+	uint32_t index_offset)
+{
+	meshlets.clear();
+
+	const size_t vertex_count = vertices.size();
+	const size_t triangle_count = index_count / 3;
+
+	// Triangles using each vertex
+	std::vector<uint32_t> offsets(vertex_count + 1, 0);
+	std::vector<uint32_t> vertex_triangles(index_count);
+	for (size_t i = 0; i < index_count; i++)
+	{
+		offsets[indices[i] + 1]++;
+	}
+	for (size_t i = 0; i < vertex_count; i++)
+	{
+		offsets[i + 1] += offsets[i];
+	}
+	std::vector<uint32_t> fill(offsets.begin(), offsets.end() - 1);
+	for (size_t i = 0; i < index_count; i++)
+	{
+		vertex_triangles[fill[indices[i]]++] = (uint32_t)(i / 3);
+	}
+
+	std::vector<uint32_t> ordered;
+	ordered.reserve(index_count);
+	std::vector<uint8_t> emitted(triangle_count, 0);
+	std::vector<uint8_t> in_meshlet(vertex_count, 0);
+	std::vector<uint32_t> meshlet_vertices;
+	meshlet_vertices.reserve(MESHLET_MAX_VERTICES);
+
+	Meshlet meshlet;
+	size_t seed_cursor = 0;
+
+	const auto new_vertex_count = [&](uint32_t triangle) {
+		uint32_t count = 0;
+		for (uint32_t k = 0; k < 3; k++)
+		{
+			count += in_meshlet[indices[triangle * 3 + k]] ? 0u : 1u;
+		}
+		return count;
+	};
+
+	const auto flush = [&]() {
+		if (meshlet.index_count == 0)
+		{
+			return;
+		}
+		meshlet.vertex_count = (uint32_t)meshlet_vertices.size();
+		meshlets.push_back(meshlet);
+		for (const uint32_t v : meshlet_vertices)
+		{
+			in_meshlet[v] = 0;
+		}
+		meshlet_vertices.clear();
+		meshlet = Meshlet();
+		meshlet.index_offset = (uint32_t)ordered.size();
+	};
+
+	for (size_t emitted_count = 0; emitted_count < triangle_count; emitted_count++)
+	{
+		// Prefer the neighbouring triangle that adds the fewest new vertices
+		uint32_t best = UINT32_MAX;
+		uint32_t best_extra = 4;
+		for (const uint32_t v : meshlet_vertices)
+		{
+			for (uint32_t i = offsets[v]; i < offsets[v + 1]; i++)
+			{
+				const uint32_t triangle = vertex_triangles[i];
+				if (emitted[triangle])
+				{
+					continue;
+				}
+				const uint32_t extra = new_vertex_count(triangle);
+				if (extra < best_extra)
+				{
+					best = triangle;
+					best_extra = extra;
+				}
+			}
+		}
+
+		// Nothing connected is left, so restart from the next unused triangle
+		if (best == UINT32_MAX)
+		{
+			while (emitted[seed_cursor])
+			{
+				seed_cursor++;
+			}
+			best = (uint32_t)seed_cursor;
+			best_extra = new_vertex_count(best);
+		}
+
+		if (meshlet_vertices.size() + best_extra > MESHLET_MAX_VERTICES
+			|| meshlet.index_count / 3 + 1 > MESHLET_MAX_TRIANGLES)
+		{
+			flush();
+		}
+
+		for (uint32_t k = 0; k < 3; k++)
+		{
+			const uint32_t v = indices[best * 3 + k];
+			if (!in_meshlet[v])
+			{
+				in_meshlet[v] = 1;
+				meshlet_vertices.push_back(v);
+			}
+			ordered.push_back(v);
+		}
+		meshlet.index_count += 3;
+		emitted[best] = 1;
+	}
+	flush();
+
+	std::copy(ordered.begin(), ordered.end(), indices);
+
+	for (Meshlet& m : meshlets)
+	{
+		compute_meshlet_bounds(m, vertices, indices);
+		m.index_offset += index_offset;
+	}
+}
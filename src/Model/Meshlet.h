@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <glm/vec3.hpp>
+
+#include "../Renderer/Vertex.h"
+
+constexpr uint32_t MESHLET_MAX_VERTICES = 64;
+constexpr uint32_t MESHLET_MAX_TRIANGLES = 124;
+
+// A small cluster of triangles that can be culled as a unit. The triangles
+// are a contiguous range of the model's index buffer.
+struct Meshlet
+{
+	uint32_t index_offset = 0;
+	uint32_t index_count = 0;
+	uint32_t vertex_count = 0;
+	uint32_t submesh = 0; // LOD 0 submesh the triangles belong to
+
+	// Bounding sphere
+	glm::vec3 center = glm::vec3(0.0f);
+	float radius = 0.0f;
+
+	// Normal cone. The cluster faces away from any viewer for which
+	// dot(normalize(cone_apex - eye), cone_axis) >= cone_cutoff.
+	glm::vec3 cone_apex = glm::vec3(0.0f);
+	glm::vec3 cone_axis = glm::vec3(0.0f);
+	float cone_cutoff = 1.0f;
+};
+
+// Groups the triangles in indices[0, index_count) into meshlets, greedily
+// growing each one through triangles that share the most vertices with it.
+// The triangles are reordered in place so each meshlet is a contiguous range;
+// indices is expected to start at index_offset in the model's index buffer.
+void build_meshlets(std::vector<Meshlet>& meshlets,
+	const std::vector<Vertex>& vertices, uint32_t* indices, size_t index_count,
+	uint32_t index_offset);
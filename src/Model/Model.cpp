@@ -0,0 +1,349 @@
+#include "Model.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <unordered_map>
+
+#include <glm/common.hpp>
+#include <glm/geometric.hpp>
+
+#include "Simplifier.h"
+
+#if defined(__clang__)
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Weverything"
+#endif
+#define FAST_OBJ_IMPLEMENTATION
+#include <fast_obj/fast_obj.h>
+#if defined(__clang__)
+#pragma clang diagnostic pop
+#endif
+
+namespace
+{
+	struct IndexHash
+	{
+		size_t operator()(const fastObjIndex& index) const
+		{
+			return (size_t)((index.p * 73856093u) ^ (index.t * 19349663u)
+				^ (index.n * 83492791u));
+		}
+	};
+
+	struct IndexEqual
+	{
+		bool operator()(const fastObjIndex& a, const fastObjIndex& b) const
+		{
+			return a.p == b.p && a.t == b.t && a.n == b.n;
+		}
+	};
+
+	// A submesh's vertices packed together, so the simplifier and the meshlet
+	// builder only walk what the submesh uses rather than the whole model
+	struct SubmeshVertices
+	{
+		std::vector<Vertex> vertices;
+		std::vector<uint32_t> indices; // into vertices
+		std::vector<uint32_t> model_ids; // the model's vertex for each of vertices
+		std::vector<uint32_t> local_ids; // per model vertex, UINT32_MAX if unused
+	};
+
+	void gather_submesh(SubmeshVertices& submesh, const std::vector<Vertex>& vertices,
+		const uint32_t* indices, size_t index_count)
+	{
+		// Only the entries the last submesh set need clearing
+		submesh.local_ids.resize(vertices.size(), UINT32_MAX);
+		for (const uint32_t id : submesh.model_ids)
+		{
+			submesh.local_ids[id] = UINT32_MAX;
+		}
+		submesh.vertices.clear();
+		submesh.model_ids.clear();
+		submesh.indices.resize(index_count);
+
+		for (size_t i = 0; i < index_count; i++)
+		{
+			uint32_t& local = submesh.local_ids[indices[i]];
+			if (local == UINT32_MAX)
+			{
+				local = (uint32_t)submesh.vertices.size();
+				submesh.vertices.push_back(vertices[indices[i]]);
+				submesh.model_ids.push_back(indices[i]);
+			}
+			submesh.indices[i] = local;
+		}
+	}
+
+	Material material_from_obj(const fastObjMaterial& source)
+	{
+		Material material;
+		material.name = source.name ? source.name : "";
+		material.diffuse = glm::vec3(source.Kd[0], source.Kd[1], source.Kd[2]);
+		material.specular = glm::vec3(source.Ks[0], source.Ks[1], source.Ks[2]);
+		material.shininess = source.Ns;
+		material.opacity = source.d;
+		material.diffuse_map = source.map_Kd.path ? source.map_Kd.path : "";
+		return material;
+	}
+}
+
+void Model::generate_lods(int lod_count, float reduction)
+{
+	// Everything past LOD 0 gets rebuilt
+	if (!lods.empty())
+	{
+		indices.resize(lods[0].index_offset + lods[0].index_count);
+		lods.resize(1);
+	}
+	else
+	{
+		ModelLod lod;
+		lod.index_count = (uint32_t)indices.size();
+		lod.submeshes.push_back({0, lod.index_count, 0});
+		lods.push_back(lod);
+	}
+
+	SubmeshVertices local;
+	std::vector<uint32_t> lod_indices;
+	lod_count = std::min(lod_count, MAX_MODEL_LODS);
+
+	for (int i = 1; i < lod_count; i++)
+	{
+		const ModelLod previous = lods.back();
+
+		ModelLod lod;
+		lod.index_offset = (uint32_t)indices.size();
+		lod.error = previous.error;
+
+		// Simplify from the previous level rather than LOD 0, which is much
+		// cheaper and keeps the levels nested
+		for (const Submesh& submesh : previous.submeshes)
+		{
+			// Round the target down to whole triangles
+			const size_t target = (size_t)((float)submesh.index_count * reduction) / 3 * 3;
+
+			float error = 0.0f;
+			gather_submesh(local, vertices, &indices[submesh.index_offset], submesh.index_count);
+			const size_t count = simplify_mesh(lod_indices, local.vertices, local.indices.data(),
+				submesh.index_count, target, INFINITY, &error);
+			if (count == 0)
+			{
+				continue;
+			}
+
+			lod.submeshes.push_back({(uint32_t)indices.size(), (uint32_t)count, submesh.material});
+			lod.index_count += (uint32_t)count;
+			lod.error = std::max(lod.error, previous.error + error);
+			for (size_t j = 0; j < count; j++)
+			{
+				indices.push_back(local.model_ids[lod_indices[j]]);
+			}
+		}
+
+		// Stop once the simplifier can't make meaningful progress, usually
+		// because everything left is locked to a border or seam
+		if (lod.index_count == 0 || (float)lod.index_count > (float)previous.index_count * 0.95f)
+		{
+			indices.resize(lod.index_offset);
+			break;
+		}
+
+		lods.push_back(lod);
+	}
+}
+
+void Model::generate_meshlets()
+{
+	meshlets.clear();
+	if (lods.empty())
+	{
+		return;
+	}
+
+	SubmeshVertices local;
+	std::vector<Meshlet> submesh_meshlets;
+	for (uint32_t i = 0; i < (uint32_t)lods[0].submeshes.size(); i++)
+	{
+		const Submesh& submesh = lods[0].submeshes[i];
+		gather_submesh(local, vertices, &indices[submesh.index_offset], submesh.index_count);
+		build_meshlets(submesh_meshlets, local.vertices, local.indices.data(),
+			submesh.index_count, submesh.index_offset);
+
+		// The triangles come back reordered
+		for (uint32_t j = 0; j < submesh.index_count; j++)
+		{
+			indices[submesh.index_offset + j] = local.model_ids[local.indices[j]];
+		}
+		for (Meshlet& meshlet : submesh_meshlets)
+		{
+			meshlet.submesh = i;
+			meshlets.push_back(meshlet);
+		}
+	}
+}
+
+uint32_t select_lod(const Model& model, LodState& state, float distance,
+	float projection_scale, float pixel_threshold)
+{
+	const uint32_t lod_count = (uint32_t)model.lods.size();
+	if (lod_count == 0)
+	{
+		return 0;
+	}
+
+	// Inside the bounding sphere everything is as close as it gets
+	const float scale = projection_scale / std::max(distance - model.radius, 1e-3f);
+
+	// Coarsest level that is still within the threshold, and the coarsest one
+	// that is comfortably within it
+	uint32_t allowed = 0;
+	uint32_t comfortable = 0;
+	for (uint32_t i = 0; i < lod_count; i++)
+	{
+		const float pixels = model.lods[i].error * scale;
+		if (pixels <= pixel_threshold)
+		{
+			allowed = i;
+		}
+		if (pixels <= pixel_threshold * (1.0f - LOD_HYSTERESIS))
+		{
+			comfortable = i;
+		}
+	}
+
+	// Refine immediately, but only coarsen once there's some margin
+	if (allowed < state.lod)
+	{
+		state.lod = allowed;
+	}
+	else if (comfortable > state.lod)
+	{
+		state.lod = comfortable;
+	}
+	state.lod = std::min(state.lod, lod_count - 1);
+
+	return state.lod;
+}
+
+void weld_obj_mesh(const void* obj_mesh, std::vector<Vertex>& vertices,
+	std::vector<std::vector<uint32_t>>& material_indices)
+{
+	const fastObjMesh* mesh = static_cast<const fastObjMesh*>(obj_mesh);
+
+	// Weld identical position/uv/normal triplets into single vertices
+	std::unordered_map<fastObjIndex, uint32_t, IndexHash, IndexEqual> vertex_map;
+	std::vector<uint32_t> face_indices;
+	size_t index = 0;
+
+	for (unsigned int face = 0; face < mesh->face_count; face++)
+	{
+		const unsigned int face_vertex_count = mesh->face_vertices[face];
+		const unsigned int material = mesh->material_count > 0
+			? std::min(mesh->face_materials[face], mesh->material_count - 1) : 0;
+		std::vector<uint32_t>& triangles = material_indices[material];
+		face_indices.clear();
+
+		for (unsigned int i = 0; i < face_vertex_count; i++)
+		{
+			const fastObjIndex& src = mesh->indices[index + i];
+			const auto [it, inserted] = vertex_map.emplace(src,
+				(uint32_t)vertices.size());
+			if (inserted)
+			{
+				Vertex vertex{};
+				vertex.position = glm::vec3(mesh->positions[src.p * 3 + 0],
+					mesh->positions[src.p * 3 + 1], mesh->positions[src.p * 3 + 2]);
+				vertex.color = glm::vec3(1.0f);
+				vertex.uv = glm::vec2(mesh->texcoords[src.t * 2 + 0],
+					mesh->texcoords[src.t * 2 + 1]);
+				vertex.normal = glm::vec3(mesh->normals[src.n * 3 + 0],
+					mesh->normals[src.n * 3 + 1], mesh->normals[src.n * 3 + 2]);
+				vertices.push_back(vertex);
+			}
+			face_indices.push_back(it->second);
+		}
+
+		// Triangulate polygons as fans
+		for (unsigned int i = 2; i < face_vertex_count; i++)
+		{
+			triangles.push_back(face_indices[0]);
+			triangles.push_back(face_indices[i - 1]);
+			triangles.push_back(face_indices[i]);
+		}
+
+		index += face_vertex_count;
+	}
+}
+
+std::shared_ptr<Model> load_model_from_obj(const char* filename, int lod_count)
+{
+	fastObjMesh* mesh = fast_obj_read(filename);
+	if (!mesh)
+	{
+		std::cerr << "Unable to open model file: " << filename << "\n";
+		return nullptr;
+	}
+
+	auto model = std::make_shared<Model>();
+
+	for (unsigned int i = 0; i < mesh->material_count; i++)
+	{
+		model->materials.push_back(material_from_obj(mesh->materials[i]));
+	}
+	if (model->materials.empty())
+	{
+		model->materials.emplace_back();
+	}
+
+	// Triangles are bucketed by material so each material is one range
+	std::vector<std::vector<uint32_t>> material_indices(model->materials.size());
+	weld_obj_mesh(mesh, model->vertices, material_indices);
+
+	fast_obj_destroy(mesh);
+
+	ModelLod lod;
+	for (uint32_t material = 0; material < (uint32_t)material_indices.size(); material++)
+	{
+		const std::vector<uint32_t>& triangles = material_indices[material];
+		if (triangles.empty())
+		{
+			continue;
+		}
+		lod.submeshes.push_back({(uint32_t)model->indices.size(), (uint32_t)triangles.size(), material});
+		model->indices.insert(model->indices.end(), triangles.begin(), triangles.end());
+	}
+	lod.index_count = (uint32_t)model->indices.size();
+	model->lods.push_back(lod);
+
+	if (model->vertices.empty())
+	{
+		std::cerr << "Model file contains no faces: " << filename << "\n";
+		return nullptr;
+	}
+
+	// Bounds are needed to turn LOD errors into screen space errors
+	model->bounds_min = model->vertices[0].position;
+	model->bounds_max = model->vertices[0].position;
+	for (const Vertex& vertex : model->vertices)
+	{
+		model->bounds_min = glm::min(model->bounds_min, vertex.position);
+		model->bounds_max = glm::max(model->bounds_max, vertex.position);
+	}
+	model->radius = glm::length(model->bounds_max - model->bounds_min) * 0.5f;
+
+	model->generate_lods(lod_count);
+	model->generate_meshlets();
+
+	for (size_t i = 0; i < model->lods.size(); i++)
+	{
+		std::cout << filename << ": LOD " << i << " "
+				  << model->lods[i].index_count / 3 << " triangles, error "
+				  << model->lods[i].error << "\n";
+	}
+	std::cout << filename << ": " << model->meshlets.size() << " meshlets, "
+			  << model->materials.size() << " materials, "
+			  << model->lods[0].submeshes.size() << " submeshes\n";
+
+	return model;
+}
@@ -1,14 +1,82 @@
 #pragma once
 
+#include <cstdint>
 #include <memory>
+#include <vector>
 
 #include <glm/vec3.hpp>
 
+#include "../Renderer/Vertex.h"
+#include "Material.h"
+#include "Meshlet.h"
+
+constexpr int MAX_MODEL_LODS = 8;
+
+// Fraction of the threshold a coarser LOD has to beat before we switch to it,
+// so objects sitting right at a transition distance don't flicker
+constexpr float LOD_HYSTERESIS = 0.25f;
+
+// A range of triangles that share one material
+struct Submesh
+{
+	uint32_t index_offset = 0;
+	uint32_t index_count = 0;
+	uint32_t material = 0; // index into Model::materials
+};
+
+// One level of detail, stored as a range of the model's index buffer which
+// is split into submeshes sorted by material
+struct ModelLod
+{
+	uint32_t index_offset = 0;
+	uint32_t index_count = 0;
+	float error = 0.0f; // object space deviation from LOD 0
+	std::vector<Submesh> submeshes;
+};
+
 class Model
 {
 public:
-	
+	// Generates up to lod_count - 1 coarser levels after LOD 0, each keeping
+	// roughly `reduction` of the previous level's triangles. Submeshes are
+	// simplified separately, so material boundaries stay locked.
+	void generate_lods(int lod_count, float reduction = 0.5f);
 
+	// Splits each LOD 0 submesh into meshlets for cluster culling. This
+	// reorders the LOD 0 triangles but leaves the other levels untouched.
+	void generate_meshlets();
+
+	std::vector<Vertex> vertices;
+	std::vector<uint32_t> indices;
+	std::vector<ModelLod> lods;
+	std::vector<Meshlet> meshlets;
+	std::vector<Material> materials;
+
+	// Ids of the materials in the MaterialLibrary, filled in by add_model
+	std::vector<uint32_t> material_ids;
+
+	glm::vec3 bounds_min = glm::vec3(0.0f);
+	glm::vec3 bounds_max = glm::vec3(0.0f);
+	float radius = 0.0f;
+};
+
+// Per instance LOD state, kept between frames for the hysteresis
+struct LodState
+{
+	uint32_t lod = 0;
 };
 
-std::shared_ptr<Model> load_model_from_obj(const char* filename);
+// Picks the coarsest LOD whose error projects to at most pixel_threshold
+// pixels. projection_scale is viewport_height / (2 * tan(fov_y / 2)).
+uint32_t select_lod(const Model& model, LodState& state, float distance,
+	float projection_scale, float pixel_threshold);
+
+std::shared_ptr<Model> load_model_from_obj(const char* filename,
+	int lod_count = 1);
+
+// Welds the corners of an OBJ mesh that share a position, uv and normal
+// into single vertices, and triangulates its faces as fans into one index
+// list per material. obj_mesh is a fastObjMesh, which as a void* keeps
+// fast_obj out of everyone's includes.
+void weld_obj_mesh(const void* obj_mesh, std::vector<Vertex>& vertices,
+	std::vector<std::vector<uint32_t>>& material_indices);
@@ -0,0 +1,405 @@
+#include "Simplifier.h"
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <unordered_map>
+
+#include <glm/geometric.hpp>
+
+namespace
+{
+	enum class VertexKind : uint8_t
+	{
+		Manifold, // interior vertex with a single set of attributes
+		Border, // lies on an open edge of the mesh
+		Seam, // shares its position with vertices that have other attributes
+	};
+
+	// Symmetric 4x4 error quadric, stored as the upper triangle plus the
+	// accumulated area weight so errors can be normalized to a distance
+	struct Quadric
+	{
+		float a00 = 0.0f, a11 = 0.0f, a22 = 0.0f;
+		float a10 = 0.0f, a20 = 0.0f, a21 = 0.0f;
+		float b0 = 0.0f, b1 = 0.0f, b2 = 0.0f;
+		float c = 0.0f;
+		float w = 0.0f;
+	};
+
+	struct Collapse
+	{
+		uint32_t v0; // position id that moves
+		uint32_t v1; // position id it moves onto
+		uint32_t target; // vertex index that replaces v0 in the triangles
+		float error;
+	};
+
+	struct PositionHash
+	{
+		size_t operator()(const glm::vec3& p) const
+		{
+			const uint32_t x = std::bit_cast<uint32_t>(p.x);
+			const uint32_t y = std::bit_cast<uint32_t>(p.y);
+			const uint32_t z = std::bit_cast<uint32_t>(p.z);
+			return (size_t)((x * 73856093u) ^ (y * 19349663u) ^ (z * 83492791u));
+		}
+	};
+
+	struct PositionEqual
+	{
+		bool operator()(const glm::vec3& a, const glm::vec3& b) const
+		{
+			return std::bit_cast<uint32_t>(a.x) == std::bit_cast<uint32_t>(b.x)
+				&& std::bit_cast<uint32_t>(a.y) == std::bit_cast<uint32_t>(b.y)
+				&& std::bit_cast<uint32_t>(a.z) == std::bit_cast<uint32_t>(b.z);
+		}
+	};
+
+	// Compressed adjacency: for each position id, the triangles using it
+	struct Adjacency
+	{
+		std::vector<uint32_t> offsets;
+		std::vector<uint32_t> triangles;
+	};
+
+	void quadric_add(Quadric& q, const Quadric& r)
+	{
+		q.a00 += r.a00;
+		q.a11 += r.a11;
+		q.a22 += r.a22;
+		q.a10 += r.a10;
+		q.a20 += r.a20;
+		q.a21 += r.a21;
+		q.b0 += r.b0;
+		q.b1 += r.b1;
+		q.b2 += r.b2;
+		q.c += r.c;
+		q.w += r.w;
+	}
+
+	Quadric quadric_from_triangle(const glm::vec3& p0, const glm::vec3& p1,
+		const glm::vec3& p2)
+	{
+		Quadric q;
+
+		const glm::vec3 cross = glm::cross(p1 - p0, p2 - p0);
+		const float length = glm::length(cross);
+		if (length <= 0.0f)
+		{
+			return q;
+		}
+
+		// Plane through the triangle, weighted by its area
+		const glm::vec3 n = cross / length;
+		const float d = -glm::dot(n, p0);
+		const float w = length * 0.5f;
+
+		q.a00 = w * n.x * n.x;
+		q.a11 = w * n.y * n.y;
+		q.a22 = w * n.z * n.z;
+		q.a10 = w * n.y * n.x;
+		q.a20 = w * n.z * n.x;
+		q.a21 = w * n.z * n.y;
+		q.b0 = w * n.x * d;
+		q.b1 = w * n.y * d;
+		q.b2 = w * n.z * d;
+		q.c = w * d * d;
+		q.w = w;
+
+		return q;
+	}
+
+	// Mean squared distance from v to the planes accumulated in q
+	float quadric_error(const Quadric& q, const glm::vec3& v)
+	{
+		const float rx = q.a00 * v.x + q.a10 * v.y + q.a20 * v.z + 2.0f * q.b0;
+		const float ry = q.a10 * v.x + q.a11 * v.y + q.a21 * v.z + 2.0f * q.b1;
+		const float rz = q.a20 * v.x + q.a21 * v.y + q.a22 * v.z + 2.0f * q.b2;
+		const float error = rx * v.x + ry * v.y + rz * v.z + q.c;
+
+		return q.w > 0.0f ? std::fabs(error) / q.w : 0.0f;
+	}
+
+	void build_adjacency(Adjacency& adjacency, const std::vector<uint32_t>& remap,
+		const std::vector<uint32_t>& indices, size_t index_count)
+	{
+		const size_t vertex_count = remap.size();
+		adjacency.offsets.assign(vertex_count + 1, 0);
+		adjacency.triangles.resize(index_count);
+
+		for (size_t i = 0; i < index_count; i++)
+		{
+			adjacency.offsets[remap[indices[i]] + 1]++;
+		}
+		for (size_t i = 0; i < vertex_count; i++)
+		{
+			adjacency.offsets[i + 1] += adjacency.offsets[i];
+		}
+
+		std::vector<uint32_t> fill(adjacency.offsets.begin(), adjacency.offsets.end() - 1);
+		for (size_t i = 0; i < index_count; i++)
+		{
+			const uint32_t v = remap[indices[i]];
+			adjacency.triangles[fill[v]++] = (uint32_t)(i / 3);
+		}
+	}
+
+	// Whether the directed edge a -> b appears in any triangle around a
+	bool has_edge(const Adjacency& adjacency, const std::vector<uint32_t>& remap,
+		const std::vector<uint32_t>& indices, uint32_t a, uint32_t b)
+	{
+		for (uint32_t i = adjacency.offsets[a]; i < adjacency.offsets[a + 1]; i++)
+		{
+			const uint32_t* tri = &indices[adjacency.triangles[i] * 3];
+			for (int e = 0; e < 3; e++)
+			{
+				if (remap[tri[e]] == a && remap[tri[(e + 1) % 3]] == b)
+				{
+					return true;
+				}
+			}
+		}
+
+		return false;
+	}
+
+	// Rejects collapses that would turn any surviving triangle around v0 over
+	bool collapse_flips(const Adjacency& adjacency,
+		const std::vector<uint32_t>& remap, const std::vector<uint32_t>& indices,
+		const std::vector<Vertex>& vertices, uint32_t v0, uint32_t v1)
+	{
+		const glm::vec3& target = vertices[v1].position;
+
+		for (uint32_t i = adjacency.offsets[v0]; i < adjacency.offsets[v0 + 1]; i++)
+		{
+			const uint32_t* tri = &indices[adjacency.triangles[i] * 3];
+			const uint32_t r0 = remap[tri[0]];
+			const uint32_t r1 = remap[tri[1]];
+			const uint32_t r2 = remap[tri[2]];
+
+			// Triangles on the collapsed edge disappear anyway
+			if (r0 == v1 || r1 == v1 || r2 == v1)
+			{
+				continue;
+			}
+
+			glm::vec3 p0 = vertices[r0].position;
+			glm::vec3 p1 = vertices[r1].position;
+			glm::vec3 p2 = vertices[r2].position;
+			const glm::vec3 before = glm::cross(p1 - p0, p2 - p0);
+
+			if (r0 == v0)
+			{
+				p0 = target;
+			}
+			if (r1 == v0)
+			{
+				p1 = target;
+			}
+			if (r2 == v0)
+			{
+				p2 = target;
+			}
+			const glm::vec3 after = glm::cross(p1 - p0, p2 - p0);
+
+			if (glm::dot(before, after) <= 0.0f)
+			{
+				return true;
+			}
+		}
+
+		return false;
+	}
+}
+
+size_t simplify_mesh(std::vector<uint32_t>& destination,
+	const std::vector<Vertex>& vertices, const uint32_t* indices,
+	size_t index_count, size_t target_index_count, float target_error,
+	float* result_error)
+{
+	const size_t vertex_count = vertices.size();
+	destination.assign(indices, indices + index_count);
+
+	// Map every vertex to the first vertex sharing its position, so topology
+	// is built across attribute seams
+	std::vector<uint32_t> remap(vertex_count);
+	std::vector<uint32_t> wedge_count(vertex_count, 0);
+	std::unordered_map<glm::vec3, uint32_t, PositionHash, PositionEqual> positions;
+	positions.reserve(vertex_count);
+	for (uint32_t i = 0; i < (uint32_t)vertex_count; i++)
+	{
+		const auto [it, inserted] = positions.emplace(vertices[i].position, i);
+		remap[i] = it->second;
+		wedge_count[it->second]++;
+	}
+
+	Adjacency adjacency;
+	build_adjacency(adjacency, remap, destination, index_count);
+
+	// Classify vertices; anything that isn't manifold stays where it is
+	std::vector<VertexKind> kinds(vertex_count, VertexKind::Manifold);
+	for (size_t i = 0; i < index_count; i++)
+	{
+		const uint32_t a = remap[destination[i]];
+		const uint32_t b = remap[destination[i - i % 3 + (i + 1) % 3]];
+		if (!has_edge(adjacency, remap, destination, b, a))
+		{
+			kinds[a] = VertexKind::Border;
+			kinds[b] = VertexKind::Border;
+		}
+	}
+	for (size_t i = 0; i < vertex_count; i++)
+	{
+		if (wedge_count[i] > 1)
+		{
+			kinds[i] = VertexKind::Seam;
+		}
+	}
+
+	// Accumulate the plane quadrics of all triangles onto their corners
+	std::vector<Quadric> quadrics(vertex_count);
+	for (size_t i = 0; i < index_count; i += 3)
+	{
+		const uint32_t r0 = remap[destination[i + 0]];
+		const uint32_t r1 = remap[destination[i + 1]];
+		const uint32_t r2 = remap[destination[i + 2]];
+		const Quadric q = quadric_from_triangle(vertices[r0].position,
+			vertices[r1].position, vertices[r2].position);
+		quadric_add(quadrics[r0], q);
+		quadric_add(quadrics[r1], q);
+		quadric_add(quadrics[r2], q);
+	}
+
+	const float error_limit = target_error * target_error;
+	float max_error = 0.0f;
+	size_t result_count = index_count;
+
+	std::vector<Collapse> collapses;
+	std::vector<uint32_t> collapse_remap(vertex_count);
+	std::vector<uint8_t> locked(vertex_count);
+
+	while (result_count > target_index_count)
+	{
+		build_adjacency(adjacency, remap, destination, result_count);
+
+		// Gather every edge with at least one movable end, once per edge
+		collapses.clear();
+		for (size_t i = 0; i < result_count; i++)
+		{
+			const uint32_t i0 = destination[i];
+			const uint32_t i1 = destination[i - i % 3 + (i + 1) % 3];
+			const uint32_t r0 = remap[i0];
+			const uint32_t r1 = remap[i1];
+			if (r0 >= r1)
+			{
+				continue;
+			}
+
+			const bool can_move_r0 = kinds[r0] == VertexKind::Manifold;
+			const bool can_move_r1 = kinds[r1] == VertexKind::Manifold;
+			if (!can_move_r0 && !can_move_r1)
+			{
+				continue;
+			}
+
+			Quadric q = quadrics[r0];
+			quadric_add(q, quadrics[r1]);
+			const float error_01 = can_move_r0
+				? quadric_error(q, vertices[r1].position) : INFINITY;
+			const float error_10 = can_move_r1
+				? quadric_error(q, vertices[r0].position) : INFINITY;
+
+			if (error_01 <= error_10)
+			{
+				collapses.push_back({r0, r1, i1, error_01});
+			}
+			else
+			{
+				collapses.push_back({r1, r0, i0, error_10});
+			}
+		}
+
+		std::sort(collapses.begin(), collapses.end(),
+			[](const Collapse& a, const Collapse& b) { return a.error < b.error; });
+
+		for (uint32_t i = 0; i < (uint32_t)vertex_count; i++)
+		{
+			collapse_remap[i] = i;
+		}
+		std::fill(locked.begin(), locked.end(), 0);
+
+		// Every interior collapse removes two triangles
+		const size_t triangles_to_remove = (result_count - target_index_count) / 3;
+		size_t triangles_removed = 0;
+		size_t collapse_count = 0;
+
+		for (const Collapse& collapse : collapses)
+		{
+			if (triangles_removed >= triangles_to_remove || collapse.error > error_limit)
+			{
+				break;
+			}
+			if (locked[collapse.v0] || locked[collapse.v1])
+			{
+				continue;
+			}
+			if (collapse_flips(adjacency, remap, destination, vertices,
+					collapse.v0, collapse.v1))
+			{
+				continue;
+			}
+
+			collapse_remap[collapse.v0] = collapse.target;
+			quadric_add(quadrics[collapse.v1], quadrics[collapse.v0]);
+
+			// Lock the whole one-ring so later collapses in this pass still
+			// see valid adjacency
+			for (uint32_t t = adjacency.offsets[collapse.v0];
+				 t < adjacency.offsets[collapse.v0 + 1]; t++)
+			{
+				const uint32_t* tri = &destination[adjacency.triangles[t] * 3];
+				locked[remap[tri[0]]] = 1;
+				locked[remap[tri[1]]] = 1;
+				locked[remap[tri[2]]] = 1;
+			}
+
+			max_error = std::max(max_error, collapse.error);
+			triangles_removed += 2;
+			collapse_count++;
+		}
+
+		if (collapse_count == 0)
+		{
+			break;
+		}
+
+		// Apply the collapses and drop the triangles that became degenerate
+		size_t write = 0;
+		for (size_t i = 0; i < result_count; i += 3)
+		{
+			const uint32_t a = collapse_remap[destination[i + 0]];
+			const uint32_t b = collapse_remap[destination[i + 1]];
+			const uint32_t c = collapse_remap[destination[i + 2]];
+			if (remap[a] == remap[b] || remap[b] == remap[c] || remap[a] == remap[c])
+			{
+				continue;
+			}
+
+			destination[write + 0] = a;
+			destination[write + 1] = b;
+			destination[write + 2] = c;
+			write += 3;
+		}
+		result_count = write;
+	}
+
+	destination.resize(result_count);
+
+	if (result_error)
+	{
+		*result_error = std::sqrt(max_error);
+	}
+
+	return result_count;
+}
@@ -0,0 +1,21 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "../Renderer/Vertex.h"
+
+// Simplifies a triangle list with quadric error metrics by collapsing edges
+// onto existing vertices, so the vertex buffer can be shared between LODs.
+// Vertices on open borders and on attribute seams (same position, different
+// uv/normal/color) are locked and never move.
+//
+// Writes at most index_count indices to destination and returns how many
+// were written. Stops once target_index_count is reached or the next
+// collapse would exceed target_error (object space distance). The error of
+// the result is written to result_error if it isn't null.
+size_t simplify_mesh(std::vector<uint32_t>& destination,
+	const std::vector<Vertex>& vertices, const uint32_t* indices,
+	size_t index_count, size_t target_index_count, float target_error,
+	float* result_error);
@@ -0,0 +1,21 @@
+#include "Camera.h"
+
+#include <cmath>
+
+#include <glm/ext/matrix_clip_space.hpp>
+#include <glm/ext/matrix_transform.hpp>
+
+glm::mat4 Camera::view() const
+{
+	return glm::lookAt(position, target, glm::vec3(0.0f, 1.0f, 0.0f));
+}
+
+glm::mat4 Camera::projection(float aspect) const
+{
+	return glm::perspective(fov, aspect, near_plane, far_plane);
+}
+
+float Camera::projection_scale(int viewport_height) const
+{
+	return (float)viewport_height / (2.0f * std::tan(fov * 0.5f));
+}
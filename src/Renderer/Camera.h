@@ -0,0 +1,19 @@
+#pragma once
+
+#include <glm/mat4x4.hpp>
+#include <glm/vec3.hpp>
+
+struct Camera
+{
+	glm::vec3 position = glm::vec3(0.0f, 0.0f, 3.0f);
+	glm::vec3 target = glm::vec3(0.0f);
+	float fov = 1.0471976f; // vertical, in radians
+	float near_plane = 0.1f;
+	float far_plane = 1000.0f;
+
+	glm::mat4 view() const;
+	glm::mat4 projection(float aspect) const;
+
+	// Pixels covered by one world unit at distance one, for LOD selection
+	float projection_scale(int viewport_height) const;
+};
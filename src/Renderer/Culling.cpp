@@ -0,0 +1,184 @@
+#include "Culling.h"
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+
+#include <glm/common.hpp>
+#include <glm/geometric.hpp>
+#include <glm/matrix.hpp>
+
+#include "../Model/Model.h"
+#include "../Scene/SceneFile.h"
+
+namespace
+{
+	enum class Containment
+	{
+		Outside,
+		Intersecting,
+		Inside,
+	};
+
+	Containment box_in_frustum(const Frustum& frustum, const glm::vec3& bounds_min,
+		const glm::vec3& bounds_max)
+	{
+		const glm::vec3 center = (bounds_min + bounds_max) * 0.5f;
+		const glm::vec3 extent = (bounds_max - bounds_min) * 0.5f;
+		Containment containment = Containment::Inside;
+		for (const glm::vec4& plane : frustum.planes)
+		{
+			// How far the box reaches along the plane normal either side of
+			// its center
+			const float distance = glm::dot(glm::vec3(plane), center) + plane.w;
+			const float reach = glm::dot(glm::abs(glm::vec3(plane)), extent);
+			if (distance < -reach)
+			{
+				return Containment::Outside;
+			}
+			if (distance < reach)
+			{
+				containment = Containment::Intersecting;
+			}
+		}
+		return containment;
+	}
+}
+
+Frustum extract_frustum(const glm::mat4& view_projection)
+{
+	// Gribb/Hartmann: each plane is the fourth row plus or minus another row
+	const glm::mat4 m = glm::transpose(view_projection);
+
+	Frustum frustum;
+	frustum.planes[0] = m[3] + m[0]; // left
+	frustum.planes[1] = m[3] - m[0]; // right
+	frustum.planes[2] = m[3] + m[1]; // bottom
+	frustum.planes[3] = m[3] - m[1]; // top
+	frustum.planes[4] = m[3] + m[2]; // near
+	frustum.planes[5] = m[3] - m[2]; // far
+
+	for (glm::vec4& plane : frustum.planes)
+	{
+		plane /= glm::length(glm::vec3(plane));
+	}
+
+	return frustum;
+}
+
+bool sphere_in_frustum(const Frustum& frustum, const glm::vec3& center,
+	float radius)
+{
+	for (const glm::vec4& plane : frustum.planes)
+	{
+		if (glm::dot(glm::vec3(plane), center) + plane.w < -radius)
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+float max_axis_scale(const glm::mat4& transform)
+{
+	return std::max({glm::length(glm::vec3(transform[0])),
+		glm::length(glm::vec3(transform[1])), glm::length(glm::vec3(transform[2]))});
+}
+
+void cull_meshlets(const Model& model, const glm::mat4& model_matrix,
+	const Frustum& frustum, const glm::vec3& camera_position,
+	std::vector<DrawRange>& ranges, CullStats& stats)
+{
+	const float scale = max_axis_scale(model_matrix);
+
+	// Do the cone test in model space, which saves transforming every cone
+	const glm::vec3 local_camera = glm::vec3(
+		glm::inverse(model_matrix) * glm::vec4(camera_position, 1.0f));
+
+	for (const Meshlet& meshlet : model.meshlets)
+	{
+		stats.tested++;
+
+		const glm::vec3 center = glm::vec3(model_matrix * glm::vec4(meshlet.center, 1.0f));
+		if (!sphere_in_frustum(frustum, center, meshlet.radius * scale))
+		{
+			stats.frustum_culled++;
+			continue;
+		}
+
+		const glm::vec3 view = meshlet.cone_apex - local_camera;
+		const float view_length = glm::length(view);
+		if (view_length > 0.0f
+			&& glm::dot(view, meshlet.cone_axis) >= meshlet.cone_cutoff * view_length)
+		{
+			stats.cone_culled++;
+			continue;
+		}
+
+		if (!ranges.empty() && ranges.back().submesh == meshlet.submesh
+			&& ranges.back().index_offset + ranges.back().index_count == meshlet.index_offset)
+		{
+			ranges.back().index_count += meshlet.index_count;
+		}
+		else
+		{
+			ranges.push_back({meshlet.index_offset, meshlet.index_count, meshlet.submesh});
+		}
+	}
+}
+
+void cull_scene(const SceneFileHeader& scene, const Frustum& frustum,
+	std::vector<uint32_t>& visible, CullStats& stats)
+{
+	const SceneInstances& instances = scene.instances;
+	const uint32_t node_count = (uint32_t)scene.nodes.count;
+	uint32_t index = 0;
+	while (index < node_count)
+	{
+		const SceneNode& node = scene.nodes[index];
+		const Containment containment = box_in_frustum(frustum, node.bounds_min, node.bounds_max);
+		if (containment == Containment::Outside)
+		{
+			stats.frustum_culled += node.instance_count;
+			index = node.skip;
+			continue;
+		}
+		if (containment == Containment::Inside)
+		{
+			const size_t first = visible.size();
+			visible.resize(first + node.instance_count);
+			std::iota(visible.begin() + (ptrdiff_t)first, visible.end(), node.first_instance);
+			index = node.skip;
+			continue;
+		}
+		if (!node.leaf)
+		{
+			index++;
+			continue;
+		}
+
+		// Straight down the component arrays, without branching per plane
+		const uint32_t end = node.first_instance + node.instance_count;
+		for (uint32_t i = node.first_instance; i < end; i++)
+		{
+			bool inside = true;
+			for (const glm::vec4& plane : frustum.planes)
+			{
+				const float distance = plane.x * instances.center_x[i] + plane.y * instances.center_y[i]
+					+ plane.z * instances.center_z[i] + plane.w;
+				inside &= distance >= -instances.radius[i];
+			}
+			stats.tested++;
+			if (inside)
+			{
+				visible.push_back(i);
+			}
+			else
+			{
+				stats.frustum_culled++;
+			}
+		}
+		index = node.skip;
+	}
+}
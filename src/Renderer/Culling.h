@@ -0,0 +1,57 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+#include <glm/mat4x4.hpp>
+#include <glm/vec3.hpp>
+#include <glm/vec4.hpp>
+
+class Model;
+struct SceneFileHeader;
+
+// The six clip planes of a view frustum, normals pointing inwards
+struct Frustum
+{
+	std::array<glm::vec4, 6> planes;
+};
+
+// A contiguous range of the index buffer to draw
+struct DrawRange
+{
+	uint32_t index_offset = 0;
+	uint32_t index_count = 0;
+	uint32_t submesh = 0;
+};
+
+struct CullStats
+{
+	uint32_t tested = 0;
+	uint32_t frustum_culled = 0;
+	uint32_t cone_culled = 0;
+};
+
+Frustum extract_frustum(const glm::mat4& view_projection);
+
+bool sphere_in_frustum(const Frustum& frustum, const glm::vec3& center,
+	float radius);
+
+// Length of the longest axis of a transform. Bounds scaled by it stay
+// conservative under non-uniform scaling.
+float max_axis_scale(const glm::mat4& transform);
+
+// Tests every meshlet of the model against the frustum and its normal cone
+// and appends the index ranges of the survivors to ranges, merging ranges
+// of the same submesh that end up adjacent so they can go out in as few
+// draws as possible. Ranges come out grouped by submesh.
+void cull_meshlets(const Model& model, const glm::mat4& model_matrix,
+	const Frustum& frustum, const glm::vec3& camera_position,
+	std::vector<DrawRange>& ranges, CullStats& stats);
+
+// Walks the scene's instance hierarchy, skipping subtrees outside the
+// frustum and taking those inside it whole, and appends the indices of the
+// instances that survive to visible. Instances of leaves straddling the
+// frustum are tested one by one against their bounding spheres.
+void cull_scene(const SceneFileHeader& scene, const Frustum& frustum,
+	std::vector<uint32_t>& visible, CullStats& stats);
@@ -0,0 +1,44 @@
+#include "DrawList.h"
+
+#include <algorithm>
+
+uint64_t make_sort_key(uint32_t texture_array, uint32_t vertex_array,
+	uint32_t material, float depth)
+{
+	const uint64_t quantized_depth = (uint64_t)(std::clamp(depth, 0.0f, 1.0f) * 65535.0f);
+	return (uint64_t)(texture_array & 0xffff) << 48 | (uint64_t)(vertex_array & 0xffff) << 32
+		| (uint64_t)(material & 0xffff) << 16 | quantized_depth;
+}
+
+void DrawList::clear(LinearArena& arena)
+{
+	// Room for as many as last time, as storage a vector grows out of
+	// stays taken in the arena until it resets
+	const size_t item_count = items.size();
+	const size_t range_count = ranges.size();
+	items = ArenaVector<DrawItem>(ArenaAllocator<DrawItem>(arena));
+	items.reserve(item_count);
+	ranges = ArenaVector<DrawRange>(ArenaAllocator<DrawRange>(arena));
+	ranges.reserve(range_count);
+}
+
+void DrawList::add(uint64_t key, uint32_t model, uint32_t material,
+	const DrawRange* draw_ranges, uint32_t count)
+{
+	DrawItem item;
+	item.key = key;
+	item.model = model;
+	item.material = material;
+	item.first_range = (uint32_t)ranges.size();
+	item.range_count = count;
+	items.push_back(item);
+	ranges.insert(ranges.end(), draw_ranges, draw_ranges + count);
+}
+
+void DrawList::sort()
+{
+	// Items only point into ranges, so moving them around is cheap
+	std::sort(items.begin(), items.end(), [](const DrawItem& a, const DrawItem& b) {
+		return a.key < b.key;
+	});
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstdint>
+
+#include "Culling.h"
+#include "../Memory/LinearArena.h"
+
+// One draw call: some index ranges of one model, all with one material
+struct DrawItem
+{
+	uint64_t key = 0;
+	uint32_t model = 0; // index into the renderer's models
+	uint32_t material = 0; // id in the MaterialLibrary
+	uint32_t first_range = 0; // into DrawList::ranges
+	uint32_t range_count = 0;
+};
+
+// Orders draws by texture array, then vertex array, then material, so
+// sorted draws change as little state as possible between each other.
+// Depth (0 near, 1 far) breaks ties front to back. Each field keeps its
+// low 16 bits; a collision only costs a redundant state change.
+uint64_t make_sort_key(uint32_t texture_array, uint32_t vertex_array,
+	uint32_t material, float depth);
+
+// The draws of one frame, collected in any order and sorted before
+// submission. They live in a frame arena.
+class DrawList
+{
+public:
+	// Empties the list and moves it to the arena, which has to outlive it
+	// until the next clear
+	void clear(LinearArena& arena);
+	void add(uint64_t key, uint32_t model, uint32_t material,
+		const DrawRange* draw_ranges, uint32_t count);
+	void sort();
+
+	ArenaVector<DrawItem> items;
+	ArenaVector<DrawRange> ranges;
+};
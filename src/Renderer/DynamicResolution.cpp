@@ -0,0 +1,99 @@
+#include "DynamicResolution.h"
+
+#include <algorithm>
+#include <cmath>
+
+void DynamicResolution::configure(const DynamicResolutionSettings& new_settings)
+{
+	settings = new_settings;
+	settings.max_scale = std::clamp(settings.max_scale, RESOLUTION_SCALE_STEP, 2.0f);
+	settings.min_scale = std::clamp(settings.min_scale, RESOLUTION_SCALE_STEP, settings.max_scale);
+	current_scale = quantize(settings.max_scale);
+	smoothed_ms = 0.0;
+	frames_over = 0;
+	frames_under = 0;
+	settle_frames = 0;
+	clear();
+}
+
+float DynamicResolution::update(double gpu_ms)
+{
+	if (settle_frames > 0)
+	{
+		settle_frames--;
+		add_sample(gpu_ms);
+		return current_scale;
+	}
+
+	// A little smoothing so one slow frame doesn't count for several
+	smoothed_ms = smoothed_ms > 0.0 ? smoothed_ms + (gpu_ms - smoothed_ms) * 0.5 : gpu_ms;
+
+	const double target = (double)settings.target_ms;
+	frames_over = smoothed_ms > target * RESOLUTION_HIGH ? frames_over + 1 : 0;
+	frames_under = smoothed_ms < target * RESOLUTION_LOW ? frames_under + 1 : 0;
+
+	float next_scale = current_scale;
+	if (frames_over >= RESOLUTION_DOWN_FRAMES || frames_under >= RESOLUTION_UP_FRAMES)
+	{
+		// Aims for the middle of the band the scale holds in
+		const double ratio = target * (RESOLUTION_HIGH + RESOLUTION_LOW) * 0.5
+			/ std::max(smoothed_ms, 0.01);
+		next_scale = current_scale * (float)std::sqrt(ratio);
+		next_scale = std::min(next_scale, current_scale + RESOLUTION_MAX_GROWTH);
+		next_scale = quantize(std::clamp(next_scale, settings.min_scale, settings.max_scale));
+		frames_over = 0;
+		frames_under = 0;
+	}
+
+	if (next_scale != current_scale)
+	{
+		current_scale = next_scale;
+		change_count++;
+		smoothed_ms = 0.0;
+		settle_frames = RESOLUTION_SETTLE_FRAMES;
+	}
+	add_sample(gpu_ms);
+	return current_scale;
+}
+
+float DynamicResolution::scale() const
+{
+	return current_scale;
+}
+
+std::vector<ResolutionSample> DynamicResolution::history() const
+{
+	std::vector<ResolutionSample> ordered(samples.begin() + (ptrdiff_t)next_sample, samples.end());
+	ordered.insert(ordered.end(), samples.begin(), samples.begin() + (ptrdiff_t)next_sample);
+	return ordered;
+}
+
+uint32_t DynamicResolution::changes() const
+{
+	return change_count;
+}
+
+void DynamicResolution::clear()
+{
+	samples.clear();
+	next_sample = 0;
+	change_count = 0;
+}
+
+void DynamicResolution::add_sample(double gpu_ms)
+{
+	if (samples.size() < RESOLUTION_HISTORY_SIZE)
+	{
+		samples.push_back({gpu_ms, current_scale});
+		return;
+	}
+	samples[next_sample] = {gpu_ms, current_scale};
+	next_sample = (next_sample + 1) % RESOLUTION_HISTORY_SIZE;
+}
+
+float DynamicResolution::quantize(float value) const
+{
+	// Down, so a step never lands above the maximum
+	const float steps = std::floor(value / RESOLUTION_SCALE_STEP + 0.001f);
+	return std::clamp(steps * RESOLUTION_SCALE_STEP, settings.min_scale, settings.max_scale);
+}
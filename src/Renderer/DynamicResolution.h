@@ -0,0 +1,78 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "FrameTimer.h"
+
+// Dynamic resolution: the scene renders at a fraction of the window's size
+// and is stretched up to it, with the fraction picked from how long the GPU
+// took on recent frames. GPU cost goes with the pixel count, so the scale
+// moves with the square root of the time ratio.
+struct DynamicResolutionSettings
+{
+	float target_ms = 16.0f; // GPU time per frame to stay under
+	float min_scale = 0.5f; // of the window's width and height
+	float max_scale = 1.0f;
+};
+
+// Frames are over budget above HIGH of the target and have room to spare
+// below LOW. In between the scale holds, so it doesn't hunt around the
+// target.
+constexpr double RESOLUTION_HIGH = 0.95;
+constexpr double RESOLUTION_LOW = 0.8;
+// Going down has to happen before vsync is missed for long, going up can
+// wait until the room is sure to last
+constexpr uint32_t RESOLUTION_DOWN_FRAMES = 3;
+constexpr uint32_t RESOLUTION_UP_FRAMES = 30;
+// GPU times come back this late, so the frames right after a change were
+// still drawn at the old scale and tell nothing about the new one
+constexpr uint32_t RESOLUTION_SETTLE_FRAMES = FRAME_TIMER_QUERIES;
+// The most the scale grows in one change
+constexpr float RESOLUTION_MAX_GROWTH = 0.1f;
+// Scales are whole steps of this, so the render size stays put across
+// frames with slightly different timings
+constexpr float RESOLUTION_SCALE_STEP = 1.0f / 32.0f;
+// Samples kept for the report; older ones are overwritten
+constexpr size_t RESOLUTION_HISTORY_SIZE = 1024;
+
+struct ResolutionSample
+{
+	double gpu_ms = 0.0; // of the frame the scale was picked from
+	float scale = 1.0f; // picked for the next frames
+};
+
+class DynamicResolution
+{
+public:
+	// Starts back at the largest scale
+	void configure(const DynamicResolutionSettings& new_settings);
+
+	// Takes the GPU time of a frame as it comes back from the timer, which
+	// is a few frames late, and returns the scale to render at from now on
+	float update(double gpu_ms);
+	float scale() const;
+
+	// A sample per update, oldest first, for the last
+	// RESOLUTION_HISTORY_SIZE updates
+	std::vector<ResolutionSample> history() const;
+	uint32_t changes() const; // of the scale
+	void clear();
+
+	DynamicResolutionSettings settings;
+
+private:
+	float quantize(float value) const;
+	void add_sample(double gpu_ms);
+
+	float current_scale = 1.0f;
+	double smoothed_ms = 0.0;
+	uint32_t frames_over = 0;
+	uint32_t frames_under = 0;
+	uint32_t settle_frames = 0;
+	uint32_t change_count = 0;
+	// A ring once full, with next_sample the oldest
+	std::vector<ResolutionSample> samples;
+	size_t next_sample = 0;
+};
@@ -0,0 +1,216 @@
+#include "FrameTimer.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include <GL/glew.h>
+#include <GL/gl.h>
+
+TimingSummary summarize_timings(std::vector<double> samples)
+{
+	TimingSummary summary;
+	if (samples.empty())
+	{
+		return summary;
+	}
+
+	std::sort(samples.begin(), samples.end());
+
+	double sum = 0.0;
+	for (const double sample : samples)
+	{
+		sum += sample;
+	}
+
+	// Nearest rank percentiles
+	const auto percentile = [&samples](double p) {
+		const size_t rank = (size_t)std::ceil(p * (double)samples.size());
+		return samples[std::clamp(rank, (size_t)1, samples.size()) - 1];
+	};
+
+	summary.mean = sum / (double)samples.size();
+	summary.median = percentile(0.5);
+	summary.p99 = percentile(0.99);
+	summary.min = samples.front();
+	summary.max = samples.back();
+	return summary;
+}
+
+void FrameTimer::initialize()
+{
+	glGenQueries(FRAME_TIMER_QUERIES, queries.data());
+	pending.fill(false);
+	next_query = 0;
+}
+
+void FrameTimer::destroy()
+{
+	glDeleteQueries(FRAME_TIMER_QUERIES, queries.data());
+	queries.fill(0);
+	pending.fill(false);
+	cpu_samples.clear();
+	gpu_samples.clear();
+}
+
+void FrameTimer::begin_frame()
+{
+	frame_start = std::chrono::steady_clock::now();
+
+	// The slot's previous query is FRAME_TIMER_QUERIES frames old by now,
+	// so this normally doesn't wait
+	if (pending[next_query])
+	{
+		collect(next_query);
+	}
+	glBeginQuery(GL_TIME_ELAPSED, queries[next_query]);
+}
+
+void FrameTimer::end_frame()
+{
+	glEndQuery(GL_TIME_ELAPSED);
+	pending[next_query] = true;
+	next_query = (next_query + 1) % FRAME_TIMER_QUERIES;
+
+	cpu_samples.push_back(std::chrono::duration<double, std::milli>(
+		std::chrono::steady_clock::now() - frame_start).count());
+}
+
+void FrameTimer::collect(uint32_t slot)
+{
+	GLuint64 nanoseconds = 0;
+	glGetQueryObjectui64v(queries[slot], GL_QUERY_RESULT, &nanoseconds);
+	gpu_samples.push_back((double)nanoseconds / 1.0e6);
+	pending[slot] = false;
+	gpu_time_taken = false;
+}
+
+void FrameTimer::finish()
+{
+	// Oldest first, so samples stay in frame order
+	for (uint32_t i = 0; i < FRAME_TIMER_QUERIES; i++)
+	{
+		const uint32_t slot = (next_query + i) % FRAME_TIMER_QUERIES;
+		if (pending[slot])
+		{
+			collect(slot);
+		}
+	}
+}
+
+void FrameTimer::clear()
+{
+	// Queries in flight belong to the frames being thrown away
+	finish();
+	cpu_samples.clear();
+	gpu_samples.clear();
+}
+
+bool FrameTimer::take_gpu_time(double& milliseconds)
+{
+	if (gpu_time_taken || gpu_samples.empty())
+	{
+		return false;
+	}
+	milliseconds = gpu_samples.back();
+	gpu_time_taken = true;
+	return true;
+}
+
+const std::vector<double>& FrameTimer::cpu_times() const
+{
+	return cpu_samples;
+}
+
+const std::vector<double>& FrameTimer::gpu_times() const
+{
+	return gpu_samples;
+}
+
+void PassTimer::destroy()
+{
+	for (Pass& pass : passes)
+	{
+		for (std::array<uint32_t, 2>& pair : pass.queries)
+		{
+			glDeleteQueries(2, pair.data());
+		}
+	}
+	passes.clear();
+	pass_timings.clear();
+}
+
+void PassTimer::begin(const std::string& name)
+{
+	current = 0;
+	while (current < pass_timings.size() && pass_timings[current].name != name)
+	{
+		current++;
+	}
+	if (current == passes.size())
+	{
+		Pass& pass = passes.emplace_back();
+		for (std::array<uint32_t, 2>& pair : pass.queries)
+		{
+			glGenQueries(2, pair.data());
+		}
+		pass_timings.push_back({name, 0.0, 0});
+	}
+
+	// FRAME_TIMER_QUERIES frames old, so normally done
+	if (passes[current].pending[slot])
+	{
+		collect(current, slot);
+	}
+	glQueryCounter(passes[current].queries[slot][0], GL_TIMESTAMP);
+}
+
+void PassTimer::end()
+{
+	glQueryCounter(passes[current].queries[slot][1], GL_TIMESTAMP);
+	passes[current].pending[slot] = true;
+}
+
+void PassTimer::end_frame()
+{
+	slot = (slot + 1) % FRAME_TIMER_QUERIES;
+}
+
+void PassTimer::collect(size_t pass, uint32_t query_slot)
+{
+	GLuint64 start = 0;
+	GLuint64 end = 0;
+	glGetQueryObjectui64v(passes[pass].queries[query_slot][0], GL_QUERY_RESULT, &start);
+	glGetQueryObjectui64v(passes[pass].queries[query_slot][1], GL_QUERY_RESULT, &end);
+	pass_timings[pass].total_ms += (double)(end - start) / 1.0e6;
+	pass_timings[pass].samples++;
+	passes[pass].pending[query_slot] = false;
+}
+
+void PassTimer::finish()
+{
+	for (size_t i = 0; i < passes.size(); i++)
+	{
+		for (uint32_t j = 0; j < FRAME_TIMER_QUERIES; j++)
+		{
+			if (passes[i].pending[j])
+			{
+				collect(i, j);
+			}
+		}
+	}
+}
+
+void PassTimer::clear()
+{
+	finish();
+	for (Timing& timing : pass_timings)
+	{
+		timing.total_ms = 0.0;
+		timing.samples = 0;
+	}
+}
+
+const std::vector<PassTimer::Timing>& PassTimer::timings() const
+{
+	return pass_timings;
+}
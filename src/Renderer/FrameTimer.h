@@ -0,0 +1,102 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// GPU timer queries in flight; results are read this many frames late so
+// reading them never stalls
+constexpr int FRAME_TIMER_QUERIES = 4;
+
+struct TimingSummary
+{
+	double mean = 0.0;
+	double median = 0.0;
+	double p99 = 0.0;
+	double min = 0.0;
+	double max = 0.0;
+};
+
+TimingSummary summarize_timings(std::vector<double> samples);
+
+// Records CPU and GPU time for every frame, in milliseconds. GPU time
+// comes from GL_TIME_ELAPSED queries around the frame's commands.
+class FrameTimer
+{
+public:
+	void initialize();
+	void destroy();
+
+	void begin_frame();
+	void end_frame();
+
+	// Waits for the queries still in flight so every frame has a GPU time
+	void finish();
+	// Drops every sample so far, e.g. after warming up
+	void clear();
+
+	// The GPU time of the newest frame read back since the last call, if
+	// one was
+	bool take_gpu_time(double& milliseconds);
+
+	const std::vector<double>& cpu_times() const;
+	const std::vector<double>& gpu_times() const;
+
+private:
+	// Reads the slot's query back, waiting for it if needed
+	void collect(uint32_t slot);
+
+	std::array<uint32_t, FRAME_TIMER_QUERIES> queries{};
+	std::array<bool, FRAME_TIMER_QUERIES> pending{};
+	uint32_t next_query = 0;
+	bool gpu_time_taken = true;
+	std::chrono::steady_clock::time_point frame_start;
+
+	std::vector<double> cpu_samples;
+	std::vector<double> gpu_samples;
+};
+
+// GPU time of named passes within frames, from timestamps on either side
+// of each. GL_TIME_ELAPSED queries can't nest, and the frame timer has one
+// running around the whole frame.
+class PassTimer
+{
+public:
+	struct Timing
+	{
+		std::string name;
+		double total_ms = 0.0;
+		uint32_t samples = 0;
+	};
+
+	void destroy();
+
+	// Around each pass. A pass that runs more than once in a frame only
+	// keeps the last.
+	void begin(const std::string& name);
+	void end();
+	// Moves on to the next frame's queries
+	void end_frame();
+
+	// Waits for the queries still in flight
+	void finish();
+	void clear();
+	const std::vector<Timing>& timings() const;
+
+private:
+	struct Pass
+	{
+		std::array<std::array<uint32_t, 2>, FRAME_TIMER_QUERIES> queries{};
+		std::array<bool, FRAME_TIMER_QUERIES> pending{};
+	};
+
+	void collect(size_t pass, uint32_t slot);
+
+	// Parallel to the timings
+	std::vector<Pass> passes;
+	std::vector<Timing> pass_timings;
+	size_t current = 0;
+	uint32_t slot = 0;
+};
@@ -0,0 +1,494 @@
+#include "GpuCulling.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cstring>
+#include <iostream>
+
+#include <GL/glew.h>
+#include <GL/gl.h>
+
+#include "../Resources/GpuMemory.h"
+#include "../Scene/SceneFile.h"
+#include "../Capture/CapturedGL.h"
+
+namespace
+{
+	// Buffer bindings shared with the shaders
+	constexpr GLuint PARAMS_BINDING = 0;
+	constexpr GLuint INSTANCE_DATA_BINDING = 0;
+	constexpr GLuint MESH_BINDING = 1;
+	constexpr GLuint COMMAND_BINDING = 2;
+	constexpr GLuint VISIBLE_BINDING = 3;
+	constexpr GLuint COUNTER_BINDING = 4;
+	constexpr GLuint MATERIAL_BINDING = 5;
+
+	constexpr GLuint CULL_GROUP_SIZE = 64;
+	constexpr GLuint HIZ_GROUP_SIZE = 8;
+	// The smallest maximum group count GL allows in each dimension
+	constexpr GLuint MAX_GROUPS_X = 65535;
+
+	// The scene wide counters ahead of the per mesh ones
+	constexpr size_t COUNTER_WORDS = 4;
+	// What each visible instance takes in the visible buffer: position and
+	// scale, then the rotation
+	constexpr size_t VISIBLE_INSTANCE_BYTES = sizeof(float) * 8;
+
+	bool has_extension(const char* name)
+	{
+		GLint count = 0;
+		glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+		for (GLint i = 0; i < count; i++)
+		{
+			const GLubyte* extension = glGetStringi(GL_EXTENSIONS, (GLuint)i);
+			if (extension && std::strcmp(reinterpret_cast<const char*>(extension), name) == 0)
+			{
+				return true;
+			}
+		}
+		return false;
+	}
+
+	GLuint group_count(int size, GLuint group_size)
+	{
+		return ((GLuint)size + group_size - 1) / group_size;
+	}
+
+	// Makes a buffer of the given size, or grows one that's too small. Its
+	// contents are lost either way.
+	void reserve_buffer(uint32_t& buffer, GLenum target, size_t bytes, GLenum usage,
+		GpuMemoryCategory category, const char* owner)
+	{
+		if (!buffer)
+		{
+			glGenBuffers(1, &buffer);
+		}
+		glBindBuffer(target, buffer);
+		glBufferData(target, (GLsizeiptr)bytes, nullptr, usage);
+		gpu_memory().allocate(GpuObject::Buffer, buffer, category, owner, bytes);
+	}
+
+	void delete_buffer(uint32_t& buffer)
+	{
+		gpu_memory().release(GpuObject::Buffer, buffer);
+		glDeleteBuffers(1, &buffer);
+		buffer = 0;
+	}
+}
+
+bool GpuCulling::initialize()
+{
+	GLint major = 0;
+	GLint minor = 0;
+	glGetIntegerv(GL_MAJOR_VERSION, &major);
+	glGetIntegerv(GL_MINOR_VERSION, &minor);
+	if (major * 10 + minor < 45 || !has_extension("GL_ARB_shader_draw_parameters"))
+	{
+		std::cerr << "GPU culling needs OpenGL 4.5 and ARB_shader_draw_parameters, this is "
+				  << major << "." << minor << "\n";
+		return false;
+	}
+
+	cull_shader = Shader("./shaders/cull_instances.glsl");
+	hiz_copy_shader = Shader("./shaders/hiz_copy.glsl");
+	hiz_reduce_shader = Shader("./shaders/hiz_reduce.glsl");
+	if (!cull_shader.program || !hiz_copy_shader.program || !hiz_reduce_shader.program)
+	{
+		destroy();
+		return false;
+	}
+
+	reserve_buffer(params_buffer, GL_UNIFORM_BUFFER, sizeof(CullParams), GL_STREAM_DRAW,
+		GpuMemoryCategory::Uniform, "GPU culling");
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+	initialized = true;
+	return true;
+}
+
+void GpuCulling::destroy()
+{
+	for (uint32_t slot = 0; slot < GPU_CULL_READBACKS; slot++)
+	{
+		if (readback_fences[slot])
+		{
+			glDeleteSync(static_cast<GLsync>(readback_fences[slot]));
+			readback_fences[slot] = nullptr;
+		}
+		delete_buffer(readback_buffers[slot]);
+	}
+	delete_buffer(params_buffer);
+	delete_buffer(instance_data_buffer);
+	delete_buffer(mesh_buffer);
+	delete_buffer(command_buffer);
+	delete_buffer(material_buffer);
+	delete_buffer(visible_buffer);
+	delete_buffer(counter_buffer);
+	destroy_hiz();
+
+	cull_shader.destroy();
+	hiz_copy_shader.destroy();
+	hiz_reduce_shader.destroy();
+	cull_shader = Shader();
+	hiz_copy_shader = Shader();
+	hiz_reduce_shader = Shader();
+	initialized = false;
+}
+
+bool GpuCulling::is_initialized() const
+{
+	return initialized;
+}
+
+void GpuCulling::load_scene(const SceneFileHeader& scene)
+{
+	const SceneInstances& instances = scene.instances;
+	instance_count = (uint32_t)scene.instance_count;
+	mesh_count = (uint32_t)scene.meshes.count;
+
+	// Uploaded from the first array to the end of the last, gaps and all,
+	// with the shader told where each one starts
+	const SceneArray<float>* floats[] = {&instances.position_x, &instances.position_y,
+		&instances.position_z, &instances.rotation_x, &instances.rotation_y,
+		&instances.rotation_z, &instances.rotation_w, &instances.scale, &instances.center_x,
+		&instances.center_y, &instances.center_z, &instances.radius};
+	const uint8_t* begin = reinterpret_cast<const uint8_t*>(instances.mesh.begin());
+	const uint8_t* end = reinterpret_cast<const uint8_t*>(instances.mesh.end());
+	for (const SceneArray<float>* array : floats)
+	{
+		begin = std::min(begin, reinterpret_cast<const uint8_t*>(array->begin()));
+		end = std::max(end, reinterpret_cast<const uint8_t*>(array->end()));
+	}
+	const auto word = [begin](const void* data) {
+		return (uint32_t)((size_t)(reinterpret_cast<const uint8_t*>(data) - begin) / sizeof(uint32_t));
+	};
+	components[0] = glm::uvec4(word(instances.mesh.begin()), word(instances.position_x.begin()),
+		word(instances.position_y.begin()), word(instances.position_z.begin()));
+	components[1] = glm::uvec4(word(instances.rotation_x.begin()),
+		word(instances.rotation_y.begin()), word(instances.rotation_z.begin()),
+		word(instances.rotation_w.begin()));
+	components[2] = glm::uvec4(word(instances.scale.begin()), word(instances.center_x.begin()),
+		word(instances.center_y.begin()), word(instances.center_z.begin()));
+	components[3] = glm::uvec4(word(instances.radius.begin()), 0, 0, 0);
+
+	const size_t instance_bytes = std::max((size_t)(end - begin), sizeof(uint32_t));
+	reserve_buffer(instance_data_buffer, GL_SHADER_STORAGE_BUFFER, instance_bytes,
+		GL_STATIC_DRAW, GpuMemoryCategory::Vertex, "GPU culling instances");
+	if (end > begin)
+	{
+		glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, end - begin, begin);
+	}
+
+	// Each mesh gets room in the visible buffer for all of its instances
+	mesh_first_instance.assign(mesh_count, 0);
+	for (const uint32_t mesh : instances.mesh)
+	{
+		mesh_first_instance[mesh]++;
+	}
+	uint32_t total = 0;
+	for (uint32_t& first : mesh_first_instance)
+	{
+		const uint32_t count = first;
+		first = total;
+		total += count;
+	}
+	reserve_buffer(visible_buffer, GL_SHADER_STORAGE_BUFFER,
+		std::max<size_t>(instance_count, 1) * VISIBLE_INSTANCE_BYTES, GL_STREAM_COPY,
+		GpuMemoryCategory::Vertex, "GPU culling visible instances");
+	reserve_buffer(mesh_buffer, GL_SHADER_STORAGE_BUFFER,
+		std::max<size_t>(mesh_count, 1) * sizeof(MeshDraws), GL_STREAM_DRAW,
+		GpuMemoryCategory::Uniform, "GPU culling");
+
+	// Nearest distances start at the farthest there is, for atomicMin
+	counter_reset.assign(COUNTER_WORDS + mesh_count * 2, 0);
+	uint32_t farthest = 0;
+	const float far_distance = FLT_MAX;
+	std::memcpy(&farthest, &far_distance, sizeof(farthest));
+	for (size_t i = 0; i < mesh_count; i++)
+	{
+		counter_reset[COUNTER_WORDS + i * 2 + 1] = farthest;
+	}
+	const size_t counter_bytes = counter_reset.size() * sizeof(uint32_t);
+	reserve_buffer(counter_buffer, GL_SHADER_STORAGE_BUFFER, counter_bytes, GL_STREAM_COPY,
+		GpuMemoryCategory::Uniform, "GPU culling");
+	for (uint32_t slot = 0; slot < GPU_CULL_READBACKS; slot++)
+	{
+		reserve_buffer(readback_buffers[slot], GL_COPY_WRITE_BUFFER, counter_bytes,
+			GL_STREAM_READ, GpuMemoryCategory::Staging, "GPU culling readback");
+	}
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+	readback_data.assign(counter_reset.size(), 0);
+	latest_counters = GpuCullCounters();
+	latest_mesh_stats.assign(mesh_count, GpuCullMeshStats());
+	meshes.assign(mesh_count, MeshDraws());
+}
+
+void GpuCulling::begin_frame()
+{
+	// Oldest first, stopping at the first the GPU hasn't got to, so the
+	// latest counters are always the newest that came back
+	for (uint32_t i = 0; i < GPU_CULL_READBACKS; i++)
+	{
+		const uint32_t slot = (next_readback + i) % GPU_CULL_READBACKS;
+		if (readback_fences[slot] && !collect(slot, false))
+		{
+			break;
+		}
+	}
+
+	commands.clear();
+	materials.clear();
+	for (uint32_t i = 0; i < mesh_count; i++)
+	{
+		meshes[i] = MeshDraws();
+		meshes[i].first_instance = mesh_first_instance[i];
+	}
+}
+
+void GpuCulling::add_draw(uint32_t mesh, uint32_t index_count, uint32_t first_index,
+	int32_t base_vertex, uint32_t material)
+{
+	MeshDraws& draws = meshes[mesh];
+	if (draws.command_count == 0)
+	{
+		draws.first_command = (uint32_t)commands.size();
+	}
+	draws.command_count++;
+
+	DrawCommand command;
+	command.count = index_count;
+	command.first_index = first_index;
+	command.base_vertex = base_vertex;
+	command.base_instance = draws.first_instance;
+	commands.push_back(command);
+	materials.push_back(material);
+}
+
+void GpuCulling::cull(const Frustum& frustum, const glm::vec3& camera_position)
+{
+	// Always at least one, as empty buffers can't be bound
+	if (commands.size() > command_capacity || command_buffer == 0)
+	{
+		command_capacity = std::max({commands.size(), command_capacity * 2, (size_t)64});
+		reserve_buffer(command_buffer, GL_DRAW_INDIRECT_BUFFER,
+			command_capacity * sizeof(DrawCommand), GL_STREAM_DRAW, GpuMemoryCategory::Uniform,
+			"GPU culling draws");
+		reserve_buffer(material_buffer, GL_SHADER_STORAGE_BUFFER,
+			command_capacity * sizeof(uint32_t), GL_STREAM_DRAW, GpuMemoryCategory::Uniform,
+			"GPU culling draws");
+	}
+	if (!commands.empty())
+	{
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, command_buffer);
+		glBufferSubData(GL_DRAW_INDIRECT_BUFFER, 0,
+			(GLsizeiptr)(commands.size() * sizeof(DrawCommand)), commands.data());
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, material_buffer);
+		glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0,
+			(GLsizeiptr)(materials.size() * sizeof(uint32_t)), materials.data());
+	}
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, mesh_buffer);
+	glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, (GLsizeiptr)(meshes.size() * sizeof(MeshDraws)),
+		meshes.data());
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, counter_buffer);
+	glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0,
+		(GLsizeiptr)(counter_reset.size() * sizeof(uint32_t)), counter_reset.data());
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+	CullParams params;
+	params.frustum_planes = frustum.planes;
+	params.previous_view_projection = hiz_view_projection;
+	params.camera_position = glm::vec4(camera_position, 1.0f);
+	params.hiz_size = glm::vec2((float)hiz_width, (float)hiz_height);
+	params.instance_count = instance_count;
+	params.hiz_levels = hiz_ready ? (uint32_t)hiz_levels : 0;
+	params.components = components;
+	glBindBuffer(GL_UNIFORM_BUFFER, params_buffer);
+	glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(CullParams), &params);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+	glUseProgram(cull_shader.program);
+	glBindBufferBase(GL_UNIFORM_BUFFER, PARAMS_BINDING, params_buffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, INSTANCE_DATA_BINDING, instance_data_buffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, MESH_BINDING, mesh_buffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, COMMAND_BINDING, command_buffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, VISIBLE_BINDING, visible_buffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, COUNTER_BINDING, counter_buffer);
+	if (hiz_ready)
+	{
+		glActiveTexture(GL_TEXTURE0 + GPU_CULL_TEXTURE_UNIT);
+		glBindTexture(GL_TEXTURE_2D, hiz_texture);
+		glActiveTexture(GL_TEXTURE0);
+	}
+
+	// Past the limit on groups in x, the rest go in rows
+	const GLuint groups = std::max(group_count((int)instance_count, CULL_GROUP_SIZE), 1u);
+	const GLuint groups_x = std::min(groups, MAX_GROUPS_X);
+	glDispatchCompute(groups_x, (groups + groups_x - 1) / groups_x, 1);
+	glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT
+		| GL_BUFFER_UPDATE_BARRIER_BIT);
+	glUseProgram(0);
+
+	// The slot is GPU_CULL_READBACKS frames old, so it's normally long done
+	const uint32_t slot = next_readback;
+	if (readback_fences[slot])
+	{
+		collect(slot, true);
+	}
+	glBindBuffer(GL_COPY_READ_BUFFER, counter_buffer);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, readback_buffers[slot]);
+	glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0,
+		(GLsizeiptr)(counter_reset.size() * sizeof(uint32_t)));
+	glBindBuffer(GL_COPY_READ_BUFFER, 0);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+	readback_fences[slot] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	next_readback = (slot + 1) % GPU_CULL_READBACKS;
+}
+
+void GpuCulling::draw(uint32_t first, uint32_t count) const
+{
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, command_buffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, MATERIAL_BINDING, material_buffer);
+	glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT,
+		reinterpret_cast<const void*>((uintptr_t)first * sizeof(DrawCommand)), (GLsizei)count, 0);
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+}
+
+void GpuCulling::build_hiz(uint32_t framebuffer, int width, int height, uint32_t depth_format,
+	const glm::mat4& view_projection)
+{
+	if (width != hiz_width || height != hiz_height || depth_format != hiz_depth_format)
+	{
+		create_hiz(width, height, depth_format);
+	}
+
+	// Blits only copy between matching formats, which is why the copy
+	// has the frame's own depth format and goes through a shader from there
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer);
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, depth_framebuffer);
+	glBlitFramebuffer(0, 0, width, height, 0, 0, width, height, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+	glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+
+	glUseProgram(hiz_copy_shader.program);
+	glActiveTexture(GL_TEXTURE0 + GPU_CULL_TEXTURE_UNIT);
+	glBindTexture(GL_TEXTURE_2D, depth_texture);
+	glActiveTexture(GL_TEXTURE0);
+	glBindImageTexture(0, hiz_texture, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
+	glDispatchCompute(group_count(width, HIZ_GROUP_SIZE), group_count(height, HIZ_GROUP_SIZE), 1);
+
+	glUseProgram(hiz_reduce_shader.program);
+	for (int level = 1; level < hiz_levels; level++)
+	{
+		glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+		glBindImageTexture(0, hiz_texture, level - 1, GL_FALSE, 0, GL_READ_ONLY, GL_R32F);
+		glBindImageTexture(1, hiz_texture, level, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
+		glDispatchCompute(group_count(std::max(width >> level, 1), HIZ_GROUP_SIZE),
+			group_count(std::max(height >> level, 1), HIZ_GROUP_SIZE), 1);
+	}
+	glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+	glUseProgram(0);
+
+	hiz_view_projection = view_projection;
+	hiz_ready = true;
+}
+
+void GpuCulling::create_hiz(int width, int height, uint32_t depth_format)
+{
+	destroy_hiz();
+	hiz_width = width;
+	hiz_height = height;
+	hiz_depth_format = depth_format;
+	hiz_levels = 1;
+	while ((std::max(width, height) >> hiz_levels) > 0)
+	{
+		hiz_levels++;
+	}
+
+	glActiveTexture(GL_TEXTURE0 + GPU_CULL_TEXTURE_UNIT);
+	glGenTextures(1, &depth_texture);
+	glBindTexture(GL_TEXTURE_2D, depth_texture);
+	glTexStorage2D(GL_TEXTURE_2D, 1, depth_format, width, height);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	gpu_memory().allocate(GpuObject::Texture, depth_texture, GpuMemoryCategory::RenderTarget,
+		"GPU culling", texture_bytes((uint32_t)width, (uint32_t)height, 1, 4, false));
+
+	glGenTextures(1, &hiz_texture);
+	glBindTexture(GL_TEXTURE_2D, hiz_texture);
+	glTexStorage2D(GL_TEXTURE_2D, hiz_levels, GL_R32F, width, height);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	gpu_memory().allocate(GpuObject::Texture, hiz_texture, GpuMemoryCategory::RenderTarget,
+		"GPU culling", texture_bytes((uint32_t)width, (uint32_t)height, 1, 4, true));
+	glBindTexture(GL_TEXTURE_2D, 0);
+	glActiveTexture(GL_TEXTURE0);
+
+	glGenFramebuffers(1, &depth_framebuffer);
+	glBindFramebuffer(GL_FRAMEBUFFER, depth_framebuffer);
+	glFramebufferTexture2D(GL_FRAMEBUFFER,
+		depth_format == GL_DEPTH24_STENCIL8 ? GL_DEPTH_STENCIL_ATTACHMENT : GL_DEPTH_ATTACHMENT,
+		GL_TEXTURE_2D, depth_texture, 0);
+}
+
+void GpuCulling::destroy_hiz()
+{
+	glDeleteFramebuffers(1, &depth_framebuffer);
+	gpu_memory().release(GpuObject::Texture, depth_texture);
+	gpu_memory().release(GpuObject::Texture, hiz_texture);
+	glDeleteTextures(1, &depth_texture);
+	glDeleteTextures(1, &hiz_texture);
+	depth_framebuffer = 0;
+	depth_texture = 0;
+	hiz_texture = 0;
+	hiz_width = 0;
+	hiz_height = 0;
+	hiz_depth_format = 0;
+	hiz_ready = false;
+}
+
+bool GpuCulling::collect(uint32_t slot, bool wait)
+{
+	GLsync fence = static_cast<GLsync>(readback_fences[slot]);
+	const GLenum status = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT,
+		wait ? UINT64_MAX : 0);
+	if (status == GL_TIMEOUT_EXPIRED)
+	{
+		return false;
+	}
+	glDeleteSync(fence);
+	readback_fences[slot] = nullptr;
+
+	glGetNamedBufferSubData(readback_buffers[slot], 0,
+		(GLsizeiptr)(readback_data.size() * sizeof(uint32_t)), readback_data.data());
+	latest_counters.visible = readback_data[0];
+	latest_counters.frustum_culled = readback_data[1];
+	latest_counters.occlusion_culled = readback_data[2];
+	latest_counters.drawn = readback_data[3];
+	for (size_t i = 0; i < latest_mesh_stats.size(); i++)
+	{
+		latest_mesh_stats[i].visible = readback_data[COUNTER_WORDS + i * 2];
+		std::memcpy(&latest_mesh_stats[i].nearest, &readback_data[COUNTER_WORDS + i * 2 + 1],
+			sizeof(float));
+	}
+	return true;
+}
+
+const std::vector<uint32_t>& GpuCulling::draw_materials() const
+{
+	return materials;
+}
+
+uint32_t GpuCulling::instance_buffer() const
+{
+	return visible_buffer;
+}
+
+const GpuCullCounters& GpuCulling::counters() const
+{
+	return latest_counters;
+}
+
+const std::vector<GpuCullMeshStats>& GpuCulling::mesh_stats() const
+{
+	return latest_mesh_stats;
+}
@@ -0,0 +1,162 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+#include <glm/mat4x4.hpp>
+#include <glm/vec2.hpp>
+#include <glm/vec3.hpp>
+#include <glm/vec4.hpp>
+
+#include "Culling.h"
+#include "../Shader/Shader.h"
+
+struct SceneFileHeader;
+
+// Readbacks of the culling counters in flight; they're read this many
+// frames late so reading them never stalls
+constexpr int GPU_CULL_READBACKS = 4;
+// Where the depth copy and the pyramid are sampled, clear of the units the
+// renderer binds materials on
+constexpr uint32_t GPU_CULL_TEXTURE_UNIT = 15;
+
+// What the culling shader counted over the whole scene
+struct GpuCullCounters
+{
+	uint32_t visible = 0;
+	uint32_t frustum_culled = 0;
+	uint32_t occlusion_culled = 0;
+	uint32_t drawn = 0; // visible, and of a resident mesh
+};
+
+// What the culling shader saw of one mesh, for streaming and LOD selection
+struct GpuCullMeshStats
+{
+	uint32_t visible = 0;
+	float nearest = 0.0f; // model space distance of the closest visible instance
+};
+
+// Culls the instances of a scene file on the GPU. A compute shader tests
+// each instance against the frustum and against a Hi-Z pyramid of last
+// frame's depth, and appends the survivors to the indirect draws of their
+// mesh. The CPU does nothing per instance: it adds a draw per submesh of
+// every resident mesh, dispatches, and draws them all in one call. Counters
+// come back a few frames late, without waiting on the GPU.
+//
+// Needs GL 4.5 and ARB_shader_draw_parameters, for the draw's material.
+class GpuCulling
+{
+public:
+	// Compiles the shaders. False when the context can't run them.
+	bool initialize();
+	void destroy();
+	bool is_initialized() const;
+
+	// Uploads the scene's instance arrays as they are in the file
+	void load_scene(const SceneFileHeader& scene);
+
+	// Clears the draws and picks up whatever counters have come back
+	void begin_frame();
+	// Adds a draw of one submesh for every visible instance of the mesh. The
+	// draws of a mesh go in one after the other.
+	void add_draw(uint32_t mesh, uint32_t index_count, uint32_t first_index, int32_t base_vertex,
+		uint32_t material);
+	// Uploads the draws, culls the instances into them and starts reading
+	// the counters back
+	void cull(const Frustum& frustum, const glm::vec3& camera_position);
+	// Issues count of the frame's draws from first in one call, with the
+	// draw materials bound for the indirect model shader
+	void draw(uint32_t first, uint32_t count) const;
+	// Copies the depth of the finished frame out of framebuffer and builds
+	// the pyramid the next frame culls against
+	void build_hiz(uint32_t framebuffer, int width, int height, uint32_t depth_format,
+		const glm::mat4& view_projection);
+
+	// This frame's draws, by material
+	const std::vector<uint32_t>& draw_materials() const;
+	// Visible instance transforms, as the model shader reads them
+	uint32_t instance_buffer() const;
+	// The latest that came back
+	const GpuCullCounters& counters() const;
+	const std::vector<GpuCullMeshStats>& mesh_stats() const;
+
+private:
+	// Laid out as glMultiDrawElementsIndirect reads it
+	struct DrawCommand
+	{
+		uint32_t count = 0;
+		uint32_t instance_count = 0;
+		uint32_t first_index = 0;
+		int32_t base_vertex = 0;
+		uint32_t base_instance = 0;
+	};
+
+	struct MeshDraws
+	{
+		uint32_t first_command = 0;
+		uint32_t command_count = 0;
+		uint32_t first_instance = 0; // of its slice of the visible instances
+		uint32_t padding = 0;
+	};
+
+	// The shader's std140 CullParams block
+	struct CullParams
+	{
+		std::array<glm::vec4, 6> frustum_planes{};
+		glm::mat4 previous_view_projection = glm::mat4(1.0f);
+		glm::vec4 camera_position = glm::vec4(0.0f);
+		glm::vec2 hiz_size = glm::vec2(0.0f);
+		uint32_t instance_count = 0;
+		uint32_t hiz_levels = 0;
+		std::array<glm::uvec4, 4> components{};
+	};
+
+	void create_hiz(int width, int height, uint32_t depth_format);
+	void destroy_hiz();
+	// Reads the slot's counters back. Unless wait is set, gives up when the
+	// GPU isn't done with them yet.
+	bool collect(uint32_t slot, bool wait);
+
+	Shader cull_shader;
+	Shader hiz_copy_shader;
+	Shader hiz_reduce_shader;
+	bool initialized = false;
+
+	uint32_t instance_count = 0;
+	uint32_t mesh_count = 0;
+	std::array<glm::uvec4, 4> components{};
+	std::vector<uint32_t> mesh_first_instance;
+
+	std::vector<MeshDraws> meshes;
+	std::vector<DrawCommand> commands;
+	std::vector<uint32_t> materials;
+	size_t command_capacity = 0;
+
+	uint32_t params_buffer = 0;
+	uint32_t instance_data_buffer = 0; // the file's arrays
+	uint32_t mesh_buffer = 0;
+	uint32_t command_buffer = 0;
+	uint32_t material_buffer = 0;
+	uint32_t visible_buffer = 0;
+	uint32_t counter_buffer = 0;
+	// Counters as they start every frame
+	std::vector<uint32_t> counter_reset;
+
+	std::array<uint32_t, GPU_CULL_READBACKS> readback_buffers{};
+	std::array<void*, GPU_CULL_READBACKS> readback_fences{}; // GLsync
+	uint32_t next_readback = 0;
+	std::vector<uint32_t> readback_data;
+	GpuCullCounters latest_counters;
+	std::vector<GpuCullMeshStats> latest_mesh_stats;
+
+	uint32_t depth_texture = 0; // the frame's depth, copied
+	uint32_t depth_framebuffer = 0;
+	uint32_t hiz_texture = 0;
+	int hiz_width = 0;
+	int hiz_height = 0;
+	int hiz_levels = 0;
+	uint32_t hiz_depth_format = 0;
+	bool hiz_ready = false;
+	glm::mat4 hiz_view_projection = glm::mat4(1.0f);
+};
@@ -0,0 +1,157 @@
+#include "HeadlessContext.h"
+
+#include <cstring>
+#include <iostream>
+
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+
+namespace
+{
+	bool has_extension(const char* extensions, const char* name)
+	{
+		if (!extensions)
+		{
+			return false;
+		}
+
+		const size_t length = std::strlen(name);
+		for (const char* found = std::strstr(extensions, name); found;
+			found = std::strstr(found + length, name))
+		{
+			const bool starts = found == extensions || found[-1] == ' ';
+			const bool ends = found[length] == ' ' || found[length] == '\0';
+			if (starts && ends)
+			{
+				return true;
+			}
+		}
+		return false;
+	}
+
+	EGLDisplay open_display()
+	{
+		const char* client_extensions = eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
+		if (has_extension(client_extensions, "EGL_MESA_platform_surfaceless"))
+		{
+			const auto get_platform_display = reinterpret_cast<PFNEGLGETPLATFORMDISPLAYEXTPROC>(
+				eglGetProcAddress("eglGetPlatformDisplayEXT"));
+			if (get_platform_display)
+			{
+				EGLDisplay display = get_platform_display(EGL_PLATFORM_SURFACELESS_MESA,
+					EGL_DEFAULT_DISPLAY, nullptr);
+				if (display != EGL_NO_DISPLAY && eglInitialize(display, nullptr, nullptr))
+				{
+					return display;
+				}
+			}
+		}
+
+		EGLDisplay display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+		if (display != EGL_NO_DISPLAY && eglInitialize(display, nullptr, nullptr))
+		{
+			return display;
+		}
+		return EGL_NO_DISPLAY;
+	}
+}
+
+bool HeadlessContext::create(int major_version, int minor_version)
+{
+	display = open_display();
+	if (display == EGL_NO_DISPLAY)
+	{
+		std::cerr << "Unable to open an EGL display.\n";
+		return false;
+	}
+
+	if (!eglBindAPI(EGL_OPENGL_API))
+	{
+		std::cerr << "EGL display does not support desktop OpenGL.\n";
+		destroy();
+		return false;
+	}
+
+	const EGLint config_attributes[] = {
+		EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+		EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+		EGL_NONE,
+	};
+	EGLConfig config = nullptr;
+	EGLint config_count = 0;
+	if (!eglChooseConfig(display, config_attributes, &config, 1, &config_count)
+		|| config_count == 0)
+	{
+		// Surfaceless displays may have no pbuffer configs at all
+		const EGLint any_attributes[] = {EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT, EGL_NONE};
+		if (!eglChooseConfig(display, any_attributes, &config, 1, &config_count)
+			|| config_count == 0)
+		{
+			std::cerr << "No EGL config supports OpenGL.\n";
+			destroy();
+			return false;
+		}
+	}
+
+	const EGLint context_attributes[] = {
+		EGL_CONTEXT_MAJOR_VERSION, major_version,
+		EGL_CONTEXT_MINOR_VERSION, minor_version,
+		EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+		EGL_NONE,
+	};
+	context = eglCreateContext(display, config, EGL_NO_CONTEXT, context_attributes);
+	if (context == EGL_NO_CONTEXT)
+	{
+		std::cerr << "Unable to create an OpenGL " << major_version << "."
+				  << minor_version << " core context through EGL.\n";
+		destroy();
+		return false;
+	}
+
+	// No surface at all where the driver allows it, otherwise a 1x1 pbuffer
+	// that never gets drawn to
+	const char* extensions = eglQueryString(display, EGL_EXTENSIONS);
+	if (!has_extension(extensions, "EGL_KHR_surfaceless_context"))
+	{
+		const EGLint pbuffer_attributes[] = {EGL_WIDTH, 1, EGL_HEIGHT, 1, EGL_NONE};
+		surface = eglCreatePbufferSurface(display, config, pbuffer_attributes);
+		if (surface == EGL_NO_SURFACE)
+		{
+			std::cerr << "Unable to create an EGL pbuffer surface.\n";
+			destroy();
+			return false;
+		}
+	}
+
+	if (!eglMakeCurrent(display, surface, surface, context))
+	{
+		std::cerr << "Unable to make the EGL context current.\n";
+		destroy();
+		return false;
+	}
+
+	return true;
+}
+
+void HeadlessContext::destroy()
+{
+	if (display == EGL_NO_DISPLAY)
+	{
+		return;
+	}
+
+	eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+	if (surface != EGL_NO_SURFACE)
+	{
+		eglDestroySurface(display, surface);
+	}
+	if (context != EGL_NO_CONTEXT)
+	{
+		eglDestroyContext(display, context);
+	}
+	eglTerminate(display);
+
+	display = EGL_NO_DISPLAY;
+	context = EGL_NO_CONTEXT;
+	surface = EGL_NO_SURFACE;
+}
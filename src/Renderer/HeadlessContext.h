@@ -0,0 +1,19 @@
+#pragma once
+
+// A GL context with no window, made through EGL. Mesa's surfaceless
+// platform is tried first, then the default display with a tiny pbuffer
+// for drivers that can't make a context current without a surface.
+// Everything is drawn into framebuffer objects.
+class HeadlessContext
+{
+public:
+	bool create(int major_version, int minor_version);
+	void destroy();
+
+private:
+	// EGLDisplay, EGLContext and EGLSurface are all pointers, and keeping
+	// them as void* keeps EGL out of everyone's includes
+	void* display = nullptr;
+	void* context = nullptr;
+	void* surface = nullptr;
+};
@@ -0,0 +1,330 @@
+#include "LightClusters.h"
+
+#include <algorithm>
+#include <bit>
+#include <cfloat>
+#include <cmath>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include <glm/common.hpp>
+#include <glm/geometric.hpp>
+#include <glm/mat3x3.hpp>
+#include <glm/mat4x4.hpp>
+
+#include "Camera.h"
+#include "../Jobs/JobSystem.h"
+
+namespace
+{
+	constexpr uint32_t SIMD_WIDTH = 4;
+
+	// The lanes of a group of four that hold lights, not padding
+	uint32_t lane_mask(uint32_t remaining)
+	{
+		return remaining >= SIMD_WIDTH ? 0xF : (1u << remaining) - 1;
+	}
+}
+
+void LightClusters::LightArrays::clear()
+{
+	for (std::vector<float>* component : {&x, &y, &z, &range, &direction_x, &direction_y,
+			&direction_z, &cos_angle, &sin_angle, &spot})
+	{
+		component->clear();
+	}
+	light.clear();
+	count = 0;
+}
+
+void LightClusters::LightArrays::push(const LightArrays& from, uint32_t i)
+{
+	x.push_back(from.x[i]);
+	y.push_back(from.y[i]);
+	z.push_back(from.z[i]);
+	range.push_back(from.range[i]);
+	direction_x.push_back(from.direction_x[i]);
+	direction_y.push_back(from.direction_y[i]);
+	direction_z.push_back(from.direction_z[i]);
+	cos_angle.push_back(from.cos_angle[i]);
+	sin_angle.push_back(from.sin_angle[i]);
+	spot.push_back(from.spot[i]);
+	light.push_back(from.light[i]);
+	count++;
+}
+
+void LightClusters::LightArrays::pad()
+{
+	while (x.size() % SIMD_WIDTH != 0)
+	{
+		for (std::vector<float>* component : {&x, &y, &z, &range, &direction_x, &direction_y,
+				&direction_z, &cos_angle, &sin_angle, &spot})
+		{
+			component->push_back(0.0f);
+		}
+		light.push_back(0);
+	}
+}
+
+uint32_t LightClusters::spheres_touch_box(const LightArrays& lights, uint32_t first,
+	const Bounds& box)
+{
+#if defined(__SSE2__)
+	// Distance from each center to the closest point of the box
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 x = _mm_loadu_ps(&lights.x[first]);
+	const __m128 y = _mm_loadu_ps(&lights.y[first]);
+	const __m128 z = _mm_loadu_ps(&lights.z[first]);
+	const __m128 dx = _mm_max_ps(_mm_max_ps(_mm_sub_ps(_mm_set1_ps(box.min.x), x),
+		_mm_sub_ps(x, _mm_set1_ps(box.max.x))), zero);
+	const __m128 dy = _mm_max_ps(_mm_max_ps(_mm_sub_ps(_mm_set1_ps(box.min.y), y),
+		_mm_sub_ps(y, _mm_set1_ps(box.max.y))), zero);
+	const __m128 dz = _mm_max_ps(_mm_max_ps(_mm_sub_ps(_mm_set1_ps(box.min.z), z),
+		_mm_sub_ps(z, _mm_set1_ps(box.max.z))), zero);
+	const __m128 distance_squared = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx),
+		_mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+	const __m128 range = _mm_loadu_ps(&lights.range[first]);
+	return (uint32_t)_mm_movemask_ps(_mm_cmple_ps(distance_squared, _mm_mul_ps(range, range)));
+#else
+	uint32_t mask = 0;
+	for (uint32_t lane = 0; lane < SIMD_WIDTH; lane++)
+	{
+		const uint32_t i = first + lane;
+		const glm::vec3 center(lights.x[i], lights.y[i], lights.z[i]);
+		const glm::vec3 offset = glm::max(glm::max(box.min - center, center - box.max), 0.0f);
+		if (glm::dot(offset, offset) <= lights.range[i] * lights.range[i])
+		{
+			mask |= 1u << lane;
+		}
+	}
+	return mask;
+#endif
+}
+
+uint32_t LightClusters::cones_touch_sphere(const LightArrays& lights, uint32_t first,
+	const Bounds& box)
+{
+	// A spot misses the sphere when the sphere is wholly outside the cone's
+	// angle, past its range or behind its apex
+#if defined(__SSE2__)
+	const __m128 vx = _mm_sub_ps(_mm_set1_ps(box.center.x), _mm_loadu_ps(&lights.x[first]));
+	const __m128 vy = _mm_sub_ps(_mm_set1_ps(box.center.y), _mm_loadu_ps(&lights.y[first]));
+	const __m128 vz = _mm_sub_ps(_mm_set1_ps(box.center.z), _mm_loadu_ps(&lights.z[first]));
+	const __m128 length_squared = _mm_add_ps(_mm_add_ps(_mm_mul_ps(vx, vx), _mm_mul_ps(vy, vy)),
+		_mm_mul_ps(vz, vz));
+	const __m128 along = _mm_add_ps(_mm_add_ps(
+		_mm_mul_ps(vx, _mm_loadu_ps(&lights.direction_x[first])),
+		_mm_mul_ps(vy, _mm_loadu_ps(&lights.direction_y[first]))),
+		_mm_mul_ps(vz, _mm_loadu_ps(&lights.direction_z[first])));
+	const __m128 across = _mm_sqrt_ps(_mm_max_ps(
+		_mm_sub_ps(length_squared, _mm_mul_ps(along, along)), _mm_setzero_ps()));
+	const __m128 closest = _mm_sub_ps(_mm_mul_ps(_mm_loadu_ps(&lights.cos_angle[first]), across),
+		_mm_mul_ps(_mm_loadu_ps(&lights.sin_angle[first]), along));
+
+	const __m128 radius = _mm_set1_ps(box.radius);
+	const __m128 range = _mm_loadu_ps(&lights.range[first]);
+	const __m128 missed = _mm_or_ps(_mm_or_ps(_mm_cmpgt_ps(closest, radius),
+		_mm_cmpgt_ps(along, _mm_add_ps(radius, range))),
+		_mm_cmplt_ps(along, _mm_sub_ps(_mm_setzero_ps(), radius)));
+	const __m128 spot = _mm_cmpgt_ps(_mm_loadu_ps(&lights.spot[first]), _mm_set1_ps(0.5f));
+	return ~(uint32_t)_mm_movemask_ps(_mm_and_ps(missed, spot)) & 0xF;
+#else
+	uint32_t mask = 0;
+	for (uint32_t lane = 0; lane < SIMD_WIDTH; lane++)
+	{
+		const uint32_t i = first + lane;
+		const glm::vec3 v = box.center - glm::vec3(lights.x[i], lights.y[i], lights.z[i]);
+		const float along = glm::dot(v, glm::vec3(lights.direction_x[i], lights.direction_y[i],
+			lights.direction_z[i]));
+		const float across = std::sqrt(std::max(glm::dot(v, v) - along * along, 0.0f));
+		const float closest = lights.cos_angle[i] * across - lights.sin_angle[i] * along;
+		const bool missed = closest > box.radius || along > box.radius + lights.range[i]
+			|| along < -box.radius;
+		if (!(missed && lights.spot[i] > 0.5f))
+		{
+			mask |= 1u << lane;
+		}
+	}
+	return mask;
+#endif
+}
+
+void LightClusters::build_bounds(const Camera& camera, float aspect)
+{
+	const float tan_y = std::tan(camera.fov * 0.5f);
+	const float tan_x = tan_y * aspect;
+	const float depth_ratio = camera.far_plane / camera.near_plane;
+	depth_scale = (float)CLUSTER_GRID_Z / std::log(depth_ratio);
+	depth_bias = -std::log(camera.near_plane) * depth_scale;
+
+	const auto grow = [](Bounds& bounds, const glm::vec3& bounds_min, const glm::vec3& bounds_max) {
+		bounds.min = glm::min(bounds.min, bounds_min);
+		bounds.max = glm::max(bounds.max, bounds_max);
+		bounds.center = (bounds.min + bounds.max) * 0.5f;
+		bounds.radius = glm::length(bounds.max - bounds.center);
+	};
+	const Bounds empty{glm::vec3(FLT_MAX), glm::vec3(-FLT_MAX), glm::vec3(0.0f), 0.0f};
+
+	cluster_bounds.assign(CLUSTER_COUNT, empty);
+	slice_bounds.fill(empty);
+	row_bounds.fill(empty);
+	for (uint32_t z = 0; z < CLUSTER_GRID_Z; z++)
+	{
+		const float depths[2] = {
+			camera.near_plane * std::pow(depth_ratio, (float)z / (float)CLUSTER_GRID_Z),
+			camera.near_plane * std::pow(depth_ratio, (float)(z + 1) / (float)CLUSTER_GRID_Z)};
+		for (uint32_t y = 0; y < CLUSTER_GRID_Y; y++)
+		{
+			const float ndc_y[2] = {-1.0f + 2.0f * (float)y / (float)CLUSTER_GRID_Y,
+				-1.0f + 2.0f * (float)(y + 1) / (float)CLUSTER_GRID_Y};
+			Bounds& row = row_bounds[z * CLUSTER_GRID_Y + y];
+			for (uint32_t x = 0; x < CLUSTER_GRID_X; x++)
+			{
+				const float ndc_x[2] = {-1.0f + 2.0f * (float)x / (float)CLUSTER_GRID_X,
+					-1.0f + 2.0f * (float)(x + 1) / (float)CLUSTER_GRID_X};
+
+				// The eight corners of the tile's frustum between the slice's
+				// near and far depth
+				Bounds& cluster = cluster_bounds[(z * CLUSTER_GRID_Y + y) * CLUSTER_GRID_X + x];
+				for (const float depth : depths)
+				{
+					for (const float corner_x : ndc_x)
+					{
+						for (const float corner_y : ndc_y)
+						{
+							const glm::vec3 corner(corner_x * depth * tan_x,
+								corner_y * depth * tan_y, -depth);
+							grow(cluster, corner, corner);
+						}
+					}
+				}
+				grow(row, cluster.min, cluster.max);
+			}
+			grow(slice_bounds[z], row.min, row.max);
+		}
+	}
+
+	bounds_projection = glm::vec4(camera.fov, aspect, camera.near_plane, camera.far_plane);
+}
+
+void LightClusters::assign(const std::vector<Light>& lights, const Camera& camera, float aspect,
+	JobSystem& jobs)
+{
+	if (glm::vec4(camera.fov, aspect, camera.near_plane, camera.far_plane) != bounds_projection)
+	{
+		build_bounds(camera, aspect);
+	}
+
+	// Into view space, where the cluster bounds are
+	const glm::mat4 view = camera.view();
+	const glm::mat3 rotation(view);
+	const uint32_t count = (uint32_t)std::min(lights.size(), (size_t)MAX_LIGHTS);
+	view_lights.clear();
+	gpu_lights.resize(count);
+	for (uint32_t i = 0; i < count; i++)
+	{
+		const Light& light = lights[i];
+		const bool spot = light.type == LightType::Spot;
+		const float outer = std::min(light.outer_angle, MAX_SPOT_ANGLE);
+		const float inner = std::min(light.inner_angle, outer);
+		const glm::vec3 position = glm::vec3(view * glm::vec4(light.position, 1.0f));
+		const glm::vec3 direction = glm::normalize(rotation * light.direction);
+
+		view_lights.x.push_back(position.x);
+		view_lights.y.push_back(position.y);
+		view_lights.z.push_back(position.z);
+		view_lights.range.push_back(light.range);
+		view_lights.direction_x.push_back(direction.x);
+		view_lights.direction_y.push_back(direction.y);
+		view_lights.direction_z.push_back(direction.z);
+		view_lights.cos_angle.push_back(std::cos(outer));
+		view_lights.sin_angle.push_back(std::sin(outer));
+		view_lights.spot.push_back(spot ? 1.0f : 0.0f);
+		view_lights.light.push_back(i);
+		view_lights.count++;
+
+		GpuLight& gpu_light = gpu_lights[i];
+		gpu_light.position_range = glm::vec4(light.position, light.range);
+		gpu_light.color_cos_inner = glm::vec4(light.color, spot ? std::cos(inner) : -1.0f);
+		gpu_light.direction_cos_outer = glm::vec4(glm::normalize(light.direction),
+			spot ? std::cos(outer) : -2.0f);
+	}
+	view_lights.pad();
+
+	jobs.parallel_for(CLUSTER_GRID_Z, [this](uint32_t begin, uint32_t end) {
+		for (uint32_t slice = begin; slice < end; slice++)
+		{
+			assign_slice(slice);
+		}
+	});
+
+	// Slices found their lists independently; join them up in order
+	stats = LightClusterStats();
+	stats.lights = count;
+	clusters.resize(CLUSTER_COUNT);
+	indices.clear();
+	for (uint32_t z = 0; z < CLUSTER_GRID_Z; z++)
+	{
+		const SliceResult& slice = slices[z];
+		const uint32_t base = (uint32_t)indices.size();
+		for (uint32_t i = 0; i < (uint32_t)slice.clusters.size(); i++)
+		{
+			LightCluster& cluster = clusters[z * CLUSTER_GRID_X * CLUSTER_GRID_Y + i];
+			cluster.offset = base + slice.clusters[i].offset;
+			cluster.count = slice.clusters[i].count;
+			stats.max_cluster_lights = std::max(stats.max_cluster_lights, cluster.count);
+		}
+		indices.insert(indices.end(), slice.indices.begin(), slice.indices.end());
+		stats.tests += slice.tests;
+	}
+	stats.indices = (uint32_t)indices.size();
+}
+
+void LightClusters::assign_slice(uint32_t z)
+{
+	SliceResult& result = slices[z];
+	result.indices.clear();
+	result.tests = 0;
+
+	// Narrowed down slice, then row, then cluster, so each cluster only
+	// tests the lights that reach its row
+	const auto filter = [](const LightArrays& from, const Bounds& bounds, LightArrays& to) {
+		to.clear();
+		for (uint32_t first = 0; first < from.count; first += SIMD_WIDTH)
+		{
+			uint32_t mask = spheres_touch_box(from, first, bounds) & lane_mask(from.count - first);
+			for (; mask; mask &= mask - 1)
+			{
+				to.push(from, first + (uint32_t)std::countr_zero(mask));
+			}
+		}
+		to.pad();
+	};
+
+	filter(view_lights, slice_bounds[z], result.candidates);
+	for (uint32_t y = 0; y < CLUSTER_GRID_Y; y++)
+	{
+		filter(result.candidates, row_bounds[z * CLUSTER_GRID_Y + y], result.row);
+		const LightArrays& row = result.row;
+
+		for (uint32_t x = 0; x < CLUSTER_GRID_X; x++)
+		{
+			const uint32_t cluster = y * CLUSTER_GRID_X + x;
+			const Bounds& bounds = cluster_bounds[z * CLUSTER_GRID_X * CLUSTER_GRID_Y + cluster];
+			const uint32_t offset = (uint32_t)result.indices.size();
+			for (uint32_t first = 0; first < row.count; first += SIMD_WIDTH)
+			{
+				uint32_t mask = spheres_touch_box(row, first, bounds)
+					& cones_touch_sphere(row, first, bounds) & lane_mask(row.count - first);
+				for (; mask; mask &= mask - 1)
+				{
+					result.indices.push_back((uint16_t)row.light[first + (uint32_t)std::countr_zero(mask)]);
+				}
+				result.tests++;
+			}
+			result.clusters[cluster] = {offset, (uint32_t)result.indices.size() - offset};
+		}
+	}
+}
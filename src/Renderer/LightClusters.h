@@ -0,0 +1,150 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+#include <glm/vec3.hpp>
+#include <glm/vec4.hpp>
+
+class JobSystem;
+struct Camera;
+
+// Clustered forward lighting: the view frustum is cut into X by Y tiles of
+// the screen and Z slices of depth, spaced exponentially so clusters are
+// roughly as deep as they are wide. Every cluster gets a list of the lights
+// that can reach it, and each fragment only shades the lights of its own.
+constexpr uint32_t CLUSTER_GRID_X = 16;
+constexpr uint32_t CLUSTER_GRID_Y = 9;
+constexpr uint32_t CLUSTER_GRID_Z = 24;
+constexpr uint32_t CLUSTER_COUNT = CLUSTER_GRID_X * CLUSTER_GRID_Y * CLUSTER_GRID_Z;
+// Light indices go to the GPU as 16 bits
+constexpr uint32_t MAX_LIGHTS = 65535;
+// Spot cones wider than this would need a different culling test
+constexpr float MAX_SPOT_ANGLE = 1.5f;
+
+enum class LightType : uint8_t
+{
+	Point,
+	Spot,
+};
+
+struct Light
+{
+	LightType type = LightType::Point;
+	glm::vec3 position = glm::vec3(0.0f);
+	glm::vec3 color = glm::vec3(1.0f); // linear, times intensity
+	float range = 10.0f; // nothing past this is lit
+	// Spot lights only. Angles are from the direction to the edge, full
+	// strength inside the inner one fading to nothing at the outer.
+	glm::vec3 direction = glm::vec3(0.0f, -1.0f, 0.0f);
+	float inner_angle = 0.3f;
+	float outer_angle = 0.5f;
+};
+
+// What the fragment shader reads per light, GPU_LIGHT_TEXELS texels of a
+// RGBA32F texture buffer. Point lights get cosines that pass every
+// direction.
+struct GpuLight
+{
+	glm::vec4 position_range = glm::vec4(0.0f);
+	glm::vec4 color_cos_inner = glm::vec4(0.0f);
+	glm::vec4 direction_cos_outer = glm::vec4(0.0f);
+};
+
+constexpr uint32_t GPU_LIGHT_TEXELS = sizeof(GpuLight) / sizeof(glm::vec4);
+
+// Where the lights of one cluster are in the index list
+struct LightCluster
+{
+	uint32_t offset = 0;
+	uint32_t count = 0;
+};
+
+struct LightClusterStats
+{
+	uint32_t lights = 0;
+	uint32_t indices = 0; // light to cluster assignments
+	uint32_t max_cluster_lights = 0;
+	uint32_t tests = 0; // light against cluster, four at a time with SIMD
+};
+
+// Assigns lights to the clusters of the camera's frustum. The shader finds
+// a fragment's slice as log(view depth) * depth_scale + depth_bias.
+class LightClusters
+{
+public:
+	// Rebuilds the cluster bounds if the projection changed, then tests
+	// every light against them one slice per job
+	void assign(const std::vector<Light>& lights, const Camera& camera, float aspect,
+		JobSystem& jobs);
+
+	float depth_scale = 0.0f;
+	float depth_bias = 0.0f;
+
+	// For the shader: the lights, then each cluster's range of indices,
+	// x fastest, then y up the screen, then z away from the camera
+	std::vector<GpuLight> gpu_lights;
+	std::vector<LightCluster> clusters;
+	std::vector<uint16_t> indices;
+
+	LightClusterStats stats;
+
+private:
+	// View space, with the camera looking down -z
+	struct Bounds
+	{
+		glm::vec3 min = glm::vec3(0.0f);
+		glm::vec3 max = glm::vec3(0.0f);
+		glm::vec3 center = glm::vec3(0.0f);
+		float radius = 0.0f;
+	};
+
+	// Lights in view space, one array per component, padded with zeros to
+	// a multiple of four so the tests never need a scalar tail
+	struct LightArrays
+	{
+		std::vector<float> x, y, z, range;
+		// Spot lights only; spot is one for them and zero for point lights
+		std::vector<float> direction_x, direction_y, direction_z;
+		std::vector<float> cos_angle, sin_angle, spot;
+		std::vector<uint32_t> light; // index into the assigned lights
+		uint32_t count = 0;
+
+		void clear();
+		void push(const LightArrays& from, uint32_t i);
+		void pad();
+	};
+
+	// What one slice found, merged into the outputs once all are done
+	struct SliceResult
+	{
+		LightArrays candidates;
+		LightArrays row;
+		std::array<LightCluster, CLUSTER_GRID_X * CLUSTER_GRID_Y> clusters{};
+		std::vector<uint16_t> indices;
+		uint32_t tests = 0;
+	};
+
+	// Bit i is set for each of the four lights from first whose sphere
+	// reaches the box
+	static uint32_t spheres_touch_box(const LightArrays& lights, uint32_t first,
+		const Bounds& box);
+	// Bit i is set for each of the four lights from first that are point
+	// lights, or spot lights whose cone reaches the sphere around the box
+	static uint32_t cones_touch_sphere(const LightArrays& lights, uint32_t first,
+		const Bounds& box);
+
+	void build_bounds(const Camera& camera, float aspect);
+	void assign_slice(uint32_t slice);
+
+	// Cluster bounds in output order, then those of every row and slice
+	std::vector<Bounds> cluster_bounds;
+	std::array<Bounds, CLUSTER_GRID_Y * CLUSTER_GRID_Z> row_bounds{};
+	std::array<Bounds, CLUSTER_GRID_Z> slice_bounds{};
+	// What the bounds were built for
+	glm::vec4 bounds_projection = glm::vec4(0.0f);
+
+	LightArrays view_lights;
+	std::array<SliceResult, CLUSTER_GRID_Z> slices;
+};
@@ -0,0 +1,334 @@
+#include "PostChain.h"
+
+#include <algorithm>
+#include <iostream>
+#include <sstream>
+
+#include <GL/glew.h>
+#include <GL/gl.h>
+
+#include "../Capture/CapturedGL.h"
+
+namespace
+{
+	// Where the effects read the pass's source and the bloom chain
+	constexpr GLuint SOURCE_TEXTURE_UNIT = 0;
+	constexpr GLuint BLOOM_TEXTURE_UNIT = 1;
+	// Texels of the chain's first level each downsample group covers
+	constexpr int BLOOM_TILE = 32;
+	constexpr int BLOOM_UPSAMPLE_GROUP = 8;
+
+	// Per-pixel effects only, each defining vec3 name(vec3 color, vec2 uv)
+	const char* effect_source_file(PostEffect effect)
+	{
+		switch (effect)
+		{
+		case PostEffect::Bloom:
+			return "./shaders/post_bloom.glsl";
+		case PostEffect::Tonemap:
+			return "./shaders/post_tonemap.glsl";
+		case PostEffect::Grading:
+			return "./shaders/post_grading.glsl";
+		default:
+			return nullptr;
+		}
+	}
+
+	GLuint group_count(int size, int group_size)
+	{
+		return (GLuint)((size + group_size - 1) / group_size);
+	}
+
+	// Joined with separator, in the order they run
+	std::string join_effects(uint32_t effects, const char* separator)
+	{
+		std::string names;
+		for (uint32_t i = 0; i < (uint32_t)PostEffect::Count; i++)
+		{
+			if (effects & post_effect_bit((PostEffect)i))
+			{
+				names += (names.empty() ? "" : separator);
+				names += post_effect_name((PostEffect)i);
+			}
+		}
+		return names;
+	}
+}
+
+const char* post_effect_name(PostEffect effect)
+{
+	switch (effect)
+	{
+	case PostEffect::Bloom:
+		return "bloom";
+	case PostEffect::Tonemap:
+		return "tonemap";
+	case PostEffect::Grading:
+		return "grading";
+	case PostEffect::Fxaa:
+		return "fxaa";
+	default:
+		return "";
+	}
+}
+
+bool parse_post_effects(const std::string& list, uint32_t& effects)
+{
+	effects = 0;
+	std::stringstream stream(list);
+	std::string name;
+	while (std::getline(stream, name, ','))
+	{
+		if (name == "all")
+		{
+			effects |= post_effect_bit(PostEffect::Count) - 1;
+			continue;
+		}
+		uint32_t i = 0;
+		while (i < (uint32_t)PostEffect::Count && name != post_effect_name((PostEffect)i))
+		{
+			i++;
+		}
+		if (i == (uint32_t)PostEffect::Count)
+		{
+			std::cerr << "Unknown post effect: " << name << "\n";
+			return false;
+		}
+		effects |= post_effect_bit((PostEffect)i);
+	}
+	return true;
+}
+
+bool PostChain::initialize(bool compute_shaders)
+{
+	compute = compute_shaders;
+	if ((settings.effects & post_effect_bit(PostEffect::Bloom)) && !compute)
+	{
+		std::cerr << "Bloom needs compute shaders, leaving it out.\n";
+		settings.effects &= ~post_effect_bit(PostEffect::Bloom);
+	}
+
+	fullscreen_vertex_source = Shader::read_source("./shaders/fullscreen_vertex.glsl");
+	fxaa_shader = Shader("./shaders/fullscreen_vertex.glsl", "./shaders/fxaa_fragment.glsl");
+	if (compute)
+	{
+		bloom_downsample_shader = Shader("./shaders/bloom_downsample.glsl");
+		bloom_upsample_shader = Shader("./shaders/bloom_upsample.glsl");
+	}
+	if (fullscreen_vertex_source.empty() || !fxaa_shader.program
+		|| (compute && (!bloom_downsample_shader.program || !bloom_upsample_shader.program)))
+	{
+		destroy();
+		return false;
+	}
+	glUseProgram(fxaa_shader.program);
+	fxaa_shader.set_uniform("source", (int)SOURCE_TEXTURE_UNIT);
+	if (compute)
+	{
+		glUseProgram(bloom_downsample_shader.program);
+		bloom_downsample_shader.set_uniform("scene", (int)SOURCE_TEXTURE_UNIT);
+		glUseProgram(bloom_upsample_shader.program);
+		bloom_upsample_shader.set_uniform("chain", (int)SOURCE_TEXTURE_UNIT);
+	}
+	glUseProgram(0);
+
+	glGenVertexArrays(1, &empty_vao);
+	return true;
+}
+
+void PostChain::destroy()
+{
+	bloom_downsample_shader.destroy();
+	bloom_upsample_shader.destroy();
+	fxaa_shader.destroy();
+	for (const auto& [effects, shader] : fused_shaders)
+	{
+		shader.destroy();
+	}
+	fused_shaders.clear();
+	glDeleteVertexArrays(1, &empty_vao);
+	empty_vao = 0;
+}
+
+bool PostChain::active() const
+{
+	return settings.effects != 0 && empty_vao != 0;
+}
+
+void PostChain::add_passes(RenderGraph& graph, RenderResource scene, RenderResource output)
+{
+	plan_passes(passes);
+	scene_color = scene;
+	const RenderTextureDesc size = graph.desc(scene);
+	if (settings.effects & post_effect_bit(PostEffect::Bloom))
+	{
+		bloom_chain = graph.create_texture("bloom_chain", {std::max((size.width + 1) / 2, 1),
+			std::max((size.height + 1) / 2, 1), GL_RGBA16F, BLOOM_LEVELS});
+		graph.add_pass("bloom", [this](RenderGraph& pass_graph) { draw_bloom(pass_graph); })
+			.read(scene)
+			.write(bloom_chain);
+	}
+
+	RenderResource source = scene;
+	bool hdr = true;
+	for (size_t i = 0; i < passes.size(); i++)
+	{
+		Pass& pass = passes[i];
+		pass.source = source;
+
+		// Eight bits a channel are plenty once tone mapped
+		hdr &= (pass.effects & post_effect_bit(PostEffect::Tonemap)) == 0;
+		const RenderResource target = i + 1 == passes.size() ? output : graph.create_texture(
+			"post_target", {size.width, size.height, (GLenum)(hdr ? GL_RGBA16F : GL_RGBA8)});
+		RenderGraph::PassBuilder builder = graph.add_pass(pass.name,
+			[this, i](RenderGraph& pass_graph) { draw_pass(pass_graph, passes[i]); });
+		builder.read(source).color(target);
+		if (pass.effects & post_effect_bit(PostEffect::Bloom))
+		{
+			builder.read(bloom_chain);
+		}
+		source = target;
+	}
+}
+
+std::string PostChain::effect_names() const
+{
+	return join_effects(settings.effects, ",");
+}
+
+void PostChain::plan_passes(std::vector<Pass>& planned) const
+{
+	// Per-pixel effects gather into one pass until an effect that reads
+	// its neighbours needs what they wrote. At zero intensity nothing reads
+	// the bloom chain, and the graph culls the pass making it.
+	uint32_t effects = settings.effects;
+	if (settings.bloom_intensity <= 0.0f)
+	{
+		effects &= ~post_effect_bit(PostEffect::Bloom);
+	}
+	planned.clear();
+	uint32_t fused = 0;
+	for (uint32_t i = 0; i < (uint32_t)PostEffect::Count; i++)
+	{
+		const uint32_t bit = post_effect_bit((PostEffect)i);
+		if ((effects & bit) == 0)
+		{
+			continue;
+		}
+		if ((PostEffect)i == PostEffect::Fxaa)
+		{
+			if (fused)
+			{
+				planned.push_back({fused, false, join_effects(fused, "+"), {}});
+				fused = 0;
+			}
+			planned.push_back({0, true, "fxaa", {}});
+		}
+		else
+		{
+			fused |= bit;
+		}
+	}
+	if (fused)
+	{
+		planned.push_back({fused, false, join_effects(fused, "+"), {}});
+	}
+}
+
+void PostChain::draw_bloom(RenderGraph& graph) const
+{
+	const RenderTextureDesc& chain = graph.desc(bloom_chain);
+	const uint32_t chain_texture = graph.texture(bloom_chain);
+
+	// Every level in one go
+	glUseProgram(bloom_downsample_shader.program);
+	bloom_downsample_shader.set_uniform("threshold", settings.bloom_threshold);
+	bloom_downsample_shader.set_uniform("knee", std::max(settings.bloom_knee, 0.0f));
+	glActiveTexture(GL_TEXTURE0 + SOURCE_TEXTURE_UNIT);
+	glBindTexture(GL_TEXTURE_2D, graph.texture(scene_color));
+	for (int level = 0; level < BLOOM_LEVELS; level++)
+	{
+		glBindImageTexture((GLuint)level, chain_texture, level, GL_FALSE, 0, GL_WRITE_ONLY,
+			GL_RGBA16F);
+	}
+	glDispatchCompute(group_count(chain.width, BLOOM_TILE), group_count(chain.height, BLOOM_TILE),
+		1);
+
+	// Then back up, each level onto the one above
+	glUseProgram(bloom_upsample_shader.program);
+	glBindTexture(GL_TEXTURE_2D, chain_texture);
+	for (int level = BLOOM_LEVELS - 2; level >= 0; level--)
+	{
+		glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT | GL_TEXTURE_FETCH_BARRIER_BIT);
+		bloom_upsample_shader.set_uniform("source_level", level + 1);
+		glBindImageTexture(0, chain_texture, level, GL_FALSE, 0, GL_READ_WRITE, GL_RGBA16F);
+		glDispatchCompute(group_count(std::max(chain.width >> level, 1), BLOOM_UPSAMPLE_GROUP),
+			group_count(std::max(chain.height >> level, 1), BLOOM_UPSAMPLE_GROUP), 1);
+	}
+	glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+	glUseProgram(0);
+}
+
+void PostChain::draw_pass(RenderGraph& graph, const Pass& pass)
+{
+	const Shader& shader = pass.fxaa ? fxaa_shader : fused_shader(pass.effects);
+	glUseProgram(shader.program);
+	if (!pass.fxaa)
+	{
+		set_effect_uniforms(shader);
+	}
+	if (pass.effects & post_effect_bit(PostEffect::Bloom))
+	{
+		glActiveTexture(GL_TEXTURE0 + BLOOM_TEXTURE_UNIT);
+		glBindTexture(GL_TEXTURE_2D, graph.texture(bloom_chain));
+	}
+	glActiveTexture(GL_TEXTURE0 + SOURCE_TEXTURE_UNIT);
+	glBindTexture(GL_TEXTURE_2D, graph.texture(pass.source));
+	glBindVertexArray(empty_vao);
+	glDrawArrays(GL_TRIANGLES, 0, 3);
+	glBindVertexArray(0);
+	glUseProgram(0);
+}
+
+const Shader& PostChain::fused_shader(uint32_t effects)
+{
+	const auto found = fused_shaders.find(effects);
+	if (found != fused_shaders.end())
+	{
+		return found->second;
+	}
+
+	// The effects' functions, then a main that calls them in order
+	std::string source = "#version 330 core\n// Generated by PostChain: "
+		+ join_effects(effects, ", ") + "\nout vec4 out_color;\nuniform sampler2D source;\n\n";
+	std::string calls;
+	for (uint32_t i = 0; i < (uint32_t)PostEffect::Count; i++)
+	{
+		if (effects & post_effect_bit((PostEffect)i))
+		{
+			source += Shader::read_source(effect_source_file((PostEffect)i)) + "\n";
+			calls += std::string("\tcolor = ") + post_effect_name((PostEffect)i) + "(color, uv);\n";
+		}
+	}
+	source += "void main()\n{\n"
+		"\tvec2 uv = gl_FragCoord.xy / vec2(textureSize(source, 0));\n"
+		"\tvec3 color = texelFetch(source, ivec2(gl_FragCoord.xy), 0).rgb;\n"
+		+ calls + "\tout_color = vec4(color, 1.0);\n}\n";
+
+	const Shader shader = Shader::from_source(fullscreen_vertex_source, source);
+	glUseProgram(shader.program);
+	shader.set_uniform("source", (int)SOURCE_TEXTURE_UNIT);
+	shader.set_uniform("bloom_chain", (int)BLOOM_TEXTURE_UNIT);
+	return fused_shaders.emplace(effects, shader).first->second;
+}
+
+void PostChain::set_effect_uniforms(const Shader& shader) const
+{
+	shader.set_uniform("bloom_intensity", settings.bloom_intensity);
+	shader.set_uniform("exposure", settings.exposure);
+	shader.set_uniform("grading_lift", settings.grading_lift);
+	shader.set_uniform("grading_gamma", settings.grading_gamma);
+	shader.set_uniform("grading_gain", settings.grading_gain);
+	shader.set_uniform("grading_contrast", settings.grading_contrast);
+	shader.set_uniform("grading_saturation", settings.grading_saturation);
+}
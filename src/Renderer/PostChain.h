@@ -0,0 +1,106 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <glm/vec3.hpp>
+
+#include "RenderGraph.h"
+#include "../Shader/Shader.h"
+
+// In the order they run
+enum class PostEffect : uint32_t
+{
+	Bloom,
+	Tonemap,
+	Grading,
+	Fxaa,
+	Count,
+};
+
+constexpr uint32_t post_effect_bit(PostEffect effect)
+{
+	return 1u << (uint32_t)effect;
+}
+
+const char* post_effect_name(PostEffect effect);
+// A comma separated list of effect names, or "all". False on a name it
+// doesn't know.
+bool parse_post_effects(const std::string& list, uint32_t& effects);
+
+// Levels of the bloom chain, the first at half the render size. One
+// dispatch builds all of them, see bloom_downsample.glsl.
+constexpr int BLOOM_LEVELS = 6;
+
+struct PostSettings
+{
+	uint32_t effects = 0; // post_effect_bit of each one that runs
+	float bloom_threshold = 1.0f;
+	float bloom_knee = 0.5f;
+	float bloom_intensity = 0.15f;
+	float exposure = 1.0f;
+	glm::vec3 grading_lift = glm::vec3(0.0f);
+	glm::vec3 grading_gamma = glm::vec3(1.0f);
+	glm::vec3 grading_gain = glm::vec3(1.0f);
+	float grading_contrast = 1.0f;
+	float grading_saturation = 1.0f;
+};
+
+// Post-processing between the scene and the frame, as passes of the frame's
+// render graph. The scene renders into a transient HDR texture, and each
+// pass hands the next one a transient of its own. Runs of effects that only
+// look at their own pixel are fused into one generated shader per
+// combination, so they cost one full screen pass together; only effects
+// that read their neighbours, like FXAA, need a pass of their own. Effects
+// that are off cost nothing, and with all of them off the scene renders
+// straight into the frame.
+class PostChain
+{
+public:
+	// Bloom needs compute shaders, and is dropped without them
+	bool initialize(bool compute);
+	void destroy();
+
+	bool active() const;
+
+	// Adds the passes taking the scene to output, which is the scene's size
+	void add_passes(RenderGraph& graph, RenderResource scene, RenderResource output);
+
+	// Names of the effects that run, comma separated
+	std::string effect_names() const;
+
+	PostSettings settings;
+
+private:
+	// One full screen pass: a fused run of per-pixel effects, or FXAA
+	struct Pass
+	{
+		uint32_t effects = 0;
+		bool fxaa = false;
+		std::string name;
+		RenderResource source;
+	};
+
+	// What runs this frame, in order
+	void plan_passes(std::vector<Pass>& passes) const;
+	void draw_bloom(RenderGraph& graph) const;
+	void draw_pass(RenderGraph& graph, const Pass& pass);
+	// Generated and compiled the first time the combination is asked for
+	const Shader& fused_shader(uint32_t effects);
+	void set_effect_uniforms(const Shader& shader) const;
+
+	bool compute = false;
+	Shader bloom_downsample_shader;
+	Shader bloom_upsample_shader;
+	Shader fxaa_shader;
+	std::unordered_map<uint32_t, Shader> fused_shaders;
+	std::string fullscreen_vertex_source;
+	uint32_t empty_vao = 0;
+
+	// This frame's
+	RenderResource scene_color;
+	RenderResource bloom_chain;
+	std::vector<Pass> passes;
+};
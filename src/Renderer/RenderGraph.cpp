@@ -0,0 +1,646 @@
+#include "RenderGraph.h"
+
+#include <algorithm>
+#include <array>
+#include <iostream>
+
+#include <GL/glew.h>
+#include <GL/gl.h>
+
+#include "../Resources/GpuMemory.h"
+#include "../Capture/CapturedGL.h"
+
+namespace
+{
+	struct TexelFormat
+	{
+		GLenum format = GL_RGBA;
+		GLenum type = GL_UNSIGNED_BYTE;
+		uint32_t bytes = 4;
+		bool depth = false;
+		bool integer = false;
+		// Formats of the same class can be views of each other's texels.
+		// Depth formats can only be viewed as themselves.
+		uint32_t view_class = 32;
+	};
+
+	TexelFormat texel_format(GLenum internal_format)
+	{
+		switch (internal_format)
+		{
+		case GL_RGBA16F:
+			return {GL_RGBA, GL_HALF_FLOAT, 8, false, false, 64};
+		case GL_RGBA16UI:
+			return {GL_RGBA_INTEGER, GL_UNSIGNED_SHORT, 8, false, true, 64};
+		case GL_R11F_G11F_B10F:
+			return {GL_RGB, GL_HALF_FLOAT, 4, false, false, 32};
+		case GL_R32F:
+			return {GL_RED, GL_FLOAT, 4, false, false, 32};
+		case GL_DEPTH_COMPONENT16:
+			return {GL_DEPTH_COMPONENT, GL_UNSIGNED_SHORT, 2, true, false, 0};
+		case GL_DEPTH_COMPONENT24:
+		case GL_DEPTH_COMPONENT32:
+			return {GL_DEPTH_COMPONENT, GL_UNSIGNED_INT, 4, true, false, 0};
+		case GL_DEPTH24_STENCIL8:
+			return {GL_DEPTH_STENCIL, GL_UNSIGNED_INT_24_8, 4, true, false, 0};
+		default:
+			return {GL_RGBA, GL_UNSIGNED_BYTE, 4, false, false, 32};
+		}
+	}
+
+	GLenum depth_attachment(GLenum format)
+	{
+		return format == GL_DEPTH24_STENCIL8 ? GL_DEPTH_STENCIL_ATTACHMENT : GL_DEPTH_ATTACHMENT;
+	}
+
+	size_t texture_size(const RenderTextureDesc& desc)
+	{
+		const uint32_t bytes = texel_format(desc.format).bytes;
+		size_t size = 0;
+		for (int level = 0; level < desc.levels; level++)
+		{
+			size += (size_t)std::max(desc.width >> level, 1)
+				* (size_t)std::max(desc.height >> level, 1) * bytes;
+		}
+		return size;
+	}
+
+	// Of the bound texture
+	void set_sampling(const RenderTextureDesc& desc)
+	{
+		// Integer and depth textures can't be filtered; they're only fetched
+		const TexelFormat texel = texel_format(desc.format);
+		const bool nearest = texel.depth || texel.integer;
+		const GLint filter = nearest ? GL_NEAREST : GL_LINEAR;
+		GLint min_filter = filter;
+		if (desc.levels > 1)
+		{
+			min_filter = nearest ? GL_NEAREST_MIPMAP_NEAREST : GL_LINEAR_MIPMAP_NEAREST;
+		}
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, min_filter);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, filter);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, desc.levels - 1);
+	}
+
+	bool contains(const std::vector<uint32_t>& indices, uint32_t index)
+	{
+		return std::find(indices.begin(), indices.end(), index) != indices.end();
+	}
+}
+
+RenderGraph::PassBuilder::PassBuilder(RenderGraph& owner, uint32_t pass_index)
+	: graph(owner), pass(pass_index)
+{
+}
+
+RenderGraph::PassBuilder& RenderGraph::PassBuilder::read(RenderResource resource)
+{
+	graph.passes[pass].reads.push_back(resource.index);
+	return *this;
+}
+
+RenderGraph::PassBuilder& RenderGraph::PassBuilder::write(RenderResource resource)
+{
+	graph.passes[pass].writes.push_back(resource.index);
+	return *this;
+}
+
+RenderGraph::PassBuilder& RenderGraph::PassBuilder::color(RenderResource resource, bool clear)
+{
+	Pass& target = graph.passes[pass];
+	target.writes.push_back(resource.index);
+	target.color = resource;
+	target.clear_color = clear;
+	return *this;
+}
+
+RenderGraph::PassBuilder& RenderGraph::PassBuilder::depth(RenderResource resource, bool clear)
+{
+	Pass& target = graph.passes[pass];
+	target.writes.push_back(resource.index);
+	target.depth = resource;
+	target.clear_depth = clear;
+	return *this;
+}
+
+RenderGraph::PassBuilder& RenderGraph::PassBuilder::keep()
+{
+	graph.passes[pass].keep = true;
+	return *this;
+}
+
+void RenderGraph::initialize(bool views, bool invalidate_attachments)
+{
+	texture_views = views;
+	invalidation = invalidate_attachments;
+}
+
+void RenderGraph::destroy()
+{
+	for (const Framebuffer& cached : framebuffers)
+	{
+		glDeleteFramebuffers(1, &cached.framebuffer);
+	}
+	for (const Storage& storage : storages)
+	{
+		destroy_storage(storage);
+	}
+	framebuffers.clear();
+	storages.clear();
+	resources.clear();
+	passes.clear();
+	resource_count = 0;
+	pass_count = 0;
+	timers.destroy();
+}
+
+void RenderGraph::begin_frame()
+{
+	resource_count = 0;
+	pass_count = 0;
+	frame_stats = RenderGraphStats();
+	for (Storage& storage : storages)
+	{
+		storage.in_use = false;
+	}
+}
+
+RenderResource RenderGraph::create_texture(const std::string& name,
+	const RenderTextureDesc& desc)
+{
+	if (resource_count == resources.size())
+	{
+		resources.emplace_back();
+	}
+	Resource& resource = resources[resource_count];
+	resource.name = name;
+	resource.desc = desc;
+	resource.framebuffer = 0;
+	resource.imported = false;
+	resource.first_use = UINT32_MAX;
+	resource.last_use = 0;
+	resource.texture = 0;
+	return {resource_count++};
+}
+
+RenderResource RenderGraph::import_framebuffer(const std::string& name, uint32_t imported,
+	int width, int height)
+{
+	const RenderResource handle = create_texture(name, {width, height, 0, 1});
+	Resource& resource = resources[handle.index];
+	resource.framebuffer = imported;
+	resource.imported = true;
+	return handle;
+}
+
+const RenderTextureDesc& RenderGraph::desc(RenderResource resource) const
+{
+	return resources[resource.index].desc;
+}
+
+RenderGraph::PassBuilder RenderGraph::add_pass(const std::string& name, Execute run)
+{
+	if (pass_count == passes.size())
+	{
+		passes.emplace_back();
+	}
+	Pass& pass = passes[pass_count];
+	pass.name = name;
+	pass.execute = std::move(run);
+	pass.reads.clear();
+	pass.writes.clear();
+	pass.color = RenderResource();
+	pass.depth = RenderResource();
+	pass.clear_color = false;
+	pass.clear_depth = false;
+	pass.keep = false;
+	pass.culled = false;
+	return PassBuilder(*this, pass_count++);
+}
+
+void RenderGraph::execute()
+{
+	sort_passes();
+	cull_passes();
+	place_transients();
+
+	for (uint32_t position = 0; position < pass_count; position++)
+	{
+		Pass& pass = passes[order[position]];
+		if (!pass.culled)
+		{
+			run_pass(pass, position);
+			frame_stats.passes++;
+		}
+	}
+	current_framebuffer = 0;
+
+	evict();
+	timers.end_frame();
+	frame++;
+}
+
+uint32_t RenderGraph::texture(RenderResource resource) const
+{
+	return resources[resource.index].texture;
+}
+
+uint32_t RenderGraph::framebuffer() const
+{
+	return current_framebuffer;
+}
+
+uint32_t RenderGraph::framebuffer_of(RenderResource resource)
+{
+	const Resource& source = resources[resource.index];
+	if (source.imported)
+	{
+		return source.framebuffer;
+	}
+	if (texel_format(source.desc.format).depth)
+	{
+		return cached_framebuffer(0, source.texture, source.desc.format);
+	}
+	return cached_framebuffer(source.texture, 0, 0);
+}
+
+const RenderGraphStats& RenderGraph::stats() const
+{
+	return frame_stats;
+}
+
+bool RenderGraph::depends(uint32_t b, uint32_t a) const
+{
+	// Readers wait for every pass writing what they read, and passes
+	// writing the same resource keep the order they were added in
+	const Pass& later = passes[b];
+	for (uint32_t resource : passes[a].writes)
+	{
+		const bool writes = contains(later.writes, resource);
+		if (writes ? a < b : contains(later.reads, resource))
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+void RenderGraph::sort_passes()
+{
+	order.clear();
+	scheduled.assign(pass_count, 0);
+	const auto waiting = [this](uint32_t pass) {
+		for (uint32_t other = 0; other < pass_count; other++)
+		{
+			if (other != pass && !scheduled[other] && depends(pass, other))
+			{
+				return true;
+			}
+		}
+		return false;
+	};
+
+	while (order.size() < pass_count)
+	{
+		// The first pass added with nothing left to wait for
+		uint32_t next = 0;
+		while (next < pass_count && (scheduled[next] || waiting(next)))
+		{
+			next++;
+		}
+		if (next == pass_count)
+		{
+			std::cerr << "Render graph passes depend on each other in a cycle, running them in "
+				"the order they were added.\n";
+			order.clear();
+			for (uint32_t pass = 0; pass < pass_count; pass++)
+			{
+				order.push_back(pass);
+			}
+			return;
+		}
+		scheduled[next] = 1;
+		order.push_back(next);
+	}
+}
+
+void RenderGraph::cull_passes()
+{
+	// Backwards from the imports, so a pass only runs if a pass after it
+	// needs something it writes
+	needed.assign(resource_count, 0);
+	for (uint32_t position = pass_count; position-- > 0;)
+	{
+		Pass& pass = passes[order[position]];
+		bool live = pass.keep;
+		for (uint32_t resource : pass.writes)
+		{
+			live = live || resources[resource].imported || needed[resource];
+		}
+		pass.culled = !live;
+		if (!live)
+		{
+			frame_stats.culled_passes++;
+			continue;
+		}
+
+		// Passes before it only matter for what it draws over or reads, not
+		// for what it clears
+		for (uint32_t resource : pass.writes)
+		{
+			const bool cleared = (pass.clear_color && resource == pass.color.index)
+				|| (pass.clear_depth && resource == pass.depth.index);
+			needed[resource] = !cleared;
+		}
+		for (uint32_t resource : pass.reads)
+		{
+			needed[resource] = 1;
+		}
+	}
+}
+
+void RenderGraph::place_transients()
+{
+	for (uint32_t position = 0; position < pass_count; position++)
+	{
+		const Pass& pass = passes[order[position]];
+		if (pass.culled)
+		{
+			continue;
+		}
+		for (const std::vector<uint32_t>* used : {&pass.reads, &pass.writes})
+		{
+			for (uint32_t index : *used)
+			{
+				Resource& resource = resources[index];
+				resource.first_use = std::min(resource.first_use, position);
+				resource.last_use = std::max(resource.last_use, position);
+			}
+		}
+	}
+
+	// In the order they're first used, each into a texture the ones before
+	// it are done with by then
+	transients.clear();
+	for (uint32_t index = 0; index < resource_count; index++)
+	{
+		if (!resources[index].imported && resources[index].first_use != UINT32_MAX)
+		{
+			transients.push_back(index);
+		}
+	}
+	std::sort(transients.begin(), transients.end(), [this](uint32_t a, uint32_t b) {
+		const uint32_t first_a = resources[a].first_use;
+		const uint32_t first_b = resources[b].first_use;
+		return first_a != first_b ? first_a < first_b : a < b;
+	});
+
+	for (uint32_t index : transients)
+	{
+		Resource& resource = resources[index];
+		Storage& storage = storages[find_storage(resource.desc, resource.first_use)];
+		if (!storage.in_use)
+		{
+			frame_stats.physical_textures++;
+			frame_stats.aliased_bytes += storage.bytes;
+		}
+		storage.in_use = true;
+		storage.free_after = resource.last_use;
+		storage.last_used = frame;
+		resource.texture = storage.desc.format == resource.desc.format
+			? storage.texture : view(storage, resource.desc.format);
+		frame_stats.transient_textures++;
+		frame_stats.transient_bytes += texture_size(resource.desc);
+	}
+}
+
+uint32_t RenderGraph::find_storage(const RenderTextureDesc& desc, uint32_t first_use)
+{
+	// One of the same format if there is one, so views are only made when
+	// they save a texture
+	uint32_t viewable = UINT32_MAX;
+	for (uint32_t i = 0; i < (uint32_t)storages.size(); i++)
+	{
+		const Storage& storage = storages[i];
+		const RenderTextureDesc& other = storage.desc;
+		if ((storage.in_use && storage.free_after >= first_use) || other.width != desc.width
+			|| other.height != desc.height || other.levels != desc.levels)
+		{
+			continue;
+		}
+		if (other.format == desc.format)
+		{
+			return i;
+		}
+		const uint32_t view_class = texel_format(desc.format).view_class;
+		if (texture_views && viewable == UINT32_MAX && view_class != 0
+			&& view_class == texel_format(other.format).view_class)
+		{
+			viewable = i;
+		}
+	}
+	if (viewable != UINT32_MAX)
+	{
+		return viewable;
+	}
+
+	// Views need immutable storage
+	Storage storage;
+	storage.desc = desc;
+	storage.bytes = texture_size(desc);
+	const TexelFormat texel = texel_format(desc.format);
+	glGenTextures(1, &storage.texture);
+	glBindTexture(GL_TEXTURE_2D, storage.texture);
+	if (texture_views)
+	{
+		glTexStorage2D(GL_TEXTURE_2D, desc.levels, desc.format, desc.width, desc.height);
+	}
+	else
+	{
+		for (int level = 0; level < desc.levels; level++)
+		{
+			glTexImage2D(GL_TEXTURE_2D, level, (GLint)desc.format, std::max(desc.width >> level, 1),
+				std::max(desc.height >> level, 1), 0, texel.format, texel.type, nullptr);
+		}
+	}
+	set_sampling(desc);
+	glBindTexture(GL_TEXTURE_2D, 0);
+	gpu_memory().allocate(GpuObject::Texture, storage.texture, GpuMemoryCategory::RenderTarget,
+		"RenderGraph", storage.bytes);
+	storages.push_back(storage);
+	return (uint32_t)storages.size() - 1;
+}
+
+uint32_t RenderGraph::view(Storage& storage, GLenum format)
+{
+	for (const auto& [view_format, view_texture] : storage.views)
+	{
+		if (view_format == format)
+		{
+			return view_texture;
+		}
+	}
+
+	// Shares the storage's memory, so isn't counted again
+	uint32_t view_texture = 0;
+	glGenTextures(1, &view_texture);
+	glTextureView(view_texture, GL_TEXTURE_2D, storage.texture, format, 0,
+		(GLuint)storage.desc.levels, 0, 1);
+	glBindTexture(GL_TEXTURE_2D, view_texture);
+	set_sampling({storage.desc.width, storage.desc.height, format, storage.desc.levels});
+	glBindTexture(GL_TEXTURE_2D, 0);
+	storage.views.emplace_back(format, view_texture);
+	return view_texture;
+}
+
+uint32_t RenderGraph::cached_framebuffer(uint32_t color, uint32_t depth, GLenum depth_format)
+{
+	for (Framebuffer& cached : framebuffers)
+	{
+		if (cached.color == color && cached.depth == depth)
+		{
+			cached.last_used = frame;
+			return cached.framebuffer;
+		}
+	}
+
+	Framebuffer cached;
+	cached.color = color;
+	cached.depth = depth;
+	cached.last_used = frame;
+	glGenFramebuffers(1, &cached.framebuffer);
+	glBindFramebuffer(GL_FRAMEBUFFER, cached.framebuffer);
+	if (color)
+	{
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, color, 0);
+	}
+	else
+	{
+		glDrawBuffer(GL_NONE);
+		glReadBuffer(GL_NONE);
+	}
+	if (depth)
+	{
+		glFramebufferTexture2D(GL_FRAMEBUFFER, depth_attachment(depth_format), GL_TEXTURE_2D,
+			depth, 0);
+	}
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+	{
+		std::cerr << "Render graph framebuffer is incomplete.\n";
+	}
+	framebuffers.push_back(cached);
+	return cached.framebuffer;
+}
+
+void RenderGraph::run_pass(Pass& pass, uint32_t position)
+{
+	current_framebuffer = 0;
+	const RenderResource target = pass.color.valid() ? pass.color : pass.depth;
+	if (target.valid())
+	{
+		const Resource* color = pass.color.valid() ? &resources[pass.color.index] : nullptr;
+		const Resource* depth = pass.depth.valid() ? &resources[pass.depth.index] : nullptr;
+		if (color && color->imported)
+		{
+			current_framebuffer = color->framebuffer;
+		}
+		else if (depth && depth->imported)
+		{
+			current_framebuffer = depth->framebuffer;
+		}
+		else
+		{
+			current_framebuffer = cached_framebuffer(color ? color->texture : 0,
+				depth ? depth->texture : 0, depth ? depth->desc.format : 0);
+		}
+		glBindFramebuffer(GL_FRAMEBUFFER, current_framebuffer);
+		const RenderTextureDesc& size = resources[target.index].desc;
+		glViewport(0, 0, size.width, size.height);
+	}
+
+	timers.begin(pass.name);
+	invalidate(pass, position, true);
+	const GLbitfield clear = (pass.clear_color ? GL_COLOR_BUFFER_BIT : 0u)
+		| (pass.clear_depth ? GL_DEPTH_BUFFER_BIT : 0u);
+	if (clear)
+	{
+		glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+		glClear(clear);
+	}
+	pass.execute(*this);
+	invalidate(pass, position, false);
+	timers.end();
+}
+
+void RenderGraph::invalidate(const Pass& pass, uint32_t position, bool first)
+{
+	// Transient attachments needn't be loaded before a pass that draws over
+	// whatever they held, nor stored after their last pass
+	if (!invalidation)
+	{
+		return;
+	}
+	std::array<GLenum, 2> attachments{};
+	GLsizei count = 0;
+	const auto add = [&](RenderResource handle, bool clear, GLenum attachment) {
+		if (!handle.valid() || resources[handle.index].imported)
+		{
+			return;
+		}
+		const Resource& resource = resources[handle.index];
+		if (first ? resource.first_use == position && !clear : resource.last_use == position)
+		{
+			attachments[(size_t)count++] = attachment;
+		}
+	};
+	add(pass.color, pass.clear_color, GL_COLOR_ATTACHMENT0);
+	if (pass.depth.valid())
+	{
+		const GLenum format = resources[pass.depth.index].desc.format;
+		add(pass.depth, pass.clear_depth, depth_attachment(format));
+	}
+	if (count > 0)
+	{
+		glInvalidateFramebuffer(GL_FRAMEBUFFER, count, attachments.data());
+		frame_stats.invalidations += (uint32_t)count;
+	}
+}
+
+void RenderGraph::evict()
+{
+	// Framebuffers are used no later than the textures they have attached,
+	// so they go no later than them either
+	const auto idle = [this](uint64_t last_used) {
+		return frame - last_used > RENDER_GRAPH_MAX_IDLE_FRAMES;
+	};
+	for (const Framebuffer& cached : framebuffers)
+	{
+		if (idle(cached.last_used))
+		{
+			glDeleteFramebuffers(1, &cached.framebuffer);
+		}
+	}
+	framebuffers.erase(std::remove_if(framebuffers.begin(), framebuffers.end(),
+		[&idle](const Framebuffer& cached) { return idle(cached.last_used); }), framebuffers.end());
+	for (const Storage& storage : storages)
+	{
+		if (idle(storage.last_used))
+		{
+			destroy_storage(storage);
+		}
+	}
+	storages.erase(std::remove_if(storages.begin(), storages.end(),
+		[&idle](const Storage& storage) { return idle(storage.last_used); }), storages.end());
+}
+
+void RenderGraph::destroy_storage(const Storage& storage)
+{
+	for (const auto& [format, view_texture] : storage.views)
+	{
+		glDeleteTextures(1, &view_texture);
+	}
+	gpu_memory().release(GpuObject::Texture, storage.texture);
+	glDeleteTextures(1, &storage.texture);
+}
@@ -0,0 +1,203 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "FrameTimer.h"
+
+typedef uint32_t GLenum;
+
+// Textures no frame has aliased anything onto in this many frames are
+// freed, e.g. the old sizes after the window or the resolution scale
+// changes
+constexpr uint64_t RENDER_GRAPH_MAX_IDLE_FRAMES = 60;
+
+// A texture or an imported framebuffer of this frame's graph
+struct RenderResource
+{
+	uint32_t index = UINT32_MAX;
+
+	bool valid() const
+	{
+		return index != UINT32_MAX;
+	}
+};
+
+struct RenderTextureDesc
+{
+	int width = 0;
+	int height = 0;
+	GLenum format = 0;
+	int levels = 1;
+};
+
+// What one frame's graph came to
+struct RenderGraphStats
+{
+	uint32_t passes = 0; // that ran
+	uint32_t culled_passes = 0;
+	uint32_t transient_textures = 0; // that some pass used
+	uint32_t physical_textures = 0; // they were aliased onto
+	size_t transient_bytes = 0; // had each transient had a texture of its own
+	size_t aliased_bytes = 0; // of the textures they were aliased onto
+	uint32_t invalidations = 0; // attachments
+};
+
+// The passes of a frame and the textures they pass between them, rebuilt
+// every frame. Passes declare what they read and write, and run in an
+// order that respects it once the whole frame is known; passes whose
+// writes nobody reads don't run at all. Transient textures only live from
+// the first pass using them to the last, so those whose lifetimes don't
+// overlap share a texture, and attachments are invalidated when their
+// contents are about to be overwritten or won't be looked at again.
+// Imported framebuffers are where the frame ends up, and passes writing
+// them always run.
+class RenderGraph
+{
+public:
+	using Execute = std::function<void(RenderGraph& graph)>;
+
+	// Declares what a pass touches
+	class PassBuilder
+	{
+	public:
+		// Sampled or fetched
+		PassBuilder& read(RenderResource resource);
+		// Written as an image or by a blit
+		PassBuilder& write(RenderResource resource);
+		// Drawn into. Without clearing, the pass draws over what the passes
+		// before it left there.
+		PassBuilder& color(RenderResource resource, bool clear = false);
+		PassBuilder& depth(RenderResource resource, bool clear = false);
+		// Runs even when nothing reads what it writes, for passes with
+		// effects the graph doesn't see
+		PassBuilder& keep();
+
+	private:
+		friend class RenderGraph;
+		PassBuilder(RenderGraph& graph, uint32_t pass);
+
+		RenderGraph& graph;
+		uint32_t pass = 0;
+	};
+
+	// Texture views and framebuffer invalidation both need GL 4.3. Without
+	// views transients only share textures of their own format.
+	void initialize(bool texture_views, bool invalidation);
+	void destroy();
+
+	// Forgets the last frame's passes and resources
+	void begin_frame();
+	// Lives from the first pass using it to the last, and has undefined
+	// contents until a pass writes it
+	RenderResource create_texture(const std::string& name, const RenderTextureDesc& desc);
+	// A framebuffer from outside the graph, attached whole: passes drawing
+	// into it can't draw into a transient at the same time
+	RenderResource import_framebuffer(const std::string& name, uint32_t framebuffer, int width,
+		int height);
+	const RenderTextureDesc& desc(RenderResource resource) const;
+
+	PassBuilder add_pass(const std::string& name, Execute execute);
+	// Orders, culls and runs the passes, with their attachments bound and
+	// the viewport covering them
+	void execute();
+
+	// While a pass runs. Imports have no texture.
+	uint32_t texture(RenderResource resource) const;
+	// With the pass's attachments, 0 if it has none
+	uint32_t framebuffer() const;
+	// With the texture as its only attachment, e.g. to blit from
+	uint32_t framebuffer_of(RenderResource resource);
+
+	const RenderGraphStats& stats() const;
+
+	// Every pass that runs, by name
+	PassTimer timers;
+
+private:
+	struct Resource
+	{
+		std::string name;
+		RenderTextureDesc desc;
+		uint32_t framebuffer = 0; // imported
+		bool imported = false;
+		// Positions in the order the passes run
+		uint32_t first_use = UINT32_MAX;
+		uint32_t last_use = 0;
+		uint32_t texture = 0; // the storage's, or a view of it
+	};
+
+	struct Pass
+	{
+		std::string name;
+		Execute execute;
+		std::vector<uint32_t> reads;
+		std::vector<uint32_t> writes; // attachments too
+		RenderResource color;
+		RenderResource depth;
+		bool clear_color = false;
+		bool clear_depth = false;
+		bool keep = false;
+		bool culled = false;
+	};
+
+	// A texture transients are aliased onto, kept from frame to frame
+	struct Storage
+	{
+		RenderTextureDesc desc;
+		uint32_t texture = 0;
+		size_t bytes = 0;
+		std::vector<std::pair<GLenum, uint32_t>> views; // format, texture
+		uint64_t last_used = 0; // frame
+		uint32_t free_after = 0; // position of this frame's last pass using it
+		bool in_use = false; // this frame
+	};
+
+	struct Framebuffer
+	{
+		uint32_t color = 0; // textures
+		uint32_t depth = 0;
+		uint32_t framebuffer = 0;
+		uint64_t last_used = 0; // frame
+	};
+
+	// Whether pass b has to wait for pass a
+	bool depends(uint32_t b, uint32_t a) const;
+	void sort_passes();
+	void cull_passes();
+	void place_transients();
+	// The frame's storage the transient can live in, made if there is none
+	uint32_t find_storage(const RenderTextureDesc& desc, uint32_t first_use);
+	uint32_t view(Storage& storage, GLenum format);
+	uint32_t cached_framebuffer(uint32_t color, uint32_t depth, GLenum depth_format);
+	void run_pass(Pass& pass, uint32_t position);
+	void invalidate(const Pass& pass, uint32_t position, bool first);
+	// Frees what has sat idle too long
+	void evict();
+	static void destroy_storage(const Storage& storage);
+
+	bool texture_views = false;
+	bool invalidation = false;
+	uint64_t frame = 0;
+
+	// Slots are reused from frame to frame, so their vectors and names
+	// keep their memory
+	std::vector<Resource> resources;
+	std::vector<Pass> passes;
+	uint32_t resource_count = 0;
+	uint32_t pass_count = 0;
+
+	std::vector<Storage> storages;
+	std::vector<Framebuffer> framebuffers;
+
+	std::vector<uint32_t> order; // of the passes
+	std::vector<uint8_t> scheduled; // scratch
+	std::vector<uint8_t> needed; // scratch
+	std::vector<uint32_t> transients; // scratch
+	uint32_t current_framebuffer = 0;
+	RenderGraphStats frame_stats;
+};
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Counters for one frame, reset when the frame starts
+struct RenderStats
+{
+	uint32_t draw_calls = 0;
+	uint32_t instances = 0; // scene instances drawn
+	uint32_t frustum_culled = 0; // scene instances
+	uint32_t occlusion_culled = 0;
+	uint32_t shadow_pages = 0; // static shadow pages drawn again
+	uint32_t lights = 0;
+	uint32_t light_assignments = 0; // light to cluster
+	double light_assign_ms = 0.0; // CPU time assigning them
+	uint32_t texture_bind_requests = 0; // binds the frame asked for
+	uint32_t texture_binds = 0; // binds that actually changed GL state
+	uint32_t material_changes = 0;
+	uint32_t vertex_array_binds = 0;
+	uint32_t heap_allocations = 0; // operator new calls during the frame
+	size_t frame_arena_bytes = 0;
+	size_t gbuffer_bytes = 0; // written and read back, not counting caches
+	double resolution_scale = 0.0; // of the window the scene rendered at
+	uint32_t render_passes = 0; // that the render graph ran
+	uint32_t culled_passes = 0;
+	size_t transient_bytes = 0; // of the graph's textures, had each its own
+	size_t aliased_transient_bytes = 0; // of what they were aliased onto
+	uint32_t invalidations = 0; // attachments
+
+	void accumulate(const RenderStats& other)
+	{
+		draw_calls += other.draw_calls;
+		instances += other.instances;
+		frustum_culled += other.frustum_culled;
+		occlusion_culled += other.occlusion_culled;
+		shadow_pages += other.shadow_pages;
+		lights += other.lights;
+		light_assignments += other.light_assignments;
+		light_assign_ms += other.light_assign_ms;
+		texture_bind_requests += other.texture_bind_requests;
+		texture_binds += other.texture_binds;
+		material_changes += other.material_changes;
+		vertex_array_binds += other.vertex_array_binds;
+		heap_allocations += other.heap_allocations;
+		frame_arena_bytes += other.frame_arena_bytes;
+		gbuffer_bytes += other.gbuffer_bytes;
+		resolution_scale += other.resolution_scale;
+		render_passes += other.render_passes;
+		culled_passes += other.culled_passes;
+		transient_bytes += other.transient_bytes;
+		aliased_transient_bytes += other.aliased_transient_bytes;
+		invalidations += other.invalidations;
+	}
+};
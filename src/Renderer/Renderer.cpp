@@ -1,13 +1,92 @@
 #include "Renderer.h"
 
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstddef>
+#include <fstream>
 #include <iostream>
 #include <string>
 #include <vector>
 
 #include <GL/glew.h>
 #include <GL/gl.h>
+#include <glm/geometric.hpp>
+#include <glm/matrix.hpp>
 
+#include "../Jobs/JobSystem.h"
+#include "../Memory/HeapCounter.h"
+#include "../Resources/GpuMemory.h"
 #include "../Shader/Shader.h"
+#include "TimingReport.h"
+#include "../Capture/GLCapture.h"
+#include "../Capture/CapturedGL.h"
+
+namespace
+{
+	// The deferred path's targets, see GBUFFER_BYTES_PER_PIXEL
+	constexpr GLenum GBUFFER_SURFACE_FORMAT = GL_RGBA16UI;
+	constexpr GLenum GBUFFER_DEPTH_FORMAT = GL_DEPTH_COMPONENT24;
+
+	// Where the model shader reads the per instance transform
+	constexpr GLuint INSTANCE_POSITION_LOCATION = 4;
+	constexpr GLuint INSTANCE_ROTATION_LOCATION = 5;
+
+	// With their arrays disabled, the instance attributes read these: no
+	// translation, a scale of one and the identity rotation
+	void reset_instance_attributes()
+	{
+		glVertexAttrib4f(INSTANCE_POSITION_LOCATION, 0.0f, 0.0f, 0.0f, 1.0f);
+		glVertexAttrib4f(INSTANCE_ROTATION_LOCATION, 0.0f, 0.0f, 0.0f, 1.0f);
+	}
+
+	// Depth blits need matching formats, so the GPU culling copy of the
+	// window's depth has to know what the window was given
+	GLenum window_depth_format()
+	{
+		GLint depth_bits = 0;
+		GLint stencil_bits = 0;
+		glGetFramebufferAttachmentParameteriv(GL_FRAMEBUFFER, GL_DEPTH,
+			GL_FRAMEBUFFER_ATTACHMENT_DEPTH_SIZE, &depth_bits);
+		glGetFramebufferAttachmentParameteriv(GL_FRAMEBUFFER, GL_STENCIL,
+			GL_FRAMEBUFFER_ATTACHMENT_STENCIL_SIZE, &stencil_bits);
+		if (depth_bits == 24 && stencil_bits == 8)
+		{
+			return GL_DEPTH24_STENCIL8;
+		}
+		return depth_bits == 32 ? GL_DEPTH_COMPONENT32 : depth_bits == 16 ? GL_DEPTH_COMPONENT16
+			: GL_DEPTH_COMPONENT24;
+	}
+
+	bool gl_version_at_least(GLint major, GLint minor)
+	{
+		GLint context_major = 0;
+		GLint context_minor = 0;
+		glGetIntegerv(GL_MAJOR_VERSION, &context_major);
+		glGetIntegerv(GL_MINOR_VERSION, &context_minor);
+		return context_major * 10 + context_minor >= major * 10 + minor;
+	}
+
+	// Samplers never move, so point them at their units once
+	void set_model_samplers(const Shader& shader)
+	{
+		glUseProgram(shader.program);
+		shader.set_uniform("diffuse_maps", 0);
+		shader.set_uniform("materials", 1);
+		shader.set_uniform("lights", 2);
+		shader.set_uniform("light_clusters", 3);
+		shader.set_uniform("light_indices", 4);
+		shader.set_uniform("gbuffer", 5);
+		shader.set_uniform("gbuffer_depth", 6);
+		shader.set_uniform("shadow_maps", 7);
+		glUseProgram(0);
+	}
+}
+
+Renderer::Renderer(std::shared_ptr<JobSystem> job_system)
+	: jobs(std::move(job_system))
+{
+}
 
 void Renderer::set_render_mode(const GLenum &mode)
 {
@@ -16,7 +95,913 @@ void Renderer::set_render_mode(const GLenum &mode)
 
 void Renderer::resize_window(int width, int height)
 {
-	glViewport(0, 0, width, height);
+	// The next frame sets up its viewport from these
+	window_width = std::max(width, 1);
+	window_height = std::max(height, 1);
+}
+
+void Renderer::bind_texture(uint32_t unit, GLenum target, uint32_t id)
+{
+	frame_stats.texture_bind_requests++;
+
+	TextureBinding& binding = texture_bindings[unit];
+	if (binding.target == target && binding.texture == id)
+	{
+		return;
+	}
+
+	glActiveTexture(GL_TEXTURE0 + unit);
+	glBindTexture(target, id);
+	binding.target = target;
+	binding.texture = id;
+	frame_stats.texture_binds++;
+}
+
+void Renderer::bind_instance_arrays(uint32_t buffer)
+{
+	glBindBuffer(GL_ARRAY_BUFFER, buffer);
+	glEnableVertexAttribArray(INSTANCE_POSITION_LOCATION);
+	glEnableVertexAttribArray(INSTANCE_ROTATION_LOCATION);
+	glVertexAttribDivisor(INSTANCE_POSITION_LOCATION, 1);
+	glVertexAttribDivisor(INSTANCE_ROTATION_LOCATION, 1);
+}
+
+void Renderer::point_instance_arrays(uint32_t first_instance)
+{
+	// Without a base instance in GL 3.3, the instances start where the
+	// attribute pointers do
+	const uintptr_t offset = (uintptr_t)first_instance * sizeof(SceneInstanceData);
+	glVertexAttribPointer(INSTANCE_POSITION_LOCATION, 4, GL_FLOAT, GL_FALSE,
+		sizeof(SceneInstanceData), reinterpret_cast<const void*>(offset));
+	glVertexAttribPointer(INSTANCE_ROTATION_LOCATION, 4, GL_FLOAT, GL_FALSE,
+		sizeof(SceneInstanceData),
+		reinterpret_cast<const void*>(offset + offsetof(SceneInstanceData, rotation)));
+}
+
+void Renderer::unbind_instance_arrays()
+{
+	glDisableVertexAttribArray(INSTANCE_POSITION_LOCATION);
+	glDisableVertexAttribArray(INSTANCE_ROTATION_LOCATION);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	reset_instance_attributes();
+}
+
+void Renderer::draw_ranges(const DrawRange* ranges, uint32_t count,
+	const GeometryRange& geometry)
+{
+	if (count == 0)
+	{
+		return;
+	}
+
+	const ArenaScope scope(scratch_arena());
+	GLsizei* counts = scratch_arena().allocate<GLsizei>(count);
+	const void** offsets = scratch_arena().allocate<const void*>(count);
+	GLint* base_vertices = scratch_arena().allocate<GLint>(count);
+	for (uint32_t i = 0; i < count; i++)
+	{
+		counts[i] = (GLsizei)ranges[i].index_count;
+		offsets[i] = reinterpret_cast<const void*>(
+			((uintptr_t)geometry.first_index + ranges[i].index_offset) * sizeof(uint32_t));
+		base_vertices[i] = (GLint)geometry.base_vertex;
+	}
+
+	glMultiDrawElementsBaseVertex(GL_TRIANGLES, counts, GL_UNSIGNED_INT, offsets,
+		(GLsizei)count, base_vertices);
+}
+
+uint32_t Renderer::add_model(const std::string& path, int lod_count,
+	std::shared_ptr<Model> model, const glm::mat4& transform)
+{
+	RenderModel render_model;
+	render_model.transform = transform;
+	render_model.center = (model->bounds_min + model->bounds_max) * 0.5f;
+	render_model.radius = model->radius;
+	render_model.material_count = model->materials.size();
+	render_model.submesh_count = model->lods[0].submeshes.size();
+	render_model.handle = residency.create_model(path, lod_count, std::move(model));
+
+	models.push_back(render_model);
+	return (uint32_t)models.size() - 1;
+}
+
+void Renderer::set_model_transform(uint32_t model, const glm::mat4& transform)
+{
+	models[model].transform = transform;
+	models[model].dynamic = true;
+}
+
+bool Renderer::load_scene(const std::string& path)
+{
+	if (!scene.open(path))
+	{
+		return false;
+	}
+
+	const SceneFileHeader& header = scene.header();
+	if (gpu_culling.is_initialized())
+	{
+		gpu_culling.load_scene(header);
+	}
+	scene_meshes.assign(header.meshes.count, SceneMeshState());
+	for (size_t i = 0; i < header.meshes.count; i++)
+	{
+		const SceneMesh& mesh = header.meshes[i];
+		scene_meshes[i].handle = residency.create_model(mesh.path.data, (int)mesh.lod_count);
+	}
+
+	std::cout << "Scene " << path << ": " << header.instance_count << " instances of "
+			  << header.meshes.count << " meshes, " << header.materials.count << " materials, "
+			  << header.nodes.count << " hierarchy nodes\n";
+	return true;
+}
+
+const SceneFile& Renderer::scene_file() const
+{
+	return scene;
+}
+
+void Renderer::set_residency_budget(const ResidencyBudget& budget)
+{
+	residency.set_budget(budget);
+}
+
+void Renderer::assign_lights(float aspect)
+{
+	const auto start = std::chrono::steady_clock::now();
+	light_clusters.assign(lights, camera, aspect, *jobs);
+	frame_stats.light_assign_ms = std::chrono::duration<double, std::milli>(
+		std::chrono::steady_clock::now() - start).count();
+	frame_stats.lights = light_clusters.stats.lights;
+	frame_stats.light_assignments = light_clusters.stats.indices;
+
+	// Empty lists still need a buffer behind them
+	const GpuLight no_light;
+	const uint16_t no_index = 0;
+	upload_light_buffer(light_data, GL_RGBA32F,
+		light_clusters.gpu_lights.empty() ? &no_light : light_clusters.gpu_lights.data(),
+		std::max(light_clusters.gpu_lights.size(), (size_t)1) * sizeof(GpuLight));
+	upload_light_buffer(light_cluster_data, GL_RG32UI, light_clusters.clusters.data(),
+		light_clusters.clusters.size() * sizeof(LightCluster));
+	upload_light_buffer(light_index_data, GL_R16UI,
+		light_clusters.indices.empty() ? &no_index : light_clusters.indices.data(),
+		std::max(light_clusters.indices.size(), (size_t)1) * sizeof(uint16_t));
+
+	bind_texture(2, GL_TEXTURE_BUFFER, light_data.texture);
+	bind_texture(3, GL_TEXTURE_BUFFER, light_cluster_data.texture);
+	bind_texture(4, GL_TEXTURE_BUFFER, light_index_data.texture);
+}
+
+void Renderer::upload_light_buffer(LightBuffer& light_buffer, GLenum format, const void* data,
+	size_t bytes)
+{
+	if (!light_buffer.buffer)
+	{
+		glGenBuffers(1, &light_buffer.buffer);
+		glGenTextures(1, &light_buffer.texture);
+	}
+
+	// Orphaned every frame like the instance buffer. The texture keeps
+	// pointing at the buffer, so it only needs attaching once it grows.
+	glBindBuffer(GL_TEXTURE_BUFFER, light_buffer.buffer);
+	const bool grow = bytes > light_buffer.size;
+	if (grow)
+	{
+		light_buffer.size = std::max(bytes, light_buffer.size * 2);
+		gpu_memory().allocate(GpuObject::Buffer, light_buffer.buffer, GpuMemoryCategory::Uniform,
+			"LightClusters", light_buffer.size);
+	}
+	glBufferData(GL_TEXTURE_BUFFER, (GLsizeiptr)light_buffer.size, nullptr, GL_STREAM_DRAW);
+	glBufferSubData(GL_TEXTURE_BUFFER, 0, (GLsizeiptr)bytes, data);
+	glBindBuffer(GL_TEXTURE_BUFFER, 0);
+	if (grow)
+	{
+		glBindTexture(GL_TEXTURE_BUFFER, light_buffer.texture);
+		glTexBuffer(GL_TEXTURE_BUFFER, format, light_buffer.buffer);
+		glBindTexture(GL_TEXTURE_BUFFER, 0);
+	}
+}
+
+void Renderer::set_light_uniforms(const Shader& target) const
+{
+	target.set_uniform("cluster_grid",
+		glm::ivec3(CLUSTER_GRID_X, CLUSTER_GRID_Y, CLUSTER_GRID_Z));
+	target.set_uniform("cluster_tile_scale", glm::vec2((float)CLUSTER_GRID_X / (float)render_width,
+		(float)CLUSTER_GRID_Y / (float)render_height));
+	target.set_uniform("cluster_depth",
+		glm::vec2(light_clusters.depth_scale, light_clusters.depth_bias));
+	target.set_uniform("depth_range", glm::vec2(camera.near_plane, camera.far_plane));
+	target.set_uniform("light_direction", sun_direction);
+
+	// Splits of zero put every fragment past the last cascade, unshadowed
+	std::array<glm::mat4, SHADOW_CASCADES> shadow_matrices;
+	shadow_matrices.fill(glm::mat4(1.0f));
+	glm::vec4 shadow_splits(0.0f);
+	glm::vec4 shadow_texel_sizes(0.0f);
+	for (uint32_t i = 0; i < SHADOW_CASCADES && shadows; i++)
+	{
+		shadow_matrices[i] = shadow_maps.cascades[i].view_projection;
+		shadow_splits[(int)i] = shadow_maps.cascades[i].split;
+		shadow_texel_sizes[(int)i] = shadow_maps.cascades[i].texel_size;
+	}
+	target.set_uniform("shadow_matrices", shadow_matrices.data(), (int)SHADOW_CASCADES);
+	target.set_uniform("shadow_splits", shadow_splits);
+	target.set_uniform("shadow_texel_sizes", shadow_texel_sizes);
+}
+
+void Renderer::bind_material(const Shader& target, uint32_t material, uint32_t& bound_material)
+{
+	if (material == bound_material)
+	{
+		return;
+	}
+
+	const uint32_t texture_array = material_library.texture_array(material);
+	if (texture_array)
+	{
+		bind_texture(0, GL_TEXTURE_2D_ARRAY, texture_array);
+	}
+	target.set_uniform("material_index", (int)material);
+	bound_material = material;
+	frame_stats.material_changes++;
+}
+
+void Renderer::collect_scene_instances(const Frustum& frustum, float projection_scale)
+{
+	const SceneFileHeader& header = scene.header();
+	const SceneInstances& instances = header.instances;
+
+	visible_instances.clear();
+	CullStats cull_stats;
+	cull_scene(header, frustum, visible_instances, cull_stats);
+	frame_stats.frustum_culled += cull_stats.frustum_culled;
+
+	// Count the survivors of each mesh and find the closest, for its LOD and
+	// its size on screen
+	for (SceneMeshState& mesh : scene_meshes)
+	{
+		mesh.instance_count = 0;
+		mesh.nearest = FLT_MAX;
+		mesh.resident = nullptr;
+	}
+	for (const uint32_t instance : visible_instances)
+	{
+		SceneMeshState& mesh = scene_meshes[instances.mesh[instance]];
+		const glm::vec3 center(instances.center_x[instance], instances.center_y[instance],
+			instances.center_z[instance]);
+		mesh.nearest = std::min(mesh.nearest,
+			glm::distance(camera.position, center) / instances.scale[instance]);
+		mesh.instance_count++;
+	}
+
+	// Meshes still streaming in get no space in the buffer
+	uint32_t total = 0;
+	for (size_t i = 0; i < scene_meshes.size(); i++)
+	{
+		SceneMeshState& mesh = scene_meshes[i];
+		if (mesh.instance_count == 0)
+		{
+			continue;
+		}
+		const float screen_size = header.meshes[i].radius * projection_scale
+			/ std::max(mesh.nearest, camera.near_plane);
+		residency.touch(mesh.handle, frame_count, screen_size);
+		mesh.resident = residency.model(mesh.handle);
+		if (!mesh.resident)
+		{
+			mesh.instance_count = 0;
+			continue;
+		}
+		if (mesh.resident->model->material_ids.empty())
+		{
+			material_library.add_model(*mesh.resident->model);
+		}
+		mesh.first_instance = total;
+		total += mesh.instance_count;
+		mesh.instance_count = 0;
+	}
+	frame_stats.instances += total;
+	if (total == 0)
+	{
+		return;
+	}
+
+	// Scatter the transforms into mesh order, straight from the file
+	SceneInstanceData* data = frame_arena.current().allocate<SceneInstanceData>(total);
+	for (const uint32_t instance : visible_instances)
+	{
+		SceneMeshState& mesh = scene_meshes[instances.mesh[instance]];
+		if (!mesh.resident)
+		{
+			continue;
+		}
+		SceneInstanceData& out = data[mesh.first_instance + mesh.instance_count++];
+		out.position_scale = glm::vec4(instances.position_x[instance],
+			instances.position_y[instance], instances.position_z[instance],
+			instances.scale[instance]);
+		out.rotation = glm::vec4(instances.rotation_x[instance], instances.rotation_y[instance],
+			instances.rotation_z[instance], instances.rotation_w[instance]);
+	}
+
+	upload_instances(instance_buffer, instance_buffer_size, data, total, "scene instances");
+}
+
+void Renderer::upload_instances(uint32_t& buffer, size_t& buffer_size,
+	const SceneInstanceData* instances, uint32_t count, const char* owner)
+{
+	// Orphaned on every upload so it never waits on the draws before
+	const size_t bytes = sizeof(SceneInstanceData) * count;
+	if (!buffer)
+	{
+		glGenBuffers(1, &buffer);
+	}
+	glBindBuffer(GL_ARRAY_BUFFER, buffer);
+	if (bytes > buffer_size)
+	{
+		buffer_size = std::max(bytes, buffer_size * 2);
+		gpu_memory().allocate(GpuObject::Buffer, buffer, GpuMemoryCategory::Vertex, owner,
+			buffer_size);
+	}
+	glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr)buffer_size, nullptr, GL_STREAM_DRAW);
+	glBufferSubData(GL_ARRAY_BUFFER, 0, (GLsizeiptr)bytes, instances);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void Renderer::draw_scene_instances(const Shader& target, uint32_t& bound_material)
+{
+	const float projection_scale = camera.projection_scale(render_height);
+	target.set_uniform("model", glm::mat4(1.0f));
+
+	bind_instance_arrays(instance_buffer);
+	for (SceneMeshState& mesh : scene_meshes)
+	{
+		if (mesh.instance_count == 0)
+		{
+			continue;
+		}
+		Model& model = *mesh.resident->model;
+		const GeometryRange& geometry = geometry_heap.range(mesh.resident->geometry);
+
+		point_instance_arrays(mesh.first_instance);
+
+		// Every instance shares the LOD of the closest
+		const uint32_t lod = select_lod(model, mesh.lod_state, mesh.nearest, projection_scale,
+			LOD_PIXEL_THRESHOLD);
+		for (const Submesh& submesh : model.lods[lod].submeshes)
+		{
+			bind_material(target, model.material_ids[submesh.material], bound_material);
+			glDrawElementsInstancedBaseVertex(GL_TRIANGLES, (GLsizei)submesh.index_count,
+				GL_UNSIGNED_INT, reinterpret_cast<const void*>(
+					((uintptr_t)geometry.first_index + submesh.index_offset) * sizeof(uint32_t)),
+				(GLsizei)mesh.instance_count, (GLint)geometry.base_vertex);
+			frame_stats.draw_calls++;
+		}
+	}
+	unbind_instance_arrays();
+}
+
+void Renderer::add_gpu_scene_draws(float projection_scale)
+{
+	const SceneFileHeader& header = scene.header();
+	gpu_culling.begin_frame();
+	const std::vector<GpuCullMeshStats>& seen = gpu_culling.mesh_stats();
+
+	for (uint32_t i = 0; i < (uint32_t)scene_meshes.size(); i++)
+	{
+		SceneMeshState& mesh = scene_meshes[i];
+		// Meshes that were out of sight keep whatever residency they had
+		if (seen[i].visible > 0)
+		{
+			const float screen_size = header.meshes[i].radius * projection_scale
+				/ std::max(seen[i].nearest, camera.near_plane);
+			residency.touch(mesh.handle, frame_count, screen_size);
+		}
+		mesh.resident = residency.model(mesh.handle);
+		if (!mesh.resident)
+		{
+			continue;
+		}
+		Model& model = *mesh.resident->model;
+		if (model.material_ids.empty())
+		{
+			material_library.add_model(model);
+		}
+
+		// Every instance shares the LOD of the closest the GPU last saw
+		const uint32_t lod = seen[i].visible > 0
+			? select_lod(model, mesh.lod_state, seen[i].nearest, projection_scale,
+				LOD_PIXEL_THRESHOLD)
+			: std::min(mesh.lod_state.lod, (uint32_t)model.lods.size() - 1);
+		const GeometryRange& geometry = geometry_heap.range(mesh.resident->geometry);
+		for (const Submesh& submesh : model.lods[lod].submeshes)
+		{
+			gpu_culling.add_draw(i, submesh.index_count, geometry.first_index + submesh.index_offset,
+				(int32_t)geometry.base_vertex, model.material_ids[submesh.material]);
+		}
+	}
+}
+
+void Renderer::draw_gpu_scene(const Shader& target)
+{
+	// Each draw's base instance is where its mesh's slice starts
+	bind_instance_arrays(gpu_culling.instance_buffer());
+	point_instance_arrays(0);
+
+	// Draws without a diffuse map go with whichever texture array is bound
+	const std::vector<uint32_t>& materials = gpu_culling.draw_materials();
+	for (uint32_t first = 0; first < (uint32_t)materials.size();)
+	{
+		uint32_t texture_array = material_library.texture_array(materials[first]);
+		uint32_t last = first + 1;
+		for (; last < (uint32_t)materials.size(); last++)
+		{
+			const uint32_t next = material_library.texture_array(materials[last]);
+			if (next && texture_array && next != texture_array)
+			{
+				break;
+			}
+			texture_array = std::max(texture_array, next);
+		}
+
+		if (texture_array)
+		{
+			bind_texture(0, GL_TEXTURE_2D_ARRAY, texture_array);
+		}
+		target.set_uniform("first_draw", (int)first);
+		gpu_culling.draw(first, last - first);
+		frame_stats.draw_calls++;
+		first = last;
+	}
+	unbind_instance_arrays();
+}
+
+void Renderer::draw_models()
+{
+	const float aspect = (float)window_width / (float)window_height;
+	view_projection = camera.projection(aspect) * camera.view();
+	const Frustum frustum = extract_frustum(view_projection);
+	// Screen sizes are in the pixels actually rendered, so lower scales
+	// pick coarser LODs too
+	const float projection_scale = camera.projection_scale(render_height);
+
+	draw_list.clear(frame_arena.current());
+	for (uint32_t i = 0; i < (uint32_t)models.size(); i++)
+	{
+		RenderModel& render_model = models[i];
+		const glm::mat4& transform = render_model.transform;
+		render_model.resident = nullptr;
+
+		const float scale = max_axis_scale(transform);
+		const glm::vec3 center = glm::vec3(transform * glm::vec4(render_model.center, 1.0f));
+		const float radius = render_model.radius * scale;
+		if (!sphere_in_frustum(frustum, center, radius))
+		{
+			continue;
+		}
+
+		// Asks for the model if it isn't resident, and keeps it from being
+		// evicted this frame if it is
+		const float distance = glm::distance(camera.position, center);
+		const float screen_size = radius * projection_scale / std::max(distance, camera.near_plane);
+		residency.touch(render_model.handle, frame_count, screen_size);
+
+		render_model.resident = residency.model(render_model.handle);
+		if (!render_model.resident)
+		{
+			continue;
+		}
+		Model& model = *render_model.resident->model;
+
+		// Models streamed back in come without material ids
+		if (model.material_ids.empty())
+		{
+			material_library.add_model(model);
+		}
+
+		// LOD errors are in model space, so measure the distance there too
+		const uint32_t lod = select_lod(model, render_model.lod_state,
+			distance / scale, projection_scale, LOD_PIXEL_THRESHOLD);
+		const std::vector<Submesh>& submeshes = model.lods[lod].submeshes;
+
+		// Only LOD 0 has meshlets; coarser levels draw whole submeshes
+		model_ranges.clear();
+		if (lod == 0 && !model.meshlets.empty())
+		{
+			CullStats cull_stats;
+			cull_meshlets(model, transform, frustum, camera.position, model_ranges, cull_stats);
+		}
+		else
+		{
+			for (uint32_t j = 0; j < (uint32_t)submeshes.size(); j++)
+			{
+				model_ranges.push_back({submeshes[j].index_offset, submeshes[j].index_count, j});
+			}
+		}
+
+		// One draw per submesh that survived
+		const float depth = distance / camera.far_plane;
+		for (size_t first = 0; first < model_ranges.size();)
+		{
+			size_t last = first + 1;
+			while (last < model_ranges.size() && model_ranges[last].submesh == model_ranges[first].submesh)
+			{
+				last++;
+			}
+
+			const uint32_t material = model.material_ids[submeshes[model_ranges[first].submesh].material];
+			const uint64_t key = make_sort_key(material_library.texture_array(material),
+				geometry_heap.vertex_array(), material, depth);
+			draw_list.add(key, i, material, &model_ranges[first], (uint32_t)(last - first));
+			first = last;
+		}
+	}
+	draw_list.sort();
+
+	gpu_scene = scene.is_open() && gpu_culling.is_initialized();
+	if (gpu_scene)
+	{
+		add_gpu_scene_draws(projection_scale);
+	}
+	else if (scene.is_open())
+	{
+		collect_scene_instances(frustum, projection_scale);
+	}
+
+	// Picks up the materials of models loaded since the last frame
+	material_library.upload(texture_packer, *jobs);
+
+	if (gpu_scene)
+	{
+		gpu_culling.cull(frustum, camera.position);
+
+		// The counters trail by a few frames
+		const GpuCullCounters& counters = gpu_culling.counters();
+		frame_stats.instances += counters.drawn;
+		frame_stats.frustum_culled += counters.frustum_culled;
+		frame_stats.occlusion_culled += counters.occlusion_culled;
+	}
+	assign_lights(aspect);
+	if (shadows)
+	{
+		draw_shadows(aspect);
+		bind_texture(7, GL_TEXTURE_2D_ARRAY, shadow_maps.texture());
+	}
+	// Whatever's missing this frame is compiled out of the shaders
+	shader_features = (shadows ? SHADER_SHADOWS : 0)
+		| (lights.empty() ? 0 : SHADER_CLUSTERED_LIGHTS);
+
+	RenderResource depth = scene_depth;
+	GLenum format = depth_format;
+	if (shading_path == ShadingPath::Deferred)
+	{
+		depth = add_deferred_passes();
+		format = GBUFFER_DEPTH_FORMAT;
+	}
+	else
+	{
+		frame_graph.add_pass("forward", [this](RenderGraph&) {
+			glEnable(GL_DEPTH_TEST);
+			submit_draws(model_shaders.get(shader_features),
+				model_shaders.get(shader_features | (gpu_scene ? SHADER_GPU_CULLED : 0)));
+			glDisable(GL_DEPTH_TEST);
+		})
+			.color(scene_color, true)
+			.depth(scene_depth, true);
+	}
+
+	// What next frame's instances are tested against
+	if (gpu_scene)
+	{
+		frame_graph.add_pass("hiz", [this, depth, format](RenderGraph& graph) {
+			gpu_culling.build_hiz(graph.framebuffer_of(depth), render_width, render_height, format,
+				view_projection);
+		})
+			.read(depth)
+			.keep();
+	}
+}
+
+void Renderer::draw_shadows(float aspect)
+{
+	// The static casters' bounds, and a version that changes whenever one
+	// of them streams in or out
+	glm::vec3 bounds_min(FLT_MAX);
+	glm::vec3 bounds_max(-FLT_MAX);
+	uint64_t static_version = 14695981039346656037ull;
+	const auto mix = [&static_version](const ResidentModel* resident) {
+		static_version = (static_version ^ (uintptr_t)(resident ? resident->model.get() : nullptr))
+			* 1099511628211ull;
+	};
+	bool dynamic_casters = false;
+	for (const RenderModel& render_model : models)
+	{
+		if (render_model.dynamic)
+		{
+			dynamic_casters = true;
+			continue;
+		}
+		const glm::vec3 center = glm::vec3(render_model.transform
+			* glm::vec4(render_model.center, 1.0f));
+		const float radius = render_model.radius * max_axis_scale(render_model.transform);
+		bounds_min = glm::min(bounds_min, center - radius);
+		bounds_max = glm::max(bounds_max, center + radius);
+		mix(residency.model(render_model.handle));
+	}
+	if (scene.is_open())
+	{
+		const SceneFileHeader& header = scene.header();
+		bounds_min = glm::min(bounds_min, header.bounds_min);
+		bounds_max = glm::max(bounds_max, header.bounds_max);
+		for (const SceneMeshState& mesh : scene_meshes)
+		{
+			mix(residency.model(mesh.handle));
+		}
+	}
+	glm::vec3 caster_center(0.0f);
+	float caster_radius = 0.0f;
+	if (bounds_min.x <= bounds_max.x)
+	{
+		caster_center = (bounds_min + bounds_max) * 0.5f;
+		caster_radius = glm::distance(bounds_min, bounds_max) * 0.5f;
+	}
+
+	const uint32_t stale = shadow_maps.update(camera, aspect, shadow_distance, sun_direction,
+		caster_center, caster_radius, static_version);
+	if (stale == 0 && !dynamic_casters)
+	{
+		return;
+	}
+
+	// One cascade per job. Only the pages being drawn again need their
+	// static casters; the dynamic ones go into every page.
+	jobs->parallel_for(SHADOW_CASCADES, [&](uint32_t begin, uint32_t end) {
+		for (uint32_t i = begin; i < end; i++)
+		{
+			ShadowCasters& casters = shadow_casters[i];
+			casters.models.clear();
+			casters.dynamic_models.clear();
+			casters.instances.clear();
+			const Frustum& frustum = shadow_maps.cascades[i].frustum;
+			const bool redraw = (stale >> i) & 1;
+			for (uint32_t j = 0; j < (uint32_t)models.size(); j++)
+			{
+				const RenderModel& render_model = models[j];
+				if (!render_model.dynamic && !redraw)
+				{
+					continue;
+				}
+				const glm::mat4& transform = render_model.transform;
+				const glm::vec3 center = glm::vec3(transform * glm::vec4(render_model.center, 1.0f));
+				if (sphere_in_frustum(frustum, center, render_model.radius * max_axis_scale(transform)))
+				{
+					(render_model.dynamic ? casters.dynamic_models : casters.models).push_back(j);
+				}
+			}
+			if (redraw && scene.is_open())
+			{
+				CullStats cull_stats;
+				cull_scene(scene.header(), frustum, casters.instances, cull_stats);
+			}
+		}
+	});
+
+	const Shader& depth_shader = depth_shaders.get(0);
+	glUseProgram(depth_shader.program);
+	glBindVertexArray(geometry_heap.vertex_array());
+	frame_stats.vertex_array_binds++;
+	glEnable(GL_DEPTH_TEST);
+	for (uint32_t i = 0; i < SHADOW_CASCADES; i++)
+	{
+		if (((stale >> i) & 1) == 0)
+		{
+			continue;
+		}
+		shadow_maps.begin_static_page(i);
+		depth_shader.set_uniform("view_projection", shadow_maps.cascades[i].view_projection);
+		draw_shadow_models(shadow_casters[i].models, i);
+		draw_shadow_instances(shadow_casters[i].instances, i);
+		frame_stats.shadow_pages++;
+	}
+	if (dynamic_casters)
+	{
+		for (uint32_t i = 0; i < SHADOW_CASCADES; i++)
+		{
+			shadow_maps.begin_dynamic_page(i);
+			depth_shader.set_uniform("view_projection", shadow_maps.cascades[i].view_projection);
+			draw_shadow_models(shadow_casters[i].dynamic_models, i);
+		}
+	}
+	shadow_maps.end_pages();
+	glDisable(GL_DEPTH_TEST);
+	glBindVertexArray(0);
+}
+
+void Renderer::draw_shadow_models(const std::vector<uint32_t>& casters, uint32_t cascade)
+{
+	const Shader& depth_shader = depth_shaders.get(0);
+	for (const uint32_t index : casters)
+	{
+		const RenderModel& render_model = models[index];
+		const ResidentModel* resident = residency.model(render_model.handle);
+		if (!resident)
+		{
+			continue;
+		}
+
+		// The wider cascades have bigger texels, so coarser LODs do
+		const Model& model = *resident->model;
+		const uint32_t lod = std::min(cascade, (uint32_t)model.lods.size() - 1);
+		const std::vector<Submesh>& submeshes = model.lods[lod].submeshes;
+		model_ranges.clear();
+		for (uint32_t j = 0; j < (uint32_t)submeshes.size(); j++)
+		{
+			model_ranges.push_back({submeshes[j].index_offset, submeshes[j].index_count, j});
+		}
+		depth_shader.set_uniform("model", render_model.transform);
+		draw_ranges(model_ranges.data(), (uint32_t)model_ranges.size(),
+			geometry_heap.range(resident->geometry));
+		frame_stats.draw_calls++;
+	}
+}
+
+void Renderer::draw_shadow_instances(const std::vector<uint32_t>& instances, uint32_t cascade)
+{
+	if (instances.empty())
+	{
+		return;
+	}
+	const SceneInstances& data = scene.header().instances;
+
+	// Count each mesh's instances, leaving out meshes that aren't resident,
+	// then scatter them into mesh order
+	const size_t mesh_count = scene_meshes.size();
+	shadow_mesh_starts.assign(mesh_count + 1, 0);
+	shadow_mesh_resident.resize(mesh_count);
+	for (const uint32_t instance : instances)
+	{
+		shadow_mesh_starts[data.mesh[instance]]++;
+	}
+	uint32_t total = 0;
+	for (size_t i = 0; i < mesh_count; i++)
+	{
+		shadow_mesh_resident[i] = residency.model(scene_meshes[i].handle);
+		const uint32_t count = shadow_mesh_resident[i] ? shadow_mesh_starts[i] : 0;
+		shadow_mesh_starts[i] = total;
+		total += count;
+	}
+	shadow_mesh_starts[mesh_count] = total;
+	if (total == 0)
+	{
+		return;
+	}
+
+	// The scatter leaves each start at the next mesh's
+	SceneInstanceData* sorted = frame_arena.current().allocate<SceneInstanceData>(total);
+	for (const uint32_t instance : instances)
+	{
+		const uint32_t mesh = data.mesh[instance];
+		if (!shadow_mesh_resident[mesh])
+		{
+			continue;
+		}
+		SceneInstanceData& out = sorted[shadow_mesh_starts[mesh]++];
+		out.position_scale = glm::vec4(data.position_x[instance], data.position_y[instance],
+			data.position_z[instance], data.scale[instance]);
+		out.rotation = glm::vec4(data.rotation_x[instance], data.rotation_y[instance],
+			data.rotation_z[instance], data.rotation_w[instance]);
+	}
+	upload_instances(shadow_instance_buffer, shadow_instance_buffer_size, sorted, total,
+		"ShadowMaps");
+
+	depth_shaders.get(0).set_uniform("model", glm::mat4(1.0f));
+	bind_instance_arrays(shadow_instance_buffer);
+	uint32_t first = 0;
+	for (size_t i = 0; i < mesh_count; i++)
+	{
+		const uint32_t count = shadow_mesh_starts[i] - first;
+		if (count == 0)
+		{
+			continue;
+		}
+		const Model& model = *shadow_mesh_resident[i]->model;
+		const GeometryRange& geometry = geometry_heap.range(shadow_mesh_resident[i]->geometry);
+		point_instance_arrays(first);
+		first += count;
+
+		const uint32_t lod = std::min(cascade, (uint32_t)model.lods.size() - 1);
+		for (const Submesh& submesh : model.lods[lod].submeshes)
+		{
+			glDrawElementsInstancedBaseVertex(GL_TRIANGLES, (GLsizei)submesh.index_count,
+				GL_UNSIGNED_INT, reinterpret_cast<const void*>(
+					((uintptr_t)geometry.first_index + submesh.index_offset) * sizeof(uint32_t)),
+				(GLsizei)count, (GLint)geometry.base_vertex);
+			frame_stats.draw_calls++;
+		}
+	}
+	unbind_instance_arrays();
+}
+
+void Renderer::submit_draws(const Shader& target, const Shader& indirect_target)
+{
+	const auto use_program = [&](const Shader& program) {
+		glUseProgram(program.program);
+		program.set_uniform("view_projection", view_projection);
+		set_light_uniforms(program);
+	};
+	use_program(target);
+	bind_texture(1, GL_TEXTURE_BUFFER, material_library.buffer_texture);
+
+	// Every model is in the one heap
+	glBindVertexArray(geometry_heap.vertex_array());
+	frame_stats.vertex_array_binds++;
+
+	// Sorted items mostly share state with the one before, so only set
+	// what changed
+	uint32_t bound_model = UINT32_MAX;
+	uint32_t bound_material = UINT32_MAX;
+	for (const DrawItem& item : draw_list.items)
+	{
+		RenderModel& render_model = models[item.model];
+		if (item.model != bound_model)
+		{
+			target.set_uniform("model", render_model.transform);
+			bound_model = item.model;
+		}
+		bind_material(target, item.material, bound_material);
+
+		draw_ranges(&draw_list.ranges[item.first_range], item.range_count,
+			geometry_heap.range(render_model.resident->geometry));
+		frame_stats.draw_calls++;
+		render_model.draw_calls++;
+	}
+
+	if (gpu_scene)
+	{
+		use_program(indirect_target);
+		draw_gpu_scene(indirect_target);
+	}
+	else if (scene.is_open())
+	{
+		draw_scene_instances(target, bound_material);
+	}
+
+	glBindVertexArray(0);
+}
+
+RenderResource Renderer::add_deferred_passes()
+{
+	const RenderResource surface = frame_graph.create_texture("gbuffer_surface",
+		{render_width, render_height, GBUFFER_SURFACE_FORMAT});
+	const RenderResource depth = frame_graph.create_texture("gbuffer_depth",
+		{render_width, render_height, GBUFFER_DEPTH_FORMAT});
+
+	// Depth first, so the G-buffer pass fills in each pixel only once
+	frame_graph.add_pass("depth_prepass", [this](RenderGraph&) {
+		glEnable(GL_DEPTH_TEST);
+		submit_draws(depth_shaders.get(0), depth_shaders.get(gpu_scene ? SHADER_GPU_CULLED : 0));
+		glDisable(GL_DEPTH_TEST);
+	})
+		.depth(depth, true);
+
+	// The surface target needs no clearing; the lighting pass skips every
+	// pixel left at the far plane. The vertex stage is invariant, so only the
+	// prepass's closest surface passes an equal test.
+	frame_graph.add_pass("gbuffer", [this](RenderGraph&) {
+		glEnable(GL_DEPTH_TEST);
+		glDepthFunc(GL_EQUAL);
+		glDepthMask(GL_FALSE);
+		submit_draws(gbuffer_shaders.get(0), gbuffer_shaders.get(gpu_scene ? SHADER_GPU_CULLED : 0));
+		glDepthMask(GL_TRUE);
+		glDepthFunc(GL_LESS);
+		glDisable(GL_DEPTH_TEST);
+	})
+		.color(surface)
+		.depth(depth);
+
+	// Each pixel only loops over the lights of its own cluster, which
+	// limits the lights to their volumes without a draw per light
+	frame_graph.add_pass("lighting", [this, surface, depth](RenderGraph& graph) {
+		const Shader& deferred_shader = deferred_shaders.get(shader_features);
+		glUseProgram(deferred_shader.program);
+		deferred_shader.set_uniform("inverse_view_projection", glm::inverse(view_projection));
+		deferred_shader.set_uniform("viewport_size",
+			glm::vec2((float)render_width, (float)render_height));
+		set_light_uniforms(deferred_shader);
+		bind_texture(5, GL_TEXTURE_2D, graph.texture(surface));
+		bind_texture(6, GL_TEXTURE_2D, graph.texture(depth));
+		glBindVertexArray(empty_vao);
+		glDrawArrays(GL_TRIANGLES, 0, 3);
+		glBindVertexArray(0);
+		frame_stats.draw_calls++;
+	})
+		.read(surface)
+		.read(depth)
+		.color(scene_color, true);
+
+	// Every pixel written once and read once
+	frame_stats.gbuffer_bytes += (size_t)render_width * (size_t)render_height
+		* GBUFFER_BYTES_PER_PIXEL * 2;
+	return depth;
 }
 
 void Renderer::create_shaders()
@@ -24,10 +1009,62 @@ void Renderer::create_shaders()
 	// Create the shader from the source code
 	shader = Shader("./shaders/2dvertex.glsl", "./shaders/2dfragment.glsl");
 
+	reset_instance_attributes();
+	glGenVertexArrays(1, &empty_vao);
+
+	shadows = shadow_maps.initialize();
+	if (!shadows)
+	{
+		std::cerr << "Drawing without shadows.\n";
+	}
+
+	if (post_chain.settings.effects && !post_chain.initialize(gl_version_at_least(4, 5)))
+	{
+		std::cerr << "Drawing without post effects.\n";
+	}
+	// Texture views and framebuffer invalidation both came with GL 4.3
+	const bool gl_4_3 = gl_version_at_least(4, 3);
+	frame_graph.initialize(gl_4_3, gl_4_3);
+
+	if (gpu_culling_requested && !gpu_culling.initialize())
+	{
+		std::cerr << "Culling scene instances on the CPU instead.\n";
+	}
+
+	// The GPU culled variants read each draw's material from a buffer
+	// indexed by gl_DrawIDARB, which wants GLSL 4.5
+	const ShaderFeature gpu_culled{SHADER_GPU_CULLED, "GPU_CULLED", 450};
+	const ShaderFeature shadowed{SHADER_SHADOWS, "SHADOWS", 0};
+	const ShaderFeature clustered_lights{SHADER_CLUSTERED_LIGHTS, "CLUSTERED_LIGHTS", 0};
+	model_shaders.initialize("./shaders/model_vertex.glsl", "./shaders/model_fragment.glsl",
+		{gpu_culled, shadowed, clustered_lights}, set_model_samplers);
+	depth_shaders.initialize("./shaders/model_vertex.glsl", "./shaders/depth_fragment.glsl",
+		{gpu_culled});
+	gbuffer_shaders.initialize("./shaders/model_vertex.glsl", "./shaders/gbuffer_fragment.glsl",
+		{gpu_culled}, set_model_samplers);
+	deferred_shaders.initialize("./shaders/fullscreen_vertex.glsl",
+		"./shaders/deferred_fragment.glsl", {shadowed, clustered_lights}, set_model_samplers);
+
+	// Every variant a frame can ask for, ahead of time, so lights coming
+	// and going never stall a frame on a compile
+	const uint32_t shadow_feature = shadows ? SHADER_SHADOWS : 0;
+	const uint32_t culled_feature = gpu_culling.is_initialized() ? SHADER_GPU_CULLED : 0;
+	for (const uint32_t lights_feature : {0u, SHADER_CLUSTERED_LIGHTS})
+	{
+		for (const uint32_t culled : {0u, culled_feature})
+		{
+			const uint32_t features = shadow_feature | lights_feature | culled;
+			model_shaders.get(features);
+			depth_shaders.get(features);
+			gbuffer_shaders.get(features);
+			deferred_shaders.get(features);
+		}
+	}
+
 	// Define the vertex data for the triangles
-	vertices[0] = {glm::vec3(-0.5f, -0.5f, 0.0f), glm::vec3(1.0f, 0.0f, 0.0f), glm::vec2(0.0f, 0.0f)}; // bottom left
-	vertices[1] = {glm::vec3( 0.5f, -0.5f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f), glm::vec2(1.0f, 0.0f)}; // bottom right
-	vertices[2] = {glm::vec3( 0.0f,  0.5f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f), glm::vec2(0.5f, 1.0f)}; // top
+	vertices[0] = {glm::vec3(-0.5f, -0.5f, 0.0f), glm::vec3(1.0f, 0.0f, 0.0f), glm::vec2(0.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f)}; // bottom left
+	vertices[1] = {glm::vec3( 0.5f, -0.5f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f), glm::vec2(1.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f)}; // bottom right
+	vertices[2] = {glm::vec3( 0.0f,  0.5f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f), glm::vec2(0.5f, 1.0f), glm::vec3(0.0f, 0.0f, 1.0f)}; // top
 
 	// Create the vertex buffer object (VBO)
 	glGenBuffers(1, &vbo);
@@ -38,6 +1075,8 @@ void Renderer::create_shaders()
 		vertices.data(), 
 		GL_STATIC_DRAW
 	);
+	gpu_memory().allocate(GpuObject::Buffer, vbo, GpuMemoryCategory::Vertex, "Renderer",
+		sizeof(vertices));
 
 	// Define the face indices for the triangles
 	indices = {0, 1, 2};
@@ -51,6 +1090,8 @@ void Renderer::create_shaders()
 		indices.data(), 
 		GL_STATIC_DRAW
 	);
+	gpu_memory().allocate(GpuObject::Buffer, ebo, GpuMemoryCategory::Index, "Renderer",
+		sizeof(indices));
 
 	// Create the vertex array object (VAO)
 	glGenVertexArrays(1, &vao);
@@ -80,47 +1121,216 @@ void Renderer::create_shaders()
 		sizeof(Vertex),
 		col_attr_offset
 	);
+
+	const int uv_attr = glGetAttribLocation(shader.program, "uv");
+	const void* uv_attr_offset = reinterpret_cast<void*>(offsetof(Vertex, uv));
+	glEnableVertexAttribArray((GLuint)uv_attr);
+	glVertexAttribPointer(
+		(GLuint)uv_attr,
+		2,
+		GL_FLOAT,
+		GL_FALSE,
+		sizeof(Vertex),
+		uv_attr_offset
+	);
+
+	// Streams in over the next few frames, drawn with a placeholder until then
+	texture = residency.create_texture("./assets/textures/wall.jpg");
 }
 
-bool Renderer::initialize()
+bool Renderer::initialize(const RendererOptions& options)
 {
-	// Initialize SDL
-	SDL_Init(SDL_INIT_EVERYTHING);
+	headless = options.headless;
+	gpu_culling_requested = options.gpu_culling;
+	shading_path = options.shading_path;
+	window_width = options.width;
+	window_height = options.height;
+	scaling = options.dynamic_resolution;
+	dynamic_resolution.configure(options.resolution);
+	post_chain.settings = options.post;
+	// Compute shaders want GL 4.5, for GPU culling and for bloom
+	const bool compute = options.gpu_culling
+		|| (options.post.effects & post_effect_bit(PostEffect::Bloom));
 
-	// Create a window
-	window = SDL_CreateWindow(
-		"OpenGL Example", 
-		SDL_WINDOWPOS_CENTERED,
-		SDL_WINDOWPOS_CENTERED, 
-		window_width, window_height,
-		SDL_WINDOW_OPENGL | 
-		SDL_WINDOW_BORDERLESS | 
-		SDL_WINDOW_RESIZABLE
-	);
+	if (headless)
+	{
+		// Only the timers; there's no display to talk to
+		SDL_Init(SDL_INIT_TIMER);
+
+		if (!(compute && headless_context.create(4, 5))
+			&& !headless_context.create(3, 3))
+		{
+			return false;
+		}
+
+		// glewInit also wants a GLX display, which we don't have, but the
+		// GL entry points only need the current context
+		glewExperimental = GL_TRUE;
+		if (glewContextInit() != GLEW_OK)
+		{
+			std::cerr << "Failed to initialize GLEW.\n";
+			return false;
+		}
+	}
+	else
+	{
+		// Initialize SDL
+		SDL_Init(SDL_INIT_EVERYTHING);
+
+		// Create a window
+		window = SDL_CreateWindow(
+			"OpenGL Example", 
+			SDL_WINDOWPOS_CENTERED,
+			SDL_WINDOWPOS_CENTERED, 
+			window_width, window_height,
+			SDL_WINDOW_OPENGL | 
+			SDL_WINDOW_BORDERLESS | 
+			SDL_WINDOW_RESIZABLE
+		);
+
+		// Create an OpenGL context, 4.5 for compute shaders when we can get it
+		SDL_GL_SetAttribute(SDL_GL_CONTEXT_MAJOR_VERSION, compute ? 4 : 3);
+		SDL_GL_SetAttribute(SDL_GL_CONTEXT_MINOR_VERSION, compute ? 5 : 3);
+		SDL_GL_SetAttribute(SDL_GL_CONTEXT_PROFILE_MASK, SDL_GL_CONTEXT_PROFILE_CORE);
+		SDL_GL_SetAttribute(SDL_GL_DEPTH_SIZE, 24);
+		context = SDL_GL_CreateContext(window);
+		if (!context && compute)
+		{
+			SDL_GL_SetAttribute(SDL_GL_CONTEXT_MAJOR_VERSION, 3);
+			SDL_GL_SetAttribute(SDL_GL_CONTEXT_MINOR_VERSION, 3);
+			context = SDL_GL_CreateContext(window);
+		}
 
-	// Create an OpenGL context
-	SDL_GL_SetAttribute(SDL_GL_CONTEXT_MAJOR_VERSION, 3);
-	SDL_GL_SetAttribute(SDL_GL_CONTEXT_MINOR_VERSION, 3);
-	SDL_GL_SetAttribute(SDL_GL_CONTEXT_PROFILE_MASK, SDL_GL_CONTEXT_PROFILE_CORE);
-	context = SDL_GL_CreateContext(window);
+		// Initialize GLEW to access the OpenGL functions
+		glewExperimental = GL_TRUE;
+		const GLenum err = glewInit();
+		if (err != GLEW_OK)
+		{
+			std::cerr << "Failed to initialize GLEW.\n";
+			return false;
+		}
+		depth_format = window_depth_format();
 
-	// Initialize GLEW to access the OpenGL functions
-	glewExperimental = GL_TRUE;
-	const GLenum err = glewInit();
-	if (err != GLEW_OK)
+		// The window manager may not have given us the size we asked for.
+		// From here on the resize events keep it up to date.
+		SDL_GL_GetDrawableSize(window, &window_width, &window_height);
+	}
+
+	// Starts before anything is created, so the stream has every object
+	if (!options.capture_path.empty())
+	{
+		gl_capture_begin(options.capture_path, options.capture_frames, window_width,
+			window_height);
+	}
+
+	if (headless && !create_framebuffer())
 	{
-		std::cerr << "Failed to initialize GLEW.\n";
 		return false;
 	}
 
+	texture_loader.initialize(jobs);
+	assets.initialize(jobs, texture_loader);
+	geometry_heap.initialize(model_vertex_format(), "models");
+	residency.initialize(assets, texture_loader, geometry_heap);
+	frame_timer.initialize();
+	stats_start = std::chrono::steady_clock::now();
+
 	return true;
 }
 
-void Renderer::render()
+bool Renderer::create_framebuffer()
+{
+	glGenRenderbuffers(1, &color_buffer);
+	glBindRenderbuffer(GL_RENDERBUFFER, color_buffer);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, window_width, window_height);
+	gpu_memory().allocate(GpuObject::Renderbuffer, color_buffer, GpuMemoryCategory::RenderTarget,
+		"Renderer", (size_t)window_width * (size_t)window_height * 4);
+
+	glGenRenderbuffers(1, &depth_buffer);
+	glBindRenderbuffer(GL_RENDERBUFFER, depth_buffer);
+	depth_format = GL_DEPTH_COMPONENT24;
+	glRenderbufferStorage(GL_RENDERBUFFER, depth_format, window_width, window_height);
+	// Depth24 is padded to four bytes a texel
+	gpu_memory().allocate(GpuObject::Renderbuffer, depth_buffer, GpuMemoryCategory::RenderTarget,
+		"Renderer", (size_t)window_width * (size_t)window_height * 4);
+	glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+	glGenFramebuffers(1, &framebuffer);
+	glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, color_buffer);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depth_buffer);
+
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+	{
+		std::cerr << "Headless framebuffer is incomplete.\n";
+		return false;
+	}
+
+	// Everything renders into it from now on
+	glViewport(0, 0, window_width, window_height);
+	return true;
+}
+
+bool Renderer::resize_scaled_target()
+{
+	const float max_scale = dynamic_resolution.settings.max_scale;
+	const int width = (int)std::ceil((float)window_width * max_scale);
+	const int height = (int)std::ceil((float)window_height * max_scale);
+	if (width == scaled_width && height == scaled_height)
+	{
+		return true;
+	}
+
+	if (scaled_framebuffer)
+	{
+		glDeleteFramebuffers(1, &scaled_framebuffer);
+		gpu_memory().release(GpuObject::Renderbuffer, scaled_color);
+		gpu_memory().release(GpuObject::Renderbuffer, scaled_depth);
+		glDeleteRenderbuffers(1, &scaled_color);
+		glDeleteRenderbuffers(1, &scaled_depth);
+	}
+	scaled_width = width;
+	scaled_height = height;
+
+	// Depth in the frame's own format, which the Hi-Z copy blits from
+	glGenRenderbuffers(1, &scaled_color);
+	glBindRenderbuffer(GL_RENDERBUFFER, scaled_color);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+	gpu_memory().allocate(GpuObject::Renderbuffer, scaled_color, GpuMemoryCategory::RenderTarget,
+		"DynamicResolution", (size_t)width * (size_t)height * 4);
+	glGenRenderbuffers(1, &scaled_depth);
+	glBindRenderbuffer(GL_RENDERBUFFER, scaled_depth);
+	glRenderbufferStorage(GL_RENDERBUFFER, depth_format, width, height);
+	gpu_memory().allocate(GpuObject::Renderbuffer, scaled_depth, GpuMemoryCategory::RenderTarget,
+		"DynamicResolution", (size_t)width * (size_t)height * 4);
+	glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+	glGenFramebuffers(1, &scaled_framebuffer);
+	glBindFramebuffer(GL_FRAMEBUFFER, scaled_framebuffer);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, scaled_color);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, depth_format == GL_DEPTH24_STENCIL8
+		? GL_DEPTH_STENCIL_ATTACHMENT : GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, scaled_depth);
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+	{
+		std::cerr << "Dynamic resolution framebuffer is incomplete.\n";
+		return false;
+	}
+	return true;
+}
+
+void Renderer::upscale()
+{
+	// Bilinear, straight into what gets presented
+	const uint32_t output = headless ? framebuffer : 0;
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, scaled_framebuffer);
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, output);
+	glBlitFramebuffer(0, 0, render_width, render_height, 0, 0, window_width, window_height,
+		GL_COLOR_BUFFER_BIT, GL_LINEAR);
+	glBindFramebuffer(GL_FRAMEBUFFER, output);
+}
+
+void Renderer::draw_triangle()
 {
-	// Clear the color buffer to black
-	glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
-	glClear(GL_COLOR_BUFFER_BIT);
 	// Specify the shader program to use
 	glUseProgram(shader.program);
 
@@ -133,27 +1343,376 @@ void Renderer::render()
 	const glm::vec3 offset(0.5f, 0.0f, 0.0f);
 	shader.set_uniform("offset", offset);
 
+	residency.touch(texture, frame_count, (float)window_height);
+	const uint32_t texture_id = residency.texture(texture);
+	bind_texture(0, GL_TEXTURE_2D, texture_id ? texture_id : texture_loader.placeholder);
+
 	// Get the vertex array to render
 	glBindVertexArray(vao);
 	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
 	// Draw the triangles from the vertices
-	glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, nullptr);
+	glDrawElements(GL_TRIANGLES, (GLsizei)indices.size(), GL_UNSIGNED_INT, nullptr);
+	frame_stats.draw_calls++;
 	// Clear the vertex array
 	glBindVertexArray(0);
-	// Update the framebuffer
-	SDL_GL_SwapWindow(window);
+}
+
+void Renderer::render()
+{
+	frame_stats = RenderStats();
+	frame_timer.begin_frame();
+	frame_arena.begin_frame();
+	const uint64_t heap_allocations = heap_allocation_count();
+
+	// Finish any texture uploads and start new ones, then resume the loads
+	// waiting for the render thread. Both bind textures and buffers behind
+	// our back, so forget what we think is bound.
+	texture_loader.update();
+	assets.update();
+	texture_bindings.fill(TextureBinding());
+
+	// Whichever scale the last GPU time asks for, at most the window's
+	render_width = window_width;
+	render_height = window_height;
+	if (scaling)
+	{
+		double gpu_ms = 0.0;
+		if (frame_timer.take_gpu_time(gpu_ms))
+		{
+			dynamic_resolution.update(gpu_ms);
+		}
+		if (resize_scaled_target())
+		{
+			const float scale = dynamic_resolution.scale();
+			render_width = std::clamp((int)std::lround((float)window_width * scale), 1, scaled_width);
+			render_height = std::clamp((int)std::lround((float)window_height * scale), 1,
+				scaled_height);
+		}
+		else
+		{
+			std::cerr << "Rendering at the window's resolution instead.\n";
+			scaling = false;
+		}
+	}
+	frame_stats.resolution_scale = (double)render_height / (double)window_height;
+
+	// The scene renders straight into what gets presented, unless the post
+	// effects or the scaled target come in between
+	frame_graph.begin_frame();
+	const RenderResource output = frame_graph.import_framebuffer("frame",
+		headless ? framebuffer : 0, window_width, window_height);
+	const RenderResource scaled = scaling ? frame_graph.import_framebuffer("scaled",
+		scaled_framebuffer, render_width, render_height) : output;
+	scene_color = scaled;
+	scene_depth = scaled;
+	if (post_chain.active())
+	{
+		scene_color = frame_graph.create_texture("scene_color",
+			{render_width, render_height, GL_RGBA16F});
+		scene_depth = frame_graph.create_texture("scene_depth",
+			{render_width, render_height, depth_format});
+	}
+
+	// The test triangle only shows when there are no models to look at
+	if (!models.empty() || scene.is_open())
+	{
+		draw_models();
+	}
+	else
+	{
+		frame_graph.add_pass("triangle", [this](RenderGraph&) { draw_triangle(); })
+			.color(scene_color, true)
+			.depth(scene_depth, true);
+	}
+	if (post_chain.active())
+	{
+		// Into whatever the scene would have rendered into without it
+		post_chain.add_passes(frame_graph, scene_color, scaled);
+	}
+	if (scaling)
+	{
+		frame_graph.add_pass("upscale", [this](RenderGraph&) { upscale(); })
+			.read(scaled)
+			.color(output);
+	}
+
+	// The graph makes its textures, and the post chain binds its own,
+	// behind our back
+	texture_bindings.fill(TextureBinding());
+	frame_graph.execute();
+	texture_bindings.fill(TextureBinding());
+	const RenderGraphStats& graph_stats = frame_graph.stats();
+	frame_stats.render_passes = graph_stats.passes;
+	frame_stats.culled_passes = graph_stats.culled_passes;
+	frame_stats.transient_bytes = graph_stats.transient_bytes;
+	frame_stats.aliased_transient_bytes = graph_stats.aliased_bytes;
+	frame_stats.invalidations = graph_stats.invalidations;
+
+	// Streams in what this frame asked for and evicts what it didn't need
+	residency.update(frame_count);
+	// Evictions leave holes that new models may not fit in
+	if (geometry_heap.fragmentation() > GEOMETRY_HEAP_MAX_FRAGMENTATION)
+	{
+		geometry_heap.compact();
+	}
+
+	frame_timer.end_frame();
+
+	// Update the framebuffer. Headless frames have nothing to present, so
+	// they just get the commands going without waiting on anything.
+	if (headless)
+	{
+		glFlush();
+	}
+	else
+	{
+		SDL_GL_SwapWindow(window);
+	}
+
+	frame_stats.heap_allocations = (uint32_t)(heap_allocation_count() - heap_allocations);
+	frame_stats.frame_arena_bytes = frame_arena.current().bytes_used();
+	total_stats.accumulate(frame_stats);
+	stats_frames++;
+	frame_count++;
+	gpu_memory().end_frame();
+	gl_capture_end_frame();
+}
+
+void Renderer::reset_stats()
+{
+	frame_timer.clear();
+	total_stats = RenderStats();
+	dynamic_resolution.clear();
+	frame_graph.timers.clear();
+	stats_frames = 0;
+	stats_start = std::chrono::steady_clock::now();
+	for (RenderModel& render_model : models)
+	{
+		render_model.draw_calls = 0;
+	}
+}
+
+bool Renderer::write_timing_report(const std::string& path)
+{
+	frame_timer.finish();
+	frame_graph.timers.finish();
+	const double seconds = std::chrono::duration<double>(
+		std::chrono::steady_clock::now() - stats_start).count();
+
+	std::ofstream file;
+	if (path != "-")
+	{
+		file.open(path);
+		if (!file)
+		{
+			std::cerr << "Unable to create timing report: " << path << "\n";
+			return false;
+		}
+	}
+	std::ostream& out = path == "-" ? std::cout : file;
+
+	const auto write_summary = [&out](const char* name, const std::vector<double>& samples) {
+		const TimingSummary summary = summarize_timings(samples);
+		out << "  \"" << name << "\": {\"samples\": " << samples.size()
+			<< ", \"mean\": " << summary.mean << ", \"median\": " << summary.median
+			<< ", \"p99\": " << summary.p99 << ", \"min\": " << summary.min
+			<< ", \"max\": " << summary.max << "},\n";
+	};
+
+	const double frames = stats_frames > 0 ? (double)stats_frames : 1.0;
+	const size_t shader_variants = model_shaders.variant_count() + depth_shaders.variant_count()
+		+ gbuffer_shaders.variant_count() + deferred_shaders.variant_count();
+	out << "{\n"
+		<< "  \"headless\": " << (headless ? "true" : "false") << ",\n"
+		<< "  \"width\": " << window_width << ",\n"
+		<< "  \"height\": " << window_height << ",\n"
+		<< "  \"gl_renderer\": \"" << json_escape(gl_string(GL_RENDERER)) << "\",\n"
+		<< "  \"gl_version\": \"" << json_escape(gl_string(GL_VERSION)) << "\",\n"
+		<< "  \"frames\": " << stats_frames << ",\n"
+		<< "  \"seconds\": " << seconds << ",\n"
+		<< "  \"shading\": \"" << (shading_path == ShadingPath::Deferred ? "deferred" : "forward")
+		<< "\",\n"
+		<< "  \"shader_variants\": " << shader_variants << ",\n";
+	write_summary("cpu_ms", frame_timer.cpu_times());
+	write_summary("gpu_ms", frame_timer.gpu_times());
+	out << "  \"per_frame\": {\"draw_calls\": " << total_stats.draw_calls / frames
+		<< ", \"instances\": " << total_stats.instances / frames
+		<< ", \"frustum_culled\": " << total_stats.frustum_culled / frames
+		<< ", \"occlusion_culled\": " << total_stats.occlusion_culled / frames
+		<< ", \"lights\": " << total_stats.lights / frames
+		<< ", \"light_assignments\": " << total_stats.light_assignments / frames
+		<< ", \"light_assign_ms\": " << total_stats.light_assign_ms / frames
+		<< ", \"shadow_pages\": " << total_stats.shadow_pages / frames
+		<< ", \"texture_binds\": " << total_stats.texture_binds / frames
+		<< ", \"material_changes\": " << total_stats.material_changes / frames
+		<< ", \"vertex_array_binds\": " << total_stats.vertex_array_binds / frames
+		<< ", \"heap_allocations\": " << total_stats.heap_allocations / frames
+		<< ", \"frame_arena_bytes\": " << (double)total_stats.frame_arena_bytes / frames
+		<< ", \"gbuffer_bytes\": " << (double)total_stats.gbuffer_bytes / frames << "},\n";
+
+	// The latest scales picked, with the GPU time each was picked from
+	const DynamicResolutionSettings& resolution = dynamic_resolution.settings;
+	out << "  \"dynamic_resolution\": {\"enabled\": " << (scaling ? "true" : "false")
+		<< ", \"target_ms\": " << resolution.target_ms
+		<< ", \"min_scale\": " << resolution.min_scale
+		<< ", \"max_scale\": " << resolution.max_scale
+		<< ", \"mean_scale\": " << total_stats.resolution_scale / frames
+		<< ", \"changes\": " << dynamic_resolution.changes() << ", \"history\": [";
+	const std::vector<ResolutionSample> history = dynamic_resolution.history();
+	for (size_t i = 0; i < history.size(); i++)
+	{
+		out << (i > 0 ? ", " : "") << "[" << history[i].gpu_ms << ", " << history[i].scale << "]";
+	}
+	out << "]},\n";
+
+	// GPU time of each pass that ran, fused post effects sharing theirs, and
+	// what the transient textures took with and without aliasing
+	out << "  \"render_graph\": {\"passes_run\": " << total_stats.render_passes / frames
+		<< ", \"passes_culled\": " << total_stats.culled_passes / frames
+		<< ", \"transient_bytes\": " << (double)total_stats.transient_bytes / frames
+		<< ", \"aliased_bytes\": " << (double)total_stats.aliased_transient_bytes / frames
+		<< ", \"invalidations\": " << total_stats.invalidations / frames << ", \"passes\": {";
+	const std::vector<PassTimer::Timing>& passes = frame_graph.timers.timings();
+	for (size_t i = 0; i < passes.size(); i++)
+	{
+		const double samples = passes[i].samples > 0 ? (double)passes[i].samples : 1.0;
+		out << (i > 0 ? ", " : "") << "\"" << passes[i].name << "\": {\"samples\": "
+			<< passes[i].samples << ", \"mean_ms\": " << passes[i].total_ms / samples << "}";
+	}
+	out << "}},\n"
+		<< "  \"post\": {\"effects\": \"" << post_chain.effect_names() << "\"},\n";
+
+	const GpuMemoryStats& memory = gpu_memory().stats;
+	out << "  \"gpu_memory\": {\"bytes\": " << memory.total_bytes
+		<< ", \"peak_bytes\": " << memory.peak_total_bytes
+		<< ", \"allocations\": " << gpu_memory().live_allocations();
+	for (size_t i = 0; i < (size_t)GpuMemoryCategory::Count; i++)
+	{
+		std::string name = gpu_memory_category_name((GpuMemoryCategory)i);
+		std::replace(name.begin(), name.end(), ' ', '_');
+		out << ", \"" << name << "\": {\"bytes\": " << memory.bytes[i]
+			<< ", \"peak_bytes\": " << memory.peak_bytes[i] << "}";
+	}
+	out << "}\n"
+		<< "}\n";
+
+	return (bool)out;
 }
 
 void Renderer::destroy()
 {
+	if (stats_frames > 0)
+	{
+		const double frames = (double)stats_frames;
+		std::cout << "Per frame: " << total_stats.draw_calls / frames << " draw calls, "
+				  << total_stats.instances / frames << " scene instances ("
+				  << total_stats.frustum_culled / frames << " frustum and "
+				  << total_stats.occlusion_culled / frames << " occlusion culled), "
+				  << total_stats.texture_binds / frames << " texture binds ("
+				  << total_stats.texture_bind_requests / frames << " requested), "
+				  << total_stats.material_changes / frames << " material changes, "
+				  << total_stats.vertex_array_binds / frames << " vertex array binds\n"
+				  << "Per frame: " << total_stats.lights / frames << " lights in "
+				  << total_stats.light_assignments / frames << " cluster assignments, "
+				  << total_stats.light_assign_ms / frames << " ms assigning them, "
+				  << total_stats.shadow_pages / frames << " static shadow pages drawn\n"
+				  << "Per frame: " << total_stats.heap_allocations / frames << " heap allocations, "
+				  << (double)total_stats.frame_arena_bytes / frames / 1024.0
+				  << " KB of frame arena (peak " << (double)frame_arena.peak_bytes() / 1024.0
+				  << " KB, " << frame_arena.block_allocations() << " blocks)\n"
+				  << "Per frame: " << (double)total_stats.gbuffer_bytes / frames / (1024.0 * 1024.0)
+				  << " MB of G-buffer traffic, " << total_stats.resolution_scale / frames
+				  << " mean resolution scale (" << dynamic_resolution.changes() << " changes)\n"
+				  << "Per frame: " << total_stats.render_passes / frames << " render passes ("
+				  << total_stats.culled_passes / frames << " culled), "
+				  << (double)total_stats.transient_bytes / frames / (1024.0 * 1024.0)
+				  << " MB of transient textures in "
+				  << (double)total_stats.aliased_transient_bytes / frames / (1024.0 * 1024.0)
+				  << " MB once aliased, " << total_stats.invalidations / frames
+				  << " attachments invalidated\n";
+
+		for (size_t i = 0; i < models.size(); i++)
+		{
+			std::cout << "Model " << i << ": " << models[i].material_count << " materials, "
+					  << models[i].submesh_count << " submeshes, "
+					  << (double)models[i].draw_calls / frames << " draws per frame\n";
+		}
+	}
+
+	// Loads still running may land in the residency manager
+	assets.destroy();
+	gpu_memory().print_stats();
+	residency.print_stats();
+	residency.destroy();
+	geometry_heap.print_stats();
+	geometry_heap.destroy();
+	models.clear();
+	scene_meshes.clear();
+	scene.close();
+	gpu_memory().release(GpuObject::Buffer, instance_buffer);
+	glDeleteBuffers(1, &instance_buffer);
+	gpu_memory().release(GpuObject::Buffer, shadow_instance_buffer);
+	glDeleteBuffers(1, &shadow_instance_buffer);
+	shadow_maps.destroy();
+	post_chain.destroy();
+	frame_graph.destroy();
+	gpu_culling.destroy();
+	for (LightBuffer* light_buffer : {&light_data, &light_cluster_data, &light_index_data})
+	{
+		gpu_memory().release(GpuObject::Buffer, light_buffer->buffer);
+		glDeleteTextures(1, &light_buffer->texture);
+		glDeleteBuffers(1, &light_buffer->buffer);
+		*light_buffer = LightBuffer();
+	}
+	material_library.destroy();
+
 	// Clean up resources
+	texture_loader.print_stats();
+	texture_loader.destroy();
+	texture_packer.destroy();
 	shader.destroy();
+	model_shaders.destroy();
+	depth_shaders.destroy();
+	gbuffer_shaders.destroy();
+	deferred_shaders.destroy();
+	glDeleteVertexArrays(1, &empty_vao);
+	frame_timer.destroy();
+	gpu_memory().release(GpuObject::Buffer, vbo);
+	gpu_memory().release(GpuObject::Buffer, ebo);
 	glDeleteBuffers(1, &vbo);
 	glDeleteBuffers(1, &ebo);
 	glDeleteVertexArrays(1, &vao);
 
+	gpu_memory().release(GpuObject::Renderbuffer, scaled_color);
+	gpu_memory().release(GpuObject::Renderbuffer, scaled_depth);
+	glDeleteFramebuffers(1, &scaled_framebuffer);
+	glDeleteRenderbuffers(1, &scaled_color);
+	glDeleteRenderbuffers(1, &scaled_depth);
+
 	// Close OpenGL, the SDL window and SDL
-	SDL_GL_DeleteContext(context);
-	SDL_DestroyWindow(window);
+	if (headless)
+	{
+		glDeleteFramebuffers(1, &framebuffer);
+		gpu_memory().release(GpuObject::Renderbuffer, color_buffer);
+		gpu_memory().release(GpuObject::Renderbuffer, depth_buffer);
+		glDeleteRenderbuffers(1, &color_buffer);
+		glDeleteRenderbuffers(1, &depth_buffer);
+	}
+
+	// Everything the renderer made should be gone by now
+	gpu_memory().report_leaks();
+
+	// For runs shorter than the capture
+	gl_capture_end();
+
+	if (headless)
+	{
+		headless_context.destroy();
+	}
+	else
+	{
+		SDL_GL_DeleteContext(context);
+		SDL_DestroyWindow(window);
+	}
 	SDL_Quit();
 }
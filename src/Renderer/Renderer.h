@@ -1,46 +1,358 @@
 #pragma once
 
 #include <array>
+#include <chrono>
 #include <cstdint>
+#include <memory>
+#include <string>
 #include <vector>
 
 #include <SDL2/SDL.h>
+#include <glm/mat4x4.hpp>
 
+#include "Camera.h"
+#include "Culling.h"
+#include "DrawList.h"
+#include "DynamicResolution.h"
+#include "FrameTimer.h"
+#include "GpuCulling.h"
+#include "HeadlessContext.h"
+#include "LightClusters.h"
+#include "PostChain.h"
+#include "RenderGraph.h"
+#include "RenderStats.h"
+#include "ShadowMaps.h"
 #include "Vertex.h"
+#include "../Assets/AssetLoader.h"
+#include "../Model/Material.h"
+#include "../Model/Model.h"
+#include "../Resources/ResidencyManager.h"
+#include "../Scene/SceneFile.h"
 #include "../Shader/Shader.h"
+#include "../Shader/ShaderPermutations.h"
+#include "../Texture/TextureLoader.h"
+#include "../Texture/TexturePacker.h"
 
 constexpr int NUM_TRIANGLES = 1;
 constexpr int NUM_VERTICES = 3;
 constexpr int NUM_VERTICES_PER_TRIANGLE = 3;
+constexpr int MAX_TEXTURE_UNITS = 16;
+// Screen space error in pixels a LOD may show before switching finer
+constexpr float LOD_PIXEL_THRESHOLD = 1.0f;
+
+// What the model shaders are compiled with, see ShaderPermutations. Each
+// is a #define of the same name without the prefix.
+constexpr uint32_t SHADER_GPU_CULLED = 1u << 0; // draws come from GpuCulling
+constexpr uint32_t SHADER_SHADOWS = 1u << 1;
+constexpr uint32_t SHADER_CLUSTERED_LIGHTS = 1u << 2;
+
+// What the deferred path draws the scene's surfaces into: a single RGBA16UI
+// texel packing albedo, alpha and an octahedral normal, and the depth the
+// lighting pass turns back into positions
+constexpr uint32_t GBUFFER_BYTES_PER_PIXEL = 8 + 4;
 
 typedef uint32_t GLenum;
+class JobSystem;
 class Shader;
 
+// Forward shades fragments as they're drawn. Deferred lays down depth first,
+// then the surfaces into a G-buffer, and lights every pixel once from there.
+enum class ShadingPath : uint8_t
+{
+	Forward,
+	Deferred,
+};
+
+struct RendererOptions
+{
+	// Render into a framebuffer object through an EGL context instead of
+	// a window, and never swap
+	bool headless = false;
+	int width = 800;
+	int height = 600;
+
+	// Records the GL calls of the first capture_frames frames to this
+	// file, for glreplay, when not empty
+	std::string capture_path;
+	uint32_t capture_frames = 60;
+
+	// Culls scene instances with compute shaders into indirect draws. Needs
+	// a GL 4.5 context; without one the CPU culls them as usual.
+	bool gpu_culling = false;
+
+	ShadingPath shading_path = ShadingPath::Forward;
+
+	// Renders the scene below the window's size whenever the GPU takes
+	// longer than the target, see DynamicResolution
+	bool dynamic_resolution = false;
+	DynamicResolutionSettings resolution;
+
+	// Which post effects run on the scene, none by default. Bloom needs a
+	// GL 4.5 context and is left out without one.
+	PostSettings post;
+};
+
 class Renderer
 {
 public:
-	bool initialize();
+	explicit Renderer(std::shared_ptr<JobSystem> job_system);
+
+	bool initialize(const RendererOptions& options = RendererOptions());
 	void create_shaders();
 	void render();
 	void destroy();
 
+	// Places a model in the world and hands it to the residency manager,
+	// which streams it back in from path whenever it was evicted. Returns
+	// the index of the model.
+	uint32_t add_model(const std::string& path, int lod_count,
+		std::shared_ptr<Model> model, const glm::mat4& transform);
+	// Moves a model. Moved models cast their shadows into the frame's own
+	// shadow pages from then on, leaving the cached static pages alone.
+	void set_model_transform(uint32_t model, const glm::mat4& transform);
+
+	// Maps a scene file and registers its meshes with the residency manager,
+	// which streams each in once an instance of it comes into view
+	bool load_scene(const std::string& path);
+	const SceneFile& scene_file() const;
+
+	void set_residency_budget(const ResidencyBudget& budget);
+
+	// The size frames are presented at, from the window's resize events.
+	// With dynamic resolution the scene renders at a scale of it and is
+	// stretched up to fill it.
+	void resize_window(int width, int height);
+
+	// Starts measuring afresh, e.g. once the scene has loaded and warmed up
+	void reset_stats();
+	// Writes frame times and per-frame counters since the last reset as
+	// JSON, to stdout when path is "-"
+	bool write_timing_report(const std::string& path);
+
+	// Binds a texture unless the unit already has it bound this frame
+	void bind_texture(uint32_t unit, GLenum target, uint32_t texture);
+
+	RenderStats frame_stats;
+	Camera camera;
+	// Assigned to the clusters of the view every frame, so they can move
+	std::vector<Light> lights;
+	// Can change between frames, to compare the two on the same scene
+	ShadingPath shading_path = ShadingPath::Forward;
+	glm::vec3 sun_direction = glm::vec3(-0.4f, -1.0f, -0.6f) / 1.2328828f; // normalized
+	// How far from the camera shadows reach. The cascades are fitted to it,
+	// so keeping it fixed keeps the static shadow pages cached.
+	float shadow_distance = 100.0f;
+	// Coroutines awaiting the render thread resume at the start of render()
+	AssetLoader assets;
+
 private:
+	struct TextureBinding
+	{
+		GLenum target = 0;
+		uint32_t texture = 0;
+	};
+
+	// A model placed in the world. Its bounds are kept from the first load
+	// so it can still be culled and sized while evicted.
+	struct RenderModel
+	{
+		ResourceHandle handle;
+		glm::mat4 transform = glm::mat4(1.0f);
+		LodState lod_state;
+		glm::vec3 center = glm::vec3(0.0f);
+		float radius = 0.0f;
+		size_t material_count = 0;
+		size_t submesh_count = 0;
+		uint64_t draw_calls = 0; // over all frames
+		const ResidentModel* resident = nullptr; // this frame
+		bool dynamic = false; // moved since it was added
+	};
+
+	// What each shadow cascade draws this frame. Static casters are only
+	// collected for pages that have to be drawn again.
+	struct ShadowCasters
+	{
+		std::vector<uint32_t> models;
+		std::vector<uint32_t> dynamic_models;
+		std::vector<uint32_t> instances; // of the scene
+	};
+
+	// A mesh of the scene file and where its visible instances are in the
+	// instance buffer this frame
+	struct SceneMeshState
+	{
+		ResourceHandle handle;
+		LodState lod_state;
+		const ResidentModel* resident = nullptr; // this frame
+		uint32_t first_instance = 0;
+		uint32_t instance_count = 0;
+		float nearest = 0.0f; // model space distance of the closest instance
+	};
+
+	// A texture buffer the light clusters stream through, reallocated only
+	// when it has to grow
+	struct LightBuffer
+	{
+		uint32_t buffer = 0;
+		uint32_t texture = 0;
+		size_t size = 0;
+	};
+
+	// What the model shader reads per instance at locations 4 and 5
+	struct SceneInstanceData
+	{
+		glm::vec4 position_scale = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+		glm::vec4 rotation = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f); // quaternion
+	};
+
+	// Culls, picks LODs and collects the draws of every model, then adds the
+	// passes submitting them sorted by state
+	void draw_models();
+	// Draws everything draw_models collected with the given programs, once
+	// per pass
+	void submit_draws(const Shader& target, const Shader& indirect_target);
+	// Depth, then the G-buffer, then one lighting pass into the scene's
+	// color. Returns the G-buffer's depth.
+	RenderResource add_deferred_passes();
+	// Culls the scene's instances, groups the survivors by mesh and uploads
+	// their transforms to the instance buffer
+	void collect_scene_instances(const Frustum& frustum, float projection_scale);
+	// One instanced draw per submesh of every mesh with visible instances
+	void draw_scene_instances(const Shader& target, uint32_t& bound_material);
+	// Adds the draws of every resident mesh for the GPU to fill in, picking
+	// LODs and streaming from what it saw of each mesh a few frames ago
+	void add_gpu_scene_draws(float projection_scale);
+	// The GPU culled draws, one call per run of draws sharing a texture array
+	void draw_gpu_scene(const Shader& target);
+	// Draws the static shadow pages that are out of date, then the dynamic
+	// casters over copies of all of them
+	void draw_shadows(float aspect);
+	// Whole models at the cascade's LOD into the bound shadow page
+	void draw_shadow_models(const std::vector<uint32_t>& casters, uint32_t cascade);
+	// Scene instances grouped by mesh into the bound shadow page
+	void draw_shadow_instances(const std::vector<uint32_t>& instances, uint32_t cascade);
+	// Orphans buffer, growing it if need be, and fills it with instances
+	static void upload_instances(uint32_t& buffer, size_t& buffer_size,
+		const SceneInstanceData* instances, uint32_t count, const char* owner);
+	// The instance arrays ride along in the heap's vertex array, enabled
+	// only for instanced draws
+	static void bind_instance_arrays(uint32_t buffer);
+	static void point_instance_arrays(uint32_t first_instance);
+	static void unbind_instance_arrays();
+	// Assigns the lights to the clusters of this frame's view and uploads
+	// the lists for the model shaders
+	void assign_lights(float aspect);
+	void upload_light_buffer(LightBuffer& light_buffer, GLenum format, const void* data,
+		size_t bytes);
+	// Where the model shaders find a fragment's cluster
+	void set_light_uniforms(const Shader& target) const;
+	void bind_material(const Shader& target, uint32_t material, uint32_t& bound_material);
+	void draw_triangle();
+	bool create_framebuffer();
+	// Sized for the largest scale of the window, so changing the scale
+	// only changes the viewport
+	bool resize_scaled_target();
+	// Stretches the rendered part of the scaled target over the window
+	void upscale();
+
 	SDL_Window* window = nullptr;
 	SDL_GLContext context = nullptr;
 
+	bool headless = false;
+	HeadlessContext headless_context;
+	uint32_t framebuffer = 0; // what headless frames render into
+	uint32_t color_buffer = 0;
+	uint32_t depth_buffer = 0;
+	GLenum depth_format = 0; // of whatever frames render into
+
 	int window_width = 800;
 	int window_height = 600;
+	// What the scene renders at this frame, the window's size without
+	// dynamic resolution
+	int render_width = 800;
+	int render_height = 600;
+
+	bool scaling = false; // dynamic resolution is on
+	DynamicResolution dynamic_resolution;
+	uint32_t scaled_framebuffer = 0;
+	uint32_t scaled_color = 0; // renderbuffers
+	uint32_t scaled_depth = 0;
+	int scaled_width = 0;
+	int scaled_height = 0;
+
+	PostChain post_chain;
+	RenderGraph frame_graph;
+	// What the scene renders into this frame: transients with post effects,
+	// else the scaled target with dynamic resolution, else the window or the
+	// headless framebuffer
+	RenderResource scene_color;
+	RenderResource scene_depth;
+	glm::mat4 view_projection = glm::mat4(1.0f); // this frame's
+	bool gpu_scene = false; // the GPU culls the scene this frame
 
 	uint32_t vbo = 0; // vertex buffer object
 	uint32_t ebo = 0; // element buffer object
 	uint32_t vao = 0; // vertex array object
 	Shader shader;
+	ShaderPermutations model_shaders;
+	// The deferred path's passes
+	ShaderPermutations depth_shaders;
+	ShaderPermutations gbuffer_shaders;
+	ShaderPermutations deferred_shaders;
+	uint32_t shader_features = 0; // this frame's, bar SHADER_GPU_CULLED
+	uint32_t empty_vao = 0; // for draws that make their own vertices
+
+	std::shared_ptr<JobSystem> jobs;
+	TextureLoader texture_loader;
+	TexturePacker texture_packer;
+	GeometryHeap geometry_heap;
+	ResidencyManager residency;
+	ResourceHandle texture;
+	std::array<TextureBinding, MAX_TEXTURE_UNITS> texture_bindings{};
+
+	MaterialLibrary material_library;
+	std::vector<RenderModel> models;
+	FrameArena frame_arena;
+	DrawList draw_list;
+	std::vector<DrawRange> model_ranges; // scratch for one model's ranges
+
+	SceneFile scene;
+	std::vector<SceneMeshState> scene_meshes;
+	std::vector<uint32_t> visible_instances;
+	uint32_t instance_buffer = 0;
+	size_t instance_buffer_size = 0;
+	bool gpu_culling_requested = false;
+	GpuCulling gpu_culling;
+
+	ShadowMaps shadow_maps;
+	bool shadows = false; // the shadow maps could be created
+	std::array<ShadowCasters, SHADOW_CASCADES> shadow_casters;
+	uint32_t shadow_instance_buffer = 0;
+	size_t shadow_instance_buffer_size = 0;
+	std::vector<uint32_t> shadow_mesh_starts; // scratch
+	std::vector<const ResidentModel*> shadow_mesh_resident; // scratch
+
+	LightClusters light_clusters;
+	LightBuffer light_data; // GpuLight
+	LightBuffer light_cluster_data; // LightCluster
+	LightBuffer light_index_data;
+
+	uint64_t frame_count = 0;
+
+	// Since the last reset_stats()
+	RenderStats total_stats;
+	uint64_t stats_frames = 0;
+	std::chrono::steady_clock::time_point stats_start;
+	FrameTimer frame_timer;
 
 	std::array<Vertex, NUM_VERTICES> vertices{};
 	std::array<uint32_t, (size_t)(NUM_TRIANGLES * NUM_VERTICES_PER_TRIANGLE)> indices{};
 
 public:
-	static void resize_window(int width, int height);
 	static void set_render_mode(const GLenum &mode);
+	// Draws index ranges of a mesh of the bound geometry heap in a single
+	// call
+	static void draw_ranges(const DrawRange* ranges, uint32_t count,
+		const GeometryRange& geometry);
 };
 
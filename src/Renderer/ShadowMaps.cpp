@@ -0,0 +1,183 @@
+#include "ShadowMaps.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <utility>
+
+#include <GL/glew.h>
+#include <GL/gl.h>
+#include <glm/common.hpp>
+#include <glm/geometric.hpp>
+#include <glm/ext/matrix_clip_space.hpp>
+#include <glm/ext/matrix_transform.hpp>
+
+#include "Camera.h"
+#include "../Resources/GpuMemory.h"
+#include "../Capture/CapturedGL.h"
+
+bool ShadowMaps::initialize()
+{
+	for (uint32_t* maps : {&static_maps, &frame_maps})
+	{
+		glGenTextures(1, maps);
+		glBindTexture(GL_TEXTURE_2D_ARRAY, *maps);
+		glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_DEPTH_COMPONENT24, SHADOW_MAP_SIZE,
+			SHADOW_MAP_SIZE, SHADOW_CASCADES, 0, GL_DEPTH_COMPONENT, GL_UNSIGNED_INT, nullptr);
+		// Compared in the sampler, with four texels filtered per fetch
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+		gpu_memory().allocate(GpuObject::Texture, *maps, GpuMemoryCategory::RenderTarget,
+			"ShadowMaps", texture_bytes(SHADOW_MAP_SIZE, SHADOW_MAP_SIZE, SHADOW_CASCADES, 4, false));
+	}
+	glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+
+	// A depth only framebuffer for every page
+	glGenFramebuffers(SHADOW_CASCADES, static_framebuffers.data());
+	glGenFramebuffers(SHADOW_CASCADES, frame_framebuffers.data());
+	bool complete = true;
+	for (uint32_t i = 0; i < SHADOW_CASCADES; i++)
+	{
+		for (const auto& [framebuffer, maps] : {std::pair(static_framebuffers[i], static_maps),
+				std::pair(frame_framebuffers[i], frame_maps)})
+		{
+			glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+			glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, maps, 0, (GLint)i);
+			glDrawBuffer(GL_NONE);
+			glReadBuffer(GL_NONE);
+			complete &= glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+		}
+	}
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+	if (!complete)
+	{
+		std::cerr << "Shadow map framebuffers are incomplete.\n";
+		destroy();
+		return false;
+	}
+	return true;
+}
+
+void ShadowMaps::destroy()
+{
+	glDeleteFramebuffers(SHADOW_CASCADES, static_framebuffers.data());
+	glDeleteFramebuffers(SHADOW_CASCADES, frame_framebuffers.data());
+	gpu_memory().release(GpuObject::Texture, static_maps);
+	gpu_memory().release(GpuObject::Texture, frame_maps);
+	glDeleteTextures(1, &static_maps);
+	glDeleteTextures(1, &frame_maps);
+	static_framebuffers.fill(0);
+	frame_framebuffers.fill(0);
+	static_maps = 0;
+	frame_maps = 0;
+	pages_drawn = false;
+}
+
+uint32_t ShadowMaps::update(const Camera& camera, float aspect, float distance,
+	const glm::vec3& light_direction, const glm::vec3& caster_center, float caster_radius,
+	uint64_t static_version)
+{
+	// Light space looks down the light, with any up that isn't along it
+	const glm::vec3 up = std::abs(light_direction.y) > 0.99f ? glm::vec3(0.0f, 0.0f, 1.0f)
+		: glm::vec3(0.0f, 1.0f, 0.0f);
+	const glm::mat4 light_view = glm::lookAt(glm::vec3(0.0f), light_direction, up);
+	const glm::vec3 casters = glm::vec3(light_view * glm::vec4(caster_center, 1.0f));
+
+	const glm::vec3 forward = glm::normalize(camera.target - camera.position);
+	const float tan_y = std::tan(camera.fov * 0.5f);
+	const float tan_x = tan_y * aspect;
+	const float corner = tan_x * tan_x + tan_y * tan_y; // squared, at depth one
+	const float near = camera.near_plane;
+	const float far = std::max(distance, near * 2.0f);
+
+	uint32_t stale = 0;
+	float begin = near;
+	for (uint32_t i = 0; i < SHADOW_CASCADES; i++)
+	{
+		const float t = (float)(i + 1) / (float)SHADOW_CASCADES;
+		const float end = glm::mix(near + (far - near) * t, near * std::pow(far / near, t),
+			SHADOW_SPLIT_BLEND);
+
+		// The smallest sphere around the slice of the view frustum. Its size
+		// doesn't depend on where the camera looks, so turning never
+		// resizes the page.
+		const float depth = std::min((begin + end) * (1.0f + corner) * 0.5f, end);
+		const float radius = std::sqrt((end - depth) * (end - depth) + end * end * corner);
+
+		// Pages are half as wide again as the sphere and move in whole texel
+		// steps of half its radius, which keeps the sphere inside the page
+		// while the page stays put, and the shadows from shimmering
+		const float half_size = radius * 1.5f;
+		const float texel_size = half_size * 2.0f / (float)SHADOW_MAP_SIZE;
+		const float step = texel_size * std::max(std::round(radius * 0.5f / texel_size), 1.0f);
+		const glm::vec3 center = glm::vec3(light_view
+			* glm::vec4(camera.position + forward * depth, 1.0f));
+		const glm::vec2 snapped = glm::floor(glm::vec2(center) / step + 0.5f) * step;
+
+		// Deep enough for every static caster. Dynamic ones outside get
+		// clamped onto the near plane while they're drawn.
+		const float reach = std::max(caster_radius, half_size);
+		const glm::mat4 projection = glm::ortho(snapped.x - half_size, snapped.x + half_size,
+			snapped.y - half_size, snapped.y + half_size, -(casters.z + reach), -(casters.z - reach));
+
+		ShadowCascade& cascade = cascades[i];
+		cascade.view_projection = projection * light_view;
+		cascade.frustum = extract_frustum(cascade.view_projection);
+		cascade.split = end;
+		cascade.texel_size = texel_size;
+
+		const PageKey key{snapped, half_size, light_direction, caster_center, caster_radius,
+			static_version};
+		if (!pages_drawn || !(key == page_keys[i]))
+		{
+			page_keys[i] = key;
+			stale |= 1u << i;
+		}
+		begin = end;
+	}
+
+	pages_drawn = true;
+	dynamic_drawn = false;
+	return stale;
+}
+
+void ShadowMaps::begin_page(uint32_t framebuffer)
+{
+	glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+	glViewport(0, 0, SHADOW_MAP_SIZE, SHADOW_MAP_SIZE);
+	glEnable(GL_POLYGON_OFFSET_FILL);
+	glPolygonOffset(SHADOW_SLOPE_BIAS, SHADOW_CONSTANT_BIAS);
+	glEnable(GL_DEPTH_CLAMP);
+}
+
+void ShadowMaps::begin_static_page(uint32_t cascade)
+{
+	begin_page(static_framebuffers[cascade]);
+	glClear(GL_DEPTH_BUFFER_BIT);
+}
+
+void ShadowMaps::begin_dynamic_page(uint32_t cascade)
+{
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, static_framebuffers[cascade]);
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, frame_framebuffers[cascade]);
+	glBlitFramebuffer(0, 0, SHADOW_MAP_SIZE, SHADOW_MAP_SIZE, 0, 0, SHADOW_MAP_SIZE,
+		SHADOW_MAP_SIZE, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+	begin_page(frame_framebuffers[cascade]);
+	dynamic_drawn = true;
+}
+
+void ShadowMaps::end_pages()
+{
+	glDisable(GL_POLYGON_OFFSET_FILL);
+	glDisable(GL_DEPTH_CLAMP);
+}
+
+uint32_t ShadowMaps::texture() const
+{
+	return dynamic_drawn ? frame_maps : static_maps;
+}
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+
+#include <glm/mat4x4.hpp>
+#include <glm/vec2.hpp>
+#include <glm/vec3.hpp>
+
+#include "Culling.h"
+
+struct Camera;
+
+// Cascaded shadow maps for the sun. Each cascade covers a slice of the view
+// out to the shadow distance with one page of a depth texture array.
+constexpr uint32_t SHADOW_CASCADES = 4;
+constexpr int SHADOW_MAP_SIZE = 1024;
+// Where the splits sit between uniform spacing, at 0, and logarithmic
+constexpr float SHADOW_SPLIT_BLEND = 0.75f;
+// Depth bias casters are drawn with, slope scaled and constant
+constexpr float SHADOW_SLOPE_BIAS = 1.5f;
+constexpr float SHADOW_CONSTANT_BIAS = 2.0f;
+
+struct ShadowCascade
+{
+	glm::mat4 view_projection = glm::mat4(1.0f); // world to the page
+	Frustum frustum{}; // of the page, for culling casters
+	float split = 0.0f; // view depth where the cascade ends
+	float texel_size = 0.0f; // in world units
+};
+
+// Static casters are drawn into pages that are kept from frame to frame.
+// A page is only drawn again once its cascade moves, which happens in steps
+// of a sixth of the page, or the light, the static casters' bounds or their
+// version changes. Dynamic casters are drawn every frame into a copy
+// of the static pages.
+class ShadowMaps
+{
+public:
+	bool initialize();
+	void destroy();
+
+	// Fits the cascades to the camera's view out to distance. Returns a bit
+	// for each cascade whose static page is out of date, which the caller
+	// has to draw again this frame.
+	uint32_t update(const Camera& camera, float aspect, float distance,
+		const glm::vec3& light_direction, const glm::vec3& caster_center, float caster_radius,
+		uint64_t static_version);
+
+	// Binds a cascade's static page to draw into, cleared, with the casters'
+	// depth bias on
+	void begin_static_page(uint32_t cascade);
+	// Binds the frame's page of a cascade to draw the dynamic casters into,
+	// starting from a copy of the static page
+	void begin_dynamic_page(uint32_t cascade);
+	// Turns the bias back off. The caller puts back its own framebuffer and
+	// viewport.
+	void end_pages();
+
+	// The pages to sample this frame: the frame's own once dynamic casters
+	// were drawn, the static ones otherwise
+	uint32_t texture() const;
+
+	std::array<ShadowCascade, SHADOW_CASCADES> cascades{};
+
+private:
+	// Everything a static page depends on
+	struct PageKey
+	{
+		glm::vec2 center = glm::vec2(0.0f); // in light space
+		float half_size = 0.0f;
+		glm::vec3 light_direction = glm::vec3(0.0f);
+		glm::vec3 caster_center = glm::vec3(0.0f);
+		float caster_radius = 0.0f;
+		uint64_t static_version = 0;
+
+		bool operator==(const PageKey& other) const = default;
+	};
+
+	void begin_page(uint32_t framebuffer);
+
+	uint32_t static_maps = 0; // depth texture arrays
+	uint32_t frame_maps = 0;
+	std::array<uint32_t, SHADOW_CASCADES> static_framebuffers{};
+	std::array<uint32_t, SHADOW_CASCADES> frame_framebuffers{};
+	std::array<PageKey, SHADOW_CASCADES> page_keys{};
+	bool pages_drawn = false; // none are valid before the first draw
+	bool dynamic_drawn = false; // this frame
+};
@@ -0,0 +1,24 @@
+#include "TimingReport.h"
+
+#include <GL/glew.h>
+#include <GL/gl.h>
+
+std::string gl_string(GLenum name)
+{
+	const GLubyte* value = glGetString(name);
+	return value ? reinterpret_cast<const char*>(value) : "";
+}
+
+std::string json_escape(const std::string& text)
+{
+	std::string escaped;
+	for (const char c : text)
+	{
+		if (c == '"' || c == '\\')
+		{
+			escaped += '\\';
+		}
+		escaped += c;
+	}
+	return escaped;
+}
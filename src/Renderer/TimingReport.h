@@ -0,0 +1,14 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+typedef uint32_t GLenum;
+
+// Helpers shared by the JSON timing reports of the renderer and the
+// benchmark runner
+
+// glGetString as a std::string, empty when the context has no answer
+std::string gl_string(GLenum name);
+// Escapes quotes and backslashes for a JSON string
+std::string json_escape(const std::string& text);
@@ -8,4 +8,5 @@ struct Vertex
 	glm::vec3 position;
 	glm::vec3 color;
 	glm::vec2 uv;
+	glm::vec3 normal;
 };
@@ -0,0 +1,290 @@
+#include "GeometryHeap.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <iostream>
+
+#include <GL/glew.h>
+#include <GL/gl.h>
+
+#include "GpuMemory.h"
+#include "../Renderer/Vertex.h"
+#include "../Capture/CapturedGL.h"
+
+namespace
+{
+	double megabytes(size_t bytes)
+	{
+		return (double)bytes / (1024.0 * 1024.0);
+	}
+
+	float space_fragmentation(const RangeAllocator& space)
+	{
+		const uint32_t free = space.capacity() - space.used();
+		return space.capacity() > 0
+			? (float)(free - space.largest_free()) / (float)space.capacity() : 0.0f;
+	}
+}
+
+VertexFormat model_vertex_format()
+{
+	VertexFormat format;
+	format.stride = sizeof(Vertex);
+	format.attributes = {
+		{0, 3, offsetof(Vertex, position)},
+		{1, 3, offsetof(Vertex, color)},
+		{2, 2, offsetof(Vertex, uv)},
+		{3, 3, offsetof(Vertex, normal)},
+	};
+	return format;
+}
+
+bool GeometryHeap::initialize(const VertexFormat& vertex_format, const std::string& heap_name,
+	uint32_t vertex_capacity, uint32_t index_capacity)
+{
+	format = vertex_format;
+	name = heap_name;
+	vertex_space.initialize(vertex_capacity);
+	index_space.initialize(index_capacity);
+
+	glGenBuffers(1, &vbo);
+	glBindBuffer(GL_ARRAY_BUFFER, vbo);
+	glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr)vertex_capacity * format.stride, nullptr,
+		GL_STATIC_DRAW);
+	gpu_memory().allocate(GpuObject::Buffer, vbo, GpuMemoryCategory::Vertex, name,
+		(size_t)vertex_capacity * format.stride);
+
+	glGenBuffers(1, &ebo);
+	glBindBuffer(GL_ARRAY_BUFFER, ebo);
+	glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr)index_capacity * (GLsizeiptr)sizeof(uint32_t),
+		nullptr, GL_STATIC_DRAW);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	gpu_memory().allocate(GpuObject::Buffer, ebo, GpuMemoryCategory::Index, name,
+		(size_t)index_capacity * sizeof(uint32_t));
+
+	glGenVertexArrays(1, &vao);
+	bind_buffers();
+
+	return vbo && ebo && vao;
+}
+
+void GeometryHeap::destroy()
+{
+	gpu_memory().release(GpuObject::Buffer, vbo);
+	gpu_memory().release(GpuObject::Buffer, ebo);
+	glDeleteVertexArrays(1, &vao);
+	glDeleteBuffers(1, &vbo);
+	glDeleteBuffers(1, &ebo);
+	vao = 0;
+	vbo = 0;
+	ebo = 0;
+	meshes.clear();
+	free_meshes.clear();
+}
+
+void GeometryHeap::bind_buffers()
+{
+	glBindVertexArray(vao);
+	glBindBuffer(GL_ARRAY_BUFFER, vbo);
+	for (const VertexAttribute& attribute : format.attributes)
+	{
+		glEnableVertexAttribArray(attribute.location);
+		glVertexAttribPointer(attribute.location, attribute.components, GL_FLOAT, GL_FALSE,
+			(GLsizei)format.stride, reinterpret_cast<void*>((uintptr_t)attribute.offset));
+	}
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
+	glBindVertexArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void GeometryHeap::grow(uint32_t& buffer, RangeAllocator& space, uint32_t element_size,
+	uint32_t needed, bool vertices)
+{
+	const uint32_t old_capacity = space.capacity();
+	const uint32_t capacity = std::max(old_capacity * 2, old_capacity + needed);
+	const size_t old_bytes = (size_t)old_capacity * element_size;
+	const size_t bytes = (size_t)capacity * element_size;
+
+	// The copy targets leave the vertex arrays' bindings alone
+	uint32_t grown = 0;
+	glGenBuffers(1, &grown);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, grown);
+	glBufferData(GL_COPY_WRITE_BUFFER, (GLsizeiptr)bytes, nullptr, GL_STATIC_DRAW);
+	glBindBuffer(GL_COPY_READ_BUFFER, buffer);
+	glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, (GLsizeiptr)old_bytes);
+	glBindBuffer(GL_COPY_READ_BUFFER, 0);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+	gpu_memory().release(GpuObject::Buffer, buffer);
+	glDeleteBuffers(1, &buffer);
+	gpu_memory().allocate(GpuObject::Buffer, grown,
+		vertices ? GpuMemoryCategory::Vertex : GpuMemoryCategory::Index, name, bytes);
+	buffer = grown;
+
+	space.grow(capacity);
+	bind_buffers();
+	stats.growths++;
+	stats.bytes_copied += old_bytes;
+}
+
+GeometryHandle GeometryHeap::allocate(const void* vertices, uint32_t vertex_count,
+	const uint32_t* indices, uint32_t index_count)
+{
+	RangeAllocator::Allocation vertex_range = vertex_space.allocate(vertex_count);
+	if (!vertex_range.valid())
+	{
+		grow(vbo, vertex_space, format.stride, vertex_count, true);
+		vertex_range = vertex_space.allocate(vertex_count);
+	}
+	RangeAllocator::Allocation index_range = index_space.allocate(index_count);
+	if (!index_range.valid())
+	{
+		grow(ebo, index_space, sizeof(uint32_t), index_count, false);
+		index_range = index_space.allocate(index_count);
+	}
+	if (!vertex_range.valid() || !index_range.valid())
+	{
+		std::cerr << "Geometry heap " << name << " is out of space\n";
+		vertex_space.release(vertex_range);
+		index_space.release(index_range);
+		return GeometryHandle();
+	}
+
+	glBindBuffer(GL_COPY_WRITE_BUFFER, vbo);
+	glBufferSubData(GL_COPY_WRITE_BUFFER, (GLintptr)vertex_range.offset * format.stride,
+		(GLsizeiptr)vertex_count * format.stride, vertices);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, ebo);
+	glBufferSubData(GL_COPY_WRITE_BUFFER, (GLintptr)index_range.offset * (GLintptr)sizeof(uint32_t),
+		(GLsizeiptr)index_count * (GLsizeiptr)sizeof(uint32_t), indices);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+	GeometryHandle handle;
+	if (!free_meshes.empty())
+	{
+		handle.index = free_meshes.back();
+		free_meshes.pop_back();
+	}
+	else
+	{
+		handle.index = (uint32_t)meshes.size();
+		meshes.emplace_back();
+	}
+
+	Mesh& mesh = meshes[handle.index];
+	mesh.vertices = vertex_range;
+	mesh.indices = index_range;
+	mesh.range = {vertex_range.offset, index_range.offset, vertex_count, index_count};
+	stats.allocations++;
+	return handle;
+}
+
+void GeometryHeap::release(GeometryHandle handle)
+{
+	if (!handle.valid())
+	{
+		return;
+	}
+
+	Mesh& mesh = meshes[handle.index];
+	vertex_space.release(mesh.vertices);
+	index_space.release(mesh.indices);
+	mesh = Mesh();
+	free_meshes.push_back(handle.index);
+	stats.frees++;
+}
+
+const GeometryRange& GeometryHeap::range(GeometryHandle handle) const
+{
+	return meshes[handle.index].range;
+}
+
+void GeometryHeap::compact()
+{
+	// Same order as now, so the copies read the old buffers front to back
+	std::vector<uint32_t> order;
+	for (uint32_t i = 0; i < (uint32_t)meshes.size(); i++)
+	{
+		if (meshes[i].vertices.valid())
+		{
+			order.push_back(i);
+		}
+	}
+	std::sort(order.begin(), order.end(), [this](uint32_t a, uint32_t b) {
+		return meshes[a].vertices.offset < meshes[b].vertices.offset;
+	});
+
+	const size_t vertex_bytes = (size_t)vertex_space.capacity() * format.stride;
+	const size_t index_bytes = (size_t)index_space.capacity() * sizeof(uint32_t);
+	uint32_t buffers[2] = {};
+	glGenBuffers(2, buffers);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, buffers[0]);
+	glBufferData(GL_COPY_WRITE_BUFFER, (GLsizeiptr)vertex_bytes, nullptr, GL_STATIC_DRAW);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, buffers[1]);
+	glBufferData(GL_COPY_WRITE_BUFFER, (GLsizeiptr)index_bytes, nullptr, GL_STATIC_DRAW);
+
+	vertex_space.reset();
+	index_space.reset();
+
+	const auto copy = [this](uint32_t from, uint32_t to, size_t source, size_t destination,
+		size_t bytes) {
+		glBindBuffer(GL_COPY_READ_BUFFER, from);
+		glBindBuffer(GL_COPY_WRITE_BUFFER, to);
+		glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, (GLintptr)source,
+			(GLintptr)destination, (GLsizeiptr)bytes);
+		stats.bytes_copied += bytes;
+	};
+
+	for (const uint32_t index : order)
+	{
+		Mesh& mesh = meshes[index];
+		const RangeAllocator::Allocation vertices = vertex_space.allocate(mesh.vertices.size);
+		const RangeAllocator::Allocation indices = index_space.allocate(mesh.indices.size);
+		copy(vbo, buffers[0], (size_t)mesh.vertices.offset * format.stride,
+			(size_t)vertices.offset * format.stride, (size_t)mesh.vertices.size * format.stride);
+		copy(ebo, buffers[1], (size_t)mesh.indices.offset * sizeof(uint32_t),
+			(size_t)indices.offset * sizeof(uint32_t), (size_t)mesh.indices.size * sizeof(uint32_t));
+
+		mesh.vertices = vertices;
+		mesh.indices = indices;
+		mesh.range.base_vertex = vertices.offset;
+		mesh.range.first_index = indices.offset;
+	}
+	glBindBuffer(GL_COPY_READ_BUFFER, 0);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+	gpu_memory().release(GpuObject::Buffer, vbo);
+	gpu_memory().release(GpuObject::Buffer, ebo);
+	glDeleteBuffers(1, &vbo);
+	glDeleteBuffers(1, &ebo);
+	vbo = buffers[0];
+	ebo = buffers[1];
+	gpu_memory().allocate(GpuObject::Buffer, vbo, GpuMemoryCategory::Vertex, name, vertex_bytes);
+	gpu_memory().allocate(GpuObject::Buffer, ebo, GpuMemoryCategory::Index, name, index_bytes);
+
+	bind_buffers();
+	stats.compactions++;
+}
+
+float GeometryHeap::fragmentation() const
+{
+	return std::max(space_fragmentation(vertex_space), space_fragmentation(index_space));
+}
+
+uint32_t GeometryHeap::vertex_array() const
+{
+	return vao;
+}
+
+void GeometryHeap::print_stats() const
+{
+	std::cout << "Geometry heap " << name << ": " << vertex_space.allocation_count()
+			  << " meshes, vertices " << megabytes((size_t)vertex_space.used() * format.stride)
+			  << " of " << megabytes((size_t)vertex_space.capacity() * format.stride)
+			  << " MB, indices " << megabytes((size_t)index_space.used() * sizeof(uint32_t))
+			  << " of " << megabytes((size_t)index_space.capacity() * sizeof(uint32_t)) << " MB\n"
+			  << "  " << vertex_space.free_ranges() + index_space.free_ranges()
+			  << " free ranges, fragmentation " << fragmentation() * 100.0f << "%, "
+			  << stats.allocations << " allocations, " << stats.frees << " frees, "
+			  << stats.growths << " growths, " << stats.compactions << " compactions, "
+			  << megabytes(stats.bytes_copied) << " MB copied\n";
+}
@@ -0,0 +1,116 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "RangeAllocator.h"
+
+constexpr uint32_t GEOMETRY_HEAP_VERTICES = 256 * 1024;
+constexpr uint32_t GEOMETRY_HEAP_INDICES = 1024 * 1024;
+// Share of a buffer lost in free ranges besides the largest one, past which
+// the heap gets compacted
+constexpr float GEOMETRY_HEAP_MAX_FRAGMENTATION = 0.25f;
+
+// A float vertex attribute at a fixed location
+struct VertexAttribute
+{
+	uint32_t location = 0;
+	int32_t components = 0;
+	uint32_t offset = 0;
+};
+
+struct VertexFormat
+{
+	uint32_t stride = 0;
+	std::vector<VertexAttribute> attributes;
+};
+
+// The layout of Vertex, at the locations the model shader reads it from
+VertexFormat model_vertex_format();
+
+// Refers to a mesh in a GeometryHeap. Stays the same when compaction
+// moves the mesh; its range doesn't.
+struct GeometryHandle
+{
+	uint32_t index = UINT32_MAX;
+
+	bool valid() const { return index != UINT32_MAX; }
+};
+
+// Where a mesh is in the heap's buffers. Its indices are relative to its
+// own vertices, so draws pass base_vertex along and offset their first
+// index by first_index.
+struct GeometryRange
+{
+	uint32_t base_vertex = 0;
+	uint32_t first_index = 0;
+	uint32_t vertex_count = 0;
+	uint32_t index_count = 0;
+};
+
+struct GeometryHeapStats
+{
+	uint32_t allocations = 0;
+	uint32_t frees = 0;
+	uint32_t growths = 0;
+	uint32_t compactions = 0;
+	uint64_t bytes_copied = 0; // on the GPU, by growth and compaction
+};
+
+// Keeps the geometry of every mesh of one vertex format in one vertex and
+// one index buffer, behind one vertex array, so meshes draw one after the
+// other without a vertex array switch. The buffers grow by GPU copy when
+// full, and compact() packs the meshes together again once freeing has
+// left the space in holes too small to use.
+class GeometryHeap
+{
+public:
+	bool initialize(const VertexFormat& vertex_format, const std::string& heap_name,
+		uint32_t vertex_capacity = GEOMETRY_HEAP_VERTICES,
+		uint32_t index_capacity = GEOMETRY_HEAP_INDICES);
+	void destroy();
+
+	// Uploads a mesh. Invalid if the buffers couldn't grow to fit it.
+	GeometryHandle allocate(const void* vertices, uint32_t vertex_count,
+		const uint32_t* indices, uint32_t index_count);
+	void release(GeometryHandle handle);
+	const GeometryRange& range(GeometryHandle handle) const;
+
+	// Copies the meshes to the front of new buffers, leaving the free space
+	// in one piece at the end
+	void compact();
+	// Of whichever buffer is worse, from 0 to 1
+	float fragmentation() const;
+
+	uint32_t vertex_array() const;
+	void print_stats() const;
+
+	GeometryHeapStats stats;
+
+private:
+	struct Mesh
+	{
+		GeometryRange range;
+		RangeAllocator::Allocation vertices;
+		RangeAllocator::Allocation indices;
+	};
+
+	// Moves the contents to a new buffer of the new capacity. Elements
+	// are in bytes.
+	void grow(uint32_t& buffer, RangeAllocator& space, uint32_t element_size,
+		uint32_t needed, bool vertices);
+	// Points the vertex array at the current buffers
+	void bind_buffers();
+
+	VertexFormat format;
+	std::string name;
+	uint32_t vao = 0; // vertex array object
+	uint32_t vbo = 0; // vertex buffer object
+	uint32_t ebo = 0; // element buffer object
+	RangeAllocator vertex_space;
+	RangeAllocator index_space;
+
+	std::vector<Mesh> meshes;
+	std::vector<uint32_t> free_meshes;
+};
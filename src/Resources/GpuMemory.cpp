@@ -0,0 +1,191 @@
+#include "GpuMemory.h"
+
+#include <algorithm>
+#include <iostream>
+#include <vector>
+
+namespace
+{
+	double megabytes(size_t bytes)
+	{
+		return (double)bytes / (1024.0 * 1024.0);
+	}
+
+	const char* object_name(GpuObject type)
+	{
+		switch (type)
+		{
+			case GpuObject::Buffer:
+				return "buffer";
+			case GpuObject::Texture:
+				return "texture";
+			case GpuObject::Renderbuffer:
+				return "renderbuffer";
+		}
+		return "object";
+	}
+}
+
+const char* gpu_memory_category_name(GpuMemoryCategory category)
+{
+	switch (category)
+	{
+		case GpuMemoryCategory::Vertex:
+			return "vertex";
+		case GpuMemoryCategory::Index:
+			return "index";
+		case GpuMemoryCategory::Uniform:
+			return "uniform";
+		case GpuMemoryCategory::Texture:
+			return "texture";
+		case GpuMemoryCategory::RenderTarget:
+			return "render target";
+		case GpuMemoryCategory::Staging:
+			return "staging";
+		case GpuMemoryCategory::Count:
+			break;
+	}
+	return "unknown";
+}
+
+size_t texture_bytes(uint32_t width, uint32_t height, uint32_t layers,
+	uint32_t bytes_per_texel, bool mipmapped)
+{
+	size_t bytes = 0;
+	while (true)
+	{
+		bytes += (size_t)width * height * layers * bytes_per_texel;
+		if (!mipmapped || (width == 1 && height == 1))
+		{
+			return bytes;
+		}
+		width = std::max(width / 2, 1u);
+		height = std::max(height / 2, 1u);
+	}
+}
+
+uint64_t GpuMemoryTracker::key(GpuObject type, uint32_t name)
+{
+	return (uint64_t)type << 32 | name;
+}
+
+void GpuMemoryTracker::allocate(GpuObject type, uint32_t name, GpuMemoryCategory category,
+	const std::string& owner, size_t bytes)
+{
+	if (name == 0)
+	{
+		return;
+	}
+
+	release(type, name);
+
+	Allocation& allocation = allocations[key(type, name)];
+	allocation.category = category;
+	allocation.owner = owner;
+	allocation.bytes = bytes;
+	allocation.frame = frame;
+
+	const size_t index = (size_t)category;
+	stats.bytes[index] += bytes;
+	stats.peak_bytes[index] = std::max(stats.peak_bytes[index], stats.bytes[index]);
+	stats.total_bytes += bytes;
+	stats.peak_total_bytes = std::max(stats.peak_total_bytes, stats.total_bytes);
+	stats.allocations++;
+}
+
+void GpuMemoryTracker::release(GpuObject type, uint32_t name)
+{
+	const auto it = allocations.find(key(type, name));
+	if (it == allocations.end())
+	{
+		return;
+	}
+
+	const Allocation& allocation = it->second;
+	stats.bytes[(size_t)allocation.category] -= allocation.bytes;
+	stats.total_bytes -= allocation.bytes;
+	stats.frees++;
+	stats.freed_lifetime_frames += frame - allocation.frame;
+	allocations.erase(it);
+}
+
+void GpuMemoryTracker::release(GpuObject type, size_t count, const uint32_t* names)
+{
+	for (size_t i = 0; i < count; i++)
+	{
+		release(type, names[i]);
+	}
+}
+
+void GpuMemoryTracker::end_frame()
+{
+	frame++;
+}
+
+uint32_t GpuMemoryTracker::live_allocations() const
+{
+	return (uint32_t)allocations.size();
+}
+
+void GpuMemoryTracker::print_stats() const
+{
+	std::cout << "GPU memory: " << megabytes(stats.total_bytes) << " MB in "
+			  << allocations.size() << " allocations (peak "
+			  << megabytes(stats.peak_total_bytes) << " MB), " << stats.allocations
+			  << " allocated, " << stats.frees << " freed";
+	if (stats.frees > 0)
+	{
+		std::cout << " after " << (double)stats.freed_lifetime_frames / stats.frees
+				  << " frames on average";
+	}
+	std::cout << "\n";
+
+	for (size_t i = 0; i < (size_t)GpuMemoryCategory::Count; i++)
+	{
+		if (stats.peak_bytes[i] == 0)
+		{
+			continue;
+		}
+		std::cout << "  " << gpu_memory_category_name((GpuMemoryCategory)i) << ": "
+				  << megabytes(stats.bytes[i]) << " MB (peak " << megabytes(stats.peak_bytes[i])
+				  << " MB)\n";
+	}
+}
+
+uint32_t GpuMemoryTracker::report_leaks() const
+{
+	if (allocations.empty())
+	{
+		return 0;
+	}
+
+	// Biggest first, they matter most
+	std::vector<std::pair<uint64_t, const Allocation*>> leaks;
+	for (const auto& [id, allocation] : allocations)
+	{
+		leaks.emplace_back(id, &allocation);
+	}
+	std::sort(leaks.begin(), leaks.end(), [](const auto& a, const auto& b) {
+		return a.second->bytes > b.second->bytes;
+	});
+
+	std::cerr << "GPU memory leaked: " << leaks.size() << " allocations, "
+			  << megabytes(stats.total_bytes) << " MB\n";
+	for (const auto& [id, allocation] : leaks)
+	{
+		std::cerr << "  " << object_name((GpuObject)(id >> 32)) << " " << (uint32_t)id << ": "
+				  << allocation->bytes << " bytes of "
+				  << gpu_memory_category_name(allocation->category) << " from "
+				  << allocation->owner << ", made on frame " << allocation->frame << "\n";
+	}
+
+	return (uint32_t)leaks.size();
+}
+
+GpuMemoryTracker& gpu_memory()
+{
+	// Made on first use and never destroyed, so static initialization and
+	// teardown order never matter
+	static GpuMemoryTracker* tracker = new GpuMemoryTracker();
+	return *tracker;
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+
+enum class GpuMemoryCategory : uint8_t
+{
+	Vertex,
+	Index,
+	Uniform, // constant data read by shaders, e.g. the material buffer
+	Texture,
+	RenderTarget,
+	Staging, // pixel buffers uploads go through
+	Count,
+};
+
+const char* gpu_memory_category_name(GpuMemoryCategory category);
+
+// Bytes of an uncompressed texture, with its full mip chain when mipmapped
+size_t texture_bytes(uint32_t width, uint32_t height, uint32_t layers,
+	uint32_t bytes_per_texel, bool mipmapped);
+
+// GL keeps separate names for each of these
+enum class GpuObject : uint8_t
+{
+	Buffer,
+	Texture,
+	Renderbuffer,
+};
+
+struct GpuMemoryStats
+{
+	std::array<size_t, (size_t)GpuMemoryCategory::Count> bytes{};
+	std::array<size_t, (size_t)GpuMemoryCategory::Count> peak_bytes{};
+	size_t total_bytes = 0;
+	size_t peak_total_bytes = 0;
+	uint32_t allocations = 0; // including storage respecified in place
+	uint32_t frees = 0;
+	uint64_t freed_lifetime_frames = 0; // summed over the frees
+};
+
+// Accounts for the storage of every buffer, texture and renderbuffer the
+// renderer makes: how big, what for, who made it and on which frame. The
+// sizes are what was asked for, so driver padding isn't counted. Only the
+// render thread touches it, as with the GL calls it shadows.
+class GpuMemoryTracker
+{
+public:
+	// Records the storage of an object, replacing whatever it held before
+	// as glBufferData and glTexImage do
+	void allocate(GpuObject type, uint32_t name, GpuMemoryCategory category,
+		const std::string& owner, size_t bytes);
+	// Names that were never allocated, such as 0, are ignored
+	void release(GpuObject type, uint32_t name);
+	void release(GpuObject type, size_t count, const uint32_t* names);
+
+	// Advances the clock lifetimes are measured with
+	void end_frame();
+
+	uint32_t live_allocations() const;
+	void print_stats() const;
+	// Lists every allocation still alive, for after everything was meant
+	// to have been destroyed. Returns how many there were.
+	uint32_t report_leaks() const;
+
+	GpuMemoryStats stats;
+
+private:
+	struct Allocation
+	{
+		GpuMemoryCategory category = GpuMemoryCategory::Vertex;
+		std::string owner;
+		size_t bytes = 0;
+		uint64_t frame = 0; // made on
+	};
+
+	static uint64_t key(GpuObject type, uint32_t name);
+
+	std::unordered_map<uint64_t, Allocation> allocations;
+	uint64_t frame = 0;
+};
+
+// The tracker the renderer and its loaders share
+GpuMemoryTracker& gpu_memory();
@@ -0,0 +1,300 @@
+#include "RangeAllocator.h"
+
+#include <algorithm>
+#include <bit>
+
+uint32_t RangeAllocator::bin_of(uint32_t size)
+{
+	// Below eight the second level counts single elements
+	const uint32_t first = 31 - (uint32_t)std::countl_zero(size);
+	const uint32_t second = first >= SECOND_LEVEL_BITS
+		? (size >> (first - SECOND_LEVEL_BITS)) & (SECOND_LEVELS - 1)
+		: (size << (SECOND_LEVEL_BITS - first)) & (SECOND_LEVELS - 1);
+	return first * SECOND_LEVELS + second;
+}
+
+uint32_t RangeAllocator::find_bin(uint32_t bin) const
+{
+	const uint32_t first = bin / SECOND_LEVELS;
+	const uint32_t second_map = second_level_maps[first] & (~0u << (bin % SECOND_LEVELS));
+	if (second_map)
+	{
+		return first * SECOND_LEVELS + (uint32_t)std::countr_zero(second_map);
+	}
+
+	const uint32_t first_map = first + 1 < FIRST_LEVELS ? first_level_map & (~0u << (first + 1)) : 0;
+	if (!first_map)
+	{
+		return RANGE_NO_NODE;
+	}
+	const uint32_t next_first = (uint32_t)std::countr_zero(first_map);
+	return next_first * SECOND_LEVELS + (uint32_t)std::countr_zero(second_level_maps[next_first]);
+}
+
+void RangeAllocator::initialize(uint32_t capacity)
+{
+	nodes.clear();
+	spare_nodes.clear();
+	bins.fill(RANGE_NO_NODE);
+	first_level_map = 0;
+	second_level_maps.fill(0);
+	last = RANGE_NO_NODE;
+	total = 0;
+	in_use = 0;
+	free_count = 0;
+	allocations = 0;
+	grow(capacity);
+}
+
+void RangeAllocator::reset()
+{
+	initialize(total);
+}
+
+uint32_t RangeAllocator::make_node(uint32_t offset, uint32_t size)
+{
+	uint32_t index = 0;
+	if (!spare_nodes.empty())
+	{
+		index = spare_nodes.back();
+		spare_nodes.pop_back();
+	}
+	else
+	{
+		index = (uint32_t)nodes.size();
+		nodes.emplace_back();
+	}
+
+	nodes[index] = Node();
+	nodes[index].offset = offset;
+	nodes[index].size = size;
+	return index;
+}
+
+void RangeAllocator::recycle_node(uint32_t node)
+{
+	spare_nodes.push_back(node);
+}
+
+void RangeAllocator::insert_free(uint32_t node)
+{
+	const uint32_t bin = bin_of(nodes[node].size);
+	nodes[node].used = false;
+	nodes[node].previous_free = RANGE_NO_NODE;
+	nodes[node].next_free = bins[bin];
+	if (bins[bin] != RANGE_NO_NODE)
+	{
+		nodes[bins[bin]].previous_free = node;
+	}
+	bins[bin] = node;
+
+	first_level_map |= 1u << (bin / SECOND_LEVELS);
+	second_level_maps[bin / SECOND_LEVELS] |= 1u << (bin % SECOND_LEVELS);
+	free_count++;
+}
+
+void RangeAllocator::remove_free(uint32_t node)
+{
+	const Node& removed = nodes[node];
+	const uint32_t bin = bin_of(removed.size);
+	if (removed.previous_free != RANGE_NO_NODE)
+	{
+		nodes[removed.previous_free].next_free = removed.next_free;
+	}
+	else
+	{
+		bins[bin] = removed.next_free;
+	}
+	if (removed.next_free != RANGE_NO_NODE)
+	{
+		nodes[removed.next_free].previous_free = removed.previous_free;
+	}
+
+	if (bins[bin] == RANGE_NO_NODE)
+	{
+		second_level_maps[bin / SECOND_LEVELS] &= ~(1u << (bin % SECOND_LEVELS));
+		if (!second_level_maps[bin / SECOND_LEVELS])
+		{
+			first_level_map &= ~(1u << (bin / SECOND_LEVELS));
+		}
+	}
+	free_count--;
+}
+
+RangeAllocator::Allocation RangeAllocator::allocate(uint32_t size)
+{
+	size = std::max(size, 1u);
+
+	// Every range in a bin above that of the size rounded up to the next
+	// bin fits, so the first one found does
+	uint32_t node = RANGE_NO_NODE;
+	const uint32_t first = 31 - (uint32_t)std::countl_zero(size);
+	const uint32_t round_up = first >= SECOND_LEVEL_BITS ? (1u << (first - SECOND_LEVEL_BITS)) - 1 : 0;
+	if (size <= UINT32_MAX - round_up)
+	{
+		const uint32_t bin = find_bin(bin_of(size + round_up));
+		if (bin != RANGE_NO_NODE)
+		{
+			node = bins[bin];
+		}
+	}
+
+	// Otherwise something in the size's own bin may still be big enough
+	if (node == RANGE_NO_NODE)
+	{
+		for (uint32_t candidate = bins[bin_of(size)]; candidate != RANGE_NO_NODE;
+			candidate = nodes[candidate].next_free)
+		{
+			if (nodes[candidate].size >= size)
+			{
+				node = candidate;
+				break;
+			}
+		}
+	}
+	if (node == RANGE_NO_NODE)
+	{
+		return Allocation();
+	}
+
+	remove_free(node);
+	if (nodes[node].size > size)
+	{
+		// The rest stays free, right after
+		const uint32_t rest = make_node(nodes[node].offset + size, nodes[node].size - size);
+		nodes[rest].previous = node;
+		nodes[rest].next = nodes[node].next;
+		if (nodes[node].next != RANGE_NO_NODE)
+		{
+			nodes[nodes[node].next].previous = rest;
+		}
+		else
+		{
+			last = rest;
+		}
+		nodes[node].next = rest;
+		nodes[node].size = size;
+		insert_free(rest);
+	}
+	nodes[node].used = true;
+
+	in_use += size;
+	allocations++;
+	return {nodes[node].offset, size, node};
+}
+
+void RangeAllocator::release(const Allocation& allocation)
+{
+	if (!allocation.valid())
+	{
+		return;
+	}
+
+	uint32_t node = allocation.node;
+	in_use -= nodes[node].size;
+	allocations--;
+
+	const uint32_t next = nodes[node].next;
+	if (next != RANGE_NO_NODE && !nodes[next].used)
+	{
+		remove_free(next);
+		nodes[node].size += nodes[next].size;
+		nodes[node].next = nodes[next].next;
+		if (nodes[next].next != RANGE_NO_NODE)
+		{
+			nodes[nodes[next].next].previous = node;
+		}
+		else
+		{
+			last = node;
+		}
+		recycle_node(next);
+	}
+
+	const uint32_t previous = nodes[node].previous;
+	if (previous != RANGE_NO_NODE && !nodes[previous].used)
+	{
+		remove_free(previous);
+		nodes[previous].size += nodes[node].size;
+		nodes[previous].next = nodes[node].next;
+		if (nodes[node].next != RANGE_NO_NODE)
+		{
+			nodes[nodes[node].next].previous = previous;
+		}
+		else
+		{
+			last = previous;
+		}
+		recycle_node(node);
+		node = previous;
+	}
+
+	insert_free(node);
+}
+
+void RangeAllocator::grow(uint32_t new_capacity)
+{
+	if (new_capacity <= total)
+	{
+		return;
+	}
+
+	const uint32_t extra = new_capacity - total;
+	if (last != RANGE_NO_NODE && !nodes[last].used)
+	{
+		remove_free(last);
+		nodes[last].size += extra;
+		insert_free(last);
+	}
+	else
+	{
+		const uint32_t node = make_node(total, extra);
+		nodes[node].previous = last;
+		if (last != RANGE_NO_NODE)
+		{
+			nodes[last].next = node;
+		}
+		last = node;
+		insert_free(node);
+	}
+	total = new_capacity;
+}
+
+uint32_t RangeAllocator::capacity() const
+{
+	return total;
+}
+
+uint32_t RangeAllocator::used() const
+{
+	return in_use;
+}
+
+uint32_t RangeAllocator::largest_free() const
+{
+	if (!first_level_map)
+	{
+		return 0;
+	}
+
+	// Somewhere in the highest bin
+	const uint32_t first = 31 - (uint32_t)std::countl_zero(first_level_map);
+	const uint32_t second = 31 - (uint32_t)std::countl_zero(second_level_maps[first]);
+	uint32_t largest = 0;
+	for (uint32_t node = bins[first * SECOND_LEVELS + second]; node != RANGE_NO_NODE;
+		node = nodes[node].next_free)
+	{
+		largest = std::max(largest, nodes[node].size);
+	}
+	return largest;
+}
+
+uint32_t RangeAllocator::free_ranges() const
+{
+	return free_count;
+}
+
+uint32_t RangeAllocator::allocation_count() const
+{
+	return allocations;
+}
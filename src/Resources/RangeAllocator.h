@@ -0,0 +1,79 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+constexpr uint32_t RANGE_NO_NODE = UINT32_MAX;
+
+// Hands out ranges of a linear space, such as the elements of a GPU buffer,
+// in the manner of a two-level segregated fit allocator: free ranges sit in
+// bins by size, eight to each power of two, and two levels of bitmaps find
+// the smallest bin that is sure to fit in constant time. Freed ranges merge
+// with free neighbours straight away.
+class RangeAllocator
+{
+public:
+	struct Allocation
+	{
+		uint32_t offset = 0;
+		uint32_t size = 0;
+		uint32_t node = RANGE_NO_NODE;
+
+		bool valid() const { return node != RANGE_NO_NODE; }
+	};
+
+	void initialize(uint32_t capacity);
+	// Everything free again, as after initialize
+	void reset();
+
+	// Invalid when no free range is big enough
+	Allocation allocate(uint32_t size);
+	void release(const Allocation& allocation);
+	// Adds free space to the end
+	void grow(uint32_t new_capacity);
+
+	uint32_t capacity() const;
+	uint32_t used() const;
+	uint32_t largest_free() const;
+	uint32_t free_ranges() const;
+	uint32_t allocation_count() const;
+
+private:
+	static constexpr uint32_t FIRST_LEVELS = 32;
+	static constexpr uint32_t SECOND_LEVEL_BITS = 3;
+	static constexpr uint32_t SECOND_LEVELS = 1 << SECOND_LEVEL_BITS;
+
+	struct Node
+	{
+		uint32_t offset = 0;
+		uint32_t size = 0;
+		// Neighbours in the space, and in the bin when free
+		uint32_t previous = RANGE_NO_NODE;
+		uint32_t next = RANGE_NO_NODE;
+		uint32_t previous_free = RANGE_NO_NODE;
+		uint32_t next_free = RANGE_NO_NODE;
+		bool used = false;
+	};
+
+	static uint32_t bin_of(uint32_t size);
+	// The first non-empty bin at or above bin, or RANGE_NO_NODE
+	uint32_t find_bin(uint32_t bin) const;
+
+	uint32_t make_node(uint32_t offset, uint32_t size);
+	void recycle_node(uint32_t node);
+	void insert_free(uint32_t node);
+	void remove_free(uint32_t node);
+
+	std::vector<Node> nodes;
+	std::vector<uint32_t> spare_nodes;
+	std::array<uint32_t, FIRST_LEVELS * SECOND_LEVELS> bins{};
+	uint32_t first_level_map = 0;
+	std::array<uint32_t, FIRST_LEVELS> second_level_maps{};
+	uint32_t last = RANGE_NO_NODE; // the node at the end of the space
+
+	uint32_t total = 0;
+	uint32_t in_use = 0;
+	uint32_t free_count = 0;
+	uint32_t allocations = 0;
+};
@@ -0,0 +1,474 @@
+#include "ResidencyManager.h"
+
+#include <algorithm>
+#include <iostream>
+
+#include "../Model/Model.h"
+#include "../Texture/TextureLoader.h"
+
+namespace
+{
+	double megabytes(size_t bytes)
+	{
+		return (double)bytes / (1024.0 * 1024.0);
+	}
+
+	size_t model_host_bytes(const Model& model)
+	{
+		return model.vertices.size() * sizeof(Vertex) + model.indices.size() * sizeof(uint32_t)
+			+ model.meshlets.size() * sizeof(Meshlet);
+	}
+
+	// Big on screen loads first
+	JobPriority load_priority(float screen_size)
+	{
+		if (screen_size >= 256.0f)
+		{
+			return JobPriority::High;
+		}
+		return screen_size >= 32.0f ? JobPriority::Normal : JobPriority::Low;
+	}
+}
+
+void ResidencyManager::initialize(AssetLoader& asset_loader, TextureLoader& texture_loader,
+	GeometryHeap& geometry_heap)
+{
+	assets = &asset_loader;
+	textures = &texture_loader;
+	geometry = &geometry_heap;
+}
+
+void ResidencyManager::destroy()
+{
+	// The asset loader has already run every load to completion
+	for (Resource& resource : resources)
+	{
+		free_vram(resource);
+		free_host(resource);
+	}
+	resources.clear();
+	free_slots.clear();
+	loads_in_flight = 0;
+}
+
+void ResidencyManager::set_budget(const ResidencyBudget& new_budget)
+{
+	budget = new_budget;
+}
+
+ResourceHandle ResidencyManager::allocate()
+{
+	ResourceHandle handle;
+	if (!free_slots.empty())
+	{
+		handle.index = free_slots.back();
+		free_slots.pop_back();
+	}
+	else
+	{
+		handle.index = (uint32_t)resources.size();
+		resources.emplace_back();
+	}
+
+	Resource& resource = resources[handle.index];
+	handle.generation = resource.generation;
+	resource.refs = 1;
+	return handle;
+}
+
+ResourceHandle ResidencyManager::create_model(const std::string& path, int lod_count,
+	std::shared_ptr<Model> loaded_model)
+{
+	const ResourceHandle handle = allocate();
+	Resource& resource = resources[handle.index];
+	resource.path = path;
+	resource.kind = Kind::Model;
+	resource.lod_count = lod_count;
+
+	if (loaded_model)
+	{
+		resource.host_bytes = model_host_bytes(*loaded_model);
+		resource.resident_model.model = std::move(loaded_model);
+		resource.state = State::HostResident;
+	}
+
+	return handle;
+}
+
+ResourceHandle ResidencyManager::create_texture(const std::string& path)
+{
+	const ResourceHandle handle = allocate();
+	Resource& resource = resources[handle.index];
+	resource.path = path;
+	resource.kind = Kind::Texture;
+	return handle;
+}
+
+ResidencyManager::Resource* ResidencyManager::find(ResourceHandle handle)
+{
+	if (handle.index >= resources.size())
+	{
+		return nullptr;
+	}
+	Resource& resource = resources[handle.index];
+	return resource.generation == handle.generation && resource.refs > 0 ? &resource : nullptr;
+}
+
+const ResidencyManager::Resource* ResidencyManager::find(ResourceHandle handle) const
+{
+	if (handle.index >= resources.size())
+	{
+		return nullptr;
+	}
+	const Resource& resource = resources[handle.index];
+	return resource.generation == handle.generation && resource.refs > 0 ? &resource : nullptr;
+}
+
+void ResidencyManager::add_ref(ResourceHandle handle)
+{
+	if (Resource* resource = find(handle))
+	{
+		resource->refs++;
+	}
+}
+
+void ResidencyManager::release(ResourceHandle handle)
+{
+	Resource* resource = find(handle);
+	if (!resource || --resource->refs > 0)
+	{
+		return;
+	}
+
+	// A load still in flight stops at its next hop, or finds the
+	// generation changed and drops what it loaded
+	if (resource->state == State::Loading)
+	{
+		resource->cancel.cancel();
+		loads_in_flight--;
+	}
+	free_vram(*resource);
+	free_host(*resource);
+
+	const uint32_t generation = resource->generation + 1;
+	*resource = Resource();
+	resource->generation = generation;
+	free_slots.push_back(handle.index);
+}
+
+void ResidencyManager::touch(ResourceHandle handle, uint64_t frame, float screen_size)
+{
+	Resource* resource = find(handle);
+	if (!resource)
+	{
+		return;
+	}
+
+	// Keep the largest size the resource was seen at this frame
+	if (resource->last_visible_frame != frame)
+	{
+		resource->screen_size = 0.0f;
+	}
+	resource->last_visible_frame = frame;
+	resource->screen_size = std::max(resource->screen_size, screen_size);
+
+	if (resource->state == State::Resident || resource->state == State::Failed)
+	{
+		return;
+	}
+
+	if (!resource->waiting)
+	{
+		resource->waiting = true;
+		resource->request_time = std::chrono::steady_clock::now();
+	}
+	if (resource->state == State::Unloaded)
+	{
+		resource->state = State::Queued;
+	}
+}
+
+const ResidentModel* ResidencyManager::model(ResourceHandle handle) const
+{
+	const Resource* resource = find(handle);
+	return resource && resource->kind == Kind::Model && resource->state == State::Resident
+		? &resource->resident_model : nullptr;
+}
+
+uint32_t ResidencyManager::texture(ResourceHandle handle) const
+{
+	const Resource* resource = find(handle);
+	return resource && resource->kind == Kind::Texture && resource->state == State::Resident
+		? resource->texture->id : 0;
+}
+
+float ResidencyManager::priority(const Resource& resource, uint64_t frame)
+{
+	// Big on screen and seen recently wins
+	const float age = (float)(frame - std::min(frame, resource.last_visible_frame));
+	return resource.screen_size / (1.0f + age);
+}
+
+void ResidencyManager::start_load(Resource& resource, uint32_t index)
+{
+	resource.state = State::Loading;
+	resource.cancel = CancelToken();
+	stats.loads++;
+	loads_in_flight++;
+
+	LoadOptions options;
+	options.priority = load_priority(resource.screen_size);
+	options.cancel = resource.cancel;
+	spawn(stream({index, resource.generation}, resource.kind, resource.path,
+		resource.lod_count, options));
+}
+
+Task<void> ResidencyManager::stream(ResourceHandle handle, Kind kind, std::string path,
+	int lod_count, LoadOptions options)
+{
+	std::shared_ptr<Model> model;
+	std::shared_ptr<Texture> texture;
+	if (kind == Kind::Model)
+	{
+		model = co_await assets->load_model(path, lod_count, options);
+	}
+	else
+	{
+		texture = co_await assets->load_texture(path, options);
+	}
+
+	// Back on the render thread, where the slot may have been reused
+	Resource* resource = find(handle);
+	if (!resource || resource->state != State::Loading)
+	{
+		if (texture)
+		{
+			textures->unload(*texture);
+		}
+		co_return;
+	}
+	loads_in_flight--;
+
+	if (!model && !texture && (options.cancel.cancelled() || assets->stopped()))
+	{
+		resource->state = State::Unloaded;
+	}
+	else if (!model && !texture)
+	{
+		resource->state = State::Failed;
+		stats.failed++;
+	}
+	else if (model)
+	{
+		resource->host_bytes = model_host_bytes(*model);
+		resource->resident_model.model = std::move(model);
+		resource->state = State::HostResident;
+	}
+	else
+	{
+		resource->vram_bytes = texture->gpu_bytes;
+		resource->texture = std::move(texture);
+		mark_resident(*resource);
+	}
+}
+
+void ResidencyManager::upload_model(Resource& resource)
+{
+	ResidentModel& resident = resource.resident_model;
+	const Model& source = *resident.model;
+
+	resident.geometry = geometry->allocate(source.vertices.data(),
+		(uint32_t)source.vertices.size(), source.indices.data(), (uint32_t)source.indices.size());
+	if (!resident.geometry.valid())
+	{
+		resource.state = State::Failed;
+		stats.failed++;
+		return;
+	}
+
+	resource.vram_bytes = source.vertices.size() * sizeof(Vertex)
+		+ source.indices.size() * sizeof(uint32_t);
+	stats.uploads++;
+	mark_resident(resource);
+}
+
+void ResidencyManager::mark_resident(Resource& resource)
+{
+	resource.state = State::Resident;
+	if (!resource.waiting)
+	{
+		return;
+	}
+	resource.waiting = false;
+
+	if (resource.evicted)
+	{
+		const double seconds = std::chrono::duration<double>(
+			std::chrono::steady_clock::now() - resource.request_time).count();
+		stats.reloads++;
+		stats.reload_seconds += seconds;
+		stats.max_reload_seconds = std::max(stats.max_reload_seconds, seconds);
+	}
+}
+
+void ResidencyManager::free_vram(Resource& resource)
+{
+	if (resource.kind == Kind::Model)
+	{
+		ResidentModel& resident = resource.resident_model;
+		geometry->release(resident.geometry);
+		resident.geometry = GeometryHandle();
+		if (resource.state == State::Resident)
+		{
+			resource.state = State::HostResident;
+		}
+	}
+	else if (resource.texture)
+	{
+		// Textures keep no host copy, so they go all the way
+		textures->unload(*resource.texture);
+		resource.texture.reset();
+		resource.state = State::Unloaded;
+	}
+
+	resource.vram_bytes = 0;
+}
+
+void ResidencyManager::free_host(Resource& resource)
+{
+	resource.resident_model.model.reset();
+	resource.host_bytes = 0;
+	if (resource.state == State::HostResident)
+	{
+		resource.state = State::Unloaded;
+	}
+}
+
+bool ResidencyManager::evict(uint64_t frame, bool vram)
+{
+	Resource* victim = nullptr;
+	float victim_priority = 0.0f;
+
+	for (Resource& resource : resources)
+	{
+		const size_t bytes = vram ? resource.vram_bytes : resource.host_bytes;
+		if (bytes == 0 || resource.refs == 0 || resource.last_visible_frame >= frame)
+		{
+			continue;
+		}
+
+		// Least recently visible first, then smallest on screen
+		const float resource_priority = priority(resource, frame);
+		if (!victim || resource.last_visible_frame < victim->last_visible_frame
+			|| (resource.last_visible_frame == victim->last_visible_frame
+				&& resource_priority < victim_priority))
+		{
+			victim = &resource;
+			victim_priority = resource_priority;
+		}
+	}
+
+	if (!victim)
+	{
+		return false;
+	}
+
+	free_vram(*victim);
+	if (vram)
+	{
+		stats.vram_evictions++;
+	}
+	else
+	{
+		free_host(*victim);
+		stats.host_evictions++;
+	}
+	victim->evicted = true;
+	return true;
+}
+
+void ResidencyManager::update_totals()
+{
+	stats.host_bytes = 0;
+	stats.vram_bytes = 0;
+	for (const Resource& resource : resources)
+	{
+		stats.host_bytes += resource.host_bytes;
+		stats.vram_bytes += resource.vram_bytes;
+	}
+	stats.peak_host_bytes = std::max(stats.peak_host_bytes, stats.host_bytes);
+	stats.peak_vram_bytes = std::max(stats.peak_vram_bytes, stats.vram_bytes);
+}
+
+void ResidencyManager::update(uint64_t frame)
+{
+	// Upload host resident models somebody looked at this frame
+	for (Resource& resource : resources)
+	{
+		if (resource.kind == Kind::Model && resource.state == State::HostResident
+			&& resource.waiting && resource.last_visible_frame == frame)
+		{
+			upload_model(resource);
+		}
+	}
+
+	// Start the most wanted loads first
+	std::vector<uint32_t> queued;
+	for (uint32_t i = 0; i < (uint32_t)resources.size(); i++)
+	{
+		if (resources[i].state == State::Queued)
+		{
+			queued.push_back(i);
+		}
+	}
+	std::sort(queued.begin(), queued.end(), [&](uint32_t a, uint32_t b) {
+		return priority(resources[a], frame) > priority(resources[b], frame);
+	});
+	for (const uint32_t index : queued)
+	{
+		if (loads_in_flight >= MAX_LOADS_IN_FLIGHT)
+		{
+			break;
+		}
+		start_load(resources[index], index);
+	}
+
+	// Evict down to the budgets. Anything visible this frame stays, even if
+	// that means going over.
+	update_totals();
+	bool over_vram = false;
+	while (stats.vram_bytes > budget.vram_bytes && !over_vram)
+	{
+		over_vram = !evict(frame, true);
+		update_totals();
+	}
+	bool over_host = false;
+	while (stats.host_bytes > budget.host_bytes && !over_host)
+	{
+		over_host = !evict(frame, false);
+		update_totals();
+	}
+	if (over_vram || over_host)
+	{
+		stats.over_budget_frames++;
+	}
+}
+
+void ResidencyManager::print_stats() const
+{
+	std::cout << "Residency: host " << megabytes(stats.host_bytes) << " MB (peak "
+			  << megabytes(stats.peak_host_bytes) << " of " << megabytes(budget.host_bytes)
+			  << "), VRAM " << megabytes(stats.vram_bytes) << " MB (peak "
+			  << megabytes(stats.peak_vram_bytes) << " of " << megabytes(budget.vram_bytes) << ")\n"
+			  << "  " << stats.loads << " loads, " << stats.uploads << " uploads, "
+			  << stats.failed << " failed, " << stats.over_budget_frames << " frames over budget\n"
+			  << "  evictions: " << stats.vram_evictions << " VRAM, " << stats.host_evictions
+			  << " host\n"
+			  << "  reloads: " << stats.reloads;
+	if (stats.reloads > 0)
+	{
+		std::cout << ", latency " << stats.reload_seconds / stats.reloads * 1000.0
+				  << " ms mean, " << stats.max_reload_seconds * 1000.0 << " ms max";
+	}
+	std::cout << "\n";
+}
@@ -0,0 +1,168 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "GeometryHeap.h"
+#include "../Assets/AssetLoader.h"
+
+class Model;
+class TextureLoader;
+struct Texture;
+
+// At most this many resources load from disk at once, highest priority first
+constexpr uint32_t MAX_LOADS_IN_FLIGHT = 4;
+
+// Refers to a slot of the ResidencyManager. The generation goes up every
+// time the slot is reused, so a stale handle never finds someone else's
+// resource.
+struct ResourceHandle
+{
+	uint32_t index = UINT32_MAX;
+	uint32_t generation = 0;
+
+	bool valid() const { return index != UINT32_MAX; }
+};
+
+struct ResidencyBudget
+{
+	size_t host_bytes = 512 * 1024 * 1024;
+	size_t vram_bytes = 256 * 1024 * 1024;
+};
+
+struct ResidencyStats
+{
+	size_t host_bytes = 0;
+	size_t vram_bytes = 0;
+	size_t peak_host_bytes = 0;
+	size_t peak_vram_bytes = 0;
+	uint32_t loads = 0; // from disk, including reloads
+	uint32_t uploads = 0;
+	uint32_t host_evictions = 0;
+	uint32_t vram_evictions = 0;
+	uint32_t reloads = 0; // loads of something evicted earlier
+	double reload_seconds = 0.0; // from first request to resident, summed
+	double max_reload_seconds = 0.0;
+	uint32_t over_budget_frames = 0; // everything left was visible
+	uint32_t failed = 0;
+};
+
+// A model whose geometry is on the GPU, in the geometry heap
+struct ResidentModel
+{
+	std::shared_ptr<Model> model;
+	GeometryHandle geometry;
+};
+
+// Keeps models and textures within host and VRAM budgets. Resources are
+// refcounted by their handles and only load once something touches them.
+// When over budget, whatever was visible least recently (and smallest on
+// screen among equals) goes first: VRAM eviction keeps a model's host
+// copy for a cheap re-upload, host eviction drops everything and the next
+// touch streams it back in from disk through the AssetLoader.
+class ResidencyManager
+{
+public:
+	void initialize(AssetLoader& asset_loader, TextureLoader& texture_loader,
+		GeometryHeap& geometry_heap);
+	void destroy();
+
+	void set_budget(const ResidencyBudget& new_budget);
+
+	// Registers a model with one reference. Passing the already loaded model
+	// makes it host resident from the start.
+	ResourceHandle create_model(const std::string& path, int lod_count,
+		std::shared_ptr<Model> loaded = nullptr);
+	ResourceHandle create_texture(const std::string& path);
+
+	void add_ref(ResourceHandle handle);
+	// Frees the resource once the last reference goes
+	void release(ResourceHandle handle);
+
+	// Marks the resource as visible this frame at the given size in pixels,
+	// requesting it if it isn't resident
+	void touch(ResourceHandle handle, uint64_t frame, float screen_size);
+
+	// Null or 0 unless the resource is resident
+	const ResidentModel* model(ResourceHandle handle) const;
+	uint32_t texture(ResourceHandle handle) const;
+
+	// Call once per frame on the render thread after drawing: uploads what
+	// was asked for, starts new loads and evicts down to the budgets
+	void update(uint64_t frame);
+
+	void print_stats() const;
+
+	ResidencyStats stats;
+
+private:
+	enum class Kind : uint8_t
+	{
+		Model,
+		Texture,
+	};
+
+	enum class State : uint8_t
+	{
+		Unloaded,
+		Queued, // waiting for a free load slot
+		Loading,
+		HostResident, // models only: loaded but not uploaded
+		Resident,
+		Failed,
+	};
+
+	struct Resource
+	{
+		std::string path;
+		Kind kind = Kind::Model;
+		State state = State::Unloaded;
+		uint32_t generation = 0;
+		uint32_t refs = 0;
+		int lod_count = 1;
+
+		ResidentModel resident_model;
+		std::shared_ptr<Texture> texture;
+
+		size_t host_bytes = 0;
+		size_t vram_bytes = 0;
+		uint64_t last_visible_frame = 0;
+		float screen_size = 0.0f;
+
+		bool evicted = false; // loaded before, so the next load is a reload
+		bool waiting = false; // touched while not resident
+		std::chrono::steady_clock::time_point request_time;
+		CancelToken cancel; // of the load in flight
+	};
+
+	Resource* find(ResourceHandle handle);
+	const Resource* find(ResourceHandle handle) const;
+	ResourceHandle allocate();
+	static float priority(const Resource& resource, uint64_t frame);
+
+	void start_load(Resource& resource, uint32_t index);
+	// Loads the resource and makes it host resident (models) or resident
+	// (textures), unless it was released in the meantime
+	Task<void> stream(ResourceHandle handle, Kind kind, std::string path,
+		int lod_count, LoadOptions options);
+	void upload_model(Resource& resource);
+	void mark_resident(Resource& resource);
+	void free_vram(Resource& resource);
+	void free_host(Resource& resource);
+	// Evicts the lowest priority resource not visible this frame that
+	// holds memory of the given kind. False if there was none.
+	bool evict(uint64_t frame, bool vram);
+	void update_totals();
+
+	AssetLoader* assets = nullptr;
+	TextureLoader* textures = nullptr;
+	GeometryHeap* geometry = nullptr;
+	ResidencyBudget budget;
+
+	std::vector<Resource> resources;
+	std::vector<uint32_t> free_slots;
+	uint32_t loads_in_flight = 0;
+};
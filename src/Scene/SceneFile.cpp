@@ -0,0 +1,344 @@
+#include "SceneFile.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+#include <glm/common.hpp>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace
+{
+	size_t align_up(size_t value, size_t alignment)
+	{
+		return (value + alignment - 1) / alignment * alignment;
+	}
+
+	// Lays arrays out one after the other behind the header
+	class SceneWriter
+	{
+	public:
+		explicit SceneWriter(size_t header_size) : bytes(header_size) {}
+
+		template <typename T>
+		SceneArray<T> add(const T* data, size_t count)
+		{
+			SceneArray<T> array;
+			array.offset = align_up(bytes.size(), SCENE_FILE_ALIGNMENT);
+			array.count = count;
+			bytes.resize(array.offset + sizeof(T) * count);
+			if (count > 0)
+			{
+				std::memcpy(bytes.data() + array.offset, data, sizeof(T) * count);
+			}
+			return array;
+		}
+
+		template <typename T>
+		SceneArray<T> add(const std::vector<T>& data)
+		{
+			return add(data.data(), data.size());
+		}
+
+		SceneString add(const std::string& text)
+		{
+			SceneString string = add(text.c_str(), text.size() + 1);
+			string.count = text.size();
+			return string;
+		}
+
+		std::vector<uint8_t> bytes;
+	};
+
+	struct BuildInstance
+	{
+		glm::vec3 center = glm::vec3(0.0f);
+		float radius = 0.0f;
+		uint32_t placement = 0;
+	};
+
+	// Splits at the median of the widest axis of the centers until the
+	// leaves are small enough, appending the subtree in depth first order
+	void build_node(std::vector<BuildInstance>& instances, uint32_t first, uint32_t count,
+		std::vector<SceneNode>& nodes)
+	{
+		const size_t index = nodes.size();
+		nodes.emplace_back();
+
+		SceneNode node;
+		node.first_instance = first;
+		node.instance_count = count;
+		node.bounds_min = glm::vec3(FLT_MAX);
+		node.bounds_max = glm::vec3(-FLT_MAX);
+		glm::vec3 centers_min(FLT_MAX);
+		glm::vec3 centers_max(-FLT_MAX);
+		for (uint32_t i = first; i < first + count; i++)
+		{
+			const BuildInstance& instance = instances[i];
+			node.bounds_min = glm::min(node.bounds_min, instance.center - instance.radius);
+			node.bounds_max = glm::max(node.bounds_max, instance.center + instance.radius);
+			centers_min = glm::min(centers_min, instance.center);
+			centers_max = glm::max(centers_max, instance.center);
+		}
+
+		if (count <= SCENE_LEAF_INSTANCES)
+		{
+			node.leaf = 1;
+		}
+		else
+		{
+			const glm::vec3 extent = centers_max - centers_min;
+			const int axis = extent.x >= extent.y && extent.x >= extent.z ? 0 : extent.y >= extent.z ? 1 : 2;
+			const uint32_t half = count / 2;
+			const auto begin = instances.begin() + first;
+			std::nth_element(begin, begin + half, begin + count,
+				[axis](const BuildInstance& a, const BuildInstance& b) {
+					return a.center[axis] < b.center[axis];
+				});
+			build_node(instances, first, half, nodes);
+			build_node(instances, first + half, count - half, nodes);
+		}
+
+		node.skip = (uint32_t)nodes.size();
+		nodes[index] = node;
+	}
+
+	template <typename T>
+	bool fix_up(SceneArray<T>& array, uint8_t* base, size_t size)
+	{
+		if (array.offset % alignof(T) != 0 || array.offset > size
+			|| array.count > (size - array.offset) / sizeof(T))
+		{
+			return false;
+		}
+		array.data = reinterpret_cast<const T*>(base + array.offset);
+		return true;
+	}
+
+	bool fix_up_string(SceneString& string, uint8_t* base, size_t size)
+	{
+		if (string.offset >= size || string.count >= size - string.offset
+			|| base[string.offset + string.count] != '\0')
+		{
+			return false;
+		}
+		string.data = reinterpret_cast<const char*>(base + string.offset);
+		return true;
+	}
+}
+
+bool write_scene_file(const std::string& path, const std::vector<SceneMeshSource>& meshes,
+	std::vector<ScenePlacement> placements)
+{
+	SceneFileHeader header;
+	header.instance_count = placements.size();
+
+	// World space spheres, ordered by the hierarchy
+	std::vector<BuildInstance> instances(placements.size());
+	for (uint32_t i = 0; i < (uint32_t)placements.size(); i++)
+	{
+		const ScenePlacement& placement = placements[i];
+		const SceneMeshSource& mesh = meshes[placement.mesh];
+		const glm::vec3 center = (mesh.bounds_min + mesh.bounds_max) * 0.5f;
+		instances[i].center = placement.position + placement.rotation * (center * placement.scale);
+		instances[i].radius = mesh.radius * placement.scale;
+		instances[i].placement = i;
+	}
+	std::vector<SceneNode> nodes;
+	if (!instances.empty())
+	{
+		build_node(instances, 0, (uint32_t)instances.size(), nodes);
+		header.bounds_min = nodes[0].bounds_min;
+		header.bounds_max = nodes[0].bounds_max;
+	}
+
+	SceneWriter writer(sizeof(SceneFileHeader));
+
+	std::vector<SceneMesh> mesh_table;
+	std::vector<SceneMaterial> material_table;
+	for (const SceneMeshSource& source : meshes)
+	{
+		SceneMesh mesh;
+		mesh.path = writer.add(source.path);
+		mesh.bounds_min = source.bounds_min;
+		mesh.bounds_max = source.bounds_max;
+		mesh.radius = source.radius;
+		mesh.lod_count = (uint32_t)std::max(source.lod_count, 1);
+		mesh.first_material = (uint32_t)material_table.size();
+		mesh.material_count = (uint32_t)source.materials.size();
+		mesh_table.push_back(mesh);
+
+		for (const Material& source_material : source.materials)
+		{
+			SceneMaterial material;
+			material.name = writer.add(source_material.name);
+			material.diffuse_map = writer.add(source_material.diffuse_map);
+			material.diffuse = source_material.diffuse;
+			material.opacity = source_material.opacity;
+			material.specular = source_material.specular;
+			material.shininess = source_material.shininess;
+			material_table.push_back(material);
+		}
+	}
+	header.meshes = writer.add(mesh_table);
+	header.materials = writer.add(material_table);
+	header.nodes = writer.add(nodes);
+
+	// One component at a time, in hierarchy order
+	std::vector<float> component(instances.size());
+	const auto add_component = [&](auto&& get) {
+		for (size_t i = 0; i < instances.size(); i++)
+		{
+			component[i] = get(placements[instances[i].placement], instances[i]);
+		}
+		return writer.add(component);
+	};
+	std::vector<uint32_t> mesh_indices(instances.size());
+	for (size_t i = 0; i < instances.size(); i++)
+	{
+		mesh_indices[i] = placements[instances[i].placement].mesh;
+	}
+	SceneInstances& soa = header.instances;
+	soa.mesh = writer.add(mesh_indices);
+	soa.position_x = add_component([](const ScenePlacement& p, const BuildInstance&) { return p.position.x; });
+	soa.position_y = add_component([](const ScenePlacement& p, const BuildInstance&) { return p.position.y; });
+	soa.position_z = add_component([](const ScenePlacement& p, const BuildInstance&) { return p.position.z; });
+	soa.rotation_x = add_component([](const ScenePlacement& p, const BuildInstance&) { return p.rotation.x; });
+	soa.rotation_y = add_component([](const ScenePlacement& p, const BuildInstance&) { return p.rotation.y; });
+	soa.rotation_z = add_component([](const ScenePlacement& p, const BuildInstance&) { return p.rotation.z; });
+	soa.rotation_w = add_component([](const ScenePlacement& p, const BuildInstance&) { return p.rotation.w; });
+	soa.scale = add_component([](const ScenePlacement& p, const BuildInstance&) { return p.scale; });
+	soa.center_x = add_component([](const ScenePlacement&, const BuildInstance& b) { return b.center.x; });
+	soa.center_y = add_component([](const ScenePlacement&, const BuildInstance& b) { return b.center.y; });
+	soa.center_z = add_component([](const ScenePlacement&, const BuildInstance& b) { return b.center.z; });
+	soa.radius = add_component([](const ScenePlacement&, const BuildInstance& b) { return b.radius; });
+
+	writer.bytes.resize(align_up(writer.bytes.size(), SCENE_FILE_ALIGNMENT));
+	header.file_size = writer.bytes.size();
+	std::memcpy(writer.bytes.data(), &header, sizeof(header));
+
+	std::ofstream file(path, std::ios::binary);
+	if (!file)
+	{
+		std::cerr << "Unable to create scene file: " << path << "\n";
+		return false;
+	}
+	file.write(reinterpret_cast<const char*>(writer.bytes.data()),
+		(std::streamsize)writer.bytes.size());
+	return (bool)file;
+}
+
+SceneFile::~SceneFile()
+{
+	close();
+}
+
+bool SceneFile::open(const std::string& path)
+{
+	close();
+
+	const int fd = ::open(path.c_str(), O_RDONLY);
+	if (fd < 0)
+	{
+		std::cerr << "Unable to open scene file: " << path << "\n";
+		return false;
+	}
+
+	struct stat info;
+	if (fstat(fd, &info) != 0 || (size_t)info.st_size < sizeof(SceneFileHeader))
+	{
+		std::cerr << "Scene file is too small: " << path << "\n";
+		::close(fd);
+		return false;
+	}
+
+	// Private, so the fix-up writes never reach the file
+	void* mapped = mmap(nullptr, (size_t)info.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+	::close(fd);
+	if (mapped == MAP_FAILED)
+	{
+		std::cerr << "Unable to map scene file: " << path << "\n";
+		return false;
+	}
+
+	mapping = static_cast<uint8_t*>(mapped);
+	mapping_size = (size_t)info.st_size;
+
+	// Validate everything we'll later index with, fixing up as we go
+	SceneFileHeader& h = *reinterpret_cast<SceneFileHeader*>(mapping);
+	bool valid = h.magic == SCENE_FILE_MAGIC && h.version == SCENE_FILE_VERSION
+		&& h.file_size == mapping_size
+		&& fix_up(h.meshes, mapping, mapping_size)
+		&& fix_up(h.materials, mapping, mapping_size)
+		&& fix_up(h.nodes, mapping, mapping_size);
+
+	SceneInstances& instances = h.instances;
+	for (SceneArray<float>* component : {&instances.position_x, &instances.position_y,
+			&instances.position_z, &instances.rotation_x, &instances.rotation_y,
+			&instances.rotation_z, &instances.rotation_w, &instances.scale, &instances.center_x,
+			&instances.center_y, &instances.center_z, &instances.radius})
+	{
+		valid = valid && component->count == h.instance_count
+			&& fix_up(*component, mapping, mapping_size);
+	}
+	valid = valid && instances.mesh.count == h.instance_count
+		&& fix_up(instances.mesh, mapping, mapping_size);
+
+	for (size_t i = 0; valid && i < h.materials.count; i++)
+	{
+		SceneMaterial& material = const_cast<SceneMaterial&>(h.materials[i]);
+		valid = fix_up_string(material.name, mapping, mapping_size)
+			&& fix_up_string(material.diffuse_map, mapping, mapping_size);
+	}
+	for (size_t i = 0; valid && i < h.meshes.count; i++)
+	{
+		SceneMesh& mesh = const_cast<SceneMesh&>(h.meshes[i]);
+		valid = fix_up_string(mesh.path, mapping, mapping_size) && mesh.lod_count > 0
+			&& (uint64_t)mesh.first_material + mesh.material_count <= h.materials.count;
+	}
+	for (size_t i = 0; valid && i < h.nodes.count; i++)
+	{
+		const SceneNode& node = h.nodes[i];
+		valid = (uint64_t)node.first_instance + node.instance_count <= h.instance_count
+			&& node.skip > i && node.skip <= h.nodes.count;
+	}
+	for (size_t i = 0; valid && i < h.instance_count; i++)
+	{
+		valid = instances.mesh[i] < h.meshes.count;
+	}
+
+	if (!valid)
+	{
+		std::cerr << "Invalid scene file: " << path << "\n";
+		close();
+		return false;
+	}
+
+	return true;
+}
+
+void SceneFile::close()
+{
+	if (mapping)
+	{
+		munmap(mapping, mapping_size);
+		mapping = nullptr;
+		mapping_size = 0;
+	}
+}
+
+bool SceneFile::is_open() const
+{
+	return mapping != nullptr;
+}
+
+const SceneFileHeader& SceneFile::header() const
+{
+	return *reinterpret_cast<const SceneFileHeader*>(mapping);
+}
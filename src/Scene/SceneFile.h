@@ -0,0 +1,164 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <glm/gtc/quaternion.hpp>
+#include <glm/vec3.hpp>
+
+#include "../Model/Material.h"
+
+// Flat scene container: a header of arrays, then the arrays themselves,
+// each aligned to a cache line. Arrays are stored as offsets from the start
+// of the file and opening a scene maps it copy on write and turns them into
+// pointers in place, so nothing is parsed or copied. Instances are stored
+// as one array per component, sorted so every leaf of the bounding volume
+// hierarchy covers a contiguous range of them.
+
+constexpr uint32_t SCENE_FILE_MAGIC = 0x43534C47; // "GLSC"
+constexpr uint32_t SCENE_FILE_VERSION = 1;
+constexpr size_t SCENE_FILE_ALIGNMENT = 64;
+// Instances per hierarchy leaf; culling tests them one by one
+constexpr uint32_t SCENE_LEAF_INSTANCES = 64;
+
+static_assert(sizeof(void*) == sizeof(uint64_t), "Scene files fix offsets up into 64 bit pointers");
+
+// An array in a scene file: an offset from the start of the file on disk,
+// a pointer once opened
+template <typename T>
+struct SceneArray
+{
+	union
+	{
+		uint64_t offset = 0;
+		const T* data;
+	};
+	uint64_t count = 0;
+
+	const T& operator[](size_t i) const { return data[i]; }
+	const T* begin() const { return data; }
+	const T* end() const { return data + count; }
+};
+
+// Strings are nul terminated past count
+using SceneString = SceneArray<char>;
+
+struct SceneMesh
+{
+	SceneString path; // of the model to load
+	// Of LOD 0, in model space
+	glm::vec3 bounds_min = glm::vec3(0.0f);
+	float radius = 0.0f; // around the center of the bounds
+	glm::vec3 bounds_max = glm::vec3(0.0f);
+	uint32_t lod_count = 1;
+	// The mesh's materials in submesh order, into the material table
+	uint32_t first_material = 0;
+	uint32_t material_count = 0;
+};
+
+struct SceneMaterial
+{
+	SceneString name;
+	SceneString diffuse_map; // empty without one
+	glm::vec3 diffuse = glm::vec3(0.8f);
+	float opacity = 1.0f;
+	glm::vec3 specular = glm::vec3(0.0f);
+	float shininess = 1.0f;
+};
+
+// A node of the instance hierarchy, in depth first order. Children follow
+// their parent and skip is the node after the whole subtree, so culling
+// walks the array without a stack.
+struct SceneNode
+{
+	glm::vec3 bounds_min = glm::vec3(0.0f);
+	uint32_t first_instance = 0;
+	glm::vec3 bounds_max = glm::vec3(0.0f);
+	uint32_t instance_count = 0; // of the whole subtree
+	uint32_t skip = 0;
+	uint32_t leaf = 0;
+};
+
+// Placements, one array per component, all instance_count long
+struct SceneInstances
+{
+	SceneArray<uint32_t> mesh;
+	SceneArray<float> position_x;
+	SceneArray<float> position_y;
+	SceneArray<float> position_z;
+	// Unit quaternion
+	SceneArray<float> rotation_x;
+	SceneArray<float> rotation_y;
+	SceneArray<float> rotation_z;
+	SceneArray<float> rotation_w;
+	SceneArray<float> scale; // uniform
+	// World space bounding spheres
+	SceneArray<float> center_x;
+	SceneArray<float> center_y;
+	SceneArray<float> center_z;
+	SceneArray<float> radius;
+};
+
+struct SceneFileHeader
+{
+	uint32_t magic = SCENE_FILE_MAGIC;
+	uint32_t version = SCENE_FILE_VERSION;
+	uint64_t file_size = 0;
+	uint64_t instance_count = 0;
+	glm::vec3 bounds_min = glm::vec3(0.0f); // of every instance
+	glm::vec3 bounds_max = glm::vec3(0.0f);
+
+	SceneArray<SceneMesh> meshes;
+	SceneArray<SceneMaterial> materials;
+	SceneArray<SceneNode> nodes;
+	SceneInstances instances;
+};
+
+// What a scene is built from
+struct SceneMeshSource
+{
+	std::string path;
+	int lod_count = 1;
+	glm::vec3 bounds_min = glm::vec3(0.0f);
+	glm::vec3 bounds_max = glm::vec3(0.0f);
+	float radius = 0.0f;
+	std::vector<Material> materials;
+};
+
+struct ScenePlacement
+{
+	uint32_t mesh = 0;
+	glm::vec3 position = glm::vec3(0.0f);
+	glm::quat rotation = glm::quat(1.0f, 0.0f, 0.0f, 0.0f);
+	float scale = 1.0f;
+};
+
+// Builds the hierarchy over the placements, which come out reordered, and
+// writes the scene
+bool write_scene_file(const std::string& path, const std::vector<SceneMeshSource>& meshes,
+	std::vector<ScenePlacement> placements);
+
+// A copy on write memory mapping of a scene. Only the pages holding the
+// header and the mesh and material tables are written to, by the fix-up.
+class SceneFile
+{
+public:
+	SceneFile() = default;
+	SceneFile(const SceneFile&) = delete;
+	SceneFile& operator=(const SceneFile&) = delete;
+	~SceneFile();
+
+	// Maps the file, validates every array and fixes the arrays up into
+	// pointers. Instance pages fault in as they are first read.
+	bool open(const std::string& path);
+	void close();
+	bool is_open() const;
+
+	const SceneFileHeader& header() const;
+
+private:
+	uint8_t* mapping = nullptr;
+	size_t mapping_size = 0;
+};
@@ -8,19 +8,65 @@
 #include <GL/gl.h>
 #include <glm/gtc/type_ptr.hpp>
 
+#include "ShaderPreprocessor.h"
+#include "../Capture/CapturedGL.h"
+
 Shader::Shader(const std::string& vertex_shader_file,
 	const std::string& fragment_shader_file)
 {
 	// Load and compile the shader source code
-	const uint32_t vertex_shader = load_shader(vertex_shader_file, GL_VERTEX_SHADER);
-	const uint32_t fragment_shader = load_shader(fragment_shader_file, GL_FRAGMENT_SHADER);
+	const uint32_t shaders[] = {
+		load_shader(vertex_shader_file, GL_VERTEX_SHADER),
+		load_shader(fragment_shader_file, GL_FRAGMENT_SHADER),
+	};
+	link(shaders, 2);
+}
+
+Shader::Shader(const std::string& compute_shader_file)
+{
+	const uint32_t compute_shader = load_shader(compute_shader_file, GL_COMPUTE_SHADER);
+	link(&compute_shader, 1);
+}
+
+Shader Shader::from_source(const std::string& vertex_source, const std::string& fragment_source)
+{
+	return from_source(ShaderSource{vertex_source, {}}, ShaderSource{fragment_source, {}});
+}
+
+Shader Shader::from_source(const ShaderSource& vertex_source, const ShaderSource& fragment_source)
+{
+	Shader shader;
+	const uint32_t shaders[] = {
+		compile_shader(vertex_source, GL_VERTEX_SHADER),
+		compile_shader(fragment_source, GL_FRAGMENT_SHADER),
+	};
+	shader.link(shaders, 2);
+	return shader;
+}
+
+std::string Shader::read_source(const std::string& filename)
+{
+	const std::ifstream file(filename);
+	if (!file)
+	{
+		std::cerr << "Unable to open shader file: " << filename << "\n";
+		return "";
+	}
+	std::stringstream ss;
+	ss << file.rdbuf();
+	return ss.str();
+}
 
+void Shader::link(const uint32_t* shaders, size_t count)
+{
 	// Create the shader program
 	program = glCreateProgram();
 
 	// Attach the compiled shaders
-	glAttachShader(program, vertex_shader);
-	glAttachShader(program, fragment_shader);
+	for (size_t i = 0; i < count; i++)
+	{
+		glAttachShader(program, shaders[i]);
+	}
 
 	glLinkProgram(program);
 
@@ -43,31 +89,30 @@ Shader::Shader(const std::string& vertex_shader_file,
 	}
 
 	// Detatch and delete the shaders now that we're done with them
-	glDetachShader(program, vertex_shader);
-	glDetachShader(program, fragment_shader);
-	glDeleteShader(vertex_shader);
-	glDeleteShader(fragment_shader);
+	for (size_t i = 0; i < count; i++)
+	{
+		glDetachShader(program, shaders[i]);
+		glDeleteShader(shaders[i]);
+	}
 }
 
 uint32_t Shader::load_shader(const std::string& filename, GLenum shader_type)
 {
-	// Open the shader file
-	const std::ifstream file(filename);
-	if (!file)
+	// Resolves its #includes
+	ShaderSource source;
+	if (!preprocess_shader(filename, {}, 0, source))
 	{
-		std::cerr << "Unable to open shader file: " << filename << "/n";
 		return 0;
 	}
+	return compile_shader(source, shader_type);
+}
 
-	// Load the shader source code
-	std::stringstream ss;
-	ss << file.rdbuf();
-	const std::string source = ss.str();
-
+uint32_t Shader::compile_shader(const ShaderSource& source, GLenum shader_type)
+{
 	// Create and compile the shader
 	const uint32_t shader = glCreateShader(shader_type);
-	const char* source_ptr = source.c_str();
-	const int source_length = (int)source.length();
+	const char* source_ptr = source.text.c_str();
+	const int source_length = (int)source.text.length();
 	glShaderSource(shader, 1, &source_ptr, &source_length);
 	glCompileShader(shader);
 
@@ -81,7 +126,7 @@ uint32_t Shader::load_shader(const std::string& filename, GLenum shader_type)
 		std::vector<GLchar> log((size_t)log_length);
 		glGetShaderInfoLog(shader, log_length, &log_length, log.data());
 		const std::string log_str(log.begin(), log.end());
-		std::cerr << "Shader compilation failed: " << log_str << "\n";
+		std::cerr << "Shader compilation failed: " << remap_shader_log(log_str, source.files) << "\n";
 
 		// Delete the shader if compilation failed
 		glDeleteShader(shader);
@@ -91,6 +136,15 @@ uint32_t Shader::load_shader(const std::string& filename, GLenum shader_type)
 	return shader;
 }
 
+void Shader::set_uniform(const char* name, int value) const
+{
+	const int location = glGetUniformLocation(program, name);
+	if (location != -1)
+	{
+		glUniform1i(location, value);
+	}
+}
+
 void Shader::set_uniform(const char* name, float value) const
 {
 	const int location = glGetUniformLocation(program, name);
@@ -100,6 +154,15 @@ void Shader::set_uniform(const char* name, float value) const
 	}
 }
 
+void Shader::set_uniform(const char* name, const glm::vec2& value) const
+{
+	const int location = glGetUniformLocation(program, name);
+	if (location != -1)
+	{
+		glUniform2fv(location, 1, glm::value_ptr(value));
+	}
+}
+
 void Shader::set_uniform(const char* name, const glm::vec3& value) const
 {
 	const int location = glGetUniformLocation(program, name);
@@ -109,6 +172,42 @@ void Shader::set_uniform(const char* name, const glm::vec3& value) const
 	}
 }
 
+void Shader::set_uniform(const char* name, const glm::ivec3& value) const
+{
+	const int location = glGetUniformLocation(program, name);
+	if (location != -1)
+	{
+		glUniform3iv(location, 1, glm::value_ptr(value));
+	}
+}
+
+void Shader::set_uniform(const char* name, const glm::vec4& value) const
+{
+	const int location = glGetUniformLocation(program, name);
+	if (location != -1)
+	{
+		glUniform4fv(location, 1, glm::value_ptr(value));
+	}
+}
+
+void Shader::set_uniform(const char* name, const glm::mat4& value) const
+{
+	const int location = glGetUniformLocation(program, name);
+	if (location != -1)
+	{
+		glUniformMatrix4fv(location, 1, GL_FALSE, glm::value_ptr(value));
+	}
+}
+
+void Shader::set_uniform(const char* name, const glm::mat4* values, int count) const
+{
+	const int location = glGetUniformLocation(program, name);
+	if (location != -1)
+	{
+		glUniformMatrix4fv(location, count, GL_FALSE, glm::value_ptr(values[0]));
+	}
+}
+
 void Shader::destroy() const
 {
 	glDeleteProgram(program);
@@ -1,10 +1,15 @@
 #pragma once
 
+#include <cstddef>
 #include <cstdint>
 #include <string>
+#include <glm/mat4x4.hpp>
+#include <glm/vec2.hpp>
 #include <glm/vec3.hpp>
+#include <glm/vec4.hpp>
 
 typedef uint32_t GLenum;
+struct ShaderSource;
 
 class Shader
 {
@@ -12,6 +17,16 @@ public:
 	Shader() = default; // for when we want to declare a shader without loading it
 	Shader(const std::string& vertex_shader_file,
 		const std::string& fragment_shader_file);
+	// A compute program
+	explicit Shader(const std::string& compute_shader_file);
+	// From source already in memory, such as generated code
+	static Shader from_source(const std::string& vertex_source,
+		const std::string& fragment_source);
+	// From preprocessed files, whose compile errors name the file they're in
+	static Shader from_source(const ShaderSource& vertex_source,
+		const ShaderSource& fragment_source);
+	// A shader file's contents, empty if it can't be read
+	static std::string read_source(const std::string& filename);
 
 	void destroy() const;
 
@@ -19,10 +34,21 @@ public:
 
 private:
 	static uint32_t load_shader(const std::string& filename, GLenum shader_type);
+	static uint32_t compile_shader(const ShaderSource& source, GLenum shader_type);
+	// Links the compiled shaders into program and deletes them, leaving
+	// program at zero if linking failed
+	void link(const uint32_t* shaders, size_t count);
 
 public:
+	void set_uniform(const char* name, int value) const;
 	void set_uniform(const char* name, float value) const;
+	void set_uniform(const char* name, const glm::vec2& value) const;
 	void set_uniform(const char* name, const glm::vec3& value) const;
+	void set_uniform(const char* name, const glm::ivec3& value) const;
+	void set_uniform(const char* name, const glm::vec4& value) const;
+	void set_uniform(const char* name, const glm::mat4& value) const;
+	// A whole array, from its first element on
+	void set_uniform(const char* name, const glm::mat4* values, int count) const;
 };
 
 Shader create_shader(const std::string& vertex_shader_file,
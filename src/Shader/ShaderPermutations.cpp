@@ -0,0 +1,76 @@
+#include "ShaderPermutations.h"
+
+#include <algorithm>
+#include <iostream>
+#include <utility>
+
+#include "ShaderPreprocessor.h"
+
+void ShaderPermutations::initialize(const std::string& vertex, const std::string& fragment,
+	std::vector<ShaderFeature> shader_features, void (*prepare_variant)(const Shader&))
+{
+	vertex_file = vertex;
+	fragment_file = fragment;
+	features = std::move(shader_features);
+	prepare = prepare_variant;
+	supported = 0;
+	for (const ShaderFeature& feature : features)
+	{
+		supported |= feature.bit;
+	}
+}
+
+void ShaderPermutations::destroy()
+{
+	for (const auto& [key, variant] : variants)
+	{
+		variant.destroy();
+	}
+	variants.clear();
+}
+
+const Shader& ShaderPermutations::get(uint32_t requested)
+{
+	// Features the program doesn't have would only compile the same thing
+	const uint32_t key = requested & supported;
+	const auto found = variants.find(key);
+	if (found != variants.end())
+	{
+		return found->second;
+	}
+
+	std::vector<std::string> defines;
+	int version = 0;
+	for (const ShaderFeature& feature : features)
+	{
+		if (key & feature.bit)
+		{
+			defines.push_back(feature.define);
+			version = std::max(version, feature.version);
+		}
+	}
+
+	Shader variant;
+	ShaderSource vertex_source;
+	ShaderSource fragment_source;
+	if (preprocess_shader(vertex_file, defines, version, vertex_source)
+		&& preprocess_shader(fragment_file, defines, version, fragment_source))
+	{
+		variant = Shader::from_source(vertex_source, fragment_source);
+	}
+	if (!variant.program)
+	{
+		std::cerr << "Unable to build " << vertex_file << " and " << fragment_file
+				  << " with features " << key << "\n";
+	}
+	else if (prepare)
+	{
+		prepare(variant);
+	}
+	return variants.emplace(key, variant).first->second;
+}
+
+size_t ShaderPermutations::variant_count() const
+{
+	return variants.size();
+}
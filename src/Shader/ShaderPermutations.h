@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "Shader.h"
+
+// A switch in a shader's source, compiled in with a #define
+struct ShaderFeature
+{
+	uint32_t bit = 0;
+	std::string define;
+	int version = 0; // the GLSL version it needs, if more than the files ask for
+};
+
+// Variants of one program, keyed by the features they're compiled with.
+// Code behind a feature that's off is compiled out instead of branched
+// around at run time. Each variant is compiled the first time it's asked
+// for; asking while loading compiles it ahead of time.
+class ShaderPermutations
+{
+public:
+	// prepare, when set, runs on each new variant, e.g. to point its
+	// samplers at their units
+	void initialize(const std::string& vertex, const std::string& fragment,
+		std::vector<ShaderFeature> shader_features, void (*prepare_variant)(const Shader&) = nullptr);
+	void destroy();
+
+	// The variant with whichever of features this program has. A variant
+	// that fails to compile stays cached with no program.
+	const Shader& get(uint32_t features);
+
+	size_t variant_count() const;
+
+private:
+	std::string vertex_file;
+	std::string fragment_file;
+	std::vector<ShaderFeature> features;
+	uint32_t supported = 0; // bits of features
+	void (*prepare)(const Shader&) = nullptr;
+	std::unordered_map<uint32_t, Shader> variants;
+};
@@ -0,0 +1,165 @@
+#include "ShaderPreprocessor.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+
+#include "Shader.h"
+
+namespace
+{
+	std::string directory_of(const std::string& path)
+	{
+		const size_t slash = path.find_last_of('/');
+		return slash == std::string::npos ? "" : path.substr(0, slash + 1);
+	}
+
+	// Whether line is the directive, ignoring leading whitespace
+	bool is_directive(const std::string& line, const char* directive)
+	{
+		const size_t start = line.find_first_not_of(" \t");
+		return start != std::string::npos && line.compare(start, std::strlen(directive), directive) == 0;
+	}
+
+	std::string line_directive(int line, size_t file)
+	{
+		return "#line " + std::to_string(line) + " " + std::to_string(file) + "\n";
+	}
+
+	class Preprocessor
+	{
+	public:
+		Preprocessor(const std::vector<std::string>& added_defines, int min_version,
+			ShaderSource& output)
+			: defines(added_defines), version(min_version), source(output)
+		{
+		}
+
+		bool append(const std::string& filename)
+		{
+			if (std::find(including.begin(), including.end(), filename) != including.end())
+			{
+				std::cerr << "Shader file includes itself: " << filename << "\n";
+				return false;
+			}
+			if (std::find(source.files.begin(), source.files.end(), filename) != source.files.end())
+			{
+				return true;
+			}
+
+			const std::string text = Shader::read_source(filename);
+			if (text.empty())
+			{
+				return false;
+			}
+			const size_t file = source.files.size();
+			source.files.push_back(filename);
+			including.push_back(filename);
+			if (file > 0)
+			{
+				source.text += line_directive(1, file);
+			}
+
+			std::istringstream lines(text);
+			std::string line;
+			int line_number = 0;
+			while (std::getline(lines, line))
+			{
+				line_number++;
+				if (file == 0 && is_directive(line, "#version"))
+				{
+					append_version(line);
+					source.text += line_directive(line_number + 1, file);
+				}
+				else if (is_directive(line, "#include"))
+				{
+					const size_t open = line.find('"');
+					const size_t close = open == std::string::npos ? open : line.find('"', open + 1);
+					if (close == std::string::npos)
+					{
+						std::cerr << filename << ":" << line_number << ": Expected #include \"path\"\n";
+						return false;
+					}
+					if (!append(directory_of(filename) + line.substr(open + 1, close - open - 1)))
+					{
+						return false;
+					}
+					source.text += line_directive(line_number + 1, file);
+				}
+				else
+				{
+					source.text += line + "\n";
+				}
+			}
+			including.pop_back();
+			return true;
+		}
+
+	private:
+		// The version line, at least version, then the defines
+		void append_version(const std::string& line)
+		{
+			std::istringstream words(line);
+			std::string directive;
+			int file_version = 0;
+			std::string profile;
+			words >> directive >> file_version >> profile;
+			source.text += "#version " + std::to_string(std::max(file_version, version))
+				+ (profile.empty() ? "" : " " + profile) + "\n";
+			for (const std::string& define : defines)
+			{
+				source.text += "#define " + define + "\n";
+			}
+		}
+
+		const std::vector<std::string>& defines;
+		const int version;
+		ShaderSource& source;
+		std::vector<std::string> including; // the chain of files open now
+	};
+}
+
+bool preprocess_shader(const std::string& filename, const std::vector<std::string>& defines,
+	int version, ShaderSource& source)
+{
+	source = ShaderSource();
+	Preprocessor preprocessor(defines, version, source);
+	return preprocessor.append(filename);
+}
+
+std::string remap_shader_log(const std::string& log, const std::vector<std::string>& files)
+{
+	// Lines start with the source string number, then a colon or a
+	// parenthesis and the line, after an ERROR: or WARNING: on some drivers
+	std::istringstream lines(log);
+	std::string remapped;
+	std::string line;
+	while (std::getline(lines, line))
+	{
+		size_t start = 0;
+		for (const char* prefix : {"ERROR: ", "WARNING: "})
+		{
+			if (line.starts_with(prefix))
+			{
+				start = std::strlen(prefix);
+			}
+		}
+		size_t end = start;
+		while (end < line.size() && std::isdigit((unsigned char)line[end]))
+		{
+			end++;
+		}
+		if (end > start && end < line.size() && (line[end] == ':' || line[end] == '('))
+		{
+			const size_t file = std::stoul(line.substr(start, end - start));
+			if (file < files.size())
+			{
+				line.replace(start, end - start, files[file]);
+			}
+		}
+		remapped += line + "\n";
+	}
+	return remapped;
+}
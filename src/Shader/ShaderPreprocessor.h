@@ -0,0 +1,25 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+// A shader file with its includes pulled in, ready to compile
+struct ShaderSource
+{
+	std::string text;
+	// Every file it was put together from, in the order of the source
+	// string numbers its #line directives give them
+	std::vector<std::string> files;
+};
+
+// Reads filename and pulls in every #include "path" it has, relative to the
+// including file and each file only once. Adds a #define for each of
+// defines ("NAME" or "NAME value") right after #version, which is raised to
+// version if the file asks for less. #line directives keep the line numbers
+// of each file. False if a file can't be read or includes itself.
+bool preprocess_shader(const std::string& filename, const std::vector<std::string>& defines,
+	int version, ShaderSource& source);
+
+// Names the files in a compiler log, in place of the source string numbers
+// its lines start with
+std::string remap_shader_log(const std::string& log, const std::vector<std::string>& files);
@@ -0,0 +1,43 @@
+#include "Image.h"
+
+#include <cstring>
+#include <iostream>
+
+#include <SDL2/SDL.h>
+#include <SDL2/SDL_image.h>
+
+bool decode_image_file(const std::string& path, Image& image)
+{
+	SDL_Surface* surface = IMG_Load(path.c_str());
+	if (!surface)
+	{
+		std::cerr << "Unable to load image: " << path << " (" << IMG_GetError() << ")\n";
+		return false;
+	}
+
+	// Convert to tightly packed RGBA8, the only format we work with
+	SDL_Surface* rgba = SDL_ConvertSurfaceFormat(surface, SDL_PIXELFORMAT_RGBA32, 0);
+	SDL_FreeSurface(surface);
+	if (!rgba)
+	{
+		std::cerr << "Unable to convert image: " << path << " (" << SDL_GetError() << ")\n";
+		return false;
+	}
+
+	image.width = (uint32_t)rgba->w;
+	image.height = (uint32_t)rgba->h;
+
+	const size_t row_size = (size_t)image.width * 4;
+	image.pixels.resize(row_size * image.height);
+	SDL_LockSurface(rgba);
+	for (uint32_t y = 0; y < image.height; y++)
+	{
+		std::memcpy(image.pixels.data() + row_size * y,
+			static_cast<const uint8_t*>(rgba->pixels) + (size_t)rgba->pitch * y,
+			row_size);
+	}
+	SDL_UnlockSurface(rgba);
+	SDL_FreeSurface(rgba);
+
+	return true;
+}
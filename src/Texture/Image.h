@@ -0,0 +1,17 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Uncompressed RGBA8 image, tightly packed
+struct Image
+{
+	uint32_t width = 0;
+	uint32_t height = 0;
+	std::vector<uint8_t> pixels;
+};
+
+// Decodes a JPEG/PNG file and converts it to RGBA8. Safe to call from any
+// thread once IMG_Init has run.
+bool decode_image_file(const std::string& path, Image& image);
@@ -0,0 +1,18 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+// A texture that may still be streaming in. Until it becomes resident, id
+// refers to the loader's placeholder, so it can always be bound.
+struct Texture
+{
+	std::string path;
+	uint32_t id = 0;
+	int width = 0;
+	int height = 0;
+	size_t gpu_bytes = 0; // including mips, once resident
+	bool resident = false;
+	std::atomic<bool> failed = false; // set by the worker that loads it
+};
@@ -0,0 +1,489 @@
+#include "TextureCooker.h"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+
+#include <emmintrin.h>
+
+#include "../Jobs/JobSystem.h"
+
+namespace
+{
+	constexpr int KAISER_TAPS = 6;
+
+	double seconds_since(std::chrono::steady_clock::time_point start)
+	{
+		return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	}
+
+	// 2x2 average of an even sized level, two output texels per iteration
+	void downsample_box_rows(const Image& source, Image& destination,
+		uint32_t begin, uint32_t end)
+	{
+		const __m128i rounding = _mm_set1_epi16(2);
+		const __m128i zero = _mm_setzero_si128();
+
+		for (uint32_t y = begin; y < end; y++)
+		{
+			const uint8_t* row0 = &source.pixels[(size_t)(y * 2) * source.width * 4];
+			const uint8_t* row1 = row0 + (size_t)source.width * 4;
+			uint8_t* out = &destination.pixels[(size_t)y * destination.width * 4];
+
+			uint32_t x = 0;
+			for (; x + 2 <= destination.width; x += 2)
+			{
+				const __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row0 + x * 8));
+				const __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row1 + x * 8));
+
+				// Vertical sums of the four source texels, widened to 16 bits
+				const __m128i sum_lo = _mm_add_epi16(_mm_unpacklo_epi8(a, zero), _mm_unpacklo_epi8(b, zero));
+				const __m128i sum_hi = _mm_add_epi16(_mm_unpackhi_epi8(a, zero), _mm_unpackhi_epi8(b, zero));
+
+				// Horizontal pairs: texels 0+1 and 2+3
+				__m128i sum = _mm_add_epi16(_mm_unpacklo_epi64(sum_lo, sum_hi),
+					_mm_unpackhi_epi64(sum_lo, sum_hi));
+				sum = _mm_srli_epi16(_mm_add_epi16(sum, rounding), 2);
+
+				_mm_storel_epi64(reinterpret_cast<__m128i*>(out + x * 4), _mm_packus_epi16(sum, sum));
+			}
+
+			// Odd destination width leaves one texel over
+			for (; x < destination.width; x++)
+			{
+				for (uint32_t c = 0; c < 4; c++)
+				{
+					const uint32_t sum = (uint32_t)row0[x * 8 + c] + row0[x * 8 + 4 + c]
+						+ row1[x * 8 + c] + row1[x * 8 + 4 + c];
+					out[x * 4 + c] = (uint8_t)((sum + 2) / 4);
+				}
+			}
+		}
+	}
+
+	// Box filter for levels with an odd dimension, clamping at the edges
+	void downsample_box_clamped_rows(const Image& source, Image& destination,
+		uint32_t begin, uint32_t end)
+	{
+		for (uint32_t y = begin; y < end; y++)
+		{
+			const uint32_t y0 = std::min(y * 2, source.height - 1);
+			const uint32_t y1 = std::min(y * 2 + 1, source.height - 1);
+
+			for (uint32_t x = 0; x < destination.width; x++)
+			{
+				const uint32_t x0 = std::min(x * 2, source.width - 1);
+				const uint32_t x1 = std::min(x * 2 + 1, source.width - 1);
+
+				for (uint32_t c = 0; c < 4; c++)
+				{
+					const uint32_t sum = (uint32_t)source.pixels[((size_t)y0 * source.width + x0) * 4 + c]
+						+ source.pixels[((size_t)y0 * source.width + x1) * 4 + c]
+						+ source.pixels[((size_t)y1 * source.width + x0) * 4 + c]
+						+ source.pixels[((size_t)y1 * source.width + x1) * 4 + c];
+					destination.pixels[((size_t)y * destination.width + x) * 4 + c] = (uint8_t)((sum + 2) / 4);
+				}
+			}
+		}
+	}
+
+	float bessel_i0(float x)
+	{
+		float sum = 1.0f;
+		float term = 1.0f;
+		for (int k = 1; k < 16; k++)
+		{
+			const float t = x / (2.0f * (float)k);
+			term *= t * t;
+			sum += term;
+		}
+		return sum;
+	}
+
+	// Weights for source texels at -2.5 .. 2.5 from the destination center
+	std::array<float, KAISER_TAPS> kaiser_weights()
+	{
+		constexpr float alpha = 4.0f;
+		constexpr float radius = 3.0f;
+		constexpr float pi = 3.14159265358979f;
+
+		std::array<float, KAISER_TAPS> weights{};
+		float total = 0.0f;
+		for (int i = 0; i < KAISER_TAPS; i++)
+		{
+			const float d = (float)i - 2.5f;
+			const float x = pi * d * 0.5f;
+			const float sinc = std::sin(x) / x;
+			const float r = d / radius;
+			const float window = bessel_i0(alpha * std::sqrt(1.0f - r * r)) / bessel_i0(alpha);
+			weights[(size_t)i] = sinc * window;
+			total += weights[(size_t)i];
+		}
+		for (float& weight : weights)
+		{
+			weight /= total;
+		}
+		return weights;
+	}
+
+	void downsample_kaiser(const Image& source, Image& destination, JobSystem& jobs)
+	{
+		const std::array<float, KAISER_TAPS> weights = kaiser_weights();
+
+		// Horizontal pass into a float buffer of destination width
+		std::vector<float> temp((size_t)destination.width * source.height * 4);
+		jobs.parallel_for(source.height, [&](uint32_t begin, uint32_t end) {
+			for (uint32_t y = begin; y < end; y++)
+			{
+				const uint8_t* row = &source.pixels[(size_t)y * source.width * 4];
+				for (uint32_t x = 0; x < destination.width; x++)
+				{
+					float sum[4] = {};
+					for (int t = 0; t < KAISER_TAPS; t++)
+					{
+						const int sx = std::clamp((int)x * 2 + t - 2, 0, (int)source.width - 1);
+						for (int c = 0; c < 4; c++)
+						{
+							sum[c] += weights[(size_t)t] * (float)row[sx * 4 + c];
+						}
+					}
+					for (int c = 0; c < 4; c++)
+					{
+						temp[((size_t)y * destination.width + x) * 4 + (size_t)c] = sum[c];
+					}
+				}
+			}
+		});
+
+		jobs.parallel_for(destination.height, [&](uint32_t begin, uint32_t end) {
+			for (uint32_t y = begin; y < end; y++)
+			{
+				for (uint32_t x = 0; x < destination.width; x++)
+				{
+					float sum[4] = {};
+					for (int t = 0; t < KAISER_TAPS; t++)
+					{
+						const size_t sy = (size_t)std::clamp((int)y * 2 + t - 2, 0, (int)source.height - 1);
+						for (int c = 0; c < 4; c++)
+						{
+							sum[c] += weights[(size_t)t] * temp[(sy * destination.width + x) * 4 + (size_t)c];
+						}
+					}
+					for (int c = 0; c < 4; c++)
+					{
+						destination.pixels[((size_t)y * destination.width + x) * 4 + (size_t)c]
+							= (uint8_t)std::clamp(sum[c] + 0.5f, 0.0f, 255.0f);
+					}
+				}
+			}
+		});
+	}
+
+	uint16_t pack_565(float r, float g, float b)
+	{
+		const uint32_t r5 = (uint32_t)std::clamp(r * 31.0f / 255.0f + 0.5f, 0.0f, 31.0f);
+		const uint32_t g6 = (uint32_t)std::clamp(g * 63.0f / 255.0f + 0.5f, 0.0f, 63.0f);
+		const uint32_t b5 = (uint32_t)std::clamp(b * 31.0f / 255.0f + 0.5f, 0.0f, 31.0f);
+		return (uint16_t)((r5 << 11) | (g6 << 5) | b5);
+	}
+
+	void unpack_565(uint16_t color, int* rgb)
+	{
+		const int r5 = (color >> 11) & 31;
+		const int g6 = (color >> 5) & 63;
+		const int b5 = color & 31;
+		rgb[0] = (r5 << 3) | (r5 >> 2);
+		rgb[1] = (g6 << 2) | (g6 >> 4);
+		rgb[2] = (b5 << 3) | (b5 >> 2);
+	}
+
+	// Four colour BC1 block with endpoints on the principal axis of the texels
+	void encode_color_block(const uint8_t* texels, uint8_t* block)
+	{
+		float mean[3] = {};
+		for (int i = 0; i < 16; i++)
+		{
+			for (int c = 0; c < 3; c++)
+			{
+				mean[c] += (float)texels[i * 4 + c] / 16.0f;
+			}
+		}
+
+		float cov[6] = {}; // rr, rg, rb, gg, gb, bb
+		for (int i = 0; i < 16; i++)
+		{
+			const float r = (float)texels[i * 4 + 0] - mean[0];
+			const float g = (float)texels[i * 4 + 1] - mean[1];
+			const float b = (float)texels[i * 4 + 2] - mean[2];
+			cov[0] += r * r;
+			cov[1] += r * g;
+			cov[2] += r * b;
+			cov[3] += g * g;
+			cov[4] += g * b;
+			cov[5] += b * b;
+		}
+
+		// A few power iterations are plenty for a 3x3 matrix
+		float axis[3] = {1.0f, 1.0f, 1.0f};
+		for (int iteration = 0; iteration < 8; iteration++)
+		{
+			const float x = cov[0] * axis[0] + cov[1] * axis[1] + cov[2] * axis[2];
+			const float y = cov[1] * axis[0] + cov[3] * axis[1] + cov[4] * axis[2];
+			const float z = cov[2] * axis[0] + cov[4] * axis[1] + cov[5] * axis[2];
+			const float length = std::max({std::fabs(x), std::fabs(y), std::fabs(z)});
+			if (length <= 0.0f)
+			{
+				break;
+			}
+			axis[0] = x / length;
+			axis[1] = y / length;
+			axis[2] = z / length;
+		}
+		const float axis_length = std::sqrt(axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2]);
+		for (float& a : axis)
+		{
+			a /= axis_length;
+		}
+
+		float min_t = 0.0f;
+		float max_t = 0.0f;
+		for (int i = 0; i < 16; i++)
+		{
+			float t = 0.0f;
+			for (int c = 0; c < 3; c++)
+			{
+				t += ((float)texels[i * 4 + c] - mean[c]) * axis[c];
+			}
+			min_t = std::min(min_t, t);
+			max_t = std::max(max_t, t);
+		}
+
+		uint16_t c0 = pack_565(mean[0] + axis[0] * max_t, mean[1] + axis[1] * max_t,
+			mean[2] + axis[2] * max_t);
+		uint16_t c1 = pack_565(mean[0] + axis[0] * min_t, mean[1] + axis[1] * min_t,
+			mean[2] + axis[2] * min_t);
+		if (c0 < c1)
+		{
+			std::swap(c0, c1);
+		}
+
+		block[0] = (uint8_t)(c0 & 0xff);
+		block[1] = (uint8_t)(c0 >> 8);
+		block[2] = (uint8_t)(c1 & 0xff);
+		block[3] = (uint8_t)(c1 >> 8);
+
+		// Equal endpoints select three colour mode, where index 0 is c0
+		uint32_t indices = 0;
+		if (c0 != c1)
+		{
+			int palette[4][3];
+			unpack_565(c0, palette[0]);
+			unpack_565(c1, palette[1]);
+			for (int c = 0; c < 3; c++)
+			{
+				palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+				palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+			}
+
+			for (uint32_t i = 0; i < 16; i++)
+			{
+				uint32_t best = 0;
+				int best_distance = INT32_MAX;
+				for (uint32_t p = 0; p < 4; p++)
+				{
+					int distance = 0;
+					for (int c = 0; c < 3; c++)
+					{
+						const int d = (int)texels[i * 4 + (uint32_t)c] - palette[p][c];
+						distance += d * d;
+					}
+					if (distance < best_distance)
+					{
+						best = p;
+						best_distance = distance;
+					}
+				}
+				indices |= best << (i * 2);
+			}
+		}
+
+		block[4] = (uint8_t)(indices & 0xff);
+		block[5] = (uint8_t)((indices >> 8) & 0xff);
+		block[6] = (uint8_t)((indices >> 16) & 0xff);
+		block[7] = (uint8_t)(indices >> 24);
+	}
+
+	// Eight value BC4 block for one channel of the texels
+	void encode_channel_block(const uint8_t* texels, int channel, uint8_t* block)
+	{
+		int min = 255;
+		int max = 0;
+		for (int i = 0; i < 16; i++)
+		{
+			min = std::min(min, (int)texels[i * 4 + channel]);
+			max = std::max(max, (int)texels[i * 4 + channel]);
+		}
+
+		block[0] = (uint8_t)max;
+		block[1] = (uint8_t)min;
+
+		uint64_t indices = 0;
+		if (max > min)
+		{
+			int palette[8];
+			palette[0] = max;
+			palette[1] = min;
+			for (int i = 1; i < 7; i++)
+			{
+				palette[i + 1] = ((7 - i) * max + i * min) / 7;
+			}
+
+			for (uint32_t i = 0; i < 16; i++)
+			{
+				const int value = texels[i * 4 + (uint32_t)channel];
+				uint64_t best = 0;
+				int best_distance = INT32_MAX;
+				for (uint64_t p = 0; p < 8; p++)
+				{
+					const int distance = std::abs(value - palette[p]);
+					if (distance < best_distance)
+					{
+						best = p;
+						best_distance = distance;
+					}
+				}
+				indices |= best << (i * 3);
+			}
+		}
+
+		for (int i = 0; i < 6; i++)
+		{
+			block[2 + i] = (uint8_t)((indices >> (i * 8)) & 0xff);
+		}
+	}
+}
+
+void encode_bc1_block(const uint8_t* texels, uint8_t* block)
+{
+	encode_color_block(texels, block);
+}
+
+void encode_bc3_block(const uint8_t* texels, uint8_t* block)
+{
+	encode_channel_block(texels, 3, block);
+	encode_color_block(texels, block + 8);
+}
+
+void encode_bc5_block(const uint8_t* texels, uint8_t* block)
+{
+	encode_channel_block(texels, 0, block);
+	encode_channel_block(texels, 1, block + 8);
+}
+
+void generate_mips(std::vector<Image>& mips, MipFilter filter, JobSystem& jobs)
+{
+	while (mips.back().width > 1 || mips.back().height > 1)
+	{
+		const Image& source = mips.back();
+
+		Image destination;
+		destination.width = std::max(source.width / 2, 1u);
+		destination.height = std::max(source.height / 2, 1u);
+		destination.pixels.resize((size_t)destination.width * destination.height * 4);
+
+		if (filter == MipFilter::Kaiser)
+		{
+			downsample_kaiser(source, destination, jobs);
+		}
+		else if (source.width % 2 == 0 && source.height % 2 == 0)
+		{
+			jobs.parallel_for(destination.height, [&](uint32_t begin, uint32_t end) {
+				downsample_box_rows(source, destination, begin, end);
+			});
+		}
+		else
+		{
+			jobs.parallel_for(destination.height, [&](uint32_t begin, uint32_t end) {
+				downsample_box_clamped_rows(source, destination, begin, end);
+			});
+		}
+
+		mips.push_back(std::move(destination));
+	}
+}
+
+std::vector<uint8_t> encode_image(const Image& image, TextureFormat format,
+	JobSystem& jobs)
+{
+	if (format == TextureFormat::RGBA8)
+	{
+		return image.pixels;
+	}
+
+	const uint32_t blocks_x = (image.width + 3) / 4;
+	const uint32_t blocks_y = (image.height + 3) / 4;
+	const size_t block_size = texture_format_block_size(format);
+	std::vector<uint8_t> encoded((size_t)blocks_x * blocks_y * block_size);
+
+	jobs.parallel_for(blocks_y, [&](uint32_t begin, uint32_t end) {
+		uint8_t texels[64];
+		for (uint32_t by = begin; by < end; by++)
+		{
+			for (uint32_t bx = 0; bx < blocks_x; bx++)
+			{
+				// Gather the block, repeating edge texels past the border
+				for (uint32_t i = 0; i < 16; i++)
+				{
+					const uint32_t x = std::min(bx * 4 + i % 4, image.width - 1);
+					const uint32_t y = std::min(by * 4 + i / 4, image.height - 1);
+					const uint8_t* texel = &image.pixels[((size_t)y * image.width + x) * 4];
+					std::copy(texel, texel + 4, texels + i * 4);
+				}
+
+				uint8_t* block = &encoded[((size_t)by * blocks_x + bx) * block_size];
+				switch (format)
+				{
+					case TextureFormat::BC1:
+						encode_bc1_block(texels, block);
+						break;
+					case TextureFormat::BC3:
+						encode_bc3_block(texels, block);
+						break;
+					case TextureFormat::BC5:
+						encode_bc5_block(texels, block);
+						break;
+					case TextureFormat::RGBA8:
+						break;
+				}
+			}
+		}
+	});
+
+	return encoded;
+}
+
+bool cook_texture(const Image& source, TextureFormat format, MipFilter filter,
+	JobSystem& jobs, const std::string& output_path, CookStats& stats)
+{
+	auto start = std::chrono::steady_clock::now();
+
+	std::vector<Image> mips;
+	mips.push_back(source);
+	generate_mips(mips, filter, jobs);
+	stats.mip_seconds = seconds_since(start);
+
+	start = std::chrono::steady_clock::now();
+	std::vector<std::vector<uint8_t>> levels;
+	stats.uncompressed_bytes = 0;
+	stats.cooked_bytes = 0;
+	for (const Image& mip : mips)
+	{
+		levels.push_back(encode_image(mip, format, jobs));
+		stats.uncompressed_bytes += mip.pixels.size();
+		stats.cooked_bytes += levels.back().size();
+	}
+	stats.encode_seconds = seconds_since(start);
+
+	return write_texture_file(output_path, format, levels, source.width, source.height);
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "Image.h"
+#include "TextureFile.h"
+
+class JobSystem;
+
+enum class MipFilter
+{
+	Box, // 2x2 average, fast
+	Kaiser, // 6 tap windowed sinc, sharper distant mips
+};
+
+struct CookStats
+{
+	size_t uncompressed_bytes = 0; // RGBA8 with the full mip chain
+	size_t cooked_bytes = 0;
+	double mip_seconds = 0.0;
+	double encode_seconds = 0.0;
+};
+
+// Appends the mip chain down to 1x1 to mips, which must hold the source as
+// its first element. Rows of each level are filtered in parallel.
+void generate_mips(std::vector<Image>& mips, MipFilter filter, JobSystem& jobs);
+
+// Block compresses one level, clamping the edge texels into partial blocks
+std::vector<uint8_t> encode_image(const Image& image, TextureFormat format,
+	JobSystem& jobs);
+
+bool cook_texture(const Image& source, TextureFormat format, MipFilter filter,
+	JobSystem& jobs, const std::string& output_path, CookStats& stats);
+
+// Single block encoders, taking 16 RGBA8 texels in row order
+void encode_bc1_block(const uint8_t* texels, uint8_t* block);
+void encode_bc3_block(const uint8_t* texels, uint8_t* block);
+void encode_bc5_block(const uint8_t* texels, uint8_t* block);
@@ -0,0 +1,208 @@
+#include "TextureFile.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace
+{
+	size_t align_up(size_t value, size_t alignment)
+	{
+		return (value + alignment - 1) / alignment * alignment;
+	}
+}
+
+size_t texture_format_block_size(TextureFormat format)
+{
+	switch (format)
+	{
+		case TextureFormat::RGBA8:
+			return 4;
+		case TextureFormat::BC1:
+			return 8;
+		case TextureFormat::BC3:
+		case TextureFormat::BC5:
+			return 16;
+	}
+	return 0;
+}
+
+size_t texture_format_level_size(TextureFormat format, uint32_t width,
+	uint32_t height)
+{
+	if (format == TextureFormat::RGBA8)
+	{
+		return (size_t)width * height * 4;
+	}
+
+	const size_t blocks_x = (width + 3) / 4;
+	const size_t blocks_y = (height + 3) / 4;
+	return blocks_x * blocks_y * texture_format_block_size(format);
+}
+
+bool write_texture_file(const std::string& path, TextureFormat format,
+	const std::vector<std::vector<uint8_t>>& levels, uint32_t width,
+	uint32_t height)
+{
+	TextureFileHeader header;
+	header.format = format;
+	header.width = width;
+	header.height = height;
+	header.mip_count = (uint32_t)levels.size();
+
+	// Lay the levels out after the header and mip table
+	std::vector<TextureFileMip> mips(levels.size());
+	size_t offset = align_up(sizeof(TextureFileHeader)
+		+ sizeof(TextureFileMip) * levels.size(), TEXTURE_FILE_ALIGNMENT);
+	const size_t data_start = offset;
+	for (size_t i = 0; i < levels.size(); i++)
+	{
+		mips[i].offset = offset;
+		mips[i].size = levels[i].size();
+		mips[i].width = std::max(width >> i, 1u);
+		mips[i].height = std::max(height >> i, 1u);
+		offset = align_up(offset + levels[i].size(), TEXTURE_FILE_ALIGNMENT);
+	}
+	header.data_size = offset - data_start;
+
+	std::ofstream file(path, std::ios::binary);
+	if (!file)
+	{
+		std::cerr << "Unable to create texture file: " << path << "\n";
+		return false;
+	}
+
+	file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	file.write(reinterpret_cast<const char*>(mips.data()),
+		(std::streamsize)(sizeof(TextureFileMip) * mips.size()));
+
+	const char padding[TEXTURE_FILE_ALIGNMENT] = {};
+	size_t written = sizeof(header) + sizeof(TextureFileMip) * mips.size();
+	for (size_t i = 0; i < levels.size(); i++)
+	{
+		file.write(padding, (std::streamsize)(mips[i].offset - written));
+		file.write(reinterpret_cast<const char*>(levels[i].data()),
+			(std::streamsize)levels[i].size());
+		written = mips[i].offset + levels[i].size();
+	}
+	file.write(padding, (std::streamsize)(offset - written));
+
+	return (bool)file;
+}
+
+TextureFile::~TextureFile()
+{
+	close();
+}
+
+bool TextureFile::open(const std::string& path)
+{
+	close();
+
+	const int fd = ::open(path.c_str(), O_RDONLY);
+	if (fd < 0)
+	{
+		std::cerr << "Unable to open texture file: " << path << "\n";
+		return false;
+	}
+
+	struct stat info;
+	if (fstat(fd, &info) != 0 || (size_t)info.st_size < sizeof(TextureFileHeader))
+	{
+		std::cerr << "Texture file is too small: " << path << "\n";
+		::close(fd);
+		return false;
+	}
+
+	void* mapped = mmap(nullptr, (size_t)info.st_size, PROT_READ,
+		MAP_PRIVATE | MAP_POPULATE, fd, 0);
+	::close(fd);
+	if (mapped == MAP_FAILED)
+	{
+		std::cerr << "Unable to map texture file: " << path << "\n";
+		return false;
+	}
+
+	mapping = static_cast<const uint8_t*>(mapped);
+	mapping_size = (size_t)info.st_size;
+
+	// Validate everything we'll later index with
+	const TextureFileHeader& h = header();
+	if (h.magic != TEXTURE_FILE_MAGIC || h.version != TEXTURE_FILE_VERSION)
+	{
+		std::cerr << "Invalid texture file: " << path << "\n";
+		close();
+		return false;
+	}
+	// Unknown formats size every mip at 0 bytes, which would pass below
+	if (h.format != TextureFormat::RGBA8 && h.format != TextureFormat::BC1
+		&& h.format != TextureFormat::BC3 && h.format != TextureFormat::BC5)
+	{
+		std::cerr << "Unknown format " << (uint32_t)h.format << " in texture file: " << path
+				  << "\n";
+		close();
+		return false;
+	}
+
+	bool valid = h.mip_count > 0
+		&& sizeof(TextureFileHeader) + sizeof(TextureFileMip) * h.mip_count <= mapping_size;
+	for (uint32_t i = 0; valid && i < h.mip_count; i++)
+	{
+		const TextureFileMip& m = mip(i);
+		valid = m.offset % TEXTURE_FILE_ALIGNMENT == 0 && m.offset + m.size <= mapping_size
+			&& m.size == texture_format_level_size(h.format, m.width, m.height);
+	}
+
+	if (!valid)
+	{
+		std::cerr << "Invalid texture file: " << path << "\n";
+		close();
+		return false;
+	}
+
+	return true;
+}
+
+void TextureFile::close()
+{
+	if (mapping)
+	{
+		munmap(const_cast<uint8_t*>(mapping), mapping_size);
+		mapping = nullptr;
+		mapping_size = 0;
+	}
+}
+
+const TextureFileHeader& TextureFile::header() const
+{
+	return *reinterpret_cast<const TextureFileHeader*>(mapping);
+}
+
+const TextureFileMip& TextureFile::mip(uint32_t level) const
+{
+	const auto* mips = reinterpret_cast<const TextureFileMip*>(
+		mapping + sizeof(TextureFileHeader));
+	return mips[level];
+}
+
+const uint8_t* TextureFile::data(uint32_t level) const
+{
+	return mapping + mip(level).offset;
+}
+
+const uint8_t* TextureFile::mip_data() const
+{
+	return data(0);
+}
+
+size_t TextureFile::mip_data_size() const
+{
+	const TextureFileMip& last = mip(header().mip_count - 1);
+	return (size_t)(last.offset + last.size - mip(0).offset);
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Cooked texture container: a fixed header, a table of mip levels and the
+// block compressed mip data, each level aligned so it can be handed to
+// glCompressedTexImage2D straight out of a memory mapping
+
+constexpr uint32_t TEXTURE_FILE_MAGIC = 0x58544C47; // "GLTX"
+constexpr uint32_t TEXTURE_FILE_VERSION = 1;
+constexpr size_t TEXTURE_FILE_ALIGNMENT = 16;
+
+enum class TextureFormat : uint32_t
+{
+	RGBA8 = 0,
+	BC1 = 1, // RGB, 4 bits per texel
+	BC3 = 2, // RGBA, 8 bits per texel
+	BC5 = 3, // two channel, for normal maps
+};
+
+struct TextureFileHeader
+{
+	uint32_t magic = TEXTURE_FILE_MAGIC;
+	uint32_t version = TEXTURE_FILE_VERSION;
+	TextureFormat format = TextureFormat::RGBA8;
+	uint32_t width = 0;
+	uint32_t height = 0;
+	uint32_t mip_count = 0;
+	uint64_t data_size = 0; // bytes of mip data following the mip table
+};
+
+struct TextureFileMip
+{
+	uint64_t offset = 0; // from the start of the file
+	uint64_t size = 0;
+	uint32_t width = 0;
+	uint32_t height = 0;
+};
+
+// Bytes per 4x4 block, or per texel for RGBA8
+size_t texture_format_block_size(TextureFormat format);
+size_t texture_format_level_size(TextureFormat format, uint32_t width,
+	uint32_t height);
+
+bool write_texture_file(const std::string& path, TextureFormat format,
+	const std::vector<std::vector<uint8_t>>& levels, uint32_t width,
+	uint32_t height);
+
+// A read only memory mapping of a cooked texture
+class TextureFile
+{
+public:
+	TextureFile() = default;
+	TextureFile(const TextureFile&) = delete;
+	TextureFile& operator=(const TextureFile&) = delete;
+	~TextureFile();
+
+	// Maps the file and validates its header and mip table. Pages are
+	// prefaulted so the caller's thread pays for the I/O.
+	bool open(const std::string& path);
+	void close();
+
+	const TextureFileHeader& header() const;
+	const TextureFileMip& mip(uint32_t level) const;
+	const uint8_t* data(uint32_t level) const;
+
+	// The contiguous range covering every mip level
+	const uint8_t* mip_data() const;
+	size_t mip_data_size() const;
+
+private:
+	const uint8_t* mapping = nullptr;
+	size_t mapping_size = 0;
+};
@@ -0,0 +1,370 @@
+#include "TextureLoader.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+
+#include <GL/glew.h>
+#include <GL/gl.h>
+#include <SDL2/SDL_image.h>
+
+#include "../Jobs/JobSystem.h"
+#include "../Resources/GpuMemory.h"
+#include "../Capture/CapturedGL.h"
+
+namespace
+{
+	double seconds_since(std::chrono::steady_clock::time_point start)
+	{
+		return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	}
+
+	double megabytes_per_second(uint64_t bytes, double seconds)
+	{
+		return seconds > 0.0 ? (double)bytes / (1024.0 * 1024.0) / seconds : 0.0;
+	}
+
+	bool is_cooked(const std::string& path)
+	{
+		const std::string extension = ".gltex";
+		return path.size() > extension.size()
+			&& path.compare(path.size() - extension.size(), extension.size(), extension) == 0;
+	}
+
+	GLenum gl_format(TextureFormat format)
+	{
+		switch (format)
+		{
+			case TextureFormat::BC1:
+				return GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+			case TextureFormat::BC3:
+				return GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+			case TextureFormat::BC5:
+				return GL_COMPRESSED_RG_RGTC2;
+			case TextureFormat::RGBA8:
+				break;
+		}
+		return GL_RGBA8;
+	}
+}
+
+const uint8_t* TextureLoader::DecodedImage::data() const
+{
+	return file ? file->mip_data() : image.pixels.data();
+}
+
+size_t TextureLoader::DecodedImage::size() const
+{
+	return file ? file->mip_data_size() : image.pixels.size();
+}
+
+void TextureLoader::initialize(std::shared_ptr<JobSystem> job_system)
+{
+	jobs = std::move(job_system);
+	IMG_Init(IMG_INIT_JPG | IMG_INIT_PNG);
+
+	// Grey checkerboard to show while the real texture streams in
+	const uint8_t pixels[] = {
+		96, 96, 96, 255, 160, 160, 160, 255,
+		160, 160, 160, 255, 96, 96, 96, 255,
+	};
+	glGenTextures(1, &placeholder);
+	glBindTexture(GL_TEXTURE_2D, placeholder);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, 2, 2, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+	gpu_memory().allocate(GpuObject::Texture, placeholder, GpuMemoryCategory::Texture,
+		"TextureLoader placeholder", sizeof(pixels));
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	for (PixelBuffer& buffer : pixel_buffers)
+	{
+		glGenBuffers(1, &buffer.id);
+	}
+}
+
+void TextureLoader::destroy()
+{
+	// Workers may still be pushing decoded images
+	jobs->wait_idle();
+
+	for (PixelBuffer& buffer : pixel_buffers)
+	{
+		if (buffer.fence)
+		{
+			glDeleteSync(static_cast<GLsync>(buffer.fence));
+		}
+		gpu_memory().release(GpuObject::Buffer, buffer.id);
+		glDeleteBuffers(1, &buffer.id);
+		buffer = PixelBuffer();
+	}
+
+	gpu_memory().release(GpuObject::Texture, textures.size(), textures.data());
+	gpu_memory().release(GpuObject::Texture, placeholder);
+	glDeleteTextures((GLsizei)textures.size(), textures.data());
+	glDeleteTextures(1, &placeholder);
+	textures.clear();
+	decoded.clear();
+
+	IMG_Quit();
+}
+
+std::shared_ptr<Texture> TextureLoader::load(const std::string& path)
+{
+	auto texture = std::make_shared<Texture>();
+	texture->path = path;
+	texture->id = placeholder;
+
+	jobs->submit([this, texture] { load_now(texture); });
+
+	return texture;
+}
+
+void TextureLoader::load_now(const std::shared_ptr<Texture>& texture)
+{
+	if (is_cooked(texture->path))
+	{
+		map_cooked(texture);
+	}
+	else
+	{
+		decode(texture);
+	}
+}
+
+void TextureLoader::unload(Texture& texture)
+{
+	if (!texture.resident)
+	{
+		return;
+	}
+
+	const auto it = std::find(textures.begin(), textures.end(), texture.id);
+	if (it != textures.end())
+	{
+		textures.erase(it);
+	}
+	gpu_memory().release(GpuObject::Texture, texture.id);
+	glDeleteTextures(1, &texture.id);
+
+	texture.id = placeholder;
+	texture.gpu_bytes = 0;
+	texture.resident = false;
+}
+
+void TextureLoader::decode(const std::shared_ptr<Texture>& texture)
+{
+	const auto start = std::chrono::steady_clock::now();
+
+	DecodedImage image;
+	image.texture = texture;
+	if (!decode_image_file(texture->path, image.image))
+	{
+		texture->failed = true;
+		const std::lock_guard<std::mutex> lock(decoded_mutex);
+		stats.textures_failed++;
+		return;
+	}
+	image.width = (int)image.image.width;
+	image.height = (int)image.image.height;
+
+	const double seconds = seconds_since(start);
+
+	const std::lock_guard<std::mutex> lock(decoded_mutex);
+	stats.decoded_bytes += image.image.pixels.size();
+	stats.decode_seconds += seconds;
+	decoded.push_back(std::move(image));
+}
+
+void TextureLoader::map_cooked(const std::shared_ptr<Texture>& texture)
+{
+	const auto start = std::chrono::steady_clock::now();
+
+	auto file = std::make_shared<TextureFile>();
+	if (!file->open(texture->path))
+	{
+		texture->failed = true;
+		const std::lock_guard<std::mutex> lock(decoded_mutex);
+		stats.textures_failed++;
+		return;
+	}
+
+	DecodedImage image;
+	image.texture = texture;
+	image.width = (int)file->header().width;
+	image.height = (int)file->header().height;
+	image.file = std::move(file);
+
+	const double seconds = seconds_since(start);
+
+	const std::lock_guard<std::mutex> lock(decoded_mutex);
+	stats.cooked_bytes += image.size();
+	stats.cooked_seconds += seconds;
+	decoded.push_back(std::move(image));
+}
+
+void TextureLoader::upload(PixelBuffer& buffer, DecodedImage& image)
+{
+	const size_t size = image.size();
+
+	// Orphan the old storage so mapping never waits on a previous transfer
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, buffer.id);
+	glBufferData(GL_PIXEL_UNPACK_BUFFER, (GLsizeiptr)size, nullptr, GL_STREAM_DRAW);
+	gpu_memory().allocate(GpuObject::Buffer, buffer.id, GpuMemoryCategory::Staging,
+		"TextureLoader pixel buffer", size);
+	void* mapped = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, (GLsizeiptr)size,
+		GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+	if (!mapped)
+	{
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+		std::cerr << "Unable to map pixel buffer for: " << image.texture->path << "\n";
+		image.texture->failed = true;
+		const std::lock_guard<std::mutex> lock(decoded_mutex);
+		stats.textures_failed++;
+		return;
+	}
+	std::memcpy(mapped, image.data(), size);
+	glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+
+	uint32_t id = 0;
+	glGenTextures(1, &id);
+	glBindTexture(GL_TEXTURE_2D, id);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+	if (image.file)
+	{
+		// Cooked mips go up level by level, offsets relative to the buffer
+		const TextureFile& file = *image.file;
+		const TextureFileHeader& header = file.header();
+		const uint64_t base = file.mip(0).offset;
+		for (uint32_t level = 0; level < header.mip_count; level++)
+		{
+			const TextureFileMip& mip = file.mip(level);
+			const void* offset = reinterpret_cast<const void*>((uintptr_t)(mip.offset - base));
+			if (header.format == TextureFormat::RGBA8)
+			{
+				glTexImage2D(GL_TEXTURE_2D, (GLint)level, GL_RGBA8, (GLsizei)mip.width,
+					(GLsizei)mip.height, 0, GL_RGBA, GL_UNSIGNED_BYTE, offset);
+			}
+			else
+			{
+				glCompressedTexImage2D(GL_TEXTURE_2D, (GLint)level, gl_format(header.format),
+					(GLsizei)mip.width, (GLsizei)mip.height, 0, (GLsizei)mip.size, offset);
+			}
+		}
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, (GLint)header.mip_count - 1);
+	}
+	else
+	{
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, image.width, image.height, 0,
+			GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+		// Sources from the bound pixel buffer, so this only queues the copy
+		glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, image.width, image.height,
+			GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+		glGenerateMipmap(GL_TEXTURE_2D);
+	}
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+	glBindTexture(GL_TEXTURE_2D, 0);
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	// Back to the default, which the other uploads expect
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+	textures.push_back(id);
+
+	buffer.size = size;
+	buffer.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	buffer.texture = image.texture;
+	buffer.texture_id = id;
+
+	image.texture->width = image.width;
+	image.texture->height = image.height;
+	// Generated mips add a third on top of the base level
+	image.texture->gpu_bytes = image.file ? size : size + size / 3;
+	gpu_memory().allocate(GpuObject::Texture, id, GpuMemoryCategory::Texture, image.texture->path,
+		image.texture->gpu_bytes);
+	stats.uploaded_bytes += size;
+}
+
+void TextureLoader::update()
+{
+	const auto start = std::chrono::steady_clock::now();
+
+	// Swap in every texture whose transfer has finished
+	for (PixelBuffer& buffer : pixel_buffers)
+	{
+		if (!buffer.fence)
+		{
+			continue;
+		}
+
+		const GLenum status = glClientWaitSync(static_cast<GLsync>(buffer.fence), 0, 0);
+		if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED)
+		{
+			continue;
+		}
+
+		glDeleteSync(static_cast<GLsync>(buffer.fence));
+		buffer.fence = nullptr;
+		buffer.texture->id = buffer.texture_id;
+		buffer.texture->resident = true;
+		buffer.texture.reset();
+		stats.textures_loaded++;
+	}
+
+	std::vector<DecodedImage> ready;
+	{
+		const std::lock_guard<std::mutex> lock(decoded_mutex);
+		ready.swap(decoded);
+	}
+
+	// Start as many uploads as we have free buffers and budget for
+	size_t bytes = 0;
+	size_t next = 0;
+	for (PixelBuffer& buffer : pixel_buffers)
+	{
+		if (next == ready.size() || bytes >= TEXTURE_UPLOAD_BUDGET)
+		{
+			break;
+		}
+		if (buffer.fence)
+		{
+			continue;
+		}
+
+		upload(buffer, ready[next]);
+		bytes += ready[next].size();
+		next++;
+	}
+
+	// Whatever didn't fit waits for the next frame
+	if (next < ready.size())
+	{
+		const std::lock_guard<std::mutex> lock(decoded_mutex);
+		decoded.insert(decoded.begin(), std::make_move_iterator(ready.begin() + (ptrdiff_t)next),
+			std::make_move_iterator(ready.end()));
+	}
+
+	if (next > 0)
+	{
+		stats.upload_seconds += seconds_since(start);
+	}
+}
+
+void TextureLoader::print_stats() const
+{
+	std::cout << "Textures: " << stats.textures_loaded << " loaded, "
+			  << stats.textures_failed << " failed\n"
+			  << "  decode: " << (double)stats.decoded_bytes / (1024.0 * 1024.0)
+			  << " MB at " << megabytes_per_second(stats.decoded_bytes, stats.decode_seconds)
+			  << " MB/s per thread\n"
+			  << "  cooked: " << (double)stats.cooked_bytes / (1024.0 * 1024.0)
+			  << " MB at " << megabytes_per_second(stats.cooked_bytes, stats.cooked_seconds)
+			  << " MB/s per thread\n"
+			  << "  upload: " << (double)stats.uploaded_bytes / (1024.0 * 1024.0)
+			  << " MB at " << megabytes_per_second(stats.uploaded_bytes, stats.upload_seconds)
+			  << " MB/s\n";
+}
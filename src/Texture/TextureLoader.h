@@ -0,0 +1,96 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "Image.h"
+#include "Texture.h"
+#include "TextureFile.h"
+
+class JobSystem;
+
+constexpr int TEXTURE_PBO_COUNT = 4;
+
+// Caps the bytes copied into pixel buffers per frame so a burst of
+// finished decodes can't cause a hitch
+constexpr size_t TEXTURE_UPLOAD_BUDGET = 16 * 1024 * 1024;
+
+struct TextureStats
+{
+	uint64_t decoded_bytes = 0;
+	double decode_seconds = 0.0; // summed over all worker threads
+	uint64_t cooked_bytes = 0; // compressed mips mapped from .gltex files
+	double cooked_seconds = 0.0;
+	uint64_t uploaded_bytes = 0;
+	double upload_seconds = 0.0; // render thread time spent uploading
+	uint32_t textures_loaded = 0;
+	uint32_t textures_failed = 0;
+};
+
+// Streams textures in the background. Decoding and conversion to RGBA8 run
+// on the job system, as does mapping cooked .gltex files, and the render
+// thread copies the pixels into a ring of pixel buffer objects so
+// glTexSubImage2D returns without waiting for the transfer. A texture
+// becomes resident once its upload fence signals.
+class TextureLoader
+{
+public:
+	void initialize(std::shared_ptr<JobSystem> job_system);
+	void destroy();
+
+	// Returns immediately with a texture bound to the placeholder
+	std::shared_ptr<Texture> load(const std::string& path);
+
+	// Decodes or maps the texture on the calling thread and queues it for
+	// upload, for callers already running on a worker
+	void load_now(const std::shared_ptr<Texture>& texture);
+
+	// Frees a resident texture's GL storage and points it back at the
+	// placeholder. Loading it again means calling load().
+	void unload(Texture& texture);
+
+	// Call once per frame on the render thread
+	void update();
+
+	void print_stats() const;
+
+	uint32_t placeholder = 0;
+	TextureStats stats;
+
+private:
+	struct DecodedImage
+	{
+		std::shared_ptr<Texture> texture;
+		Image image;
+		std::shared_ptr<TextureFile> file; // set instead of image when cooked
+		int width = 0;
+		int height = 0;
+
+		const uint8_t* data() const;
+		size_t size() const;
+	};
+
+	struct PixelBuffer
+	{
+		uint32_t id = 0;
+		size_t size = 0;
+		void* fence = nullptr; // GLsync
+		std::shared_ptr<Texture> texture; // waiting for this upload
+		uint32_t texture_id = 0;
+	};
+
+	void decode(const std::shared_ptr<Texture>& texture);
+	void map_cooked(const std::shared_ptr<Texture>& texture);
+	void upload(PixelBuffer& buffer, DecodedImage& image);
+
+	std::shared_ptr<JobSystem> jobs;
+	std::array<PixelBuffer, TEXTURE_PBO_COUNT> pixel_buffers{};
+	std::vector<uint32_t> textures; // everything we created, for cleanup
+
+	std::mutex decoded_mutex;
+	std::vector<DecodedImage> decoded;
+};
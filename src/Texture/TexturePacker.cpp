@@ -0,0 +1,217 @@
+#include "TexturePacker.h"
+
+#include <algorithm>
+#include <iostream>
+
+#include <GL/glew.h>
+#include <GL/gl.h>
+
+#include "../Resources/GpuMemory.h"
+#include "../Capture/CapturedGL.h"
+
+namespace
+{
+	// Copies image into page at (x, y), repeating its edge texels into the
+	// surrounding padding
+	void blit_padded(Image& page, const Image& image, uint32_t x, uint32_t y)
+	{
+		const int pad = (int)ATLAS_PADDING;
+		for (int dy = -pad; dy < (int)image.height + pad; dy++)
+		{
+			const uint32_t sy = (uint32_t)std::clamp(dy, 0, (int)image.height - 1);
+			for (int dx = -pad; dx < (int)image.width + pad; dx++)
+			{
+				const uint32_t sx = (uint32_t)std::clamp(dx, 0, (int)image.width - 1);
+				const size_t src = ((size_t)sy * image.width + sx) * 4;
+				const size_t dst = ((size_t)((int)y + dy) * page.width + (size_t)((int)x + dx)) * 4;
+				std::copy(&image.pixels[src], &image.pixels[src] + 4, &page.pixels[dst]);
+			}
+		}
+	}
+}
+
+glm::vec2 apply_uv_transform(const TextureSlot& slot, const glm::vec2& uv)
+{
+	return uv * glm::vec2(slot.uv_transform) + glm::vec2(slot.uv_transform.z, slot.uv_transform.w);
+}
+
+uint32_t TexturePacker::add(Image image)
+{
+	Pending entry;
+	entry.image = std::move(image);
+	entry.slot = (uint32_t)slots.size();
+	slots.emplace_back();
+	pending.push_back(std::move(entry));
+	return pending.back().slot;
+}
+
+void TexturePacker::pack_atlases(std::vector<Pending*>& small,
+	std::map<GroupKey, std::vector<Layer>>& groups)
+{
+	// Tallest first keeps the shelves tight
+	std::sort(small.begin(), small.end(), [](const Pending* a, const Pending* b) {
+		return a->image.height > b->image.height;
+	});
+
+	std::vector<std::vector<uint32_t>> page_slots;
+	uint32_t cursor_x = ATLAS_PAGE_SIZE;
+	uint32_t shelf_y = 0;
+	uint32_t shelf_height = ATLAS_PAGE_SIZE;
+
+	for (Pending* entry : small)
+	{
+		const uint32_t width = entry->image.width + ATLAS_PADDING * 2;
+		const uint32_t height = entry->image.height + ATLAS_PADDING * 2;
+
+		// Next shelf, then next page, when this one doesn't fit
+		if (cursor_x + width > ATLAS_PAGE_SIZE)
+		{
+			shelf_y += shelf_height;
+			cursor_x = 0;
+			shelf_height = 0;
+		}
+		if (shelf_y + height > ATLAS_PAGE_SIZE)
+		{
+			Image page;
+			page.width = ATLAS_PAGE_SIZE;
+			page.height = ATLAS_PAGE_SIZE;
+			page.pixels.resize((size_t)ATLAS_PAGE_SIZE * ATLAS_PAGE_SIZE * 4, 0);
+			atlas_pages.push_back(std::move(page));
+			page_slots.emplace_back();
+			shelf_y = 0;
+			cursor_x = 0;
+			shelf_height = 0;
+		}
+
+		const uint32_t x = cursor_x + ATLAS_PADDING;
+		const uint32_t y = shelf_y + ATLAS_PADDING;
+		blit_padded(atlas_pages.back(), entry->image, x, y);
+
+		const float page_size = (float)ATLAS_PAGE_SIZE;
+		slots[entry->slot].uv_transform = glm::vec4(
+			(float)entry->image.width / page_size, (float)entry->image.height / page_size,
+			(float)x / page_size, (float)y / page_size);
+		page_slots.back().push_back(entry->slot);
+
+		cursor_x += width;
+		shelf_height = std::max(shelf_height, height);
+	}
+
+	// Pages only become layers once they're all allocated, as the vector
+	// may have moved them until now
+	std::vector<Layer>& layers = groups[{ATLAS_PAGE_SIZE, ATLAS_PAGE_SIZE, true}];
+	for (size_t i = 0; i < page_slots.size(); i++)
+	{
+		layers.push_back({&atlas_pages[i], std::move(page_slots[i])});
+	}
+}
+
+void TexturePacker::build()
+{
+	if (pending.empty())
+	{
+		return;
+	}
+
+	std::map<GroupKey, std::vector<Layer>> groups;
+	std::vector<Pending*> small;
+
+	for (Pending& entry : pending)
+	{
+		if (entry.image.width <= ATLAS_MAX_TEXTURE_SIZE && entry.image.height <= ATLAS_MAX_TEXTURE_SIZE)
+		{
+			small.push_back(&entry);
+		}
+		else
+		{
+			groups[{entry.image.width, entry.image.height, false}].push_back({&entry.image, {entry.slot}});
+		}
+	}
+
+	pack_atlases(small, groups);
+
+	GLint max_layers = 256;
+	glGetIntegerv(GL_MAX_ARRAY_TEXTURE_LAYERS, &max_layers);
+
+	for (const auto& [key, layers] : groups)
+	{
+		const auto [width, height, is_atlas] = key;
+
+		// Split groups that exceed the layer limit over several arrays
+		for (size_t first = 0; first < layers.size(); first += (size_t)max_layers)
+		{
+			const size_t count = std::min(layers.size() - first, (size_t)max_layers);
+
+			uint32_t id = 0;
+			glGenTextures(1, &id);
+			glBindTexture(GL_TEXTURE_2D_ARRAY, id);
+			glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+			glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_RGBA8, (GLsizei)width,
+				(GLsizei)height, (GLsizei)count, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+			gpu_memory().allocate(GpuObject::Texture, id, GpuMemoryCategory::Texture,
+				is_atlas ? "TexturePacker atlas" : "TexturePacker",
+				texture_bytes(width, height, (uint32_t)count, 4, true));
+
+			for (size_t i = 0; i < count; i++)
+			{
+				const Layer& layer = layers[first + i];
+				glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, (GLint)i, (GLsizei)width,
+					(GLsizei)height, 1, GL_RGBA, GL_UNSIGNED_BYTE, layer.image->pixels.data());
+
+				for (const uint32_t slot : layer.slots)
+				{
+					slots[slot].texture = id;
+					slots[slot].layer = (uint32_t)i;
+				}
+			}
+
+			glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+			glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+			glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+			if (is_atlas)
+			{
+				// Deeper mips would blend neighbouring atlas entries
+				glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, ATLAS_MAX_LEVEL);
+			}
+			glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+			glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+			arrays.push_back(id);
+		}
+	}
+
+	std::cout << "Packed " << pending.size() << " textures into " << arrays.size()
+			  << " texture arrays (" << atlas_pages.size() << " atlas pages)\n";
+
+	atlas_pages_built += (uint32_t)atlas_pages.size();
+
+	// The pixels live on the GPU now
+	pending.clear();
+	atlas_pages.clear();
+}
+
+void TexturePacker::destroy()
+{
+	gpu_memory().release(GpuObject::Texture, arrays.size(), arrays.data());
+	glDeleteTextures((GLsizei)arrays.size(), arrays.data());
+	arrays.clear();
+	slots.clear();
+	pending.clear();
+	atlas_pages.clear();
+	atlas_pages_built = 0;
+}
+
+const TextureSlot& TexturePacker::slot(uint32_t index) const
+{
+	return slots[index];
+}
+
+uint32_t TexturePacker::array_count() const
+{
+	return (uint32_t)arrays.size();
+}
+
+uint32_t TexturePacker::atlas_page_count() const
+{
+	return atlas_pages_built;
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <tuple>
+#include <vector>
+
+#include <glm/vec2.hpp>
+#include <glm/vec4.hpp>
+
+#include "Image.h"
+
+// Textures this size or smaller in both dimensions share atlas pages
+constexpr uint32_t ATLAS_MAX_TEXTURE_SIZE = 256;
+constexpr uint32_t ATLAS_PAGE_SIZE = 2048;
+// Edge texels are repeated this far around every atlas entry so filtering
+// and the first few mips don't bleed between neighbours
+constexpr uint32_t ATLAS_PADDING = 4;
+constexpr int ATLAS_MAX_LEVEL = 2;
+
+// Where a packed texture ended up: a layer of a 2D array texture, and the
+// scale (xy) and offset (zw) that map its UVs into that layer
+struct TextureSlot
+{
+	uint32_t texture = 0;
+	uint32_t layer = 0;
+	glm::vec4 uv_transform = glm::vec4(1.0f, 1.0f, 0.0f, 0.0f);
+};
+
+glm::vec2 apply_uv_transform(const TextureSlot& slot, const glm::vec2& uv);
+
+// Packs many RGBA8 textures into a few GL_TEXTURE_2D_ARRAYs so draws with
+// different textures can share one binding. Textures with the same size
+// become layers of one array; small ones are first shelf packed into atlas
+// pages, which then become layers of the page sized array.
+class TexturePacker
+{
+public:
+	// Queues an image and returns the index of its slot after build()
+	uint32_t add(Image image);
+
+	// Packs and uploads everything queued since the last build
+	void build();
+	void destroy();
+
+	const TextureSlot& slot(uint32_t index) const;
+	uint32_t array_count() const;
+	uint32_t atlas_page_count() const;
+
+private:
+	struct Pending
+	{
+		Image image;
+		uint32_t slot = 0;
+	};
+
+	// Width, height and whether the layers are atlas pages
+	typedef std::tuple<uint32_t, uint32_t, bool> GroupKey;
+
+	// A layer image waiting to be uploaded into the array of its size
+	struct Layer
+	{
+		const Image* image = nullptr;
+		std::vector<uint32_t> slots;
+	};
+
+	void pack_atlases(std::vector<Pending*>& small,
+		std::map<GroupKey, std::vector<Layer>>& groups);
+
+	std::vector<Pending> pending;
+	std::vector<Image> atlas_pages;
+	std::vector<TextureSlot> slots;
+	std::vector<uint32_t> arrays;
+	uint32_t atlas_pages_built = 0;
+};
@@ -1,13 +1,27 @@
+#include <cstring>
+
 #include "Application.h"
+#include "./Benchmark/BenchmarkRunner.h"
 
 int main(int argc, char* argv[])
 {
+	// Benchmarks run offscreen and never open the application's window
+	for (int i = 1; i < argc; i++)
+	{
+		if (std::strcmp(argv[i], "--benchmark") == 0)
+		{
+			BenchmarkRunner benchmark;
+			benchmark.parse_arguments(argc, argv);
+			return benchmark.run();
+		}
+	}
+
 	Application app;
 
+	app.parse_arguments(argc, argv);
 	app.initialize();
 	app.run();
 	app.destroy();
 
 	return 0;
 }
-
@@ -0,0 +1,937 @@
+// Plays a GL command stream recorded with --capture back on a headless
+// context, as fast as the driver takes it, and reports where the time went:
+// the time of every frame, and the time spent in each kind of call. Object
+// names and uniform locations are remapped to whatever the driver hands out
+// this time, and the default framebuffer becomes an offscreen one of the
+// captured size.
+//
+// Usage: glreplay <stream> [--finish]
+//   --finish waits for the GPU at the end of every frame, so frame times
+//            include the GPU work and not just the submission
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <unordered_map>
+#include <vector>
+
+#include <GL/glew.h>
+#include <GL/gl.h>
+
+#include "../src/Capture/CommandStream.h"
+#include "../src/Renderer/FrameTimer.h"
+#include "../src/Renderer/HeadlessContext.h"
+
+namespace
+{
+	struct CallStats
+	{
+		uint64_t count = 0;
+		double total_ns = 0.0;
+		double max_ns = 0.0;
+	};
+
+	// Captured object names to the names made by this replay
+	class NameMap
+	{
+	public:
+		void add(GLsizei n, const GLuint* captured, const GLuint* replayed)
+		{
+			for (GLsizei i = 0; i < n; i++)
+			{
+				names[captured[i]] = replayed[i];
+			}
+		}
+
+		void add(GLuint captured, GLuint replayed)
+		{
+			names[captured] = replayed;
+		}
+
+		// Zero stays zero, and so do names the stream never created
+		GLuint operator()(GLuint captured) const
+		{
+			const auto it = names.find(captured);
+			return it != names.end() ? it->second : 0;
+		}
+
+		void remove(GLuint captured)
+		{
+			names.erase(captured);
+		}
+
+	private:
+		std::unordered_map<GLuint, GLuint> names;
+	};
+
+	class Replayer
+	{
+	public:
+		bool initialize(const CommandStreamHeader& header, bool finish_frames);
+		void destroy();
+		bool replay(CommandReader& reader);
+		void print_report() const;
+
+	private:
+		void execute(GLCommand command, CommandReader& reader);
+		GLint uniform_location(GLint captured) const;
+
+		template <typename Gen>
+		void generate(CommandReader& reader, NameMap& map, Gen gen)
+		{
+			size_t size = 0;
+			const uint8_t* data = reader.read_blob(size);
+			std::vector<GLuint> captured(size / sizeof(GLuint));
+			std::memcpy(captured.data(), data, captured.size() * sizeof(GLuint));
+			std::vector<GLuint> replayed(captured.size());
+			gen((GLsizei)replayed.size(), replayed.data());
+			map.add((GLsizei)captured.size(), captured.data(), replayed.data());
+		}
+
+		template <typename Delete>
+		void remove(CommandReader& reader, NameMap& map, Delete del)
+		{
+			size_t size = 0;
+			const uint8_t* data = reader.read_blob(size);
+			std::vector<GLuint> names(size / sizeof(GLuint));
+			std::memcpy(names.data(), data, names.size() * sizeof(GLuint));
+			for (GLuint& name : names)
+			{
+				const GLuint captured = name;
+				name = map(captured);
+				map.remove(captured);
+			}
+			del((GLsizei)names.size(), names.data());
+		}
+
+		const void* read_pixels(CommandReader& reader);
+
+		template <typename T>
+		static std::vector<T> read_array(CommandReader& reader)
+		{
+			size_t size = 0;
+			const uint8_t* data = reader.read_blob(size);
+			std::vector<T> values(size / sizeof(T));
+			std::memcpy(values.data(), data, values.size() * sizeof(T));
+			return values;
+		}
+
+		bool finish = false;
+		HeadlessContext context;
+		GLuint default_framebuffer = 0;
+		GLuint default_color = 0;
+		GLuint default_depth = 0;
+
+		NameMap buffers;
+		NameMap textures;
+		NameMap vertex_arrays;
+		NameMap framebuffers;
+		NameMap renderbuffers;
+		NameMap shaders;
+		NameMap programs;
+		// By captured program in the high half, captured location in the low
+		std::unordered_map<uint64_t, GLint> uniform_locations;
+		GLuint current_program = 0; // captured name
+
+		std::array<CallStats, (size_t)GLCommand::Count> calls{};
+		std::vector<double> frame_times; // milliseconds
+		uint64_t call_count = 0;
+		double replay_seconds = 0.0;
+	};
+
+	bool Replayer::initialize(const CommandStreamHeader& header, bool finish_frames)
+	{
+		finish = finish_frames;
+		// Streams of GPU culled frames need compute; the rest play on 3.3
+		if (!context.create(4, 5) && !context.create(3, 3))
+		{
+			return false;
+		}
+
+		glewExperimental = GL_TRUE;
+		if (glewContextInit() != GLEW_OK)
+		{
+			std::cerr << "Failed to initialize GLEW.\n";
+			return false;
+		}
+
+		// Stands in for the window the capture may have drawn to
+		glGenRenderbuffers(1, &default_color);
+		glBindRenderbuffer(GL_RENDERBUFFER, default_color);
+		glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, header.width, header.height);
+		glGenRenderbuffers(1, &default_depth);
+		glBindRenderbuffer(GL_RENDERBUFFER, default_depth);
+		glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, header.width, header.height);
+		glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+		glGenFramebuffers(1, &default_framebuffer);
+		glBindFramebuffer(GL_FRAMEBUFFER, default_framebuffer);
+		glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, default_color);
+		glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER,
+			default_depth);
+		if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+		{
+			std::cerr << "Replay framebuffer is incomplete.\n";
+			return false;
+		}
+		glViewport(0, 0, header.width, header.height);
+		framebuffers.add(0, default_framebuffer);
+
+		std::cout << "Replaying " << header.frame_count << " frames, " << header.command_count
+				  << " commands, at " << header.width << "x" << header.height << " on "
+				  << reinterpret_cast<const char*>(glGetString(GL_RENDERER)) << "\n";
+		return true;
+	}
+
+	void Replayer::destroy()
+	{
+		glDeleteFramebuffers(1, &default_framebuffer);
+		glDeleteRenderbuffers(1, &default_color);
+		glDeleteRenderbuffers(1, &default_depth);
+		context.destroy();
+	}
+
+	bool Replayer::replay(CommandReader& reader)
+	{
+		const auto replay_start = std::chrono::steady_clock::now();
+		auto frame_start = replay_start;
+
+		GLCommand command;
+		while (reader.next(command))
+		{
+			const auto start = std::chrono::steady_clock::now();
+			execute(command, reader);
+			const auto end = std::chrono::steady_clock::now();
+
+			const double ns = (double)std::chrono::duration_cast<std::chrono::nanoseconds>(
+				end - start).count();
+			CallStats& stats = calls[(size_t)command];
+			stats.count++;
+			stats.total_ns += ns;
+			stats.max_ns = std::max(stats.max_ns, ns);
+			call_count++;
+
+			if (command == GLCommand::EndFrame)
+			{
+				frame_times.push_back(std::chrono::duration<double, std::milli>(end - frame_start).count());
+				frame_start = end;
+			}
+		}
+
+		glFinish();
+		replay_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now()
+			- replay_start).count();
+
+		return call_count == reader.header().command_count;
+	}
+
+	GLint Replayer::uniform_location(GLint captured) const
+	{
+		const uint64_t key = (uint64_t)current_program << 32 | (uint32_t)captured;
+		const auto it = uniform_locations.find(key);
+		return it != uniform_locations.end() ? it->second : captured;
+	}
+
+	const void* Replayer::read_pixels(CommandReader& reader)
+	{
+		switch (reader.read<PixelSource>())
+		{
+			case PixelSource::Data:
+			{
+				size_t size = 0;
+				return reader.read_blob(size);
+			}
+			case PixelSource::UnpackBuffer:
+				return reinterpret_cast<const void*>((uintptr_t)reader.read<uint64_t>());
+			case PixelSource::None:
+				break;
+		}
+		return nullptr;
+	}
+
+	void Replayer::execute(GLCommand command, CommandReader& reader)
+	{
+		size_t size = 0;
+		switch (command)
+		{
+			case GLCommand::ActiveTexture:
+				glActiveTexture(reader.read<GLenum>());
+				break;
+			case GLCommand::AttachShader:
+			{
+				const GLuint program = programs(reader.read<GLuint>());
+				glAttachShader(program, shaders(reader.read<GLuint>()));
+				break;
+			}
+			case GLCommand::BindBuffer:
+			{
+				const GLenum target = reader.read<GLenum>();
+				glBindBuffer(target, buffers(reader.read<GLuint>()));
+				break;
+			}
+			case GLCommand::BindBufferBase:
+			{
+				const GLenum target = reader.read<GLenum>();
+				const GLuint index = reader.read<GLuint>();
+				glBindBufferBase(target, index, buffers(reader.read<GLuint>()));
+				break;
+			}
+			case GLCommand::BindFramebuffer:
+			{
+				const GLenum target = reader.read<GLenum>();
+				glBindFramebuffer(target, framebuffers(reader.read<GLuint>()));
+				break;
+			}
+			case GLCommand::BindImageTexture:
+			{
+				const GLuint unit = reader.read<GLuint>();
+				const GLuint texture = textures(reader.read<GLuint>());
+				const GLint level = reader.read<GLint>();
+				const GLboolean layered = reader.read<GLboolean>();
+				const GLint layer = reader.read<GLint>();
+				const GLenum access = reader.read<GLenum>();
+				glBindImageTexture(unit, texture, level, layered, layer, access,
+					reader.read<GLenum>());
+				break;
+			}
+			case GLCommand::BindRenderbuffer:
+			{
+				const GLenum target = reader.read<GLenum>();
+				glBindRenderbuffer(target, renderbuffers(reader.read<GLuint>()));
+				break;
+			}
+			case GLCommand::BindTexture:
+			{
+				const GLenum target = reader.read<GLenum>();
+				glBindTexture(target, textures(reader.read<GLuint>()));
+				break;
+			}
+			case GLCommand::BindVertexArray:
+				glBindVertexArray(vertex_arrays(reader.read<GLuint>()));
+				break;
+			case GLCommand::BlitFramebuffer:
+			{
+				std::array<GLint, 8> corners{};
+				for (GLint& corner : corners)
+				{
+					corner = reader.read<GLint>();
+				}
+				const GLbitfield mask = reader.read<GLbitfield>();
+				glBlitFramebuffer(corners[0], corners[1], corners[2], corners[3], corners[4],
+					corners[5], corners[6], corners[7], mask, reader.read<GLenum>());
+				break;
+			}
+			case GLCommand::BufferData:
+			{
+				const GLenum target = reader.read<GLenum>();
+				const GLenum usage = reader.read<GLenum>();
+				const uint64_t buffer_size = reader.read<uint64_t>();
+				const void* data = reader.read<uint8_t>() ? reader.read_blob(size) : nullptr;
+				glBufferData(target, (GLsizeiptr)buffer_size, data, usage);
+				break;
+			}
+			case GLCommand::BufferSubData:
+			{
+				const GLenum target = reader.read<GLenum>();
+				const uint64_t offset = reader.read<uint64_t>();
+				const uint8_t* data = reader.read_blob(size);
+				glBufferSubData(target, (GLintptr)offset, (GLsizeiptr)size, data);
+				break;
+			}
+			case GLCommand::Clear:
+				glClear(reader.read<GLbitfield>());
+				break;
+			case GLCommand::ClearColor:
+			{
+				const GLfloat red = reader.read<GLfloat>();
+				const GLfloat green = reader.read<GLfloat>();
+				const GLfloat blue = reader.read<GLfloat>();
+				glClearColor(red, green, blue, reader.read<GLfloat>());
+				break;
+			}
+			case GLCommand::ColorMask:
+			{
+				const GLboolean red = reader.read<GLboolean>();
+				const GLboolean green = reader.read<GLboolean>();
+				const GLboolean blue = reader.read<GLboolean>();
+				glColorMask(red, green, blue, reader.read<GLboolean>());
+				break;
+			}
+			case GLCommand::CompileShader:
+				glCompileShader(shaders(reader.read<GLuint>()));
+				break;
+			case GLCommand::CompressedTexImage2D:
+			{
+				const GLenum target = reader.read<GLenum>();
+				const GLint level = reader.read<GLint>();
+				const GLenum internal_format = reader.read<GLenum>();
+				const GLsizei width = reader.read<GLsizei>();
+				const GLsizei height = reader.read<GLsizei>();
+				const GLint border = reader.read<GLint>();
+				const GLsizei image_size = reader.read<GLsizei>();
+				glCompressedTexImage2D(target, level, internal_format, width, height, border,
+					image_size, read_pixels(reader));
+				break;
+			}
+			case GLCommand::CopyBufferSubData:
+			{
+				const GLenum read_target = reader.read<GLenum>();
+				const GLenum write_target = reader.read<GLenum>();
+				const uint64_t read_offset = reader.read<uint64_t>();
+				const uint64_t write_offset = reader.read<uint64_t>();
+				glCopyBufferSubData(read_target, write_target, (GLintptr)read_offset,
+					(GLintptr)write_offset, (GLsizeiptr)reader.read<uint64_t>());
+				break;
+			}
+			case GLCommand::CreateProgram:
+				programs.add(reader.read<GLuint>(), glCreateProgram());
+				break;
+			case GLCommand::CreateShader:
+			{
+				const GLenum type = reader.read<GLenum>();
+				shaders.add(reader.read<GLuint>(), glCreateShader(type));
+				break;
+			}
+			case GLCommand::DeleteBuffers:
+				remove(reader, buffers, glDeleteBuffers);
+				break;
+			case GLCommand::DeleteFramebuffers:
+				remove(reader, framebuffers, glDeleteFramebuffers);
+				break;
+			case GLCommand::DeleteProgram:
+			{
+				const GLuint captured = reader.read<GLuint>();
+				glDeleteProgram(programs(captured));
+				programs.remove(captured);
+				break;
+			}
+			case GLCommand::DeleteRenderbuffers:
+				remove(reader, renderbuffers, glDeleteRenderbuffers);
+				break;
+			case GLCommand::DeleteShader:
+			{
+				const GLuint captured = reader.read<GLuint>();
+				glDeleteShader(shaders(captured));
+				shaders.remove(captured);
+				break;
+			}
+			case GLCommand::DeleteTextures:
+				remove(reader, textures, glDeleteTextures);
+				break;
+			case GLCommand::DeleteVertexArrays:
+				remove(reader, vertex_arrays, glDeleteVertexArrays);
+				break;
+			case GLCommand::DepthFunc:
+				glDepthFunc(reader.read<GLenum>());
+				break;
+			case GLCommand::DepthMask:
+				glDepthMask(reader.read<GLboolean>());
+				break;
+			case GLCommand::DetachShader:
+			{
+				const GLuint program = programs(reader.read<GLuint>());
+				glDetachShader(program, shaders(reader.read<GLuint>()));
+				break;
+			}
+			case GLCommand::Disable:
+				glDisable(reader.read<GLenum>());
+				break;
+			case GLCommand::DisableVertexAttribArray:
+				glDisableVertexAttribArray(reader.read<GLuint>());
+				break;
+			case GLCommand::DispatchCompute:
+			{
+				const GLuint groups_x = reader.read<GLuint>();
+				const GLuint groups_y = reader.read<GLuint>();
+				glDispatchCompute(groups_x, groups_y, reader.read<GLuint>());
+				break;
+			}
+			case GLCommand::DrawArrays:
+			{
+				const GLenum mode = reader.read<GLenum>();
+				const GLint first = reader.read<GLint>();
+				glDrawArrays(mode, first, reader.read<GLsizei>());
+				break;
+			}
+			case GLCommand::DrawBuffer:
+				glDrawBuffer(reader.read<GLenum>());
+				break;
+			case GLCommand::DrawElements:
+			{
+				const GLenum mode = reader.read<GLenum>();
+				const GLsizei count = reader.read<GLsizei>();
+				const GLenum type = reader.read<GLenum>();
+				const uint64_t offset = reader.read<uint64_t>();
+				glDrawElements(mode, count, type, reinterpret_cast<const void*>((uintptr_t)offset));
+				break;
+			}
+			case GLCommand::DrawElementsInstancedBaseVertex:
+			{
+				const GLenum mode = reader.read<GLenum>();
+				const GLsizei count = reader.read<GLsizei>();
+				const GLenum type = reader.read<GLenum>();
+				const uint64_t offset = reader.read<uint64_t>();
+				const GLsizei instance_count = reader.read<GLsizei>();
+				const GLint base_vertex = reader.read<GLint>();
+				glDrawElementsInstancedBaseVertex(mode, count, type,
+					reinterpret_cast<const void*>((uintptr_t)offset), instance_count, base_vertex);
+				break;
+			}
+			case GLCommand::Enable:
+				glEnable(reader.read<GLenum>());
+				break;
+			case GLCommand::EnableVertexAttribArray:
+				glEnableVertexAttribArray(reader.read<GLuint>());
+				break;
+			case GLCommand::Flush:
+				glFlush();
+				break;
+			case GLCommand::FramebufferRenderbuffer:
+			{
+				const GLenum target = reader.read<GLenum>();
+				const GLenum attachment = reader.read<GLenum>();
+				const GLenum renderbuffer_target = reader.read<GLenum>();
+				glFramebufferRenderbuffer(target, attachment, renderbuffer_target,
+					renderbuffers(reader.read<GLuint>()));
+				break;
+			}
+			case GLCommand::FramebufferTexture2D:
+			{
+				const GLenum target = reader.read<GLenum>();
+				const GLenum attachment = reader.read<GLenum>();
+				const GLenum texture_target = reader.read<GLenum>();
+				const GLuint texture = textures(reader.read<GLuint>());
+				glFramebufferTexture2D(target, attachment, texture_target, texture,
+					reader.read<GLint>());
+				break;
+			}
+			case GLCommand::FramebufferTextureLayer:
+			{
+				const GLenum target = reader.read<GLenum>();
+				const GLenum attachment = reader.read<GLenum>();
+				const GLuint texture = textures(reader.read<GLuint>());
+				const GLint level = reader.read<GLint>();
+				glFramebufferTextureLayer(target, attachment, texture, level, reader.read<GLint>());
+				break;
+			}
+			case GLCommand::GenBuffers:
+				generate(reader, buffers, glGenBuffers);
+				break;
+			case GLCommand::GenFramebuffers:
+				generate(reader, framebuffers, glGenFramebuffers);
+				break;
+			case GLCommand::GenRenderbuffers:
+				generate(reader, renderbuffers, glGenRenderbuffers);
+				break;
+			case GLCommand::GenTextures:
+				generate(reader, textures, glGenTextures);
+				break;
+			case GLCommand::GenVertexArrays:
+				generate(reader, vertex_arrays, glGenVertexArrays);
+				break;
+			case GLCommand::GenerateMipmap:
+				glGenerateMipmap(reader.read<GLenum>());
+				break;
+			case GLCommand::GetUniformLocation:
+			{
+				const GLuint program = reader.read<GLuint>();
+				const GLint location = reader.read<GLint>();
+				const uint8_t* name = reader.read_blob(size);
+				const std::string name_string(reinterpret_cast<const char*>(name), size);
+				uniform_locations[(uint64_t)program << 32 | (uint32_t)location]
+					= glGetUniformLocation(programs(program), name_string.c_str());
+				break;
+			}
+			case GLCommand::InvalidateFramebuffer:
+			{
+				const GLenum target = reader.read<GLenum>();
+				const uint8_t* data = reader.read_blob(size);
+				std::vector<GLenum> attachments(size / sizeof(GLenum));
+				std::memcpy(attachments.data(), data, attachments.size() * sizeof(GLenum));
+				glInvalidateFramebuffer(target, (GLsizei)attachments.size(), attachments.data());
+				break;
+			}
+			case GLCommand::LinkProgram:
+				glLinkProgram(programs(reader.read<GLuint>()));
+				break;
+			case GLCommand::MemoryBarrier:
+				glMemoryBarrier(reader.read<GLbitfield>());
+				break;
+			case GLCommand::MultiDrawElements:
+			{
+				const GLenum mode = reader.read<GLenum>();
+				const GLenum type = reader.read<GLenum>();
+				const uint8_t* count_data = reader.read_blob(size);
+				std::vector<GLsizei> counts(size / sizeof(GLsizei));
+				std::memcpy(counts.data(), count_data, counts.size() * sizeof(GLsizei));
+				const uint8_t* offset_data = reader.read_blob(size);
+				std::vector<const void*> offsets(size / sizeof(uint64_t));
+				for (size_t i = 0; i < offsets.size(); i++)
+				{
+					uint64_t offset = 0;
+					std::memcpy(&offset, offset_data + i * sizeof(uint64_t), sizeof(offset));
+					offsets[i] = reinterpret_cast<const void*>((uintptr_t)offset);
+				}
+				glMultiDrawElements(mode, counts.data(), type, offsets.data(),
+					(GLsizei)std::min(counts.size(), offsets.size()));
+				break;
+			}
+			case GLCommand::MultiDrawElementsBaseVertex:
+			{
+				const GLenum mode = reader.read<GLenum>();
+				const GLenum type = reader.read<GLenum>();
+				const std::vector<GLsizei> counts = read_array<GLsizei>(reader);
+				const std::vector<uint64_t> offset_values = read_array<uint64_t>(reader);
+				const std::vector<GLint> base_vertices = read_array<GLint>(reader);
+				std::vector<const void*> offsets(offset_values.size());
+				for (size_t i = 0; i < offsets.size(); i++)
+				{
+					offsets[i] = reinterpret_cast<const void*>((uintptr_t)offset_values[i]);
+				}
+				const size_t draw_count = std::min({counts.size(), offsets.size(),
+					base_vertices.size()});
+				glMultiDrawElementsBaseVertex(mode, counts.data(), type, offsets.data(),
+					(GLsizei)draw_count, base_vertices.data());
+				break;
+			}
+			case GLCommand::MultiDrawElementsIndirect:
+			{
+				const GLenum mode = reader.read<GLenum>();
+				const GLenum type = reader.read<GLenum>();
+				const uint64_t offset = reader.read<uint64_t>();
+				const GLsizei draw_count = reader.read<GLsizei>();
+				glMultiDrawElementsIndirect(mode, type, reinterpret_cast<const void*>((uintptr_t)offset),
+					draw_count, reader.read<GLsizei>());
+				break;
+			}
+			case GLCommand::PixelStorei:
+			{
+				const GLenum name = reader.read<GLenum>();
+				glPixelStorei(name, reader.read<GLint>());
+				break;
+			}
+			case GLCommand::PolygonMode:
+			{
+				const GLenum face = reader.read<GLenum>();
+				glPolygonMode(face, reader.read<GLenum>());
+				break;
+			}
+			case GLCommand::PolygonOffset:
+			{
+				const GLfloat factor = reader.read<GLfloat>();
+				glPolygonOffset(factor, reader.read<GLfloat>());
+				break;
+			}
+			case GLCommand::ReadBuffer:
+				glReadBuffer(reader.read<GLenum>());
+				break;
+			case GLCommand::RenderbufferStorage:
+			{
+				const GLenum target = reader.read<GLenum>();
+				const GLenum internal_format = reader.read<GLenum>();
+				const GLsizei width = reader.read<GLsizei>();
+				glRenderbufferStorage(target, internal_format, width, reader.read<GLsizei>());
+				break;
+			}
+			case GLCommand::ShaderSource:
+			{
+				const GLuint shader = shaders(reader.read<GLuint>());
+				const GLchar* source = reinterpret_cast<const GLchar*>(reader.read_blob(size));
+				const GLint length = (GLint)size;
+				glShaderSource(shader, 1, &source, &length);
+				break;
+			}
+			case GLCommand::TexBuffer:
+			{
+				const GLenum target = reader.read<GLenum>();
+				const GLenum internal_format = reader.read<GLenum>();
+				glTexBuffer(target, internal_format, buffers(reader.read<GLuint>()));
+				break;
+			}
+			case GLCommand::TexImage2D:
+			{
+				const GLenum target = reader.read<GLenum>();
+				const GLint level = reader.read<GLint>();
+				const GLint internal_format = reader.read<GLint>();
+				const GLsizei width = reader.read<GLsizei>();
+				const GLsizei height = reader.read<GLsizei>();
+				const GLint border = reader.read<GLint>();
+				const GLenum format = reader.read<GLenum>();
+				const GLenum type = reader.read<GLenum>();
+				glTexImage2D(target, level, internal_format, width, height, border, format, type,
+					read_pixels(reader));
+				break;
+			}
+			case GLCommand::TexImage3D:
+			{
+				const GLenum target = reader.read<GLenum>();
+				const GLint level = reader.read<GLint>();
+				const GLint internal_format = reader.read<GLint>();
+				const GLsizei width = reader.read<GLsizei>();
+				const GLsizei height = reader.read<GLsizei>();
+				const GLsizei depth = reader.read<GLsizei>();
+				const GLint border = reader.read<GLint>();
+				const GLenum format = reader.read<GLenum>();
+				const GLenum type = reader.read<GLenum>();
+				glTexImage3D(target, level, internal_format, width, height, depth, border, format,
+					type, read_pixels(reader));
+				break;
+			}
+			case GLCommand::TexParameteri:
+			{
+				const GLenum target = reader.read<GLenum>();
+				const GLenum name = reader.read<GLenum>();
+				glTexParameteri(target, name, reader.read<GLint>());
+				break;
+			}
+			case GLCommand::TexStorage2D:
+			{
+				const GLenum target = reader.read<GLenum>();
+				const GLsizei levels = reader.read<GLsizei>();
+				const GLenum internal_format = reader.read<GLenum>();
+				const GLsizei width = reader.read<GLsizei>();
+				glTexStorage2D(target, levels, internal_format, width, reader.read<GLsizei>());
+				break;
+			}
+			case GLCommand::TexSubImage2D:
+			{
+				const GLenum target = reader.read<GLenum>();
+				const GLint level = reader.read<GLint>();
+				const GLint x = reader.read<GLint>();
+				const GLint y = reader.read<GLint>();
+				const GLsizei width = reader.read<GLsizei>();
+				const GLsizei height = reader.read<GLsizei>();
+				const GLenum format = reader.read<GLenum>();
+				const GLenum type = reader.read<GLenum>();
+				glTexSubImage2D(target, level, x, y, width, height, format, type,
+					read_pixels(reader));
+				break;
+			}
+			case GLCommand::TexSubImage3D:
+			{
+				const GLenum target = reader.read<GLenum>();
+				const GLint level = reader.read<GLint>();
+				const GLint x = reader.read<GLint>();
+				const GLint y = reader.read<GLint>();
+				const GLint z = reader.read<GLint>();
+				const GLsizei width = reader.read<GLsizei>();
+				const GLsizei height = reader.read<GLsizei>();
+				const GLsizei depth = reader.read<GLsizei>();
+				const GLenum format = reader.read<GLenum>();
+				const GLenum type = reader.read<GLenum>();
+				glTexSubImage3D(target, level, x, y, z, width, height, depth, format, type,
+					read_pixels(reader));
+				break;
+			}
+			case GLCommand::TextureView:
+			{
+				const GLuint texture = textures(reader.read<GLuint>());
+				const GLenum target = reader.read<GLenum>();
+				const GLuint original = textures(reader.read<GLuint>());
+				const GLenum internal_format = reader.read<GLenum>();
+				const GLuint min_level = reader.read<GLuint>();
+				const GLuint num_levels = reader.read<GLuint>();
+				const GLuint min_layer = reader.read<GLuint>();
+				glTextureView(texture, target, original, internal_format, min_level, num_levels,
+					min_layer, reader.read<GLuint>());
+				break;
+			}
+			case GLCommand::Uniform1f:
+			{
+				const GLint location = uniform_location(reader.read<GLint>());
+				glUniform1f(location, reader.read<GLfloat>());
+				break;
+			}
+			case GLCommand::Uniform1i:
+			{
+				const GLint location = uniform_location(reader.read<GLint>());
+				glUniform1i(location, reader.read<GLint>());
+				break;
+			}
+			case GLCommand::Uniform2fv:
+			{
+				const GLint location = uniform_location(reader.read<GLint>());
+				const uint8_t* data = reader.read_blob(size);
+				std::vector<GLfloat> values(size / sizeof(GLfloat));
+				std::memcpy(values.data(), data, values.size() * sizeof(GLfloat));
+				glUniform2fv(location, (GLsizei)(values.size() / 2), values.data());
+				break;
+			}
+			case GLCommand::Uniform3fv:
+			{
+				const GLint location = uniform_location(reader.read<GLint>());
+				const uint8_t* data = reader.read_blob(size);
+				std::vector<GLfloat> values(size / sizeof(GLfloat));
+				std::memcpy(values.data(), data, values.size() * sizeof(GLfloat));
+				glUniform3fv(location, (GLsizei)(values.size() / 3), values.data());
+				break;
+			}
+			case GLCommand::Uniform3iv:
+			{
+				const GLint location = uniform_location(reader.read<GLint>());
+				const uint8_t* data = reader.read_blob(size);
+				std::vector<GLint> values(size / sizeof(GLint));
+				std::memcpy(values.data(), data, values.size() * sizeof(GLint));
+				glUniform3iv(location, (GLsizei)(values.size() / 3), values.data());
+				break;
+			}
+			case GLCommand::Uniform4fv:
+			{
+				const GLint location = uniform_location(reader.read<GLint>());
+				const uint8_t* data = reader.read_blob(size);
+				std::vector<GLfloat> values(size / sizeof(GLfloat));
+				std::memcpy(values.data(), data, values.size() * sizeof(GLfloat));
+				glUniform4fv(location, (GLsizei)(values.size() / 4), values.data());
+				break;
+			}
+			case GLCommand::UniformMatrix4fv:
+			{
+				const GLint location = uniform_location(reader.read<GLint>());
+				const GLboolean transpose = reader.read<GLboolean>();
+				const uint8_t* data = reader.read_blob(size);
+				std::vector<GLfloat> values(size / sizeof(GLfloat));
+				std::memcpy(values.data(), data, values.size() * sizeof(GLfloat));
+				glUniformMatrix4fv(location, (GLsizei)(values.size() / 16), transpose, values.data());
+				break;
+			}
+			case GLCommand::UseProgram:
+				current_program = reader.read<GLuint>();
+				glUseProgram(programs(current_program));
+				break;
+			case GLCommand::VertexAttrib4f:
+			{
+				const GLuint index = reader.read<GLuint>();
+				const GLfloat x = reader.read<GLfloat>();
+				const GLfloat y = reader.read<GLfloat>();
+				const GLfloat z = reader.read<GLfloat>();
+				const GLfloat w = reader.read<GLfloat>();
+				glVertexAttrib4f(index, x, y, z, w);
+				break;
+			}
+			case GLCommand::VertexAttribDivisor:
+			{
+				const GLuint index = reader.read<GLuint>();
+				const GLuint divisor = reader.read<GLuint>();
+				glVertexAttribDivisor(index, divisor);
+				break;
+			}
+			case GLCommand::VertexAttribPointer:
+			{
+				const GLuint index = reader.read<GLuint>();
+				const GLint components = reader.read<GLint>();
+				const GLenum type = reader.read<GLenum>();
+				const GLboolean normalized = reader.read<GLboolean>();
+				const GLsizei stride = reader.read<GLsizei>();
+				const uint64_t offset = reader.read<uint64_t>();
+				glVertexAttribPointer(index, components, type, normalized, stride,
+					reinterpret_cast<const void*>((uintptr_t)offset));
+				break;
+			}
+			case GLCommand::Viewport:
+			{
+				const GLint x = reader.read<GLint>();
+				const GLint y = reader.read<GLint>();
+				const GLsizei width = reader.read<GLsizei>();
+				glViewport(x, y, width, reader.read<GLsizei>());
+				break;
+			}
+			case GLCommand::EndFrame:
+				if (finish)
+				{
+					glFinish();
+				}
+				break;
+			case GLCommand::Count:
+				break;
+		}
+	}
+
+	void Replayer::print_report() const
+	{
+		const TimingSummary frames = summarize_timings(frame_times);
+		std::cout << std::fixed << std::setprecision(3)
+				  << "Replayed " << frame_times.size() << " frames, " << call_count
+				  << " calls in " << replay_seconds * 1000.0 << " ms\n"
+				  << "Frame ms: mean " << frames.mean << ", median " << frames.median
+				  << ", p99 " << frames.p99 << ", min " << frames.min << ", max " << frames.max
+				  << "\n\n";
+
+		double total_ns = 0.0;
+		std::vector<size_t> order;
+		for (size_t i = 0; i < calls.size(); i++)
+		{
+			total_ns += calls[i].total_ns;
+			if (calls[i].count > 0)
+			{
+				order.push_back(i);
+			}
+		}
+		std::sort(order.begin(), order.end(), [this](size_t a, size_t b) {
+			return calls[a].total_ns > calls[b].total_ns;
+		});
+
+		std::cout << std::left << std::setw(26) << "call" << std::right << std::setw(10)
+				  << "count" << std::setw(12) << "total ms" << std::setw(11) << "mean us"
+				  << std::setw(11) << "max us" << std::setw(9) << "share" << "\n";
+		for (const size_t i : order)
+		{
+			const CallStats& stats = calls[i];
+			std::cout << std::left << std::setw(26) << gl_command_name((GLCommand)i) << std::right
+					  << std::setw(10) << stats.count
+					  << std::setw(12) << stats.total_ns / 1e6
+					  << std::setw(11) << stats.total_ns / (double)stats.count / 1e3
+					  << std::setw(11) << stats.max_ns / 1e3
+					  << std::setw(8) << (total_ns > 0.0 ? stats.total_ns / total_ns * 100.0 : 0.0)
+					  << "%\n";
+		}
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	if (argc < 2)
+	{
+		std::cerr << "Usage: glreplay <stream> [--finish]\n";
+		return 1;
+	}
+
+	bool finish = false;
+	for (int i = 2; i < argc; i++)
+	{
+		if (std::strcmp(argv[i], "--finish") == 0)
+		{
+			finish = true;
+		}
+		else
+		{
+			std::cerr << "Unknown option: " << argv[i] << "\n";
+			return 1;
+		}
+	}
+
+	CommandReader reader;
+	if (!reader.open(argv[1]))
+	{
+		return 1;
+	}
+
+	Replayer replayer;
+	if (!replayer.initialize(reader.header(), finish))
+	{
+		replayer.destroy();
+		return 1;
+	}
+
+	const bool complete = replayer.replay(reader);
+	if (!complete)
+	{
+		std::cerr << "Command stream ended early\n";
+	}
+	replayer.print_report();
+	replayer.destroy();
+
+	return complete ? 0 : 1;
+}
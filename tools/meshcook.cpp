@@ -0,0 +1,218 @@
+// Offline mesh cooker: loads OBJ files, compresses their welded vertices and
+// indices with the mesh codec, checks the result decodes back bit for bit
+// and optionally writes it next to the source as .glmz. For each mesh and
+// for the corpus as a whole, reports the size and decode throughput of the
+// raw buffers, of the plain LZ stage run over them as a generic compressor,
+// and of the codec on one thread and on every thread.
+//
+// Usage: meshcook [--write] <input.obj> [<input.obj> ...]
+
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "../src/Jobs/JobSystem.h"
+#include "../src/Model/MeshCodec.h"
+#include "../src/Model/Model.h"
+
+namespace
+{
+	// Decodes are repeated for at least this long, so small meshes time
+	// more than a handful of microseconds
+	constexpr double MIN_TIMING_SECONDS = 0.25;
+
+	struct Measurement
+	{
+		uint64_t bytes = 0;
+		double seconds = 0.0; // per decode
+	};
+
+	struct Totals
+	{
+		uint64_t raw_bytes = 0;
+		Measurement raw;
+		Measurement lz;
+		Measurement codec;
+		Measurement codec_parallel;
+	};
+
+	double seconds_since(std::chrono::steady_clock::time_point start)
+	{
+		return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	}
+
+	template <typename Function>
+	double time_repeated(const Function& function)
+	{
+		uint32_t runs = 0;
+		const auto start = std::chrono::steady_clock::now();
+		double elapsed = 0.0;
+		do
+		{
+			function();
+			runs++;
+			elapsed = seconds_since(start);
+		} while (elapsed < MIN_TIMING_SECONDS);
+		return elapsed / runs;
+	}
+
+	void print_measurement(const char* label, const Measurement& measurement, uint64_t raw_bytes)
+	{
+		const double mb = 1024.0 * 1024.0;
+		std::cout << "  " << std::left << std::setw(16) << label << std::right << std::fixed
+				  << std::setprecision(2) << std::setw(9) << (double)measurement.bytes / mb << " MB "
+				  << std::setw(7) << (double)raw_bytes / (double)measurement.bytes << ":1 "
+				  << std::setw(9) << (double)raw_bytes / mb / 1024.0 / measurement.seconds
+				  << " GB/s\n";
+	}
+
+	void add(Measurement& total, const Measurement& measurement)
+	{
+		total.bytes += measurement.bytes;
+		total.seconds += measurement.seconds;
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	bool write = false;
+	std::vector<std::string> inputs;
+	for (int i = 1; i < argc; i++)
+	{
+		const std::string arg = argv[i];
+		if (arg == "--write")
+		{
+			write = true;
+		}
+		else
+		{
+			inputs.push_back(arg);
+		}
+	}
+	if (inputs.empty())
+	{
+		std::cerr << "Usage: meshcook [--write] <input.obj> [<input.obj> ...]\n";
+		return 1;
+	}
+
+	JobSystem jobs;
+	jobs.initialize();
+
+	Totals totals;
+	bool failed = false;
+	for (const std::string& input : inputs)
+	{
+		const std::shared_ptr<Model> model = load_model_from_obj(input.c_str());
+		if (!model)
+		{
+			failed = true;
+			continue;
+		}
+
+		const std::vector<Vertex>& vertices = model->vertices;
+		const std::vector<uint32_t>& indices = model->indices;
+		const size_t vertex_bytes = vertices.size() * sizeof(Vertex);
+		const size_t index_bytes = indices.size() * sizeof(uint32_t);
+		const uint64_t raw_bytes = vertex_bytes + index_bytes;
+
+		// Reading the raw buffers is a copy
+		std::vector<Vertex> decoded_vertices(vertices.size());
+		std::vector<uint32_t> decoded_indices(indices.size());
+		Measurement raw;
+		raw.bytes = raw_bytes;
+		raw.seconds = time_repeated([&] {
+			std::memcpy(decoded_vertices.data(), vertices.data(), vertex_bytes);
+			std::memcpy(decoded_indices.data(), indices.data(), index_bytes);
+		});
+
+		// The LZ stage on the unfiltered buffers stands in for a generic
+		// compressor
+		std::vector<uint8_t> lz_vertices;
+		std::vector<uint8_t> lz_indices;
+		lz_compress(reinterpret_cast<const uint8_t*>(vertices.data()), vertex_bytes, lz_vertices);
+		lz_compress(reinterpret_cast<const uint8_t*>(indices.data()), index_bytes, lz_indices);
+		Measurement lz;
+		lz.bytes = lz_vertices.size() + lz_indices.size();
+		lz.seconds = time_repeated([&] {
+			lz_decompress(lz_vertices.data(), lz_vertices.size(),
+				reinterpret_cast<uint8_t*>(decoded_vertices.data()), vertex_bytes);
+			lz_decompress(lz_indices.data(), lz_indices.size(),
+				reinterpret_cast<uint8_t*>(decoded_indices.data()), index_bytes);
+		});
+
+		auto start = std::chrono::steady_clock::now();
+		const std::vector<uint8_t> encoded = encode_mesh(vertices.data(), (uint32_t)vertices.size(),
+			sizeof(Vertex), indices.data(), (uint32_t)indices.size());
+		const double encode_seconds = seconds_since(start);
+
+		// Scrub the output first, so a decode that writes nothing can't pass
+		std::memset(decoded_vertices.data(), 0, vertex_bytes);
+		std::memset(decoded_indices.data(), 0, index_bytes);
+		if (!decode_mesh(encoded.data(), encoded.size(), decoded_vertices.data(),
+				decoded_indices.data())
+			|| std::memcmp(decoded_vertices.data(), vertices.data(), vertex_bytes) != 0
+			|| std::memcmp(decoded_indices.data(), indices.data(), index_bytes) != 0)
+		{
+			std::cerr << input << ": decoded mesh doesn't match the source\n";
+			failed = true;
+			continue;
+		}
+
+		Measurement codec;
+		codec.bytes = encoded.size();
+		codec.seconds = time_repeated([&] {
+			decode_mesh(encoded.data(), encoded.size(), decoded_vertices.data(),
+				decoded_indices.data());
+		});
+		Measurement codec_parallel;
+		codec_parallel.bytes = encoded.size();
+		codec_parallel.seconds = time_repeated([&] {
+			decode_mesh(encoded.data(), encoded.size(), decoded_vertices.data(),
+				decoded_indices.data(), &jobs);
+		});
+
+		std::cout << input << " (" << vertices.size() << " vertices, " << indices.size() / 3
+				  << " triangles, encoded in " << std::setprecision(2) << std::fixed
+				  << encode_seconds * 1000.0 << " ms)\n";
+		print_measurement("raw", raw, raw_bytes);
+		print_measurement("lz", lz, raw_bytes);
+		print_measurement("codec", codec, raw_bytes);
+		print_measurement("codec parallel", codec_parallel, raw_bytes);
+
+		totals.raw_bytes += raw_bytes;
+		add(totals.raw, raw);
+		add(totals.lz, lz);
+		add(totals.codec, codec);
+		add(totals.codec_parallel, codec_parallel);
+
+		if (write)
+		{
+			const std::string output = input.substr(0, input.rfind('.')) + ".glmz";
+			std::ofstream file(output, std::ios::binary);
+			file.write(reinterpret_cast<const char*>(encoded.data()), (std::streamsize)encoded.size());
+			if (!file)
+			{
+				std::cerr << "Unable to write " << output << "\n";
+				failed = true;
+			}
+		}
+	}
+
+	if (inputs.size() > 1 && totals.raw_bytes > 0)
+	{
+		std::cout << "Corpus of " << inputs.size() << " meshes\n";
+		print_measurement("raw", totals.raw, totals.raw_bytes);
+		print_measurement("lz", totals.lz, totals.raw_bytes);
+		print_measurement("codec", totals.codec, totals.raw_bytes);
+		print_measurement("codec parallel", totals.codec_parallel, totals.raw_bytes);
+	}
+	std::cout << "Parallel decodes on " << jobs.worker_count() + 1 << " threads\n";
+
+	jobs.destroy();
+
+	return failed ? 1 : 0;
+}
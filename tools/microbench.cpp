@@ -0,0 +1,462 @@
+// Micro-benchmarks for the CPU kernels of the loader and renderer, each run
+// in isolation on synthetic data. Every benchmark warms up, then times a
+// number of repetitions with the time stamp counter, which ticks at a
+// constant rate whatever the core clock is doing. Repetitions slowed down
+// by interrupts or migrations are rejected as outliers before reporting.
+//
+// Usage: microbench [--filter <name>] [--reps <N>] [--warmup <N>]
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#if defined(__x86_64__)
+#include <x86intrin.h>
+#endif
+
+#include <glm/ext/matrix_transform.hpp>
+
+#include "../src/Jobs/JobSystem.h"
+#include "../src/Model/Meshlet.h"
+#include "../src/Model/Model.h"
+#include "../src/Renderer/Camera.h"
+#include "../src/Renderer/Culling.h"
+#include "../src/Renderer/LightClusters.h"
+#include "../src/Memory/LinearArena.h"
+#include "../src/Renderer/DrawList.h"
+
+#if defined(__clang__)
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Weverything"
+#endif
+#include <fast_obj/fast_obj.h>
+#if defined(__clang__)
+#pragma clang diagnostic pop
+#endif
+
+namespace
+{
+	// Samples further than this many deviations above the median are
+	// rejected. Noise only ever makes a repetition slower.
+	constexpr double OUTLIER_DEVIATIONS = 5.0;
+	// Scales the median absolute deviation to a standard deviation
+	constexpr double MAD_TO_SIGMA = 1.4826;
+
+	// Vertices along each side of the synthetic grid meshes
+	constexpr uint32_t GRID_SIZE = 256;
+	constexpr uint32_t FLOAT_LINES = 100000;
+	constexpr uint32_t INSTANCE_COUNT = 100000;
+
+	struct Options
+	{
+		std::string filter;
+		uint32_t reps = 50;
+		uint32_t warmup = 5;
+	};
+
+	uint64_t read_cycles()
+	{
+#if defined(__x86_64__)
+		// The fences keep the read from drifting into the timed code
+		_mm_lfence();
+		const uint64_t cycles = __rdtsc();
+		_mm_lfence();
+		return cycles;
+#else
+		return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+			std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+	}
+
+	// Counter ticks per nanosecond, measured against the steady clock
+	double calibrate_cycles_per_ns()
+	{
+		const auto start = std::chrono::steady_clock::now();
+		const uint64_t start_cycles = read_cycles();
+		while (std::chrono::steady_clock::now() - start < std::chrono::milliseconds(100))
+		{
+		}
+		const uint64_t cycles = read_cycles() - start_cycles;
+		const double ns = (double)std::chrono::duration_cast<std::chrono::nanoseconds>(
+			std::chrono::steady_clock::now() - start).count();
+		return (double)cycles / ns;
+	}
+
+	// Stops the compiler from throwing away results nobody reads
+	template <typename T>
+	void keep(const T& value)
+	{
+		asm volatile("" : : "g"(&value) : "memory");
+	}
+
+	double median_of(std::vector<double> values)
+	{
+		std::sort(values.begin(), values.end());
+		const size_t middle = values.size() / 2;
+		return values.size() % 2 ? values[middle] : (values[middle - 1] + values[middle]) * 0.5;
+	}
+
+	class Harness
+	{
+	public:
+		explicit Harness(const Options& harness_options)
+			: options(harness_options), cycles_per_ns(calibrate_cycles_per_ns())
+		{
+			std::cout << std::fixed << std::setprecision(3) << "Counter at " << cycles_per_ns
+					  << " ticks/ns, " << options.reps << " repetitions after " << options.warmup
+					  << " warmup runs, times in ticks per item\n\n"
+					  << std::left << std::setw(16) << "benchmark" << std::right
+					  << std::setw(10) << "items" << std::setw(12) << "mean"
+					  << std::setw(12) << "median" << std::setw(12) << "min"
+					  << std::setw(10) << "mad" << std::setw(12) << "ns/item"
+					  << std::setw(10) << "rejected" << "\n";
+		}
+
+		// Times kernel, which processes items items per call. prepare runs
+		// before each call, untimed, to restore whatever the kernel consumes.
+		void run(const char* name, uint64_t items, const std::function<void()>& kernel,
+			const std::function<void()>& prepare = nullptr)
+		{
+			if (!options.filter.empty() && std::string(name).find(options.filter) == std::string::npos)
+			{
+				return;
+			}
+
+			for (uint32_t i = 0; i < options.warmup; i++)
+			{
+				if (prepare)
+				{
+					prepare();
+				}
+				kernel();
+			}
+
+			std::vector<double> samples;
+			for (uint32_t i = 0; i < options.reps; i++)
+			{
+				if (prepare)
+				{
+					prepare();
+				}
+				const uint64_t start = read_cycles();
+				kernel();
+				samples.push_back((double)(read_cycles() - start) / (double)items);
+			}
+
+			const double median = median_of(samples);
+			std::vector<double> deviations;
+			for (const double sample : samples)
+			{
+				deviations.push_back(std::abs(sample - median));
+			}
+			const double mad = median_of(deviations);
+
+			const double limit = median + OUTLIER_DEVIATIONS * MAD_TO_SIGMA * mad;
+			const size_t sample_count = samples.size();
+			samples.erase(std::remove_if(samples.begin(), samples.end(),
+				[limit](double sample) { return sample > limit; }), samples.end());
+
+			double sum = 0.0;
+			for (const double sample : samples)
+			{
+				sum += sample;
+			}
+			const double mean = sum / (double)samples.size();
+
+			std::cout << std::fixed << std::setprecision(2) << std::left << std::setw(16)
+					  << name << std::right << std::setw(10) << items
+					  << std::setw(12) << mean << std::setw(12) << median_of(samples)
+					  << std::setw(12) << *std::min_element(samples.begin(), samples.end())
+					  << std::setw(10) << mad << std::setw(12) << mean / cycles_per_ns
+					  << std::setw(10) << sample_count - samples.size() << "\n";
+		}
+
+	private:
+		Options options;
+		double cycles_per_ns;
+	};
+
+	// Serves fast_obj its input from memory instead of a file
+	struct MemoryFile
+	{
+		const std::string* text = nullptr;
+		size_t position = 0;
+	};
+
+	fastObjMesh* parse_obj(const std::string& text)
+	{
+		MemoryFile file;
+		file.text = &text;
+
+		fastObjCallbacks callbacks;
+		callbacks.file_open = [](const char*, void* user_data) -> void* { return user_data; };
+		callbacks.file_close = [](void*, void*) {};
+		callbacks.file_read = [](void* handle, void* destination, size_t bytes, void*) {
+			MemoryFile& memory = *static_cast<MemoryFile*>(handle);
+			const size_t count = std::min(bytes, memory.text->size() - memory.position);
+			std::memcpy(destination, memory.text->data() + memory.position, count);
+			memory.position += count;
+			return count;
+		};
+		callbacks.file_size = [](void* handle, void*) {
+			return (unsigned long)static_cast<MemoryFile*>(handle)->text->size();
+		};
+
+		return fast_obj_read_with_callbacks("memory.obj", &callbacks, &file);
+	}
+
+	// A wavy grid with positions, uvs and normals, written as quads so the
+	// loader has polygons to triangulate and shared corners to weld
+	std::string grid_obj()
+	{
+		std::string text;
+		char line[128];
+		for (uint32_t y = 0; y < GRID_SIZE; y++)
+		{
+			for (uint32_t x = 0; x < GRID_SIZE; x++)
+			{
+				const float u = (float)x / (float)(GRID_SIZE - 1);
+				const float v = (float)y / (float)(GRID_SIZE - 1);
+				std::snprintf(line, sizeof(line), "v %f %f %f\nvt %f %f\nvn 0 1 0\n",
+					(double)u, (double)(0.1f * std::sin(u * 20.0f) * std::cos(v * 20.0f)),
+					(double)v, (double)u, (double)v);
+				text += line;
+			}
+		}
+		for (uint32_t y = 0; y + 1 < GRID_SIZE; y++)
+		{
+			for (uint32_t x = 0; x + 1 < GRID_SIZE; x++)
+			{
+				const uint32_t a = y * GRID_SIZE + x + 1;
+				const uint32_t b = a + 1;
+				const uint32_t c = a + GRID_SIZE + 1;
+				const uint32_t d = a + GRID_SIZE;
+				std::snprintf(line, sizeof(line), "f %u/%u/%u %u/%u/%u %u/%u/%u %u/%u/%u\n",
+					a, a, a, b, b, b, c, c, c, d, d, d);
+				text += line;
+			}
+		}
+		return text;
+	}
+
+	void benchmark_loader(Harness& harness)
+	{
+		// Nothing but vertex positions, so parsing floats is all there is
+		std::mt19937 random(1);
+		std::uniform_real_distribution<float> coordinate(-1000.0f, 1000.0f);
+		std::string floats;
+		char line[96];
+		for (uint32_t i = 0; i < FLOAT_LINES; i++)
+		{
+			std::snprintf(line, sizeof(line), "v %.6f %.6f %.6f\n", (double)coordinate(random),
+				(double)coordinate(random), (double)coordinate(random));
+			floats += line;
+		}
+		harness.run("obj_floats", FLOAT_LINES * 3, [&floats] {
+			fastObjMesh* mesh = parse_obj(floats);
+			keep(mesh->positions[3]);
+			fast_obj_destroy(mesh);
+		});
+
+		fastObjMesh* grid = parse_obj(grid_obj());
+		std::vector<Vertex> vertices;
+		std::vector<std::vector<uint32_t>> material_indices;
+		harness.run("weld_vertices", grid->index_count, [&] {
+			weld_obj_mesh(grid, vertices, material_indices);
+			keep(vertices.back());
+		}, [&] {
+			vertices.clear();
+			material_indices.assign(1, std::vector<uint32_t>());
+		});
+		fast_obj_destroy(grid);
+	}
+
+	// The welded grid, ready for the renderer's kernels
+	void grid_model(Model& model)
+	{
+		fastObjMesh* grid = parse_obj(grid_obj());
+		std::vector<std::vector<uint32_t>> material_indices(1);
+		weld_obj_mesh(grid, model.vertices, material_indices);
+		fast_obj_destroy(grid);
+
+		model.indices = std::move(material_indices[0]);
+		ModelLod lod;
+		lod.index_count = (uint32_t)model.indices.size();
+		lod.submeshes.push_back({0, lod.index_count, 0});
+		model.lods.push_back(lod);
+		model.materials.emplace_back();
+		model.bounds_max = glm::vec3(1.0f, 0.1f, 1.0f);
+		model.radius = 0.75f;
+	}
+
+	void benchmark_renderer(Harness& harness)
+	{
+		Model model;
+		grid_model(model);
+
+		// Meshlet building is the pass that reorders the index buffer
+		std::vector<uint32_t> indices;
+		std::vector<Meshlet> meshlets;
+		harness.run("build_meshlets", model.indices.size() / 3, [&] {
+			build_meshlets(meshlets, model.vertices, indices.data(), indices.size(), 0);
+			keep(meshlets.back());
+		}, [&] {
+			indices = model.indices;
+			meshlets.clear();
+		});
+
+		// Looking at part of the grid, so some meshlets survive and some don't
+		model.generate_meshlets();
+		Camera camera;
+		camera.position = glm::vec3(0.25f, 0.5f, 0.75f);
+		camera.target = glm::vec3(0.5f, 0.0f, 0.25f);
+		const glm::mat4 view_projection = camera.projection(16.0f / 9.0f) * camera.view();
+		const Frustum frustum = extract_frustum(view_projection);
+		std::vector<DrawRange> ranges;
+		harness.run("cull_meshlets", model.meshlets.size(), [&] {
+			CullStats stats;
+			cull_meshlets(model, glm::mat4(1.0f), frustum, camera.position, ranges, stats);
+			keep(stats);
+		}, [&ranges] { ranges.clear(); });
+
+		// Instances scattered around the camera, as draw_models sees them
+		std::mt19937 random(2);
+		std::uniform_real_distribution<float> position(-50.0f, 50.0f);
+		std::uniform_real_distribution<float> scale(0.5f, 2.0f);
+		std::vector<glm::mat4> transforms(INSTANCE_COUNT);
+		for (glm::mat4& transform : transforms)
+		{
+			transform = glm::scale(glm::translate(glm::mat4(1.0f),
+				glm::vec3(position(random), position(random), position(random))),
+				glm::vec3(scale(random)));
+		}
+
+		std::vector<uint8_t> visible(INSTANCE_COUNT);
+		harness.run("cull_spheres", INSTANCE_COUNT, [&] {
+			for (size_t i = 0; i < transforms.size(); i++)
+			{
+				const glm::vec3 center = glm::vec3(transforms[i][3]);
+				visible[i] = sphere_in_frustum(frustum, center, max_axis_scale(transforms[i]));
+			}
+			keep(visible.back());
+		});
+
+		std::vector<glm::mat4> model_view_projections(INSTANCE_COUNT);
+		harness.run("batch_matrices", INSTANCE_COUNT, [&] {
+			for (size_t i = 0; i < transforms.size(); i++)
+			{
+				model_view_projections[i] = view_projection * transforms[i];
+			}
+			keep(model_view_projections.back());
+		});
+
+		// A few hundred materials and vertex arrays, like a busy scene
+		std::uniform_int_distribution<uint32_t> state(0, 255);
+		std::uniform_real_distribution<float> depth(0.0f, 1.0f);
+		std::vector<uint32_t> materials(INSTANCE_COUNT);
+		std::vector<uint32_t> vertex_arrays(INSTANCE_COUNT);
+		std::vector<float> depths(INSTANCE_COUNT);
+		for (size_t i = 0; i < INSTANCE_COUNT; i++)
+		{
+			materials[i] = state(random);
+			vertex_arrays[i] = state(random);
+			depths[i] = depth(random);
+		}
+		const DrawRange range{0, 3, 0};
+		LinearArena arena;
+		DrawList draw_list;
+		harness.run("sort_keys", INSTANCE_COUNT, [&] {
+			arena.reset();
+			draw_list.clear(arena);
+			for (uint32_t i = 0; i < INSTANCE_COUNT; i++)
+			{
+				const uint64_t key = make_sort_key(materials[i] / 16, vertex_arrays[i],
+					materials[i], depths[i]);
+				draw_list.add(key, i, materials[i], &range, 1);
+			}
+			draw_list.sort();
+			keep(draw_list.items.front());
+		});
+	}
+
+	void benchmark_lights(Harness& harness)
+	{
+		// Lights scattered over a field the camera looks across, spaced so
+		// each reaches a few neighbours whatever their number
+		JobSystem jobs;
+		jobs.initialize();
+		Camera camera;
+		camera.position = glm::vec3(0.0f, 10.0f, 60.0f);
+		camera.target = glm::vec3(0.0f);
+		camera.far_plane = 200.0f;
+
+		for (const uint32_t count : {256u, 1024u, 4096u})
+		{
+			std::mt19937 random(3);
+			std::uniform_real_distribution<float> position(-50.0f, 50.0f);
+			std::uniform_real_distribution<float> height(0.0f, 5.0f);
+			std::vector<Light> lights(count);
+			for (uint32_t i = 0; i < count; i++)
+			{
+				Light& light = lights[i];
+				light.position = glm::vec3(position(random), height(random), position(random));
+				light.range = 150.0f / std::sqrt((float)count);
+				if (i % 4 == 0)
+				{
+					light.type = LightType::Spot;
+					light.direction = glm::vec3(0.2f, -1.0f, 0.1f);
+				}
+			}
+
+			LightClusters clusters;
+			const std::string name = "assign_lights_" + std::to_string(count);
+			harness.run(name.c_str(), count, [&] {
+				clusters.assign(lights, camera, 16.0f / 9.0f, jobs);
+				keep(clusters.stats);
+			});
+		}
+
+		jobs.destroy();
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	Options options;
+	for (int i = 1; i < argc; i++)
+	{
+		if (std::strcmp(argv[i], "--filter") == 0 && i + 1 < argc)
+		{
+			options.filter = argv[++i];
+		}
+		else if (std::strcmp(argv[i], "--reps") == 0 && i + 1 < argc)
+		{
+			options.reps = std::max((uint32_t)std::strtoul(argv[++i], nullptr, 10), 1u);
+		}
+		else if (std::strcmp(argv[i], "--warmup") == 0 && i + 1 < argc)
+		{
+			options.warmup = (uint32_t)std::strtoul(argv[++i], nullptr, 10);
+		}
+		else
+		{
+			std::cerr << "Usage: microbench [--filter <name>] [--reps <N>] [--warmup <N>]\n";
+			return 1;
+		}
+	}
+
+	Harness harness(options);
+	benchmark_loader(harness);
+	benchmark_renderer(harness);
+	benchmark_lights(harness);
+
+	return 0;
+}
@@ -0,0 +1,128 @@
+// Scene cooker: loads OBJ models, scatters placements of them over a square
+// field and writes a .glscene file the renderer maps and draws directly.
+// Reports how long building the hierarchy and writing took, how long
+// opening the result takes, and how long culling it takes from a camera
+// looking across the field.
+//
+// Usage: scenecook <output.glscene> <placements> <input.obj> [<input.obj> ...]
+
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <glm/gtc/quaternion.hpp>
+
+#include "../src/Model/Model.h"
+#include "../src/Renderer/Camera.h"
+#include "../src/Renderer/Culling.h"
+#include "../src/Scene/SceneFile.h"
+
+namespace
+{
+	// Opens and culls are repeated this many times and averaged
+	constexpr int TIMING_RUNS = 10;
+	// Room around each placement, in multiples of the largest radius
+	constexpr float PLACEMENT_SPACING = 3.0f;
+
+	double seconds_since(std::chrono::steady_clock::time_point start)
+	{
+		return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	if (argc < 4)
+	{
+		std::cerr << "Usage: scenecook <output.glscene> <placements> <input.obj> [<input.obj> ...]\n";
+		return 1;
+	}
+
+	const std::string output = argv[1];
+	const uint32_t placement_count = (uint32_t)std::strtoul(argv[2], nullptr, 10);
+
+	std::vector<SceneMeshSource> meshes;
+	float largest_radius = 0.0f;
+	for (int i = 3; i < argc; i++)
+	{
+		const std::shared_ptr<Model> model = load_model_from_obj(argv[i]);
+		if (!model)
+		{
+			return 1;
+		}
+
+		SceneMeshSource mesh;
+		mesh.path = argv[i];
+		mesh.lod_count = MAX_MODEL_LODS;
+		mesh.bounds_min = model->bounds_min;
+		mesh.bounds_max = model->bounds_max;
+		mesh.radius = model->radius;
+		mesh.materials = model->materials;
+		meshes.push_back(mesh);
+		largest_radius = std::max(largest_radius, model->radius);
+	}
+
+	// Same seed every time, so runs are comparable
+	std::mt19937 random(1);
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+	const float side = std::sqrt((float)placement_count) * largest_radius * PLACEMENT_SPACING;
+	std::vector<ScenePlacement> placements(placement_count);
+	for (ScenePlacement& placement : placements)
+	{
+		placement.mesh = (uint32_t)(random() % meshes.size());
+		placement.position = glm::vec3(unit(random) * side, 0.0f, unit(random) * side);
+		placement.rotation = glm::angleAxis(unit(random) * 6.2831853f, glm::vec3(0.0f, 1.0f, 0.0f));
+		placement.scale = 0.5f + unit(random);
+	}
+
+	auto start = std::chrono::steady_clock::now();
+	if (!write_scene_file(output, meshes, std::move(placements)))
+	{
+		return 1;
+	}
+	const double write_seconds = seconds_since(start);
+
+	double open_seconds = 0.0;
+	SceneFile scene;
+	for (int i = 0; i < TIMING_RUNS; i++)
+	{
+		start = std::chrono::steady_clock::now();
+		if (!scene.open(output))
+		{
+			return 1;
+		}
+		open_seconds += seconds_since(start);
+	}
+
+	// From the middle of the field, looking towards one edge
+	Camera camera;
+	camera.position = glm::vec3(side * 0.5f, largest_radius * 4.0f, side * 0.5f);
+	camera.target = glm::vec3(side, 0.0f, side * 0.5f);
+	camera.far_plane = side * 2.0f;
+	const Frustum frustum = extract_frustum(camera.projection(16.0f / 9.0f) * camera.view());
+	std::vector<uint32_t> visible;
+	CullStats stats;
+	start = std::chrono::steady_clock::now();
+	for (int i = 0; i < TIMING_RUNS; i++)
+	{
+		visible.clear();
+		stats = CullStats();
+		cull_scene(scene.header(), frustum, visible, stats);
+	}
+	const double cull_seconds = seconds_since(start) / TIMING_RUNS;
+
+	const SceneFileHeader& header = scene.header();
+	std::cout << output << ": " << header.instance_count << " instances of "
+			  << header.meshes.count << " meshes, " << header.nodes.count << " hierarchy nodes, "
+			  << (double)header.file_size / (1024.0 * 1024.0) << " MB\n"
+			  << "  build and write: " << write_seconds * 1000.0 << " ms\n"
+			  << "  open: " << open_seconds / TIMING_RUNS * 1000.0 << " ms\n"
+			  << "  cull: " << cull_seconds * 1000.0 << " ms, " << visible.size()
+			  << " visible, " << stats.tested << " tested one by one\n";
+
+	return 0;
+}